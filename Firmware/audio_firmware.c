@@ -5,18 +5,154 @@
  */
 
 #include "audio_firmware.h"
+#include "hampod_frame.h"
 #include "hal/hal_audio.h"
+#include "hal/hal_audio_stats.h"
 #include "hal/hal_tts.h"
 
 extern pid_t controller_pid;
 unsigned char audio_running = 1;
-pthread_mutex_t audio_queue_lock;
-pthread_mutex_t audio_queue_available;
 pthread_mutex_t audio_lock;
 
-void audio_process() {
+/* Carry out one audio request and return the result sent back to Software.
+ * The worker runs FRAME_CLASS_BULK requests; the IO thread runs every more
+ * urgent class itself, so interrupts, beeps, speed changes and queries never
+ * wait behind queued speech. ring is only passed by the IO thread, the
+ * ring's producer, which is the only thread allowed to flush it. */
+static int audio_execute(const unsigned char *data, unsigned short size,
+                         Packet_ring *ring) {
+  char requested_string[PACKET_RING_DATA_SIZE + 1];
   char buffer[MAXSTRINGSIZE];
+  if (size > PACKET_RING_DATA_SIZE) {
+    size = PACKET_RING_DATA_SIZE;
+  }
+  memcpy(requested_string, data, size);
+  requested_string[size] = '\0';
+  char audio_type_byte = requested_string[0];
+  char *remaining_string = requested_string + 1;
+  int system_result;
 
+  if (audio_type_byte == 'd') {
+    /* New TTS request - clear interrupt so this can play */
+    hal_audio_clear_interrupt();
+    AUDIO_PRINTF("TTS speak (direct): %s\n", remaining_string);
+    system_result = hal_tts_speak(remaining_string, NULL);
+  } else if (audio_type_byte == 'p') {
+    /* Playing audio file - clear interrupt so this can play */
+    hal_audio_clear_interrupt();
+    snprintf(buffer, sizeof(buffer), "%s.wav", remaining_string);
+    AUDIO_PRINTF("Now playing %s with HAL\n", remaining_string);
+    system_result = hal_audio_play_file(buffer);
+  } else if (audio_type_byte == 's') {
+    /* Speed setting. Format: "s1.0" where 1.0 is the speed value. */
+    float speed = atof(remaining_string);
+    AUDIO_PRINTF("Setting speed to %.2f\n", speed);
+    system_result = hal_tts_set_speed(speed);
+  } else if (audio_type_byte == 'v') {
+    /* Volume. Format: "v80" sets the software gain to 80%; "vm80" sets the
+     * card's own mixer control instead. */
+    if (remaining_string[0] == 'm') {
+      AUDIO_PRINTF("Setting mixer volume to %s%%\n", remaining_string + 1);
+      system_result = hal_audio_set_mixer_volume(atoi(remaining_string + 1));
+    } else {
+      AUDIO_PRINTF("Setting volume to %s%%\n", remaining_string);
+      system_result = hal_audio_set_volume(atoi(remaining_string));
+    }
+  } else if (audio_type_byte == 'o') {
+    /* Output geometry. Format: "o10,40" for 10 ms periods in a 40 ms
+     * buffer; "o10,40,m" also mixes straight into the mapped buffer. */
+    int period_ms = 0;
+    int buffer_ms = 0;
+    char mode = '\0';
+    sscanf(remaining_string, "%d,%d,%c", &period_ms, &buffer_ms, &mode);
+    AUDIO_PRINTF("Setting output to %d ms periods, %d ms buffer\n", period_ms,
+                 buffer_ms);
+    system_result = hal_audio_set_output(period_ms, buffer_ms, mode == 'm');
+  } else if (audio_type_byte == 'b') {
+    /* Beep request: remaining_string is beep type ('k'=keypress, 'h'=hold,
+     * 'e'=error). Clearing the interrupt first means a beep is not
+     * swallowed by an interrupt sent for the same key press. */
+    hal_audio_clear_interrupt();
+    BeepType beep_type;
+    switch (remaining_string[0]) {
+    case '\0':
+    case 'k':
+      beep_type = BEEP_KEYPRESS;
+      break;
+    case 'h':
+      beep_type = BEEP_HOLD;
+      break;
+    case 'e':
+      beep_type = BEEP_ERROR;
+      break;
+    default:
+      AUDIO_PRINTF("Unknown beep type: %c\n", remaining_string[0]);
+      beep_type = BEEP_KEYPRESS;
+    }
+    system_result = audio_play_beep(beep_type);
+  } else if (audio_type_byte == 'i') {
+    /* Interrupt request */
+    AUDIO_PRINTF("Interrupting audio playback\n");
+    hal_audio_interrupt();
+    hal_tts_interrupt();
+    if (ring != NULL) {
+      /* Queued speech must not play after the interrupt */
+      packet_ring_flush(ring);
+    }
+    system_result = 0;
+  } else if (audio_type_byte == 'q') {
+    /* Query audio device info - return card number */
+    AUDIO_PRINTF("Querying audio device info\n");
+    system_result = hal_audio_get_card_number();
+    AUDIO_PRINTF("Returning card number: %d\n", system_result);
+  } else {
+    AUDIO_PRINTF("Audio error. Unrecognized packet data %s\n",
+                 requested_string);
+    system_result = -1;
+  }
+  return system_result;
+}
+
+static void copy_latency(Audio_latency_wire *wire,
+                         const LatencySummary *summary) {
+  wire->count = summary->count;
+  wire->p50_us = summary->p50_us;
+  wire->p90_us = summary->p90_us;
+  wire->p99_us = summary->p99_us;
+  wire->max_us = summary->max_us;
+}
+
+/* Answer an AUDIO_REQUEST_STATS packet ("m", or "mr" to zero afterwards) */
+static void audio_send_stats(int output_pipe_fd, unsigned short tag,
+                             const unsigned char *data, unsigned short size) {
+  AudioStatsSnapshot snapshot;
+  Audio_stats_payload payload;
+
+  hal_stats_snapshot(&snapshot);
+  if (size > 1 && data[1] == 'r') {
+    hal_stats_reset();
+  }
+
+  memset(&payload, 0, sizeof(payload));
+  payload.version = AUDIO_STATS_VERSION;
+  payload.xruns = snapshot.counters[AUDIO_COUNT_XRUNS];
+  payload.recoveries = snapshot.counters[AUDIO_COUNT_RECOVERIES];
+  payload.interrupts = snapshot.counters[AUDIO_COUNT_INTERRUPTS];
+  payload.drops = snapshot.counters[AUDIO_COUNT_DROPS];
+  payload.queue_ms = (unsigned int)hal_audio_get_queued_ms();
+  payload.queue_max_ms = snapshot.queue_max_ms;
+  copy_latency(&payload.tts_first_pcm,
+               &snapshot.latency[AUDIO_LAT_TTS_FIRST_PCM]);
+  copy_latency(&payload.pcm_to_device,
+               &snapshot.latency[AUDIO_LAT_PCM_TO_DEVICE]);
+  copy_latency(&payload.beep_start, &snapshot.latency[AUDIO_LAT_BEEP_START]);
+
+  AUDIO_IO_PRINTF("Stats: %u xruns, %u drops, beep p99 %u us\n",
+                  payload.xruns, payload.drops, payload.beep_start.p99_us);
+  frame_write(output_pipe_fd, AUDIO, tag, &payload, sizeof(payload));
+}
+
+void audio_process() {
   AUDIO_PRINTF("Audio process launched\nConnecting to input/output pipes\n");
 
   int input_pipe_fd = open(AUDIO_I, O_RDONLY);
@@ -47,30 +183,15 @@ void audio_process() {
     AUDIO_PRINTF("TTS HAL initialized: %s\n", hal_tts_get_impl_name());
   }
 
-  AUDIO_PRINTF("Creating input queue\n");
-
-  Packet_queue *input_queue = create_packet_queue();
+  AUDIO_PRINTF("Creating input ring\n");
 
-  AUDIO_PRINTF("Initializing queue mutex lock\n");
-
-  if (pthread_mutex_init(&audio_queue_lock, NULL) != 0) {
-    perror("pthread_mutex_init");
-    // kill(controller_pid, SIGINT);
-    exit(1);
-  }
-  AUDIO_PRINTF("Initializing queue availibility mutex lock\n");
-
-  if (pthread_mutex_init(&audio_queue_available, NULL) != 0) {
-    perror("pthread_mutex_init");
-    // kill(controller_pid, SIGINT);
-    exit(1);
-  }
+  Packet_ring *input_ring = create_packet_ring(PACKET_RING_DEFAULT_CAPACITY);
 
   pthread_t audio_io_buffer;
   audio_io_packet thread_input;
   thread_input.pipe_fd = input_pipe_fd;
   thread_input.output_pipe_fd = output_pipe_fd;
-  thread_input.queue = input_queue;
+  thread_input.ring = input_ring;
 
   AUDIO_PRINTF("Launching IO thread\n");
   if (pthread_create(&audio_io_buffer, NULL, audio_io_thread,
@@ -79,102 +200,28 @@ void audio_process() {
     // kill(controller_pid, SIGINT);
     exit(1);
   }
-  usleep(500000); // Half sec sleep to let child thread take control
 
   while (audio_running) {
-    pthread_mutex_lock(&audio_queue_available);
-    pthread_mutex_lock(&audio_queue_lock);
-    if (is_empty(input_queue)) {
-      pthread_mutex_unlock(&audio_queue_available);
-      pthread_mutex_unlock(&audio_queue_lock);
-      usleep(500);
-      continue;
+    /* Sleeps until the IO thread pushes a packet */
+    Inst_packet *received_packet = packet_ring_wait(input_ring);
+    if (received_packet == NULL) {
+      AUDIO_PRINTF("Input ring closed\n");
+      break;
     }
-    Inst_packet *received_packet = dequeue(input_queue);
-    pthread_mutex_unlock(&audio_queue_lock);
-    pthread_mutex_unlock(&audio_queue_available);
-    char *requested_string = calloc(1, received_packet->data_len + 0x10);
-    strcpy(requested_string, (char *)received_packet->data);
-    char audio_type_byte = requested_string[0];
-    char *remaining_string = requested_string + 1;
-    int system_result;
+    unsigned char request[PACKET_RING_DATA_SIZE];
+    unsigned short size = received_packet->data_len;
     unsigned short packet_tag = received_packet->tag;
-    char default_directory[0x100];
-    getcwd(default_directory, sizeof(default_directory));
-    if (audio_type_byte == 'd') {
-      /* New TTS request - clear interrupt so this can play */
-      hal_audio_clear_interrupt();
-      AUDIO_PRINTF("TTS speak (direct): %s\n", remaining_string);
-      system_result = hal_tts_speak(remaining_string, NULL);
-    } else if (audio_type_byte == 's') {
-      /* New TTS request - clear interrupt so this can play */
-      hal_audio_clear_interrupt();
-      AUDIO_PRINTF("TTS speak (save): %s\n", remaining_string);
-      /* For Piper persistent mode, we ignore output_file and speak directly */
-      system_result = hal_tts_speak(remaining_string, NULL);
-    } else if (audio_type_byte == 'p') {
-      /* Playing audio file - clear interrupt so this can play */
-      hal_audio_clear_interrupt();
-      // strcpy(buffer, "aplay '");
-      // strcat(remaining_string, ".wav'");
-      // strcat(buffer, remaining_string);
-      sprintf(buffer, "%s.wav", remaining_string);
-      AUDIO_PRINTF("Now playing %s with HAL\n", remaining_string);
-      // system_result = system(buffer);
-      system_result = hal_audio_play_file(buffer);
-    } else if (audio_type_byte == 'b') {
-      /* Beep request: remaining_string is beep type ('k'=keypress, 'h'=hold,
-       * 'e'=error) */
-      hal_audio_clear_interrupt(); /* Clear interrupt so beep can play */
-      BeepType beep_type;
-      switch (remaining_string[0]) {
-      case 'k':
-        beep_type = BEEP_KEYPRESS;
-        break;
-      case 'h':
-        beep_type = BEEP_HOLD;
-        break;
-      case 'e':
-        beep_type = BEEP_ERROR;
-        break;
-      default:
-        AUDIO_PRINTF("Unknown beep type: %c\n", remaining_string[0]);
-        beep_type = BEEP_KEYPRESS;
-      }
-      system_result = audio_play_beep(beep_type);
-    } else if (audio_type_byte == 'i') {
-      /* Interrupt request */
-      AUDIO_PRINTF("Interrupting audio playback\n");
-      hal_audio_interrupt();
-      hal_tts_interrupt();
-      system_result = 0;
-    } else if (audio_type_byte == 'q') {
-      /* Query audio device info - return card number */
-      AUDIO_PRINTF("Querying audio device info\n");
-      system_result = hal_audio_get_card_number();
-      AUDIO_PRINTF("Returning card number: %d\n", system_result);
-    } else {
-      AUDIO_PRINTF("Audio error. Unrecognized packet data %s\n",
-                   requested_string);
-      system_result = -1;
-    }
-    Inst_packet *packet_to_send = create_inst_packet(
-        AUDIO, sizeof(int), (unsigned char *)&system_result, packet_tag);
+    memcpy(request, received_packet->data, size);
+    /* Hand the slot back before the (possibly long) playback */
+    packet_ring_release(input_ring);
+    int system_result = audio_execute(request, size, NULL);
     AUDIO_PRINTF("Sending back value of %x\n", system_result);
-    write(output_pipe_fd, packet_to_send,
-          8); // Packet_to_send is a pointer, so would this not just be sending
-              // back the address of it.
-    write(
-        output_pipe_fd, packet_to_send->data,
-        sizeof(
-            int)); // while earlier you did have this be sizeof(int) would it
-                   // not be safer to just use the size value of packet_to_send
-    free(requested_string);
-    destroy_inst_packet(&packet_to_send);
+    frame_write(output_pipe_fd, AUDIO, packet_tag, &system_result,
+                sizeof(int));
   }
 
   pthread_join(audio_io_buffer, NULL);
-  destroy_queue(input_queue);
+  destroy_packet_ring(input_ring);
   close(input_pipe_fd);
   close(output_pipe_fd); // Graceful closing is always nice :)
 
@@ -188,173 +235,61 @@ void *audio_io_thread(void *arg) {
   audio_io_packet *io_args = (audio_io_packet *)arg;
   int i_pipe = io_args->pipe_fd;
   int o_pipe = io_args->output_pipe_fd;
-  Packet_queue *queue = io_args->queue;
-  unsigned char buffer[256];
+  Packet_ring *ring = io_args->ring;
+  unsigned char buffer[FRAME_MAX_MESSAGE];
+  Frame_reader reader;
+  frame_reader_init(&reader, i_pipe);
 
-  AUDIO_IO_PRINTF("Input pipe = %d, output pipe = %d, queue ptr = %p\n", i_pipe,
-                  o_pipe, (void *)queue);
+  AUDIO_IO_PRINTF("Input pipe = %d, output pipe = %d, ring ptr = %p\n", i_pipe,
+                  o_pipe, (void *)ring);
 
   while (audio_running) {
-    pthread_mutex_lock(&audio_queue_lock);
-    int queue_empty = is_empty(queue);
-    pthread_mutex_unlock(&audio_queue_lock);
-    if (queue_empty) {
-      // KEYPAD_IO_PRINTF("Making queue inaccessible\n");
-      pthread_mutex_lock(&audio_queue_available);
-    }
-
-    Packet_type type;
-    unsigned short size;
-    unsigned short tag;
-    ssize_t bytes_read;
-
-    /* Read packet header with error checking */
-    bytes_read = read(i_pipe, &type, sizeof(Packet_type));
-    if (bytes_read <= 0) {
-      AUDIO_IO_PRINTF("Pipe closed or read error (type), exiting thread\n");
-      break;
-    }
-
-    bytes_read = read(i_pipe, &size, sizeof(unsigned short));
-    if (bytes_read <= 0) {
-      AUDIO_IO_PRINTF("Pipe closed or read error (size), exiting thread\n");
-      break;
-    }
-
-    bytes_read = read(i_pipe, &tag, sizeof(unsigned short));
-    if (bytes_read <= 0) {
-      AUDIO_IO_PRINTF("Pipe closed or read error (tag), exiting thread\n");
-      break;
+    Frame_header header;
+    int result = frame_read_message(&reader, &header, buffer, sizeof(buffer));
+    if (result == FRAME_TOO_LARGE) {
+      AUDIO_IO_PRINTF("Dropped oversized packet (%d bytes)\n",
+                      header.data_len);
+      continue;
     }
-
-    bytes_read = read(i_pipe, buffer, size);
-    if (bytes_read <= 0) {
-      AUDIO_IO_PRINTF("Pipe closed or read error (data), exiting thread\n");
+    if (result != FRAME_OK) {
+      AUDIO_IO_PRINTF("Pipe closed or read error, exiting thread\n");
       break;
     }
+    Packet_type type = (Packet_type)header.type;
+    unsigned short size = header.data_len;
+    unsigned short tag = header.tag;
 
     AUDIO_IO_PRINTF("Found packet with type %d, size %d\n", type, size);
-    AUDIO_IO_PRINTF("Buffer holds: %s: with size %d\n", buffer, size);
+    AUDIO_IO_PRINTF("Buffer holds: %.*s: with size %d\n", (int)size, buffer,
+                    size);
 
     if (type != AUDIO) {
       AUDIO_IO_PRINTF("Packet not supported for Audio firmware\n");
       continue;
     }
 
-    /* ===== INTERRUPT BYPASS =====
-     * Handle interrupt packets ('i') immediately without queueing.
-     * This allows interrupts to take effect even when TTS is blocking.
-     */
-    if (size > 0 && buffer[0] == 'i') {
-      AUDIO_IO_PRINTF("INTERRUPT BYPASS: Handling interrupt immediately\n");
-      hal_audio_interrupt();
-      hal_tts_interrupt();
-
-      /* Clear any queued audio packets so they don't play after interrupt */
-      pthread_mutex_lock(&audio_queue_lock);
-      clear_queue(queue);
-      pthread_mutex_unlock(&audio_queue_lock);
-      AUDIO_IO_PRINTF("INTERRUPT BYPASS: Cleared audio queue\n");
-
-      /* Send acknowledgment directly to output pipe */
-      int ack_result = 0;
-      Inst_packet *ack_packet = create_inst_packet(
-          AUDIO, sizeof(int), (unsigned char *)&ack_result, tag);
-      write(o_pipe, ack_packet, 8);
-      write(o_pipe, ack_packet->data, sizeof(int));
-      destroy_inst_packet(&ack_packet);
-
-      /* Release queue lock if we held it, then skip normal queue processing */
-      if (queue_empty) {
-        pthread_mutex_unlock(&audio_queue_available);
-      }
-      continue;
-    }
-
-    /* ===== BEEP BYPASS =====
-     * Handle beep packets ('b') immediately without queueing.
-     * This ensures beeps play right away and aren't cleared by subsequent
-     * interrupts that may come from the callback processing the key event.
-     */
-    if (size > 0 && buffer[0] == 'b') {
-      AUDIO_IO_PRINTF("BEEP BYPASS: Playing beep immediately\n");
-
-      /* Clear interrupt to allow beep to play */
-      hal_audio_clear_interrupt();
-
-      /* Determine beep type from second character */
-      BeepType beep_type = BEEP_KEYPRESS;
-      if (size > 1) {
-        switch (buffer[1]) {
-        case 'k':
-          beep_type = BEEP_KEYPRESS;
-          break;
-        case 'h':
-          beep_type = BEEP_HOLD;
-          break;
-        case 'e':
-          beep_type = BEEP_ERROR;
-          break;
-        }
-      }
-
-      int beep_result = hal_audio_play_beep(beep_type);
-      AUDIO_IO_PRINTF("BEEP BYPASS: Beep returned %d\n", beep_result);
-
-      /* Send acknowledgment directly to output pipe */
-      Inst_packet *ack_packet = create_inst_packet(
-          AUDIO, sizeof(int), (unsigned char *)&beep_result, tag);
-      write(o_pipe, ack_packet, 8);
-      write(o_pipe, ack_packet->data, sizeof(int));
-      destroy_inst_packet(&ack_packet);
-
-      /* Release queue lock if we held it, then skip normal queue processing */
-      if (queue_empty) {
-        pthread_mutex_unlock(&audio_queue_available);
-      }
-      continue;
-    }
-
-    /* ===== SPEED SETTING BYPASS =====
-     * Handle speed packets ('s') immediately without queueing.
-     * Format: "s1.0" where 1.0 is the speed value.
-     */
-    if (size > 1 && buffer[0] == 's') {
-      float speed = atof((char *)&buffer[1]);
-      AUDIO_IO_PRINTF("SPEED BYPASS: Setting speed to %.2f\n", speed);
-
-      int speed_result = hal_tts_set_speed(speed);
-      AUDIO_IO_PRINTF("SPEED BYPASS: Result %d\n", speed_result);
-
-      /* Send acknowledgment directly to output pipe */
-      Inst_packet *ack_packet = create_inst_packet(
-          AUDIO, sizeof(int), (unsigned char *)&speed_result, tag);
-      write(o_pipe, ack_packet, 8);
-      write(o_pipe, ack_packet->data, sizeof(int));
-      destroy_inst_packet(&ack_packet);
-
-      /* Release queue lock if we held it, then skip normal queue processing */
-      if (queue_empty) {
-        pthread_mutex_unlock(&audio_queue_available);
+    /* Anything more urgent than speech and file playback is handled right
+     * here, so it takes effect even while the worker is blocked in TTS */
+    int packet_class = header.priority != FRAME_CLASS_NONE
+                           ? header.priority
+                           : frame_default_class(type, buffer, size);
+    if (packet_class < FRAME_CLASS_BULK) {
+      AUDIO_IO_PRINTF("Class %d: handling '%c' immediately\n", packet_class,
+                      size > 0 ? buffer[0] : '?');
+      if (size > 0 && buffer[0] == AUDIO_REQUEST_STATS) {
+        audio_send_stats(o_pipe, tag, buffer, size);
+        continue;
       }
+      int result = audio_execute(buffer, size, ring);
+      frame_write(o_pipe, AUDIO, tag, &result, sizeof(int));
       continue;
     }
 
-    Inst_packet *queued_packet = create_inst_packet(type, size, buffer, tag);
-
-    AUDIO_IO_PRINTF("Locking queue\n");
-    pthread_mutex_lock(&audio_queue_lock);
-
     AUDIO_IO_PRINTF("Queueing packet\n");
-    enqueue(queue, queued_packet);
-
-    AUDIO_IO_PRINTF("Releasing queue & making it accessible\n");
-    pthread_mutex_unlock(&audio_queue_lock);
-    if (queue_empty) {
-      pthread_mutex_unlock(&audio_queue_available);
-    }
-    usleep(100);
+    packet_ring_push(ring, type, tag, buffer, size);
   }
+  /* Wake the worker so it can shut down */
+  packet_ring_close(ring);
   return NULL;
 }
 
@@ -13,6 +13,7 @@
 
 #include "hampod_firm_packet.h"
 #include "hampod_queue.h"
+#include "hampod_ring.h"
 
 #define HASHING_PRIME 183373
 #define PRIME2 17
@@ -55,9 +56,8 @@
 
 typedef struct audio_io_packet {
   int pipe_fd;        /* Input pipe for receiving packets */
-  int output_pipe_fd; /* Output pipe for sending ack (used for interrupt bypass)
-                       */
-  Packet_queue *queue;
+  int output_pipe_fd; /* Output pipe for replies to urgent requests */
+  Packet_ring *ring; /* IO thread -> worker handoff */
 } audio_io_packet;
 
 #include "hal/hal_audio.h"
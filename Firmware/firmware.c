@@ -3,12 +3,17 @@
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include "audio_firmware.h"
+#include "hampod_frame.h"
 #include "hampod_queue.h"
+#include "hampod_shm.h"
+#include "hampod_trace.h"
 #include "keypad_firmware.h"
 
 #define INPUT_PIPE "Firmware_i"
@@ -47,6 +52,7 @@
 
 typedef struct Buff_input {
   int pipe_fd;
+  Shm_link *shm; /* Read from shared memory instead of pipe_fd when set */
   Packet_queue *queue;
 } Buff_input;
 
@@ -55,17 +61,29 @@ typedef struct Audio_thread_input {
   int audio_output_fd;
 } Audio_thread_input;
 
-pthread_mutex_t queue_lock;
-pthread_mutex_t queue_available;
+typedef struct Keypad_thread_input {
+  int output_pipe_fd;
+  int keypad_output_fd;
+} Keypad_thread_input;
+
 pthread_mutex_t pipe_lock;
 char running = 1;
 
+/* Optional shared-memory transport; NULL if the region could not be made */
+Shm_link shm_link;
+Shm_link *shm = NULL;
+
+/* Packet trace, only recording when $HAMPOD_TRACE is set */
+Trace_writer trace;
+
 pid_t controller_pid;
 
 void *io_buffer_thread(void *arg);
 
 void *audio_waiter(void *arg);
 
+void *keypad_waiter(void *arg);
+
 void sigsegv_handler(int signum);
 
 void sigint_handler(int signum);
@@ -103,6 +121,20 @@ int main() {
     exit(1);
   }
 
+  if (trace_open_from_env(&trace, TRACE_SOURCE_FIRMWARE) == 0) {
+    FIRMWARE_PRINTF("Recording packet trace to %s\n", getenv(HAMPOD_TRACE_ENV));
+  }
+
+  /* Created before Firmware_o so the region exists by the time Software
+   * reads the ready packet and tries to attach */
+  FIRMWARE_PRINTF("Creating shared-memory transport\n");
+  if (shm_link_create(&shm_link, HAMPOD_SHM_NAME) == 0) {
+    shm = &shm_link;
+  } else {
+    perror("shm_link_create");
+    FIRMWARE_PRINTF("Continuing with the FIFOs only\n");
+  }
+
   FIRMWARE_PRINTF("Now creating Firmware_o pipe\n");
 
   unlink(OUTPUT_PIPE); /* Remove stale pipe if exists */
@@ -207,46 +239,45 @@ int main() {
   Packet_queue *instruction_queue = create_packet_queue();
 
   FIRMWARE_PRINTF("Instruction queue created\n");
-  FIRMWARE_PRINTF("Creating queue mutex lock\n");
   FIRMWARE_PRINTF("Creating I\\O buffer thread\n");
 
   pthread_t io_buffer;
   Buff_input thread_input;
   thread_input.pipe_fd = input_pipe_fd;
+  thread_input.shm = NULL;
   thread_input.queue = instruction_queue;
 
+  pthread_t shm_buffer;
+  Buff_input shm_input;
+  shm_input.pipe_fd = -1;
+  shm_input.shm = shm;
+  shm_input.queue = instruction_queue;
+
   Audio_thread_input audio_pipes;
   audio_pipes.output_pipe_fd = output_pipe_fd;
   audio_pipes.audio_output_fd = audio_out_pipe_fd;
 
-  if (pthread_mutex_init(&queue_lock, NULL) != 0) {
-    perror("pthread_mutex_init");
-    exit(1);
-  }
-
-  if (pthread_mutex_init(&queue_available, NULL) != 0) {
-    perror("pthread_mutex_init");
-    exit(1);
-  }
+  Keypad_thread_input keypad_pipes;
+  keypad_pipes.output_pipe_fd = output_pipe_fd;
+  keypad_pipes.keypad_output_fd = keypad_out_pipe_fd;
 
   if (pthread_mutex_init(&pipe_lock, NULL) != 0) {
     perror("pthread_mutex_init");
     exit(1);
   }
 
-  FIRMWARE_PRINTF("Queue lock initialized\n");
-
   if (pthread_create(&io_buffer, NULL, io_buffer_thread,
                      (void *)&thread_input) != 0) {
     perror("Buffer thread failed");
     exit(1);
   }
 
-  FIRMWARE_PRINTF("1 second delay so thread can lock the queue\n");
-
-  usleep(1000000);
+  if (shm != NULL && pthread_create(&shm_buffer, NULL, io_buffer_thread,
+                                    (void *)&shm_input) != 0) {
+    perror("Shared-memory buffer thread failed");
+    exit(1);
+  }
 
-  FIRMWARE_PRINTF("1 second delay over\n");
   FIRMWARE_PRINTF("Starting audio response waiter thread\n");
   pthread_t audio_waiter_thread;
   if (pthread_create(&audio_waiter_thread, NULL, audio_waiter,
@@ -255,63 +286,76 @@ int main() {
     exit(1);
   }
 
+  FIRMWARE_PRINTF("Starting keypad response waiter thread\n");
+  pthread_t keypad_waiter_thread;
+  if (pthread_create(&keypad_waiter_thread, NULL, keypad_waiter,
+                     (void *)&keypad_pipes) != 0) {
+    perror("Keypad waiter thread failed");
+    exit(1);
+  }
+
   FIRMWARE_PRINTF("Sending ok packet to software\n");
-  unsigned char ok_signal = 'R';
-  Inst_packet *ready_packet = create_inst_packet(CONFIG, 1, &ok_signal, 0);
-  write(output_pipe_fd, ready_packet, 8);
-  write(output_pipe_fd, ready_packet->data, sizeof(char));
+  /* The 'R' byte comes first, so older Software still recognizes it */
+  Frame_hello hello;
+  memset(&hello, 0, sizeof(hello));
+  hello.ready = 'R';
+  hello.version = HAMPOD_PROTOCOL_VERSION;
+  hello.max_frame = FRAME_CHUNK_SIZE;
+  hello.max_message = FRAME_MAX_MESSAGE;
+  hello.caps = HAMPOD_CAP_PUSH_KEYPAD | HAMPOD_CAP_PCM_CACHE |
+               HAMPOD_CAP_CHUNKED | HAMPOD_CAP_CLASSES | HAMPOD_CAP_VOLUME |
+               HAMPOD_CAP_AUDIO_STATS | HAMPOD_CAP_AUDIO_OUTPUT;
+  if (shm != NULL)
+    hello.caps |= HAMPOD_CAP_SHM;
+  frame_write(output_pipe_fd, CONFIG, 0, &hello, sizeof(hello));
+  trace_record(&trace, TRACE_FROM_FIRMWARE, CONFIG, 0, &hello, sizeof(hello));
   while (running) {
-    pthread_mutex_lock(&queue_available);
-    pthread_mutex_lock(&queue_lock);
-
-    Inst_packet *received_packet = dequeue(instruction_queue);
-    pthread_mutex_unlock(&queue_lock);
-    pthread_mutex_unlock(&queue_available);
-    if (received_packet != NULL) {
-      FIRMWARE_PRINTF("Queue is open\n");
-      FIRMWARE_PRINTF("Packet is %p\n", received_packet);
-      FIRMWARE_PRINTF("Processing received packet\n");
-    }
+    /* Sleeps until the IO thread queues a packet. The queue hands out the
+     * most urgent class first, so keypad requests, interrupts and beeps
+     * overtake speech still waiting here. */
+    Inst_packet *received_packet = dequeue_wait(instruction_queue);
     if (received_packet == NULL) {
-      continue;
+      FIRMWARE_PRINTF("Instruction queue closed\n");
+      break;
     }
+    FIRMWARE_PRINTF("Packet is %p\n", received_packet);
+    FIRMWARE_PRINTF("Processing received packet\n");
 
-    FIRMWARE_PRINTF("Packet tag %d\n", received_packet->tag);
+    FIRMWARE_PRINTF("Packet tag %d, class %d\n", received_packet->tag,
+                    received_packet->priority);
 
     Packet_type type = received_packet->type;
     // unsigned short data_size = received_packet->data_len;
-    if (type == KEYPAD && received_packet->data[0] == 'r') {
-      FIRMWARE_PRINTF("Got a READ keypad packet\n");
-      write(keypad_in_pipe_fd, received_packet, 8);
-      write(keypad_in_pipe_fd, received_packet->data, 1);
-      FIRMWARE_PRINTF("Packet sent, now waiting for a response\n");
-      Packet_type keypad_back;
-      unsigned short keypad_back_size;
-      unsigned short keypad_back_tag;
-      char read_key;
-      read(keypad_out_pipe_fd, &keypad_back, sizeof(Packet_type));
-      read(keypad_out_pipe_fd, &keypad_back_size, sizeof(unsigned short));
-      read(keypad_out_pipe_fd, &keypad_back_tag, sizeof(unsigned short));
-      read(keypad_out_pipe_fd, &read_key, sizeof(char));
-      FIRMWARE_PRINTF("Keypad sent back %x\n", read_key);
-      pthread_mutex_lock(&pipe_lock);
-      write(output_pipe_fd, &type, sizeof(Packet_type));
-      unsigned short return_size = 1;
-      write(output_pipe_fd, &return_size, sizeof(unsigned short));
-      write(output_pipe_fd, &keypad_back_tag, sizeof(unsigned short));
-      write(output_pipe_fd, &read_key, sizeof(char));
-      pthread_mutex_unlock(&pipe_lock);
+    if (type == KEYPAD) {
+      /* Read ('r') and subscribe ('s') requests both go to the keypad
+       * process; its replies and pushed events come back through
+       * keypad_waiter so this loop never blocks on the keypad. */
+      FIRMWARE_PRINTF("Got a keypad packet ('%c')\n", received_packet->data[0]);
+      frame_write_message(
+          keypad_in_pipe_fd,
+          FRAME_TYPE_WITH_CLASS(KEYPAD, received_packet->priority),
+          received_packet->tag, received_packet->data,
+          received_packet->data_len, FRAME_CHUNK_SIZE);
     }
     if (type == AUDIO) {
       FIRMWARE_PRINTF("Got a audio packet\n");
-      write(audio_in_pipe_fd, received_packet, 8);
-      write(audio_in_pipe_fd, received_packet->data, received_packet->data_len);
+      frame_write_message(
+          audio_in_pipe_fd,
+          FRAME_TYPE_WITH_CLASS(AUDIO, received_packet->priority),
+          received_packet->tag, received_packet->data,
+          received_packet->data_len, FRAME_CHUNK_SIZE);
       FIRMWARE_PRINTF("Packet sent to audio process\n");
     }
     destroy_inst_packet(&received_packet);
   }
+  running = 0;
   pthread_join(io_buffer, NULL);
+  if (shm != NULL) {
+    pthread_join(shm_buffer, NULL);
+    shm_link_close(shm);
+  }
   destroy_queue(instruction_queue);
+  trace_close(&trace);
   close(output_pipe_fd);
   close(input_pipe_fd);
   return 0;
@@ -326,109 +370,118 @@ void *io_buffer_thread(void *arg) {
   Buff_input *function_input = (Buff_input *)arg;
   int i_pipe = function_input->pipe_fd;
   Packet_queue *queue = function_input->queue;
-  unsigned char buffer[256];
+  /* Whole messages: shared memory carries them in one frame, the pipe in
+   * FRAME_CHUNK_SIZE chunks */
+  unsigned char buffer[FRAME_MAX_MESSAGE];
+  Frame_reader reader;
+  frame_reader_init(&reader, i_pipe);
 
-  FIRMWARE_IO_PRINTF("Input pipe = %d, queue_ptr = %p\n", i_pipe, queue);
+  FIRMWARE_IO_PRINTF("Input pipe = %d, shm = %p, queue_ptr = %p\n", i_pipe,
+                     function_input->shm, queue);
 
   while (running) {
 
-    FIRMWARE_IO_PRINTF("Locking the queue\n");
-
-    pthread_mutex_lock(&queue_lock);
-    int queue_empty = is_empty(queue);
-    pthread_mutex_unlock(&queue_lock);
-
-    if (queue_empty) {
-      pthread_mutex_lock(&queue_available);
-    }
-
     FIRMWARE_IO_PRINTF("Waiting for input...\n");
 
-    Packet_type packet_type;
-    unsigned short size;
-    unsigned short tag;
-    ssize_t bytes_read;
-
-    /* Read packet header with error checking */
-    bytes_read = read(i_pipe, &packet_type, sizeof(Packet_type));
-    if (bytes_read <= 0) {
-      FIRMWARE_IO_PRINTF("Pipe closed or read error (type), exiting thread\n");
-      break;
-    }
-
-    bytes_read = read(i_pipe, &size, 2);
-    if (bytes_read <= 0) {
-      FIRMWARE_IO_PRINTF("Pipe closed or read error (size), exiting thread\n");
-      break;
+    Frame_header header;
+    int result;
+    if (function_input->shm != NULL) {
+      /* Wake up now and then to notice shutdown */
+      result = shm_link_recv(function_input->shm, &header, buffer,
+                             sizeof(buffer), 100);
+      if (result == SHM_TIMEOUT)
+        continue;
+    } else {
+      result = frame_read_message(&reader, &header, buffer, sizeof(buffer));
     }
-
-    bytes_read = read(i_pipe, &tag, sizeof(unsigned short));
-    if (bytes_read <= 0) {
-      FIRMWARE_IO_PRINTF("Pipe closed or read error (tag), exiting thread\n");
-      break;
+    if (result == FRAME_TOO_LARGE) {
+      FIRMWARE_IO_PRINTF("Dropped oversized packet (%d bytes)\n",
+                         header.data_len);
+      continue;
     }
-
-    bytes_read = read(i_pipe, buffer, size);
-    if (bytes_read <= 0) {
-      FIRMWARE_IO_PRINTF("Pipe closed or read error (data), exiting thread\n");
+    if (result != FRAME_OK) {
+      FIRMWARE_IO_PRINTF("Pipe closed or read error, exiting thread\n");
       break;
     }
+    Packet_type packet_type = (Packet_type)header.type;
+    unsigned short size = header.data_len;
+    unsigned short tag = header.tag;
+    trace_record(&trace, TRACE_TO_FIRMWARE,
+                 FRAME_TYPE_WITH_CLASS(header.type, header.priority), tag,
+                 buffer, size);
 
     FIRMWARE_IO_PRINTF("Found packet with type %d, size %d\n", packet_type,
                        size);
-    FIRMWARE_IO_PRINTF("Buffer holds:%s: with size %lu\n", buffer,
-                       sizeof(buffer));
+    FIRMWARE_IO_PRINTF("Buffer holds:%.*s: with size %d\n", (int)size, buffer,
+                       size);
 
     Inst_packet *new_packet =
         create_inst_packet(packet_type, size, buffer, tag);
+    /* Otherwise create_inst_packet() classified it from the contents */
+    if (header.priority != FRAME_CLASS_NONE)
+      new_packet->priority = header.priority;
 
     FIRMWARE_IO_PRINTF("Queueing the new packet\n");
-    pthread_mutex_lock(&queue_lock);
     enqueue(queue, new_packet);
-
-    FIRMWARE_IO_PRINTF("Releasing queue\n");
-
-    pthread_mutex_unlock(&queue_lock);
-    if (queue_empty) {
-      FIRMWARE_IO_PRINTF("Queue was not empty\n");
-      pthread_mutex_unlock(&queue_available);
-    }
-    usleep(100);
   }
+  /* Software closing Firmware_i ends the session whichever transport it
+   * used, so only the pipe reader wakes the main loop to shut down */
+  if (function_input->shm == NULL)
+    close_queue(queue);
   return NULL;
 }
 
-void *audio_waiter(void *arg) {
-  FIRMWARE_PRINTF("Audio waiter thread started\n");
-  Audio_thread_input *input = (Audio_thread_input *)arg;
-  int output_pipe_fd = input->output_pipe_fd;
-  int audio_out_pipe_fd = input->audio_output_fd;
+/* Relay replies from a child process back to Software. The child may send
+ * several replies back to back, so they are parsed out of one buffer and
+ * each is forwarded with a single write, through shared memory once
+ * Software has attached to it and through Firmware_o otherwise. */
+static void relay_replies(int child_out_fd, int output_pipe_fd,
+                          const char *name) {
+  Frame_reader reader;
+  unsigned char buffer[256];
+  frame_reader_init(&reader, child_out_fd);
 
   while (running) {
-    Packet_type audio_back;
-    unsigned short audio_back_size;
-    int return_code;
-    unsigned short audio_back_tag;
-
-    if (read(audio_out_pipe_fd, &audio_back, sizeof(Packet_type)) <= 0)
-      break;
-    if (read(audio_out_pipe_fd, &audio_back_size, sizeof(unsigned short)) <= 0)
-      break;
-    if (read(audio_out_pipe_fd, &audio_back_tag, sizeof(unsigned short)) <= 0)
-      break;
-    if (read(audio_out_pipe_fd, &return_code, sizeof(int)) <= 0)
+    Frame_header header;
+    int result = frame_read(&reader, &header, buffer, sizeof(buffer));
+    if (result == FRAME_TOO_LARGE) {
+      FIRMWARE_PRINTF("%s sent an oversized packet (%d bytes), dropped\n",
+                      name, header.data_len);
+      continue;
+    }
+    if (result != FRAME_OK)
       break;
 
-    FIRMWARE_PRINTF("audio sent back %x for tag %d\n", return_code,
-                    audio_back_tag);
+    FIRMWARE_PRINTF("%s sent back %x (len %d) for tag %d\n", name, buffer[0],
+                    header.data_len, header.tag);
+
+    trace_record(&trace, TRACE_FROM_FIRMWARE, header.type, header.tag, buffer,
+                 header.data_len);
 
     pthread_mutex_lock(&pipe_lock);
-    write(output_pipe_fd, &audio_back, sizeof(Packet_type));
-    write(output_pipe_fd, &audio_back_size, sizeof(unsigned short));
-    write(output_pipe_fd, &audio_back_tag, sizeof(unsigned short));
-    write(output_pipe_fd, &return_code, sizeof(int));
+    if (shm != NULL && shm_link_is_attached(shm)) {
+      if (shm_link_send(shm, header.type, header.tag, buffer,
+                        header.data_len) != 0)
+        FIRMWARE_PRINTF("Shared-memory ring full, %s reply dropped\n", name);
+    } else {
+      frame_write(output_pipe_fd, header.type, header.tag, buffer,
+                  header.data_len);
+    }
     pthread_mutex_unlock(&pipe_lock);
   }
+}
+
+void *audio_waiter(void *arg) {
+  FIRMWARE_PRINTF("Audio waiter thread started\n");
+  Audio_thread_input *input = (Audio_thread_input *)arg;
+  relay_replies(input->audio_output_fd, input->output_pipe_fd, "Audio");
+  return NULL;
+}
+
+void *keypad_waiter(void *arg) {
+  FIRMWARE_PRINTF("Keypad waiter thread started\n");
+  Keypad_thread_input *input = (Keypad_thread_input *)arg;
+  relay_replies(input->keypad_output_fd, input->output_pipe_fd, "Keypad");
   return NULL;
 }
 
@@ -437,6 +490,8 @@ void *audio_waiter(void *arg) {
 void sigint_handler(int signum) {
   printf("\033[0;31mTERMINATING FIRMWARE\n");
   running = 0;
+  if (shm != NULL)
+    shm_unlink(HAMPOD_SHM_NAME);
   exit(0);
 }
 
@@ -44,7 +44,9 @@ const char *hal_audio_get_device(void);
  * @brief Play an audio file
  *
  * Plays the specified WAV file through the configured audio device.
- * This function blocks until playback completes.
+ * Any PCM WAV is accepted; other rates, channel counts and bit depths are
+ * converted to 16 kHz mono in-process. This function blocks until
+ * playback completes.
  *
  * @param filepath Absolute or relative path to WAV file
  * @return 0 on success, negative error code on failure
@@ -119,6 +121,104 @@ int hal_audio_is_playing(void);
  */
 int hal_audio_pipeline_ready(void);
 
+/**
+ * @brief Keep the audio stream running on silence between sounds
+ *
+ * With the hot pipeline on, the device is never stopped: idle time is
+ * filled with silence, so new sound starts at the next period boundary and
+ * USB codecs never go through their un-mute delay (or pop) on restart.
+ * Off by default unless built with AUDIO_HOT_PIPELINE (make AUDIO_HOT=1).
+ *
+ * @param enable 1 to keep the stream running, 0 to let it stop when idle
+ */
+void hal_audio_set_hot_pipeline(int enable);
+
+/**
+ * @brief Check whether the hot pipeline is on
+ *
+ * @return 1 if on, 0 otherwise
+ */
+int hal_audio_get_hot_pipeline(void);
+
+/**
+ * @brief Duck speech and file playback under beeps
+ *
+ * With duck mode on, speech and file playback are lowered by 12 dB while a
+ * beep plays and ramp back afterwards, so a key beep is heard clearly over
+ * an utterance without cutting it. Off by default unless built with
+ * AUDIO_DUCK (make AUDIO_DUCK=1).
+ *
+ * @param enable 1 to duck, 0 to mix beeps at full level over speech
+ */
+void hal_audio_set_duck(int enable);
+
+/**
+ * @brief Check whether duck mode is on
+ *
+ * @return 1 if on, 0 otherwise
+ */
+int hal_audio_get_duck(void);
+
+/**
+ * @brief Set the output period and buffer, and how periods reach the card
+ *
+ * Shorter periods let beeps and interrupts be heard sooner, at the cost
+ * of more wake-ups and less margin against underruns: 5-10 ms suits a
+ * Pi 5 with a good USB card, the 25 ms default a Pi 3. The mixer reopens
+ * the device between periods. The device may round the sizes; if it
+ * refuses them, the last settings that worked are restored. Only the ALSA
+ * sink uses them.
+ *
+ * @param period_ms Period, 4-50 ms (AUDIO_PERIOD_MS, 25 by default)
+ * @param buffer_ms Device buffer, two periods to 500 ms (AUDIO_BUFFER_MS,
+ *                  100 by default)
+ * @param use_mmap 1 to mix straight into the mapped device buffer
+ *                 (snd_pcm_mmap_begin/commit), 0 for snd_pcm_writei()
+ * @return 0 on success, -1 if out of range
+ */
+int hal_audio_set_output(int period_ms, int buffer_ms, int use_mmap);
+
+/**
+ * @brief Get how much audio is queued ahead of a new sound
+ *
+ * Counts samples waiting in the mixer plus those already in the device.
+ *
+ * @return Queued audio in milliseconds (0 when idle)
+ */
+int hal_audio_get_queued_ms(void);
+
+/**
+ * @brief Set the output volume
+ *
+ * Applied as a fixed-point gain on the mixed signal, so it works on every
+ * card, needs no mixer control, and takes effect within one period. Changes
+ * ramp over about 20 ms so they never click. Percentages map to gain as
+ * (percent / 100)^2 for roughly even loudness steps; 100 is unity gain.
+ *
+ * @param percent Volume, clamped to 0-100
+ * @return 0 on success
+ */
+int hal_audio_set_volume(int percent);
+
+/**
+ * @brief Get the volume last set with hal_audio_set_volume()
+ *
+ * @return Volume in percent (100 by default)
+ */
+int hal_audio_get_volume(void);
+
+/**
+ * @brief Set the card's own playback volume through the ALSA mixer
+ *
+ * Optional, for cards whose hardware level should track the setting. Uses
+ * the first of the PCM, Speaker, Master or Headphone controls the selected
+ * card has, through alsa-lib (no amixer process).
+ *
+ * @param percent Volume, clamped to 0-100, across the control's range
+ * @return 0 on success, -1 if the card has no usable control
+ */
+int hal_audio_set_mixer_volume(int percent);
+
 /* ============================================================================
  * RAM-Cached Beep API (for low-latency beeps)
  * ============================================================================
@@ -153,7 +253,7 @@ int hal_audio_play_beep(BeepType type);
  * @brief Get the selected ALSA card number
  *
  * Returns the card number of the detected audio device.
- * Used by Software2 for volume control via amixer.
+ * Reported to Software2 by the 'q' audio query.
  *
  * @return Card number (0-255), or -1 if not initialized
  */
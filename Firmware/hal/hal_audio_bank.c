@@ -0,0 +1,344 @@
+/**
+ * @file hal_audio_bank.c
+ * @brief RAM-resident prompt bank (see hal_audio_bank.h)
+ */
+
+#include "hal_audio_bank.h"
+#include "hal_audio_convert.h"
+#include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BANK_BUCKETS 256 /* Power of two */
+
+/* ============================================================================
+ * WAV Loading
+ * ============================================================================
+ */
+
+int hal_audio_load_wav(const char *filepath, CachedAudio *cache) {
+  FILE *wav_file;
+  WavFormat format;
+  AudioConverter conv;
+  uint8_t *data;
+  size_t frames;
+
+  if (cache == NULL)
+    return HAL_WAV_ERROR;
+
+  /* Clear existing cache */
+  hal_audio_free_cached(cache);
+
+  /* Open WAV file */
+  wav_file = fopen(filepath, "rb");
+  if (wav_file == NULL) {
+    return HAL_WAV_ERROR;
+  }
+
+  int header = hal_wav_read_header(wav_file, &format);
+  if (header != 0) {
+    fclose(wav_file);
+    return header == -2 ? HAL_WAV_FORMAT : HAL_WAV_ERROR;
+  }
+
+  /* Convert to the pipeline format once, here, rather than per play */
+  if (hal_convert_init(&conv, format.sample_rate, format.channels,
+                       format.bits_per_sample) != 0) {
+    fclose(wav_file);
+    return HAL_WAV_FORMAT;
+  }
+
+  frames = format.data_size / format.block_align;
+  data = (uint8_t *)malloc(frames * format.block_align + 1);
+  cache->samples =
+      (int16_t *)malloc(hal_convert_max_output(&conv, frames) * 2 + 2);
+  if (data == NULL || cache->samples == NULL ||
+      fread(data, format.block_align, frames, wav_file) != frames) {
+    free(data);
+    hal_convert_free(&conv);
+    hal_audio_free_cached(cache);
+    fclose(wav_file);
+    return HAL_WAV_ERROR;
+  }
+  fclose(wav_file);
+
+  cache->num_samples = hal_convert_process(&conv, data, frames, cache->samples);
+  free(data);
+  hal_convert_free(&conv);
+
+  cache->loaded = 1;
+  return HAL_WAV_OK;
+}
+
+void hal_audio_free_cached(CachedAudio *cache) {
+  if (cache != NULL) {
+    free(cache->samples);
+    cache->samples = NULL;
+    cache->num_samples = 0;
+    cache->loaded = 0;
+  }
+}
+
+/* ============================================================================
+ * Bank State
+ * ============================================================================
+ */
+
+typedef struct BankEntry {
+  CachedAudio audio; /* First, so a CachedAudio pointer is the entry */
+  char *key;
+  uint32_t hash;
+  unsigned long last_used; /* bank_clock at the last lookup */
+  int users;               /* Acquired and not yet released */
+  int uncacheable;         /* Format the converter cannot handle */
+  struct BankEntry *next;  /* Bucket chain */
+} BankEntry;
+
+static pthread_mutex_t bank_lock = PTHREAD_MUTEX_INITIALIZER;
+static BankEntry *buckets[BANK_BUCKETS];
+static size_t bank_budget = 0;
+static size_t bank_bytes = 0;
+static size_t bank_prompts = 0;
+static unsigned long bank_clock = 0;
+static unsigned long bank_hits = 0;
+static unsigned long bank_loads = 0;
+static unsigned long bank_evictions = 0;
+
+/* FNV-1a */
+static uint32_t hash_path(const char *path) {
+  uint32_t hash = 2166136261u;
+  for (const unsigned char *p = (const unsigned char *)path; *p; p++) {
+    hash ^= *p;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static BankEntry *find_entry(const char *path, uint32_t hash) {
+  for (BankEntry *entry = buckets[hash & (BANK_BUCKETS - 1)]; entry != NULL;
+       entry = entry->next) {
+    if (entry->hash == hash && strcmp(entry->key, path) == 0) {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+static size_t entry_bytes(const BankEntry *entry) {
+  return entry->audio.num_samples * sizeof(int16_t);
+}
+
+/**
+ * @brief Drop the least recently used idle prompt
+ *
+ * The entry itself stays, marked not loaded, so a later lookup reloads it.
+ *
+ * @return 1 if something was evicted, 0 if every prompt is in use
+ */
+static int evict_one(void) {
+  BankEntry *oldest = NULL;
+  for (int b = 0; b < BANK_BUCKETS; b++) {
+    for (BankEntry *entry = buckets[b]; entry != NULL; entry = entry->next) {
+      if (entry->audio.loaded && entry->users == 0 &&
+          (oldest == NULL || entry->last_used < oldest->last_used)) {
+        oldest = entry;
+      }
+    }
+  }
+  if (oldest == NULL) {
+    return 0;
+  }
+  bank_bytes -= entry_bytes(oldest);
+  bank_prompts--;
+  bank_evictions++;
+  hal_audio_free_cached(&oldest->audio);
+  return 1;
+}
+
+/**
+ * @brief Put a loaded file in the bank, creating the entry if needed
+ *
+ * Called with bank_lock held; the file was read without it. If another
+ * thread loaded the same prompt meanwhile, its entry is kept and this copy
+ * is freed.
+ *
+ * @param result hal_audio_load_wav() result for audio (OK or FORMAT)
+ * @param evict Make room by evicting; otherwise fail when over budget
+ * @return The entry (loaded or marked uncacheable), or NULL if it does
+ *         not fit
+ */
+static BankEntry *insert_entry(const char *path, uint32_t hash,
+                               CachedAudio *audio, int result, int evict) {
+  BankEntry *entry = find_entry(path, hash);
+  if (entry != NULL && (entry->audio.loaded || entry->uncacheable)) {
+    hal_audio_free_cached(audio); /* Lost the race: keep theirs */
+    return entry;
+  }
+
+  size_t bytes = audio->num_samples * sizeof(int16_t);
+  if (result == HAL_WAV_OK) {
+    if (bytes > bank_budget) {
+      hal_audio_free_cached(audio);
+      return NULL;
+    }
+    while (bank_bytes + bytes > bank_budget) {
+      if (!evict || !evict_one()) {
+        hal_audio_free_cached(audio);
+        return NULL;
+      }
+    }
+  }
+
+  if (entry == NULL) {
+    entry = (BankEntry *)calloc(1, sizeof(BankEntry));
+    if (entry == NULL || (entry->key = strdup(path)) == NULL) {
+      free(entry);
+      hal_audio_free_cached(audio);
+      return NULL;
+    }
+    entry->hash = hash;
+    entry->next = buckets[hash & (BANK_BUCKETS - 1)];
+    buckets[hash & (BANK_BUCKETS - 1)] = entry;
+  }
+
+  entry->audio = *audio;
+  entry->uncacheable = result == HAL_WAV_FORMAT;
+  if (audio->loaded) {
+    bank_bytes += bytes;
+    bank_prompts++;
+  }
+  return entry;
+}
+
+/* ============================================================================
+ * Public API
+ * ============================================================================
+ */
+
+int hal_audio_bank_init(size_t budget_bytes) {
+  hal_audio_bank_cleanup();
+  pthread_mutex_lock(&bank_lock);
+  bank_budget = budget_bytes;
+  pthread_mutex_unlock(&bank_lock);
+  return 0;
+}
+
+int hal_audio_bank_load_dir(const char *dir) {
+  DIR *handle = opendir(dir);
+  if (handle == NULL) {
+    return -1;
+  }
+
+  int loaded = 0;
+  struct dirent *file;
+  char path[1024];
+  while ((file = readdir(handle)) != NULL) {
+    size_t len = strlen(file->d_name);
+    if (len < 4 || strcmp(file->d_name + len - 4, ".wav") != 0) {
+      continue;
+    }
+    snprintf(path, sizeof(path), "%s%s", dir, file->d_name);
+    uint32_t hash = hash_path(path);
+    pthread_mutex_lock(&bank_lock);
+    int skip = find_entry(path, hash) != NULL;
+    int full = bank_bytes >= bank_budget;
+    pthread_mutex_unlock(&bank_lock);
+    if (full) {
+      break; /* Full: the rest load on first use */
+    }
+    if (skip) {
+      continue;
+    }
+
+    /* Read and convert without the lock so lookups are not held up */
+    CachedAudio audio = {0};
+    int result = hal_audio_load_wav(path, &audio);
+    if (result == HAL_WAV_ERROR) {
+      continue;
+    }
+    pthread_mutex_lock(&bank_lock);
+    BankEntry *entry = insert_entry(path, hash, &audio, result, 0);
+    if (entry != NULL && entry->audio.loaded) {
+      loaded++;
+    }
+    pthread_mutex_unlock(&bank_lock);
+  }
+  closedir(handle);
+  return loaded;
+}
+
+const CachedAudio *hal_audio_bank_acquire(const char *filepath) {
+  if (filepath == NULL || bank_budget == 0) {
+    return NULL;
+  }
+
+  uint32_t hash = hash_path(filepath);
+  pthread_mutex_lock(&bank_lock);
+  BankEntry *entry = find_entry(filepath, hash);
+  if (entry != NULL && entry->audio.loaded) {
+    bank_hits++;
+  } else if (entry == NULL || !entry->uncacheable) {
+    /* Never seen, or evicted: read it from disk without the lock, so
+     * other prompts are not held up by the SD card */
+    pthread_mutex_unlock(&bank_lock);
+    CachedAudio audio = {0};
+    int result = hal_audio_load_wav(filepath, &audio);
+    pthread_mutex_lock(&bank_lock);
+    bank_loads++;
+    entry = result == HAL_WAV_ERROR
+                ? NULL
+                : insert_entry(filepath, hash, &audio, result, 1);
+  }
+
+  const CachedAudio *prompt = NULL;
+  if (entry != NULL && entry->audio.loaded) {
+    entry->users++;
+    entry->last_used = ++bank_clock;
+    prompt = &entry->audio;
+  }
+  pthread_mutex_unlock(&bank_lock);
+  return prompt;
+}
+
+void hal_audio_bank_release(const CachedAudio *prompt) {
+  if (prompt == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&bank_lock);
+  ((BankEntry *)prompt)->users--;
+  pthread_mutex_unlock(&bank_lock);
+}
+
+void hal_audio_bank_get_stats(AudioBankStats *stats) {
+  pthread_mutex_lock(&bank_lock);
+  stats->prompts = bank_prompts;
+  stats->bytes = bank_bytes;
+  stats->budget = bank_budget;
+  stats->hits = bank_hits;
+  stats->loads = bank_loads;
+  stats->evictions = bank_evictions;
+  pthread_mutex_unlock(&bank_lock);
+}
+
+void hal_audio_bank_cleanup(void) {
+  pthread_mutex_lock(&bank_lock);
+  for (int b = 0; b < BANK_BUCKETS; b++) {
+    BankEntry *entry = buckets[b];
+    while (entry != NULL) {
+      BankEntry *next = entry->next;
+      hal_audio_free_cached(&entry->audio);
+      free(entry->key);
+      free(entry);
+      entry = next;
+    }
+    buckets[b] = NULL;
+  }
+  bank_bytes = 0;
+  bank_prompts = 0;
+  bank_hits = 0;
+  bank_loads = 0;
+  bank_evictions = 0;
+  pthread_mutex_unlock(&bank_lock);
+}
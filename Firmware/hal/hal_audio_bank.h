@@ -0,0 +1,105 @@
+#ifndef HAL_AUDIO_BANK_H
+#define HAL_AUDIO_BANK_H
+
+/**
+ * @file hal_audio_bank.h
+ * @brief RAM-resident prompt bank for the audio HAL
+ *
+ * Holds decoded WAV prompts in memory so playing one needs no file I/O.
+ * hal_audio_init() preloads every WAV in the pregen_audio directory; files
+ * requested later are loaded on first use. Lookups go through a hash of the
+ * path exactly as it is passed to hal_audio_play_file(). When the memory
+ * budget is reached the least recently used prompt is dropped.
+ *
+ * Prompts are converted to the pipeline format (16 kHz, mono, 16-bit) as
+ * they are loaded (hal_audio_convert.c). Files the converter cannot handle
+ * are remembered as uncacheable and not retried.
+ *
+ * Nothing here touches ALSA, so the bank can be tested without a device.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Decoded audio held in RAM
+ */
+typedef struct {
+  int16_t *samples;   /* PCM data in memory */
+  size_t num_samples; /* Number of samples */
+  int loaded;         /* 1 if successfully loaded, 0 otherwise */
+} CachedAudio;
+
+/* hal_audio_load_wav() return codes */
+#define HAL_WAV_OK 0
+#define HAL_WAV_ERROR -1  /* Missing, unreadable or not a WAV file */
+#define HAL_WAV_FORMAT -2 /* PCM WAV the converter cannot handle */
+
+/**
+ * @brief Load a WAV file into memory, converted to 16 kHz mono 16-bit
+ *
+ * @param filepath Path to WAV file
+ * @param cache Filled in on success; any previous contents are freed
+ * @return HAL_WAV_OK, HAL_WAV_ERROR or HAL_WAV_FORMAT
+ */
+int hal_audio_load_wav(const char *filepath, CachedAudio *cache);
+
+/**
+ * @brief Free memory held by a CachedAudio
+ */
+void hal_audio_free_cached(CachedAudio *cache);
+
+/**
+ * @brief Set up an empty bank
+ *
+ * @param budget_bytes Most sample memory the bank may hold
+ * @return 0 on success
+ */
+int hal_audio_bank_init(size_t budget_bytes);
+
+/**
+ * @brief Preload every .wav file in a directory
+ *
+ * Files are keyed as dir followed by the file name, so dir should be
+ * spelled the way hal_audio_play_file() callers spell it (e.g.
+ * "pregen_audio/"). Stops preloading once the budget is full.
+ *
+ * @return Number of prompts loaded, or -1 if the directory cannot be read
+ */
+int hal_audio_bank_load_dir(const char *dir);
+
+/**
+ * @brief Look up a prompt, loading it on a miss
+ *
+ * The prompt cannot be evicted until released.
+ *
+ * @param filepath Path as given to hal_audio_play_file()
+ * @return The prompt, or NULL if the file is missing or not cacheable
+ */
+const CachedAudio *hal_audio_bank_acquire(const char *filepath);
+
+/**
+ * @brief Release a prompt returned by hal_audio_bank_acquire()
+ */
+void hal_audio_bank_release(const CachedAudio *prompt);
+
+/**
+ * @brief Bank usage, for logging and tests
+ */
+typedef struct {
+  size_t prompts;      /* Prompts held in memory */
+  size_t bytes;        /* Sample memory in use */
+  size_t budget;       /* Budget given to hal_audio_bank_init() */
+  unsigned long hits;  /* Lookups served from memory */
+  unsigned long loads; /* Lookups that had to read the file */
+  unsigned long evictions;
+} AudioBankStats;
+
+void hal_audio_bank_get_stats(AudioBankStats *stats);
+
+/**
+ * @brief Free every prompt
+ */
+void hal_audio_bank_cleanup(void);
+
+#endif /* HAL_AUDIO_BANK_H */
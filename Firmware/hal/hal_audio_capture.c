@@ -0,0 +1,178 @@
+/**
+ * @file hal_audio_capture.c
+ * @brief Capture sink: null sink timing, plus a WAV of everything played
+ *
+ * Selected with make AUDIO_BACKEND=capture. Every period the mixer writes
+ * lands in a 16 kHz mono WAV at the sample position of the moment it would
+ * have reached the speaker, with silence filling the time the stream was
+ * stopped. Sample n of the file therefore plays at t0 + n / rate, where t0
+ * (CLOCK_MONOTONIC microseconds, the clock hal_stats_now_us() uses) is
+ * stored in an "hpts" chunk ahead of the data. Players skip the chunk;
+ * benchmarks read it to line the audio up with request times.
+ *
+ * The file is AUDIO_CAPTURE_PATH, or the device name when that ends in
+ * ".wav" (hal_audio_set_device("/tmp/run1.wav")).
+ */
+
+#include "hal_audio_sink.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef AUDIO_CAPTURE_PATH
+#define AUDIO_CAPTURE_PATH "/tmp/hampod_capture.wav"
+#endif
+
+/* RIFF + fmt + hpts chunk headers and bodies, then the data chunk header */
+#define CAPTURE_HEADER_BYTES (12 + 8 + 16 + 8 + 8 + 8)
+
+static FILE *capture_file;
+static unsigned int capture_rate;
+static uint64_t first_us;      /* When sample 0 plays (0 = nothing yet) */
+static uint64_t file_frames;   /* Samples in the data chunk */
+
+static uint64_t now_us(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000u + (uint64_t)now.tv_nsec / 1000u;
+}
+
+static void put16(uint8_t *out, uint16_t value) {
+  out[0] = (uint8_t)value;
+  out[1] = (uint8_t)(value >> 8);
+}
+
+static void put32(uint8_t *out, uint32_t value) {
+  put16(out, (uint16_t)value);
+  put16(out + 2, (uint16_t)(value >> 16));
+}
+
+/**
+ * @brief (Re)write the header for the samples written so far
+ *
+ * Done when the stream stops as well as on close, so a run that is killed
+ * still leaves a playable file.
+ */
+static void write_header(void) {
+  uint8_t header[CAPTURE_HEADER_BYTES];
+  uint32_t data_bytes = (uint32_t)(file_frames * 2);
+
+  memcpy(header, "RIFF", 4);
+  put32(header + 4, CAPTURE_HEADER_BYTES - 8 + data_bytes);
+  memcpy(header + 8, "WAVE", 4);
+  memcpy(header + 12, "fmt ", 4);
+  put32(header + 16, 16);
+  put16(header + 20, 1); /* PCM */
+  put16(header + 22, 1); /* Mono */
+  put32(header + 24, capture_rate);
+  put32(header + 28, capture_rate * 2);
+  put16(header + 32, 2);
+  put16(header + 34, 16);
+  memcpy(header + 36, "hpts", 4);
+  put32(header + 40, 8);
+  put32(header + 44, (uint32_t)first_us);
+  put32(header + 48, (uint32_t)(first_us >> 32));
+  memcpy(header + 52, "data", 4);
+  put32(header + 56, data_bytes);
+
+  long end = ftell(capture_file);
+  fseek(capture_file, 0, SEEK_SET);
+  fwrite(header, 1, sizeof(header), capture_file);
+  fseek(capture_file, end, SEEK_SET);
+  fflush(capture_file);
+}
+
+static int capture_open(const char *device, unsigned int rate,
+                        size_t *period_frames) {
+  const char *path = AUDIO_CAPTURE_PATH;
+  size_t length = strlen(device);
+  if (length > 4 && strcmp(device + length - 4, ".wav") == 0) {
+    path = device;
+  }
+
+  capture_file = fopen(path, "wb");
+  if (capture_file == NULL) {
+    fprintf(stderr, "HAL Audio: Cannot create capture file %s\n", path);
+    return -errno;
+  }
+  capture_rate = rate;
+  first_us = 0;
+  file_frames = 0;
+  write_header();
+  fseek(capture_file, CAPTURE_HEADER_BYTES, SEEK_SET);
+
+  if (hal_audio_null_sink.open(device, rate, period_frames) != 0) {
+    fclose(capture_file);
+    capture_file = NULL;
+    return -EIO;
+  }
+  printf("HAL Audio: Capturing to %s\n", path);
+  return 0;
+}
+
+static void capture_drain(void) {
+  hal_audio_null_sink.drain();
+  write_header();
+}
+
+static void capture_close(void) {
+  hal_audio_null_sink.close();
+  write_header();
+  fclose(capture_file);
+  capture_file = NULL;
+  printf("HAL Audio: Capture closed (%llu samples)\n",
+         (unsigned long long)file_frames);
+}
+
+static long capture_write(const int16_t *samples, size_t frames) {
+  static const int16_t silence[256];
+  long queued = 0;
+
+  /* When these frames will be heard: after everything already queued */
+  hal_audio_null_sink.delay(&queued);
+  uint64_t due_us = now_us() + (uint64_t)queued * 1000000u / capture_rate;
+
+  long result = hal_audio_null_sink.write(samples, frames);
+  if (result < 0) {
+    return result; /* Underrun: the mixer drops this period */
+  }
+
+  if (first_us == 0) {
+    first_us = due_us;
+  }
+  /* A running stream is contiguous; one that is starting again fills the
+   * time it was stopped with silence */
+  uint64_t position = file_frames;
+  if (queued == 0) {
+    position = (due_us - first_us) * capture_rate / 1000000u;
+  }
+  while (position > file_frames) {
+    uint64_t gap = position - file_frames;
+    size_t chunk = gap < 256 ? (size_t)gap : 256;
+    fwrite(silence, sizeof(int16_t), chunk, capture_file);
+    file_frames += chunk;
+  }
+  fwrite(samples, sizeof(int16_t), frames, capture_file);
+  file_frames += frames;
+  return result;
+}
+
+static int capture_recover(long err) {
+  return hal_audio_null_sink.recover(err);
+}
+
+static int capture_delay(long *frames) {
+  return hal_audio_null_sink.delay(frames);
+}
+
+const AudioSink hal_audio_capture_sink = {
+    .name = "Capture to WAV (virtual clock, mixed)",
+    .uses_card = 0,
+    .open = capture_open,
+    .close = capture_close,
+    .write = capture_write,
+    .recover = capture_recover,
+    .delay = capture_delay,
+    .drain = capture_drain,
+};
@@ -0,0 +1,312 @@
+/**
+ * @file hal_audio_convert.c
+ * @brief WAV parsing and conversion to the pipeline format
+ *        (see hal_audio_convert.h)
+ */
+
+#include "hal_audio_convert.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define WAV_FORMAT_PCM 0x0001
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE
+
+/* Filter taps per phase for each unit of decimation. 32 taps at the input
+ * rate give a transition band of about a tenth of the output band. */
+#define CONVERT_TAPS 32
+#define CONVERT_ROLLOFF 0.9     /* Cutoff, as a fraction of the lower Nyquist */
+#define CONVERT_KAISER_BETA 7.0 /* About 70 dB stopband */
+#define CONVERT_MAX_COEFFS 65536
+
+/* ============================================================================
+ * WAV Header
+ * ============================================================================
+ */
+
+static uint16_t read_le16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+
+static uint32_t read_le32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+int hal_wav_read_header(FILE *file, WavFormat *format) {
+  uint8_t riff[12];
+  uint8_t chunk[8];
+  uint8_t fmt[40];
+  int have_fmt = 0;
+
+  if (fread(riff, 1, 12, file) != 12 || memcmp(riff, "RIFF", 4) != 0 ||
+      memcmp(riff + 8, "WAVE", 4) != 0) {
+    return -1;
+  }
+
+  while (fread(chunk, 1, 8, file) == 8) {
+    uint32_t size = read_le32(chunk + 4);
+
+    if (memcmp(chunk, "data", 4) == 0) {
+      if (!have_fmt) {
+        return -1;
+      }
+      format->data_size = size;
+      return 0;
+    }
+
+    if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+      size_t want = size < sizeof(fmt) ? size : sizeof(fmt);
+      if (fread(fmt, 1, want, file) != want) {
+        return -1;
+      }
+      uint16_t tag = read_le16(fmt);
+      if (tag == WAV_FORMAT_EXTENSIBLE && want >= 26) {
+        tag = read_le16(fmt + 24); /* First bytes of the SubFormat GUID */
+      }
+      if (tag != WAV_FORMAT_PCM) {
+        return -1;
+      }
+      format->channels = read_le16(fmt + 2);
+      format->sample_rate = read_le32(fmt + 4);
+      format->block_align = read_le16(fmt + 12);
+      format->bits_per_sample = read_le16(fmt + 14);
+      if (format->channels == 0 || format->sample_rate == 0) {
+        return -1;
+      }
+      /* Every reader strides by whole samples per channel; a block_align
+       * that disagrees would overrun or garble them */
+      uint16_t frame = format->channels * ((format->bits_per_sample + 7) / 8);
+      if (format->block_align == 0) {
+        format->block_align = frame;
+      } else if (format->block_align != frame) {
+        return -2;
+      }
+      have_fmt = 1;
+      size -= want;
+    }
+
+    /* Skip the rest of the chunk, plus its pad byte */
+    if (fseek(file, (long)size + (size & 1), SEEK_CUR) != 0) {
+      return -1;
+    }
+  }
+  return -1;
+}
+
+/* ============================================================================
+ * Filter Design
+ * ============================================================================
+ */
+
+static unsigned gcd(unsigned a, unsigned b) {
+  while (b != 0) {
+    unsigned t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+/* Zeroth-order modified Bessel function, for the Kaiser window */
+static double bessel_i0(double x) {
+  double sum = 1.0;
+  double term = 1.0;
+  for (int k = 1; k < 32; k++) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+/**
+ * @brief Fill conv->coeffs with a windowed-sinc lowpass split into phases
+ *
+ * The prototype runs at up * input rate, cut off just below the lower of
+ * the two Nyquist frequencies. Each phase is normalised to unity DC gain
+ * before rounding to Q15, and stored oldest-sample-first to match the
+ * history window so the inner loop is a plain dot product.
+ */
+static void design_filter(AudioConverter *conv, uint32_t in_rate) {
+  unsigned up = conv->up;
+  unsigned taps = conv->taps;
+  double length = (double)up * taps;
+  double centre = (length - 1) / 2.0;
+  uint32_t lower = in_rate < CONVERT_OUT_RATE ? in_rate : CONVERT_OUT_RATE;
+  double cutoff = CONVERT_ROLLOFF * 0.5 * lower / ((double)up * in_rate);
+  double window_norm = bessel_i0(CONVERT_KAISER_BETA);
+  double phase_taps[taps];
+
+  for (unsigned p = 0; p < up; p++) {
+    double sum = 0.0;
+    for (unsigned k = 0; k < taps; k++) {
+      double n = p + (double)k * up;
+      double x = n - centre;
+      double sinc = x == 0.0 ? 1.0 : sin(2.0 * M_PI * cutoff * x) /
+                                         (2.0 * M_PI * cutoff * x);
+      double r = 2.0 * n / (length - 1) - 1.0;
+      double window =
+          bessel_i0(CONVERT_KAISER_BETA * sqrt(r < 1.0 ? 1.0 - r * r : 0.0)) /
+          window_norm;
+      phase_taps[k] = sinc * window;
+      sum += phase_taps[k];
+    }
+
+    int16_t *phase = conv->coeffs + (size_t)p * taps;
+    for (unsigned k = 0; k < taps; k++) {
+      long q = lround(phase_taps[k] / sum * 32768.0);
+      if (q > INT16_MAX) {
+        q = INT16_MAX;
+      } else if (q < INT16_MIN) {
+        q = INT16_MIN;
+      }
+      phase[taps - 1 - k] = (int16_t)q;
+    }
+  }
+}
+
+/* ============================================================================
+ * Conversion
+ * ============================================================================
+ */
+
+/* Q15 inner product; n is a multiple of CONVERT_TAPS in practice */
+static int32_t dot_q15(const int16_t *a, const int16_t *b, unsigned n) {
+  int32_t total = 0;
+  unsigned i = 0;
+
+#if defined(__ARM_NEON)
+  int32x4_t acc = vdupq_n_s32(0);
+  for (; i + 8 <= n; i += 8) {
+    int16x8_t va = vld1q_s16(a + i);
+    int16x8_t vb = vld1q_s16(b + i);
+    acc = vmlal_s16(acc, vget_low_s16(va), vget_low_s16(vb));
+    acc = vmlal_s16(acc, vget_high_s16(va), vget_high_s16(vb));
+  }
+  int32x2_t pair = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+  total = vget_lane_s32(vpadd_s32(pair, pair), 0);
+#elif defined(__SSE2__)
+  __m128i acc = _mm_setzero_si128();
+  for (; i + 8 <= n; i += 8) {
+    __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+    __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+    acc = _mm_add_epi32(acc, _mm_madd_epi16(va, vb));
+  }
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+  total = _mm_cvtsi128_si32(acc);
+#endif
+
+  for (; i < n; i++) {
+    total += (int32_t)a[i] * b[i];
+  }
+  return total;
+}
+
+/* One input frame as a mono 16-bit sample */
+static int16_t read_frame(const AudioConverter *conv, const uint8_t *frame) {
+  int32_t sum = 0;
+  for (unsigned c = 0; c < conv->channels; c++) {
+    const uint8_t *s = frame + c * conv->bytes_per_sample;
+    switch (conv->bytes_per_sample) {
+    case 1:
+      sum += ((int32_t)s[0] - 128) << 8; /* 8-bit WAV is unsigned */
+      break;
+    case 2:
+      sum += (int16_t)read_le16(s);
+      break;
+    default:
+      /* 24/32-bit: keep the top 16 bits */
+      sum += (int16_t)read_le16(s + conv->bytes_per_sample - 2);
+      break;
+    }
+  }
+  return (int16_t)(sum / (int32_t)conv->channels);
+}
+
+int hal_convert_init(AudioConverter *conv, uint32_t sample_rate,
+                     uint16_t channels, uint16_t bits_per_sample) {
+  memset(conv, 0, sizeof(*conv));
+  if (sample_rate == 0 || channels == 0 || bits_per_sample == 0 ||
+      bits_per_sample > 32) {
+    return -1;
+  }
+
+  conv->channels = channels;
+  conv->bytes_per_sample = (bits_per_sample + 7) / 8;
+  if (sample_rate == CONVERT_OUT_RATE) {
+    conv->passthrough = 1;
+    conv->up = conv->down = 1;
+    return 0;
+  }
+
+  unsigned common = gcd(sample_rate, CONVERT_OUT_RATE);
+  conv->up = CONVERT_OUT_RATE / common;
+  conv->down = sample_rate / common;
+  conv->taps = CONVERT_TAPS * ((conv->down + conv->up - 1) / conv->up);
+  if ((size_t)conv->up * conv->taps > CONVERT_MAX_COEFFS) {
+    return -1; /* Awkward ratio, e.g. 44056 Hz */
+  }
+
+  conv->coeffs = (int16_t *)malloc((size_t)conv->up * conv->taps *
+                                   sizeof(int16_t));
+  conv->history = (int16_t *)calloc(2 * conv->taps, sizeof(int16_t));
+  if (conv->coeffs == NULL || conv->history == NULL) {
+    hal_convert_free(conv);
+    return -1;
+  }
+  design_filter(conv, sample_rate);
+  return 0;
+}
+
+size_t hal_convert_max_output(const AudioConverter *conv, size_t in_frames) {
+  if (conv->passthrough) {
+    return in_frames;
+  }
+  return (in_frames * conv->up + conv->down - 1) / conv->down + 1;
+}
+
+size_t hal_convert_process(AudioConverter *conv, const uint8_t *in,
+                           size_t in_frames, int16_t *out) {
+  size_t frame_bytes = (size_t)conv->channels * conv->bytes_per_sample;
+  size_t produced = 0;
+
+  for (size_t f = 0; f < in_frames; f++) {
+    int16_t sample = read_frame(conv, in + f * frame_bytes);
+    if (conv->passthrough) {
+      out[produced++] = sample;
+      continue;
+    }
+
+    /* Stored twice, so history + pos is always taps contiguous samples */
+    conv->history[conv->pos] = sample;
+    conv->history[conv->pos + conv->taps] = sample;
+    conv->pos = (conv->pos + 1) % conv->taps;
+
+    while (conv->phase < conv->up) {
+      int32_t acc =
+          dot_q15(conv->history + conv->pos,
+                  conv->coeffs + (size_t)conv->phase * conv->taps, conv->taps);
+      acc = (acc + (1 << 14)) >> 15;
+      if (acc > INT16_MAX) {
+        acc = INT16_MAX;
+      } else if (acc < INT16_MIN) {
+        acc = INT16_MIN;
+      }
+      out[produced++] = (int16_t)acc;
+      conv->phase += conv->down;
+    }
+    conv->phase -= conv->up;
+  }
+  return produced;
+}
+
+void hal_convert_free(AudioConverter *conv) {
+  free(conv->coeffs);
+  free(conv->history);
+  conv->coeffs = NULL;
+  conv->history = NULL;
+}
@@ -0,0 +1,97 @@
+#ifndef HAL_AUDIO_CONVERT_H
+#define HAL_AUDIO_CONVERT_H
+
+/**
+ * @file hal_audio_convert.h
+ * @brief WAV parsing and conversion to the pipeline format
+ *
+ * The mixer only plays 16 kHz mono 16-bit samples. A converter turns any
+ * PCM WAV (8/16/24/32-bit, any channel count, any common sample rate) into
+ * that format in blocks, so hal_audio_play_file() can stream it through the
+ * interruptible mixer path instead of shelling out to aplay.
+ *
+ * Channels are averaged to mono, samples are scaled to 16 bits, and the
+ * rate is changed by a rational L/M polyphase FIR (Kaiser-windowed sinc,
+ * Q15 coefficients). The filter's inner product uses NEON or SSE2 when the
+ * compiler targets them.
+ *
+ * Nothing here touches ALSA, so conversion can be tested without a device.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Format every converter produces */
+#define CONVERT_OUT_RATE 16000
+
+/**
+ * @brief Format of a PCM WAV file
+ */
+typedef struct {
+  uint32_t sample_rate;
+  uint16_t channels;
+  uint16_t bits_per_sample;
+  uint16_t block_align; /* Bytes per frame (all channels) */
+  uint32_t data_size;   /* Bytes of sample data */
+} WavFormat;
+
+/**
+ * @brief Read a WAV header, leaving the file at the first sample
+ *
+ * Walks the RIFF chunks, so files with LIST/fact chunks or a
+ * WAVE_FORMAT_EXTENSIBLE fmt chunk are accepted.
+ *
+ * @return 0 on success, -1 if the file is not a PCM WAV file, -2 if it is
+ *         but its block_align is not channels times the sample size
+ */
+int hal_wav_read_header(FILE *file, WavFormat *format);
+
+/**
+ * @brief Streaming converter state
+ */
+typedef struct {
+  uint16_t channels;
+  uint16_t bytes_per_sample;
+  int passthrough;  /* Already 16 kHz: no filtering */
+  unsigned up;      /* Interpolation factor L */
+  unsigned down;    /* Decimation factor M */
+  unsigned taps;    /* Filter taps per phase */
+  unsigned phase;   /* Next output's position, in 1/L input samples */
+  unsigned pos;     /* Oldest sample in history */
+  int16_t *coeffs;  /* up * taps, phase-major, oldest sample first */
+  int16_t *history; /* 2 * taps: each sample stored twice */
+} AudioConverter;
+
+/**
+ * @brief Set up a converter for one input format
+ *
+ * @return 0 on success, -1 if the format is not supported
+ */
+int hal_convert_init(AudioConverter *conv, uint32_t sample_rate,
+                     uint16_t channels, uint16_t bits_per_sample);
+
+/**
+ * @brief Output buffer size needed for a block of input frames
+ */
+size_t hal_convert_max_output(const AudioConverter *conv, size_t in_frames);
+
+/**
+ * @brief Convert whole input frames
+ *
+ * Filter state carries over between calls, so a file may be converted in
+ * blocks of any size.
+ *
+ * @param in Interleaved little-endian PCM, in_frames whole frames
+ * @param out At least hal_convert_max_output(conv, in_frames) samples
+ * @return Number of samples written to out
+ */
+size_t hal_convert_process(AudioConverter *conv, const uint8_t *in,
+                           size_t in_frames, int16_t *out);
+
+/**
+ * @brief Free memory held by a converter
+ */
+void hal_convert_free(AudioConverter *conv);
+
+#endif /* HAL_AUDIO_CONVERT_H */
@@ -0,0 +1,279 @@
+/**
+ * @file hal_audio_mix.c
+ * @brief Voice rings and sample mixing (see hal_audio_mix.h)
+ */
+
+#include "hal_audio_mix.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define MIX_GAIN_STEP                                                          \
+  ((MIX_GAIN_UNITY + MIX_GAIN_RAMP_SAMPLES - 1) / MIX_GAIN_RAMP_SAMPLES)
+
+int hal_mix_voice_init(MixVoice *voice, size_t capacity) {
+  size_t size = 1;
+  while (size < capacity) {
+    size <<= 1;
+  }
+
+  voice->samples = (int16_t *)calloc(size, sizeof(int16_t));
+  if (voice->samples == NULL) {
+    return -1;
+  }
+  voice->mask = size - 1;
+  atomic_store(&voice->head, 0);
+  atomic_store(&voice->tail, 0);
+  atomic_store(&voice->flush_mark, 0);
+  atomic_store(&voice->fade_mark, 0);
+  hal_mix_gain_init(&voice->gain, MIX_GAIN_UNITY);
+  return 0;
+}
+
+void hal_mix_voice_free(MixVoice *voice) {
+  free(voice->samples);
+  voice->samples = NULL;
+}
+
+size_t hal_mix_voice_space(MixVoice *voice) {
+  size_t head = atomic_load(&voice->head);
+  size_t tail = atomic_load(&voice->tail);
+  return voice->mask + 1 - (tail - head);
+}
+
+size_t hal_mix_voice_pending(MixVoice *voice) {
+  size_t head = atomic_load(&voice->head);
+  size_t tail = atomic_load(&voice->tail);
+  size_t mark = atomic_load(&voice->flush_mark);
+  /* Samples behind a pending flush will never be heard */
+  if ((ptrdiff_t)(mark - head) > 0) {
+    head = mark;
+  }
+  return tail - head;
+}
+
+size_t hal_mix_voice_write(MixVoice *voice, const int16_t *samples,
+                           size_t num_samples) {
+  size_t tail = atomic_load_explicit(&voice->tail, memory_order_relaxed);
+  size_t space = hal_mix_voice_space(voice);
+  if (num_samples > space) {
+    num_samples = space;
+  }
+
+  size_t start = tail & voice->mask;
+  size_t first = voice->mask + 1 - start;
+  if (first > num_samples) {
+    first = num_samples;
+  }
+  memcpy(voice->samples + start, samples, first * sizeof(int16_t));
+  memcpy(voice->samples, samples + first,
+         (num_samples - first) * sizeof(int16_t));
+
+  /* Publish the samples only after they are in place */
+  atomic_store(&voice->tail, tail + num_samples);
+  return num_samples;
+}
+
+void hal_mix_voice_flush(MixVoice *voice) {
+  atomic_store(&voice->flush_mark, atomic_load(&voice->tail));
+}
+
+void hal_mix_voice_fade_out(MixVoice *voice) {
+  /* Keyed to the mark, set before it, so the mixer never sees the mark
+   * without it, and a fade with nothing left to fade cannot linger until a
+   * later plain flush */
+  size_t tail = atomic_load(&voice->tail);
+  atomic_store(&voice->fade_mark, tail);
+  atomic_store(&voice->flush_mark, tail);
+}
+
+/* Copy samples out of a ring, unwrapping */
+static void voice_read(MixVoice *voice, size_t head, int16_t *out,
+                       size_t count) {
+  size_t start = head & voice->mask;
+  size_t first = voice->mask + 1 - start;
+  if (first > count) {
+    first = count;
+  }
+  memcpy(out, voice->samples + start, first * sizeof(int16_t));
+  memcpy(out + first, voice->samples, (count - first) * sizeof(int16_t));
+}
+
+static int16_t scale_sample(int16_t sample, int q15) {
+  return (int16_t)(((int32_t)sample * q15 + (1 << 14)) >> 15);
+}
+
+#if defined(__SSE2__) && !defined(__ARM_NEON)
+/* Q15 multiply with rounding, eight lanes. Multipliers must be below
+ * unity so they fit in an int16. */
+static __m128i mul_q15(__m128i in, __m128i multiplier) {
+  __m128i round = _mm_set1_epi32(1 << 14);
+  __m128i lo = _mm_mullo_epi16(in, multiplier);
+  __m128i hi = _mm_mulhi_epi16(in, multiplier);
+  __m128i first = _mm_add_epi32(_mm_unpacklo_epi16(lo, hi), round);
+  __m128i second = _mm_add_epi32(_mm_unpackhi_epi16(lo, hi), round);
+  return _mm_packs_epi32(_mm_srai_epi32(first, 15),
+                         _mm_srai_epi32(second, 15));
+}
+#endif
+
+/* Fade count (<= MIX_FADE_SAMPLES) samples out, from just under unity to
+ * exactly 0 on the last one, however few there are */
+static void fade_apply(int16_t *samples, size_t count) {
+  int step = count > 1 ? (MIX_GAIN_UNITY - 1) / (int)(count - 1) : 0;
+  size_t i = 0;
+#if defined(__ARM_NEON)
+  static const int16_t lanes[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+  int16x8_t index = vld1q_s16(lanes);
+  for (; i + 8 <= count; i += 8) {
+    /* (count - 1 - i) * step, eight at a time */
+    int16x8_t ramp = vmlsq_n_s16(
+        vdupq_n_s16((int16_t)((count - 1 - i) * step)), index, (int16_t)step);
+    vst1q_s16(samples + i, vqrdmulhq_s16(vld1q_s16(samples + i), ramp));
+  }
+#elif defined(__SSE2__)
+  __m128i index = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+  __m128i steps = _mm_set1_epi16((int16_t)step);
+  for (; i + 8 <= count; i += 8) {
+    __m128i ramp =
+        _mm_sub_epi16(_mm_set1_epi16((int16_t)((count - 1 - i) * step)),
+                      _mm_mullo_epi16(index, steps));
+    __m128i in = _mm_loadu_si128((const __m128i *)(samples + i));
+    _mm_storeu_si128((__m128i *)(samples + i), mul_q15(in, ramp));
+  }
+#endif
+  for (; i < count; i++) {
+    samples[i] = scale_sample(samples[i], (int)(count - 1 - i) * step);
+  }
+}
+
+int hal_mix_voices(MixVoice *voices, int num_voices, int16_t *out,
+                   size_t num_frames) {
+  int32_t sum[num_frames];
+  int16_t block[num_frames];
+  int active = 0;
+
+  memset(sum, 0, sizeof(sum));
+  for (int v = 0; v < num_voices; v++) {
+    MixVoice *voice = &voices[v];
+    size_t head = atomic_load_explicit(&voice->head, memory_order_relaxed);
+    size_t tail = atomic_load(&voice->tail);
+    size_t mark = atomic_load(&voice->flush_mark);
+
+    if ((ptrdiff_t)(mark - head) > 0) {
+      /* Interrupted: the start of what was dropped becomes the fade tail,
+       * overlapping whatever was queued after the interrupt */
+      size_t fade = 0;
+      if (atomic_load(&voice->fade_mark) == mark) {
+        fade = mark - head;
+        if (fade > MIX_FADE_SAMPLES) {
+          fade = MIX_FADE_SAMPLES;
+        }
+        if (fade > num_frames) {
+          fade = num_frames;
+        }
+      }
+      if (fade > 0) {
+        voice_read(voice, head, block, fade);
+        hal_mix_gain_apply(&voice->gain, block, fade);
+        fade_apply(block, fade);
+        for (size_t i = 0; i < fade; i++) {
+          sum[i] += block[i];
+        }
+        active++;
+      }
+      head = mark;
+    }
+    size_t count = tail - head;
+    if (count > num_frames) {
+      count = num_frames;
+    }
+    if (count > 0) {
+      active++;
+      voice_read(voice, head, block, count);
+      hal_mix_gain_apply(&voice->gain, block, count);
+      for (size_t i = 0; i < count; i++) {
+        sum[i] += block[i];
+      }
+    }
+
+    /* Hand the space back to the producer */
+    atomic_store(&voice->head, head + count);
+  }
+
+  for (size_t i = 0; i < num_frames; i++) {
+    int32_t sample = sum[i];
+    if (sample > INT16_MAX) {
+      sample = INT16_MAX;
+    } else if (sample < INT16_MIN) {
+      sample = INT16_MIN;
+    }
+    out[i] = (int16_t)sample;
+  }
+  return active;
+}
+
+void hal_mix_gain_init(MixGain *gain, int q15) {
+  hal_mix_gain_set(gain, q15);
+  gain->current = atomic_load(&gain->target);
+}
+
+void hal_mix_gain_set(MixGain *gain, int q15) {
+  if (q15 < 0) {
+    q15 = 0;
+  } else if (q15 > MIX_GAIN_UNITY) {
+    q15 = MIX_GAIN_UNITY;
+  }
+  atomic_store(&gain->target, q15);
+}
+
+void hal_mix_gain_apply(MixGain *gain, int16_t *samples, size_t num_frames) {
+  int target = atomic_load(&gain->target);
+  size_t i = 0;
+
+  /* Slew towards the target */
+  for (; i < num_frames && gain->current != target; i++) {
+    if (gain->current < target) {
+      gain->current += MIX_GAIN_STEP;
+      if (gain->current > target) {
+        gain->current = target;
+      }
+    } else {
+      gain->current -= MIX_GAIN_STEP;
+      if (gain->current < target) {
+        gain->current = target;
+      }
+    }
+    samples[i] = scale_sample(samples[i], gain->current);
+  }
+
+  if (target == MIX_GAIN_UNITY) {
+    return;
+  }
+  if (target == 0) {
+    memset(samples + i, 0, (num_frames - i) * sizeof(int16_t));
+    return;
+  }
+
+  /* Steady gain below unity fits in an int16 multiplier */
+#if defined(__ARM_NEON)
+  for (; i + 8 <= num_frames; i += 8) {
+    /* (2 * s * g + 0x8000) >> 16, i.e. Q15 multiply with rounding */
+    vst1q_s16(samples + i, vqrdmulhq_n_s16(vld1q_s16(samples + i), target));
+  }
+#elif defined(__SSE2__)
+  __m128i multiplier = _mm_set1_epi16((int16_t)target);
+  for (; i + 8 <= num_frames; i += 8) {
+    __m128i in = _mm_loadu_si128((const __m128i *)(samples + i));
+    _mm_storeu_si128((__m128i *)(samples + i), mul_q15(in, multiplier));
+  }
+#endif
+  for (; i < num_frames; i++) {
+    samples[i] = scale_sample(samples[i], target);
+  }
+}
@@ -0,0 +1,146 @@
+#ifndef HAL_AUDIO_MIX_H
+#define HAL_AUDIO_MIX_H
+
+/**
+ * @file hal_audio_mix.h
+ * @brief Voice rings, sample mixing and output gain for the audio HAL's
+ * mixer thread
+ *
+ * Each voice (speech, beeps, file playback) is a single-producer,
+ * single-consumer ring of 16-bit mono samples. Producers append with
+ * hal_mix_voice_write(); the mixer thread sums all voices into one period
+ * with hal_mix_voices(), fading out voices that were interrupted and
+ * scaling ducked ones on the way. Nothing here touches ALSA, so mixing can be tested
+ * without an audio device.
+ */
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Q15 gain: MIX_GAIN_UNITY leaves samples untouched */
+#define MIX_GAIN_UNITY 32768
+
+/* A gain change slews at most this many samples from mute to unity, so
+ * volume changes never click (20 ms at 16 kHz) */
+#define MIX_GAIN_RAMP_SAMPLES 320
+
+/**
+ * @brief Gain stage (output volume, or one voice's duck level)
+ *
+ * Any thread may set the target; only the mixer thread applies it.
+ */
+typedef struct {
+  _Atomic int target; /* Q15, 0..MIX_GAIN_UNITY */
+  int current;        /* Gain reached so far (mixer thread only) */
+} MixGain;
+
+/* An interrupted voice fades to silence over this many samples instead of
+ * stopping mid-waveform (4 ms at 16 kHz) */
+#define MIX_FADE_SAMPLES 64
+
+/**
+ * @brief One voice ring
+ *
+ * Positions are free-running and masked on access, like the shared-memory
+ * rings in hampod_shm.c.
+ */
+typedef struct {
+  int16_t *samples;
+  size_t mask;               /* Capacity - 1 (capacity is a power of two) */
+  _Atomic size_t head;       /* Next sample the mixer reads */
+  _Atomic size_t tail;       /* Next sample the producer writes */
+  _Atomic size_t flush_mark; /* Mixer skips ahead to here (interrupts) */
+  _Atomic size_t fade_mark;  /* Flush mark whose samples fade, not cut */
+  MixGain gain;              /* Per-voice level, for ducking */
+} MixVoice;
+
+/**
+ * @brief Allocate a voice ring
+ *
+ * @param voice Voice to initialize
+ * @param capacity Samples the ring can hold, rounded up to a power of two
+ * @return 0 on success, -1 on allocation failure
+ */
+int hal_mix_voice_init(MixVoice *voice, size_t capacity);
+
+/**
+ * @brief Free a voice ring
+ */
+void hal_mix_voice_free(MixVoice *voice);
+
+/**
+ * @brief Append samples to a voice (producer side, never blocks)
+ *
+ * @return Number of samples queued; less than num_samples if the ring filled
+ */
+size_t hal_mix_voice_write(MixVoice *voice, const int16_t *samples,
+                           size_t num_samples);
+
+/**
+ * @brief Free space in samples
+ */
+size_t hal_mix_voice_space(MixVoice *voice);
+
+/**
+ * @brief Samples queued but not yet mixed
+ */
+size_t hal_mix_voice_pending(MixVoice *voice);
+
+/**
+ * @brief Discard everything queued so far (any thread)
+ *
+ * The mixer drops the samples at its next period. Samples written after
+ * this call are kept, so a new utterance can be queued straight away.
+ */
+void hal_mix_voice_flush(MixVoice *voice);
+
+/**
+ * @brief Discard everything queued so far, fading out instead of cutting
+ *
+ * Like hal_mix_voice_flush(), but the mixer first plays the next
+ * MIX_FADE_SAMPLES of the discarded audio under a falling ramp, so a voice
+ * stopped mid-waveform does not click. The fade is part of the next period,
+ * so it adds no latency. A shorter remainder is faded over its own length;
+ * with nothing queued the call is a plain flush.
+ */
+void hal_mix_voice_fade_out(MixVoice *voice);
+
+/**
+ * @brief Mix one period from every voice (consumer side)
+ *
+ * Applies each voice's gain, then sums the voices with saturation to the
+ * 16-bit range. Voices that run short contribute silence for the rest of
+ * the period.
+ *
+ * @param voices Array of voices
+ * @param num_voices Number of voices
+ * @param out Output buffer of num_frames samples
+ * @param num_frames Period length in samples
+ * @return Number of voices that contributed samples, including fades
+ *         (0 = silence)
+ */
+int hal_mix_voices(MixVoice *voices, int num_voices, int16_t *out,
+                   size_t num_frames);
+
+/**
+ * @brief Start a gain stage at a fixed gain, with no ramp
+ */
+void hal_mix_gain_init(MixGain *gain, int q15);
+
+/**
+ * @brief Set the gain to ramp towards (any thread)
+ *
+ * @param q15 Gain, clamped to 0..MIX_GAIN_UNITY
+ */
+void hal_mix_gain_set(MixGain *gain, int q15);
+
+/**
+ * @brief Apply the gain to a block of samples in place (consumer side)
+ *
+ * Ramps linearly while the gain is changing, then scales the rest of the
+ * period with a fixed-point multiply (NEON or SSE2 when available).
+ */
+void hal_mix_gain_apply(MixGain *gain, int16_t *samples, size_t num_frames);
+
+#endif /* HAL_AUDIO_MIX_H */
@@ -0,0 +1,122 @@
+/**
+ * @file hal_audio_null.c
+ * @brief Null audio sink: plays nothing, at exactly the real-time rate
+ *
+ * Stands in for the sound card (make AUDIO_BACKEND=null) so the mixer, TTS
+ * and latency statistics can be exercised on a machine with no audio
+ * hardware. A virtual clock started by the first write "plays" rate frames
+ * per second from a 100 ms buffer: writes block while the buffer is full,
+ * the delay reported to the mixer is what the clock has not reached yet,
+ * and a write after the clock ran past everything queued is an underrun,
+ * as it would be on the device. See hal_audio_sink.h.
+ */
+
+#include "hal_audio_sink.h"
+#include <errno.h>
+#include <stdio.h>
+#include <time.h>
+
+/* Same geometry the ALSA sink asks for */
+#define NULL_BUFFER_DIVISOR 10 /* 100 ms buffer */
+#define NULL_PERIOD_DIVISOR 40 /* 25 ms periods */
+
+static unsigned int sink_rate;
+static int running;         /* Clock started, not drained since */
+static uint64_t start_us;   /* When frame 0 of this run started playing */
+static uint64_t written;    /* Frames queued since start_us */
+
+static uint64_t now_us(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000u + (uint64_t)now.tv_nsec / 1000u;
+}
+
+/* Frames the virtual clock has played since start_us (not capped) */
+static uint64_t played_frames(void) {
+  return (now_us() - start_us) * sink_rate / 1000000u;
+}
+
+static void sleep_frames(uint64_t frames) {
+  uint64_t micros = frames * 1000000u / sink_rate + 1;
+  struct timespec pause = {(time_t)(micros / 1000000u),
+                           (long)(micros % 1000000u) * 1000L};
+  nanosleep(&pause, NULL);
+}
+
+static int null_open(const char *device, unsigned int rate,
+                     size_t *period_frames) {
+  (void)device;
+  sink_rate = rate;
+  running = 0;
+  *period_frames = rate / NULL_PERIOD_DIVISOR;
+  printf("HAL Audio: Null sink opened (rate=%u, buffer=%u, period=%zu)\n",
+         rate, rate / NULL_BUFFER_DIVISOR, *period_frames);
+  return 0;
+}
+
+static void null_drain(void) {
+  long queued = 0;
+  if (running && hal_audio_null_sink.delay(&queued) == 0 && queued > 0) {
+    sleep_frames((uint64_t)queued);
+  }
+  running = 0;
+}
+
+static void null_close(void) {
+  null_drain();
+  printf("HAL Audio: Null sink closed\n");
+}
+
+static long null_write(const int16_t *samples, size_t frames) {
+  uint64_t buffer = sink_rate / NULL_BUFFER_DIVISOR;
+  (void)samples;
+
+  if (running && played_frames() > written) {
+    running = 0; /* Ran dry: report it, the mixer recovers */
+    return -EPIPE;
+  }
+  if (!running) {
+    start_us = now_us();
+    written = 0;
+    running = 1;
+  }
+
+  /* Block like a full device buffer */
+  for (;;) {
+    uint64_t played = played_frames();
+    uint64_t queued = written > played ? written - played : 0;
+    if (queued + frames <= buffer) {
+      break;
+    }
+    sleep_frames(queued + frames - buffer);
+  }
+  written += frames;
+  return (long)frames;
+}
+
+static int null_recover(long err) {
+  (void)err;
+  running = 0; /* The next write restarts the clock */
+  return 0;
+}
+
+static int null_delay(long *frames) {
+  if (!running) {
+    *frames = 0;
+    return 0;
+  }
+  uint64_t played = played_frames();
+  *frames = written > played ? (long)(written - played) : 0;
+  return 0;
+}
+
+const AudioSink hal_audio_null_sink = {
+    .name = "Null audio (virtual clock, mixed)",
+    .uses_card = 0,
+    .open = null_open,
+    .close = null_close,
+    .write = null_write,
+    .recover = null_recover,
+    .delay = null_delay,
+    .drain = null_drain,
+};
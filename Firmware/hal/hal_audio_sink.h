@@ -0,0 +1,83 @@
+#ifndef HAL_AUDIO_SINK_H
+#define HAL_AUDIO_SINK_H
+
+/**
+ * @file hal_audio_sink.h
+ * @brief Output device behind the audio HAL's mixer thread
+ *
+ * hal_audio_usb.c owns the mixer, voices, beeps and prompt bank; the sink
+ * is only where mixed periods go. The ALSA sink lives in hal_audio_usb.c.
+ * The makefile's AUDIO_BACKEND variable swaps in a headless one:
+ *
+ * - null (AUDIO_BACKEND_NULL, hal_audio_null.c): consumes samples at the
+ *   real-time rate against a virtual clock, with no device at all
+ * - capture (AUDIO_BACKEND_CAPTURE, hal_audio_capture.c): the null sink's
+ *   timing, plus everything played written to a timestamped WAV file
+ *
+ * The calls mirror the snd_pcm_* ones the mixer used directly, and are
+ * only made from the mixer thread (and init/cleanup before and after it).
+ * Errors are negative errno values, as in ALSA.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+  const char *name; /* For hal_audio_get_impl_name() */
+  int uses_card;    /* Look for a USB sound card at init */
+
+  /**
+   * @brief Open for 16-bit mono at rate
+   *
+   * @param device Device name from hal_audio_set_device()
+   * @param period_frames Set to the period the mixer should write
+   * @return 0 on success, negative on failure
+   */
+  int (*open)(const char *device, unsigned int rate, size_t *period_frames);
+
+  /** @brief Let queued audio play out, then close */
+  void (*close)(void);
+
+  /**
+   * @brief Queue one period, blocking while the buffer is full
+   *
+   * @return Frames queued, or negative (-EPIPE on underrun)
+   */
+  long (*write)(const int16_t *samples, size_t frames);
+
+  /** @brief Recover from a write error: 0 if playback can go on */
+  int (*recover)(long err);
+
+  /**
+   * @brief Frames queued and not yet played
+   *
+   * @return 0 on success, negative if unknown
+   */
+  int (*delay)(long *frames);
+
+  /** @brief Let queued audio play out and stop; the next write restarts */
+  void (*drain)(void);
+
+  /**
+   * @brief Optional: where to mix the next frames in place
+   *
+   * For sinks with a buffer the mixer can write into directly (ALSA mmap
+   * access). NULL when there is no such buffer, or it has no contiguous
+   * room for frames; the mixer then mixes into its own array and calls
+   * write(). A non-NULL return must be followed by commit().
+   */
+  int16_t *(*map)(size_t frames);
+
+  /**
+   * @brief Queue frames mixed at map()'s pointer (0 abandons them)
+   *
+   * @return As write()
+   */
+  long (*commit)(size_t frames);
+} AudioSink;
+
+/* Headless sinks (linked only when AUDIO_BACKEND selects them) */
+extern const AudioSink hal_audio_null_sink;
+extern const AudioSink hal_audio_capture_sink;
+
+#endif /* HAL_AUDIO_SINK_H */
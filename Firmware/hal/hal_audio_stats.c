@@ -0,0 +1,138 @@
+/**
+ * @file hal_audio_stats.c
+ * @brief Audio pipeline telemetry (see hal_audio_stats.h)
+ */
+
+#include "hal_audio_stats.h"
+#include <stdatomic.h>
+#include <time.h>
+
+typedef struct {
+  _Atomic uint32_t buckets[STATS_BUCKETS];
+  _Atomic uint32_t max_us;
+} Histogram;
+
+static _Atomic uint32_t counters[AUDIO_COUNT_TOTAL];
+static Histogram histograms[AUDIO_LAT_TOTAL];
+static _Atomic uint32_t queue_max_ms;
+
+/* Below STATS_SUB_BUCKETS us each value has its own bucket; above, each
+ * power of two is split into STATS_SUB_BUCKETS equal parts */
+static int bucket_index(uint64_t micros) {
+  if (micros < STATS_SUB_BUCKETS) {
+    return (int)micros;
+  }
+  int msb = 63 - __builtin_clzll(micros);
+  int shift = msb - STATS_SUB_BUCKET_BITS;
+  int index = STATS_SUB_BUCKETS + shift * STATS_SUB_BUCKETS +
+              (int)((micros >> shift) - STATS_SUB_BUCKETS);
+  return index < STATS_BUCKETS ? index : STATS_BUCKETS - 1;
+}
+
+/* Largest value that lands in a bucket */
+static uint32_t bucket_upper(int index) {
+  if (index < STATS_SUB_BUCKETS) {
+    return (uint32_t)index;
+  }
+  int shift = (index - STATS_SUB_BUCKETS) / STATS_SUB_BUCKETS;
+  uint64_t sub = (uint64_t)(index % STATS_SUB_BUCKETS) + STATS_SUB_BUCKETS;
+  return (uint32_t)(((sub + 1) << shift) - 1);
+}
+
+static void store_max(_Atomic uint32_t *target, uint32_t value) {
+  uint32_t seen = atomic_load_explicit(target, memory_order_relaxed);
+  while (value > seen &&
+         !atomic_compare_exchange_weak_explicit(
+             target, &seen, value, memory_order_relaxed, memory_order_relaxed)) {
+  }
+}
+
+uint64_t hal_stats_now_us(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000u + (uint64_t)now.tv_nsec / 1000u;
+}
+
+void hal_stats_count(AudioCounter counter) {
+  atomic_fetch_add_explicit(&counters[counter], 1, memory_order_relaxed);
+}
+
+void hal_stats_record_us(AudioLatency latency, uint64_t micros) {
+  Histogram *histogram = &histograms[latency];
+  atomic_fetch_add_explicit(&histogram->buckets[bucket_index(micros)], 1,
+                            memory_order_relaxed);
+  store_max(&histogram->max_us,
+            micros > UINT32_MAX ? UINT32_MAX : (uint32_t)micros);
+}
+
+void hal_stats_record_since(AudioLatency latency, uint64_t start_us) {
+  uint64_t now = hal_stats_now_us();
+  hal_stats_record_us(latency, now > start_us ? now - start_us : 0);
+}
+
+void hal_stats_note_queue_ms(uint32_t queued_ms) {
+  store_max(&queue_max_ms, queued_ms);
+}
+
+uint32_t hal_stats_percentile(AudioLatency latency, double fraction) {
+  Histogram *histogram = &histograms[latency];
+  uint32_t counts[STATS_BUCKETS];
+  uint64_t total = 0;
+
+  for (int i = 0; i < STATS_BUCKETS; i++) {
+    counts[i] =
+        atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed);
+    total += counts[i];
+  }
+  if (total == 0) {
+    return 0;
+  }
+
+  uint64_t wanted = (uint64_t)(fraction * total + 0.999999);
+  if (wanted == 0) {
+    wanted = 1;
+  }
+  uint64_t seen = 0;
+  uint32_t max = atomic_load_explicit(&histogram->max_us, memory_order_relaxed);
+  for (int i = 0; i < STATS_BUCKETS; i++) {
+    seen += counts[i];
+    if (seen >= wanted) {
+      uint32_t upper = bucket_upper(i);
+      return upper < max ? upper : max;
+    }
+  }
+  return max;
+}
+
+void hal_stats_snapshot(AudioStatsSnapshot *out) {
+  for (int c = 0; c < AUDIO_COUNT_TOTAL; c++) {
+    out->counters[c] = atomic_load_explicit(&counters[c], memory_order_relaxed);
+  }
+  for (int l = 0; l < AUDIO_LAT_TOTAL; l++) {
+    LatencySummary *summary = &out->latency[l];
+    summary->count = 0;
+    for (int i = 0; i < STATS_BUCKETS; i++) {
+      summary->count += atomic_load_explicit(&histograms[l].buckets[i],
+                                             memory_order_relaxed);
+    }
+    summary->p50_us = hal_stats_percentile((AudioLatency)l, 0.50);
+    summary->p90_us = hal_stats_percentile((AudioLatency)l, 0.90);
+    summary->p99_us = hal_stats_percentile((AudioLatency)l, 0.99);
+    summary->max_us =
+        atomic_load_explicit(&histograms[l].max_us, memory_order_relaxed);
+  }
+  out->queue_max_ms = atomic_load_explicit(&queue_max_ms, memory_order_relaxed);
+}
+
+void hal_stats_reset(void) {
+  for (int c = 0; c < AUDIO_COUNT_TOTAL; c++) {
+    atomic_store(&counters[c], 0);
+  }
+  for (int l = 0; l < AUDIO_LAT_TOTAL; l++) {
+    for (int i = 0; i < STATS_BUCKETS; i++) {
+      atomic_store(&histograms[l].buckets[i], 0);
+    }
+    atomic_store(&histograms[l].max_us, 0);
+  }
+  atomic_store(&queue_max_ms, 0);
+}
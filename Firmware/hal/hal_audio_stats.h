@@ -0,0 +1,109 @@
+#ifndef HAL_AUDIO_STATS_H
+#define HAL_AUDIO_STATS_H
+
+/**
+ * @file hal_audio_stats.h
+ * @brief Audio pipeline telemetry shared by the audio and TTS HALs
+ *
+ * Event counters and latency histograms, updated lock-free from the mixer
+ * thread, TTS and request handlers. Histograms are log-linear in the style
+ * of HdrHistogram: every power of two of microseconds is split into
+ * STATS_SUB_BUCKETS buckets, so any recorded latency is known to within
+ * 25% from 1 us to over a minute, in a fixed 432-byte table.
+ *
+ * Nothing here touches ALSA, so the statistics can be tested without a
+ * device.
+ */
+
+#include <stdint.h>
+
+/* Event counters */
+typedef enum {
+  AUDIO_COUNT_XRUNS,      /* Device ran dry (or suspended) */
+  AUDIO_COUNT_RECOVERIES, /* Successful snd_pcm_recover() calls */
+  AUDIO_COUNT_INTERRUPTS, /* hal_audio_interrupt() calls that stopped audio */
+  AUDIO_COUNT_DROPS,      /* Sounds refused or cut short */
+  AUDIO_COUNT_TOTAL
+} AudioCounter;
+
+/* Latency histograms */
+typedef enum {
+  AUDIO_LAT_TTS_FIRST_PCM, /* hal_tts_speak() -> first PCM from the engine */
+  AUDIO_LAT_PCM_TO_DEVICE, /* Speech/file PCM queued -> due at the speaker */
+  AUDIO_LAT_BEEP_START,    /* hal_audio_play_beep() -> due at the speaker */
+  AUDIO_LAT_TOTAL
+} AudioLatency;
+
+#define STATS_SUB_BUCKET_BITS 2
+#define STATS_SUB_BUCKETS (1 << STATS_SUB_BUCKET_BITS)
+#define STATS_BUCKETS 108 /* Up to 2^28 us (268 s); larger values clamp */
+
+/**
+ * @brief Summary of one latency histogram
+ *
+ * Percentiles are the upper edge of the bucket they fall in.
+ */
+typedef struct {
+  uint32_t count;
+  uint32_t p50_us;
+  uint32_t p90_us;
+  uint32_t p99_us;
+  uint32_t max_us; /* Exact */
+} LatencySummary;
+
+/**
+ * @brief Everything hal_stats_snapshot() reports
+ */
+typedef struct {
+  uint32_t counters[AUDIO_COUNT_TOTAL];
+  LatencySummary latency[AUDIO_LAT_TOTAL];
+  uint32_t queue_max_ms; /* Deepest mixer + device backlog seen */
+} AudioStatsSnapshot;
+
+/**
+ * @brief Monotonic time in microseconds, for latency start stamps
+ */
+uint64_t hal_stats_now_us(void);
+
+/**
+ * @brief Add one to a counter (any thread)
+ */
+void hal_stats_count(AudioCounter counter);
+
+/**
+ * @brief Record one latency sample (any thread)
+ */
+void hal_stats_record_us(AudioLatency latency, uint64_t micros);
+
+/**
+ * @brief Record the time elapsed since a hal_stats_now_us() stamp
+ */
+void hal_stats_record_since(AudioLatency latency, uint64_t start_us);
+
+/**
+ * @brief Note the current backlog, keeping the deepest seen (any thread)
+ */
+void hal_stats_note_queue_ms(uint32_t queued_ms);
+
+/**
+ * @brief Value at or below which a fraction of the samples fall
+ *
+ * @param fraction 0.0 to 1.0 (e.g. 0.99)
+ * @return Upper edge of the bucket, in us; 0 if nothing was recorded
+ */
+uint32_t hal_stats_percentile(AudioLatency latency, double fraction);
+
+/**
+ * @brief Read every counter and histogram summary
+ *
+ * Not an atomic snapshot across fields: an event landing mid-read may be
+ * counted in one field and not yet in another.
+ */
+void hal_stats_snapshot(AudioStatsSnapshot *out);
+
+/**
+ * @brief Zero everything
+ */
+void hal_stats_reset(void);
+
+#endif /* HAL_AUDIO_STATS_H */
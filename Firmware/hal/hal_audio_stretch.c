@@ -0,0 +1,182 @@
+/**
+ * @file hal_audio_stretch.c
+ * @brief WSOLA time-stretch (see hal_audio_stretch.h)
+ *
+ * With a periodic Hann window and a hop of half the frame, overlapping
+ * windows sum to one, so a stretch factor of 1 with no seeking would give
+ * back the input. Positions in in[] are relative to its first sample;
+ * everything before the next frame and the previous frame's continuation
+ * is discarded after each frame.
+ */
+
+#include "hal_audio_stretch.h"
+#include <math.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* Input consumed per output hop */
+static double analysis_hop(const AudioStretch *st) {
+  return STRETCH_HOP / (double)st->factor;
+}
+
+static int16_t clamp16(float value) {
+  if (value > 32767.0f) {
+    return 32767;
+  }
+  if (value < -32768.0f) {
+    return -32768;
+  }
+  return (int16_t)lrintf(value);
+}
+
+/* Input needed before the next frame can be placed */
+static size_t frame_needs(const AudioStretch *st) {
+  if (!st->started) {
+    return STRETCH_FRAME;
+  }
+  long center = lround(st->ideal);
+  long need = center + STRETCH_SEEK + STRETCH_FRAME;
+  if (st->prev + STRETCH_FRAME > need) {
+    need = st->prev + STRETCH_FRAME;
+  }
+  return (size_t)need;
+}
+
+/**
+ * @brief Start of the input frame that best continues the previous one
+ *
+ * Compares each candidate's first half with what followed the previous
+ * frame in the input (its natural continuation), by cross-correlation.
+ */
+static long best_start(const AudioStretch *st) {
+  long center = lround(st->ideal);
+  long lo = center - STRETCH_SEEK;
+  if (lo < 0) {
+    lo = 0;
+  }
+  const float *natural = st->in + st->prev + STRETCH_HOP;
+  long best = center;
+  float best_score = -INFINITY;
+
+  for (long k = lo; k <= center + STRETCH_SEEK; k++) {
+    const float *candidate = st->in + k;
+    float score = 0.0f;
+    for (int j = 0; j < STRETCH_FRAME - STRETCH_HOP; j++) {
+      score += candidate[j] * natural[j];
+    }
+    if (score > best_score) {
+      best_score = score;
+      best = k;
+    }
+  }
+  return best;
+}
+
+/**
+ * @brief Place frames while there is input for them
+ *
+ * @param limit Most samples to write
+ * @return Samples written
+ */
+static size_t run_frames(AudioStretch *st, int16_t *out, size_t limit) {
+  size_t written = 0;
+
+  while (written < limit && st->in_len >= frame_needs(st)) {
+    long start = st->started ? best_start(st) : 0;
+    const float *frame = st->in + start;
+
+    size_t count = STRETCH_HOP;
+    if (count > limit - written) {
+      count = limit - written;
+    }
+    for (size_t j = 0; j < count; j++) {
+      out[written + j] = clamp16(st->tail[j] + frame[j] * st->window[j]);
+    }
+    for (int j = 0; j < STRETCH_HOP; j++) {
+      st->tail[j] = frame[STRETCH_HOP + j] * st->window[STRETCH_HOP + j];
+    }
+    written += count;
+    st->prev = start;
+    st->started = 1;
+    st->ideal += analysis_hop(st);
+
+    /* Drop input neither the next frame nor its template can reach */
+    long keep = (long)floor(st->ideal) - STRETCH_SEEK;
+    if (st->prev + STRETCH_HOP < keep) {
+      keep = st->prev + STRETCH_HOP;
+    }
+    if (keep > 0) {
+      memmove(st->in, st->in + keep, (st->in_len - keep) * sizeof(float));
+      st->in_len -= keep;
+      st->ideal -= keep;
+      st->prev -= keep;
+    }
+  }
+  st->out_total += written;
+  return written;
+}
+
+void hal_stretch_init(AudioStretch *st, float factor) {
+  if (factor < STRETCH_MIN_FACTOR) {
+    factor = STRETCH_MIN_FACTOR;
+  }
+  if (factor > STRETCH_MAX_FACTOR) {
+    factor = STRETCH_MAX_FACTOR;
+  }
+  memset(st, 0, sizeof(*st));
+  st->factor = factor;
+  st->passthrough = fabsf(factor - 1.0f) < 0.005f;
+  for (int j = 0; j < STRETCH_FRAME; j++) {
+    st->window[j] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * j / STRETCH_FRAME));
+  }
+}
+
+size_t hal_stretch_process(AudioStretch *st, const int16_t *in, size_t count,
+                           int16_t *out) {
+  size_t written = 0;
+
+  st->in_total += count;
+  if (st->passthrough) {
+    memcpy(out, in, count * sizeof(int16_t));
+    st->out_total += count;
+    return count;
+  }
+  while (count > 0) {
+    size_t take = STRETCH_BUFFER - st->in_len;
+    if (take > count) {
+      take = count;
+    }
+    for (size_t i = 0; i < take; i++) {
+      st->in[st->in_len + i] = in[i];
+    }
+    st->in_len += take;
+    in += take;
+    count -= take;
+    written += run_frames(st, out + written, (size_t)-1);
+  }
+  return written;
+}
+
+size_t hal_stretch_flush(AudioStretch *st, int16_t *out) {
+  if (st->passthrough) {
+    return 0;
+  }
+  uint64_t expected = (uint64_t)llround(st->in_total * (double)st->factor);
+  size_t written = 0;
+
+  /* Pad with silence until the frames have covered every real sample */
+  while (st->out_total < expected) {
+    size_t pad = 4 * STRETCH_FRAME;
+    if (pad > STRETCH_BUFFER - st->in_len) {
+      pad = STRETCH_BUFFER - st->in_len;
+    }
+    memset(st->in + st->in_len, 0, pad * sizeof(float));
+    st->in_len += pad;
+    written += run_frames(st, out + written,
+                          (size_t)(expected - st->out_total));
+  }
+  return written;
+}
@@ -0,0 +1,80 @@
+#ifndef HAL_AUDIO_STRETCH_H
+#define HAL_AUDIO_STRETCH_H
+
+/**
+ * @file hal_audio_stretch.h
+ * @brief Pitch-preserving time-stretch for the speech stream
+ *
+ * Speech speed used to be Piper's --length_scale, so every change restarted
+ * Piper and reloaded the model. Piper now runs at one speed and its PCM is
+ * stretched to the requested duration here, which also lets cached and
+ * spliced speech play at any speed.
+ *
+ * WSOLA (waveform-similarity overlap-add): 20 ms Hann-windowed frames are
+ * overlap-added every 10 ms of output. Frames are taken from the input
+ * every 10 ms / factor, each moved by up to 5 ms to where it best matches
+ * the natural continuation of the previous frame, so pitch periods line up
+ * and the voice keeps its pitch.
+ *
+ * Streaming, 16 kHz mono, no allocation. Nothing here touches ALSA.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define STRETCH_FRAME 320    /* 20 ms window */
+#define STRETCH_HOP 160      /* 10 ms output hop */
+#define STRETCH_SEEK 80      /* Frames move up to 5 ms to match */
+#define STRETCH_BUFFER 4096  /* Input history; holds a frame at any factor */
+#define STRETCH_MIN_FACTOR 0.25f /* Range of the stretch factor */
+#define STRETCH_MAX_FACTOR 4.0f
+
+/* Output room hal_stretch_process() may need for count input samples */
+#define STRETCH_OUTPUT_MAX(count)                                              \
+  ((count) * (size_t)STRETCH_MAX_FACTOR + 2 * STRETCH_FRAME)
+
+/**
+ * @brief Time-stretch state for one utterance
+ */
+typedef struct {
+  float factor;   /* Output duration / input duration */
+  int passthrough; /* factor 1: samples are copied untouched */
+  float window[STRETCH_FRAME];
+  float in[STRETCH_BUFFER]; /* Input not yet behind the next frame */
+  size_t in_len;
+  double ideal;   /* Next frame's unadjusted start in in[] */
+  int started;    /* A frame has been placed */
+  long prev;      /* Last frame's start in in[] (may go negative) */
+  float tail[STRETCH_HOP]; /* Second half of the last frame, windowed */
+  uint64_t in_total;  /* Samples taken */
+  uint64_t out_total; /* Samples produced */
+} AudioStretch;
+
+/**
+ * @brief Start a stream
+ *
+ * @param factor Output duration / input duration (2.0 = half speed),
+ *               clamped to STRETCH_MIN_FACTOR..STRETCH_MAX_FACTOR
+ */
+void hal_stretch_init(AudioStretch *st, float factor);
+
+/**
+ * @brief Stretch a block of samples
+ *
+ * @param out Room for STRETCH_OUTPUT_MAX(count) samples
+ * @return Samples written to out
+ */
+size_t hal_stretch_process(AudioStretch *st, const int16_t *in, size_t count,
+                           int16_t *out);
+
+/**
+ * @brief End the stream, writing what is still held back
+ *
+ * Total output is then the input length times the factor, to the sample.
+ *
+ * @param out Room for STRETCH_OUTPUT_MAX(STRETCH_FRAME + STRETCH_SEEK) samples
+ * @return Samples written to out
+ */
+size_t hal_stretch_flush(AudioStretch *st, int16_t *out);
+
+#endif /* HAL_AUDIO_STRETCH_H */
@@ -7,17 +7,80 @@
  *
  * Phase 3: Direct ALSA Implementation
  * - Uses snd_pcm_* API instead of popen("aplay")
- * - snd_pcm_drop() for immediate interrupt
  * - RAM-cached beep support
+ *
+ * Phase 4: Mixer thread
+ * - One thread owns the PCM handle and keeps it fed, one period at a time
+ * - Speech, beeps and file playback each write to their own voice ring
+ *   (hal_audio_mix.c); the mixer sums them, so a beep overlays speech
+ *   instead of waiting for it
+ * - Interrupts flush the voice rings instead of snd_pcm_drop() + prepare
+ * - Optional hot pipeline (AUDIO_HOT_PIPELINE / hal_audio_set_hot_pipeline):
+ *   the stream never stops, so new sound starts at the next period boundary
+ *   and the device never has to restart (no un-mute delay or pop)
+ *
+ * Phase 5: Prompt bank
+ * - Every pregen_audio WAV is held in RAM (hal_audio_bank.c); 'p' requests
+ *   play from memory with no open/read on the hot path
+ * - WAVs in other formats are converted in-process (hal_audio_convert.c)
+ *   instead of being handed to aplay, so every file is interruptible
+ *
+ * Phase 6: Software volume
+ * - hal_audio_set_volume() scales the mixed signal with a ramped Q15 gain,
+ *   replacing amixer shell-outs; hal_audio_set_mixer_volume() sets the
+ *   card's own control through alsa-lib when that is wanted
+ *
+ * Phase 7: Telemetry
+ * - Xruns, recoveries, interrupts, drops and start-up latency histograms are
+ *   kept in hal_audio_stats.c and reported by the 'm' audio query
+ *
+ * Phase 8: Click-free interrupts and ducking
+ * - Interrupted voices fade out over 4 ms inside the next mixed period
+ *   instead of stopping mid-waveform (hal_mix_voice_fade_out)
+ * - Optional duck mode (AUDIO_DUCK / hal_audio_set_duck): speech and file
+ *   playback drop by 12 dB while a beep plays, instead of summing at full
+ *   level with it
+ *
+ * Phase 9: Headless sinks
+ * - The mixer writes through an AudioSink (hal_audio_sink.h). ALSA is the
+ *   default; make AUDIO_BACKEND=null or capture swaps in a virtual-clock
+ *   sink (hal_audio_null.c) or one that also records a WAV
+ *   (hal_audio_capture.c), so benchmarks run with no sound card
+ *
+ * Phase 10: Hotplug
+ * - A thread watches kernel uevents for sound cards coming and going,
+ *   re-runs the hal_usb_find_audio() ranking, opens the winner in the
+ *   background and hands the PCM to the mixer, which swaps it in between
+ *   periods; queued audio carries on from the next period
+ * - A card that disappears with no replacement is closed, and re-found
+ *   when it returns, instead of failing every write
+ *
+ * Phase 11: Output geometry
+ * - Period and buffer sizes are set at run time (hal_audio_set_output,
+ *   the 'o' audio request), so a fast machine can run 5 ms periods while a
+ *   slow one keeps 25 ms; a geometry the device rejects is rolled back
+ * - Optional mmap access: the mixer mixes each period straight into the
+ *   device buffer (snd_pcm_mmap_begin/commit) instead of copying it in
+ *   with snd_pcm_writei
  */
 
 #include "hal_audio.h"
+#include "hal_audio_bank.h"
+#include "hal_audio_convert.h"
+#include "hal_audio_mix.h"
+#include "hal_audio_sink.h"
+#include "hal_audio_stats.h"
 #include "hal_usb_util.h"
 #include <alsa/asoundlib.h>
+#include <poll.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
 
 /* Default audio device - uses system default which should be configured for
  * dmix */
@@ -27,21 +90,136 @@ static int initialized = 0;
 /* Selected audio device info (from USB enumeration) */
 static AudioDeviceInfo selected_audio_device = {0};
 
-/* Direct ALSA PCM handle (replaces popen/aplay pipeline) */
+/* Direct ALSA PCM handle (replaces popen/aplay pipeline). Once the mixer
+ * thread is running, only it touches the handle. */
 static snd_pcm_t *pcm_handle = NULL;
 
+/* Where mixed periods go (see Phase 9); device_open says it was opened */
+static const AudioSink alsa_sink;
+#if defined(AUDIO_BACKEND_NULL)
+static const AudioSink *sink = &hal_audio_null_sink;
+#elif defined(AUDIO_BACKEND_CAPTURE)
+static const AudioSink *sink = &hal_audio_capture_sink;
+#else
+static const AudioSink *sink = &alsa_sink;
+#endif
+static volatile int device_open = 0;
+static size_t pcm_period_frames = 0;
+
+/* ALSA sink geometry and access mode (Phase 11) */
+#ifndef AUDIO_PERIOD_MS
+#define AUDIO_PERIOD_MS 25
+#endif
+#ifndef AUDIO_BUFFER_MS
+#define AUDIO_BUFFER_MS 100
+#endif
+#define OUTPUT_PERIOD_MIN_MS 4 /* One interrupt fade (MIX_FADE_SAMPLES) */
+#define OUTPUT_PERIOD_MAX_MS 50
+#define OUTPUT_BUFFER_MAX_MS 500
+
+typedef struct {
+  int period_ms;
+  int buffer_ms;
+  int mmap; /* Mix into the device buffer instead of snd_pcm_writei() */
+} OutputConfig;
+
+/* Requested, and the last one a device accepted (restored if the request
+ * is refused); both guarded by mixer_lock */
+static OutputConfig output_config = {AUDIO_PERIOD_MS, AUDIO_BUFFER_MS, 0};
+static OutputConfig output_good = {AUDIO_PERIOD_MS, AUDIO_BUFFER_MS, 0};
+static int pcm_mmap = 0; /* pcm_handle was opened for mmap access */
+static snd_pcm_uframes_t map_offset; /* Between alsa_map and alsa_commit */
+
 /* Audio playback state for interrupt support */
 static volatile int audio_interrupted = 0;
 static volatile int audio_playing = 0;
 
-/* Chunk size for streaming: 50ms at 16kHz mono = 800 samples = 1600 bytes */
-#define AUDIO_SAMPLE_RATE 16000
+/* Pipeline format, and 50 ms chunks when streaming a file from disk */
+#define AUDIO_SAMPLE_RATE CONVERT_OUT_RATE
 #define AUDIO_CHANNELS 1
-#define AUDIO_BYTES_PER_SAMPLE 2
 #define AUDIO_CHUNK_MS 50
-#define AUDIO_CHUNK_SAMPLES ((AUDIO_SAMPLE_RATE * AUDIO_CHUNK_MS) / 1000)
-#define AUDIO_CHUNK_BYTES                                                      \
-  (AUDIO_CHUNK_SAMPLES * AUDIO_CHANNELS * AUDIO_BYTES_PER_SAMPLE)
+
+/* ============================================================================
+ * Mixer State (Phase 4)
+ * ============================================================================
+ */
+
+/* Voice ring sizes. Speech stays short so hal_tts_speak() still returns
+ * about when the utterance ends; beeps get room for a burst of key presses. */
+#define MIXER_SPEECH_SAMPLES 4096 /* ~256 ms */
+#define MIXER_BEEP_SAMPLES 16384  /* ~1 s */
+#define MIXER_FILE_SAMPLES 8192   /* ~512 ms */
+
+/* Periods queued in the device before the mixer waits. Two keep the device
+ * fed through scheduling jitter while a new beep is heard within ~50 ms. */
+#define MIXER_LEAD_PERIODS 2
+
+/* Silence before the mixer stops feeding the device and sleeps. Not used
+ * in hot pipeline mode, where silence is fed for ever. */
+#define MIXER_IDLE_FRAMES AUDIO_SAMPLE_RATE /* 1 s */
+
+/* How long a blocked writer waits before re-checking for an interrupt */
+#define MIXER_SPACE_WAIT_MS 100
+
+enum { VOICE_SPEECH, VOICE_BEEP, VOICE_FILE, VOICE_COUNT };
+
+static MixVoice voices[VOICE_COUNT];
+static pthread_t mixer_thread;
+static volatile int mixer_running = 0;
+static volatile int mixer_reopen = 0; /* hal_audio_set_device() was called */
+static volatile int device_pinned = 0; /* ...so hotplug must not re-pick */
+
+#ifdef AUDIO_HOT_PIPELINE
+static volatile int hot_pipeline = 1;
+#else
+static volatile int hot_pipeline = 0;
+#endif
+
+/* Speech and file level while a beep plays, in duck mode (-12 dB) */
+#define MIXER_DUCK_GAIN (MIX_GAIN_UNITY / 4)
+
+#ifdef AUDIO_DUCK
+static volatile int duck_mode = 1;
+#else
+static volatile int duck_mode = 0;
+#endif
+
+/* Frames in the device after the mixer's last write (0 while it sleeps) */
+static volatile long device_queued = 0;
+
+/* hal_stats_now_us() when a silent voice was given samples, until the
+ * mixer writes them (0 = nothing pending). Feeds the latency histograms. */
+static _Atomic uint64_t voice_arrival[VOICE_COUNT];
+
+/* Output volume, applied to each mixed period */
+static MixGain output_gain = {MIX_GAIN_UNITY, MIX_GAIN_UNITY};
+static volatile int volume_percent = 100;
+
+/* ALSA simple controls tried, in order, by hal_audio_set_mixer_volume() */
+static const char *const mixer_controls[] = {"PCM", "Speaker", "Master",
+                                             "Headphone"};
+
+/* Hotplug (Phase 10). The hotplug thread opens a new PCM and leaves it
+ * here; the mixer takes it at its next period. */
+#define HOTPLUG_SETTLE_MS 500 /* A card arrives as a burst of uevents */
+#define HOTPLUG_OPEN_TRIES 4  /* Device nodes can lag the card's uevent */
+static pthread_t hotplug_thread;
+static volatile int hotplug_running = 0;
+static int hotplug_fd = -1;
+static _Atomic(snd_pcm_t *) pending_pcm = NULL;
+static size_t pending_period;
+static int pending_mmap;
+static AudioDeviceInfo pending_device;
+
+/* Guards the two condition variables below, output_config, and
+ * audio_device and selected_audio_device once the mixer runs; the voice
+ * rings themselves are lock-free */
+static pthread_mutex_t mixer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t mixer_wake;  /* Samples queued or device change */
+static pthread_cond_t voice_space; /* The mixer consumed samples */
+
+/* Beeps can come from more than one thread (Software2's unified build) */
+static pthread_mutex_t beep_lock = PTHREAD_MUTEX_INITIALIZER;
 
 /* ============================================================================
  * RAM-Cached Beeps (Phase 2)
@@ -57,161 +235,84 @@ static volatile int audio_playing = 0;
 #define BEEP_HOLD_PATH BEEP_BASE_PATH "beep_hold.wav"
 #define BEEP_ERROR_PATH BEEP_BASE_PATH "beep_error.wav"
 
-/* Structure for caching audio in RAM */
-typedef struct {
-  int16_t *samples;   /* PCM data in memory */
-  size_t num_samples; /* Number of samples */
-  int loaded;         /* 1 if successfully loaded, 0 otherwise */
-} CachedAudio;
-
 /* Cached beep sounds */
 static CachedAudio beep_keypress = {0};
 static CachedAudio beep_hold = {0};
 static CachedAudio beep_error = {0};
 
 /**
- * @brief Load a WAV file into the cache
- *
- * Reads the WAV file, validates format, and stores PCM data in memory.
- *
- * @param filepath Path to WAV file
- * @param cache Pointer to CachedAudio structure to fill
- * @return 0 on success, -1 on failure
+ * @brief Load one beep into its cache, reporting failures
  */
-static int load_wav_to_cache(const char *filepath, CachedAudio *cache) {
-  FILE *wav_file;
-  uint8_t header[44];
-  uint32_t data_size;
-  uint32_t sample_rate;
-  uint16_t num_channels;
-  uint16_t bits_per_sample;
-  size_t samples_read;
-
-  if (cache == NULL)
-    return -1;
-
-  /* Clear existing cache */
-  if (cache->samples != NULL) {
-    free(cache->samples);
-    cache->samples = NULL;
-  }
-  cache->num_samples = 0;
-  cache->loaded = 0;
-
-  /* Open WAV file */
-  wav_file = fopen(filepath, "rb");
-  if (wav_file == NULL) {
-    fprintf(stderr, "HAL Audio: Cannot open beep file: %s\n", filepath);
-    return -1;
-  }
-
-  /* Read and parse WAV header */
-  if (fread(header, 1, 44, wav_file) != 44) {
-    fprintf(stderr, "HAL Audio: Failed to read WAV header: %s\n", filepath);
-    fclose(wav_file);
-    return -1;
-  }
-
-  /* Verify RIFF header */
-  if (memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
-    fprintf(stderr, "HAL Audio: Not a valid WAV file: %s\n", filepath);
-    fclose(wav_file);
-    return -1;
-  }
-
-  /* Parse header fields */
-  num_channels = header[22] | (header[23] << 8);
-  sample_rate =
-      header[24] | (header[25] << 8) | (header[26] << 16) | (header[27] << 24);
-  bits_per_sample = header[34] | (header[35] << 8);
-  data_size =
-      header[40] | (header[41] << 8) | (header[42] << 16) | (header[43] << 24);
-
-  /* Validate format */
-  if (sample_rate != AUDIO_SAMPLE_RATE || num_channels != AUDIO_CHANNELS ||
-      bits_per_sample != 16) {
-    fprintf(stderr,
-            "HAL Audio: Beep format mismatch (rate=%u, ch=%u, bits=%u): %s\n",
-            sample_rate, num_channels, bits_per_sample, filepath);
-    fclose(wav_file);
-    return -1;
-  }
-
-  /* Allocate memory for samples */
-  cache->num_samples = data_size / 2; /* 16-bit = 2 bytes per sample */
-  cache->samples = (int16_t *)malloc(data_size);
-  if (cache->samples == NULL) {
-    fprintf(stderr, "HAL Audio: Failed to allocate memory for beep: %s\n",
-            filepath);
-    fclose(wav_file);
-    return -1;
+static void load_beep(const char *filepath, CachedAudio *cache) {
+  int result = hal_audio_load_wav(filepath, cache);
+  if (result == HAL_WAV_OK) {
+    printf("HAL Audio: Cached beep: %s (%zu samples, %zu ms)\n", filepath,
+           cache->num_samples, (cache->num_samples * 1000) / AUDIO_SAMPLE_RATE);
+  } else if (result == HAL_WAV_FORMAT) {
+    fprintf(stderr, "HAL Audio: Unsupported beep format: %s\n", filepath);
+  } else {
+    fprintf(stderr, "HAL Audio: Cannot load beep file: %s\n", filepath);
   }
+}
 
-  /* Read PCM data */
-  samples_read = fread(cache->samples, 2, cache->num_samples, wav_file);
-  fclose(wav_file);
+/* ============================================================================
+ * Prompt Bank (Phase 5)
+ * ============================================================================
+ */
 
-  if (samples_read != cache->num_samples) {
-    fprintf(stderr, "HAL Audio: Incomplete read (got %zu of %zu): %s\n",
-            samples_read, cache->num_samples, filepath);
-    free(cache->samples);
-    cache->samples = NULL;
-    cache->num_samples = 0;
-    return -1;
-  }
+/* Every WAV here is loaded into RAM at init (hal_audio_bank.c), keyed the
+ * way audio requests spell the path, so 'p' requests skip the file system */
+#ifndef PROMPT_BANK_DIR
+#define PROMPT_BANK_DIR BEEP_BASE_PATH
+#endif
 
-  cache->loaded = 1;
-  printf("HAL Audio: Cached beep: %s (%zu samples, %zu ms)\n", filepath,
-         cache->num_samples, (cache->num_samples * 1000) / AUDIO_SAMPLE_RATE);
-  return 0;
-}
+/* Sample memory the bank may hold before evicting the least recently used
+ * prompt. All of pregen_audio is about 4 MB. */
+#ifndef PROMPT_BANK_BUDGET_KB
+#define PROMPT_BANK_BUDGET_KB 16384
+#endif
 
-/**
- * @brief Free cached audio memory
+/* ============================================================================
+ * ALSA Sink
+ * ============================================================================
  */
-static void free_cached_audio(CachedAudio *cache) {
-  if (cache != NULL && cache->samples != NULL) {
-    free(cache->samples);
-    cache->samples = NULL;
-    cache->num_samples = 0;
-    cache->loaded = 0;
-  }
-}
 
 /**
  * @brief Open the ALSA PCM device for direct audio output
  *
  * Uses snd_pcm_* API for low latency and interruptible playback.
- * Buffer size: 100ms total, 25ms periods - allows interrupt within 25ms
+ * Buffer and period come from config (100 ms and 25 ms by default; an
+ * interrupt takes effect within a period or two). The device may round
+ * them; it must still fit two periods in its buffer.
  *
  * @return 0 on success, -1 on failure
  */
-static int open_pcm_device(void) {
+static int alsa_open_handle(const char *device, unsigned int rate,
+                            const OutputConfig *config,
+                            snd_pcm_t **handle_out, size_t *period_out) {
   int err;
+  snd_pcm_t *handle = NULL;
   snd_pcm_hw_params_t *hw_params = NULL;
-  unsigned int rate = AUDIO_SAMPLE_RATE;
   snd_pcm_uframes_t buffer_frames;
   snd_pcm_uframes_t period_frames;
 
-  if (pcm_handle != NULL) {
-    return 0; /* Already open */
-  }
-
   /* Open PCM device for playback */
-  err = snd_pcm_open(&pcm_handle, audio_device, SND_PCM_STREAM_PLAYBACK, 0);
+  err = snd_pcm_open(&handle, device, SND_PCM_STREAM_PLAYBACK, 0);
   if (err < 0) {
-    fprintf(stderr, "HAL Audio: Cannot open device '%s': %s\n", audio_device,
+    fprintf(stderr, "HAL Audio: Cannot open device '%s': %s\n", device,
             snd_strerror(err));
     return -1;
   }
 
   /* Allocate hardware parameters */
   snd_pcm_hw_params_malloc(&hw_params);
-  snd_pcm_hw_params_any(pcm_handle, hw_params);
+  snd_pcm_hw_params_any(handle, hw_params);
 
-  /* Set access type: interleaved read/write */
-  err = snd_pcm_hw_params_set_access(pcm_handle, hw_params,
-                                     SND_PCM_ACCESS_RW_INTERLEAVED);
+  /* Set access type: interleaved read/write, or mapped */
+  err = snd_pcm_hw_params_set_access(handle, hw_params,
+                                     config->mmap
+                                         ? SND_PCM_ACCESS_MMAP_INTERLEAVED
+                                         : SND_PCM_ACCESS_RW_INTERLEAVED);
   if (err < 0) {
     fprintf(stderr, "HAL Audio: Cannot set access type: %s\n",
             snd_strerror(err));
@@ -219,7 +320,7 @@ static int open_pcm_device(void) {
   }
 
   /* Set sample format: 16-bit signed little-endian */
-  err = snd_pcm_hw_params_set_format(pcm_handle, hw_params,
+  err = snd_pcm_hw_params_set_format(handle, hw_params,
                                      SND_PCM_FORMAT_S16_LE);
   if (err < 0) {
     fprintf(stderr, "HAL Audio: Cannot set format: %s\n", snd_strerror(err));
@@ -227,14 +328,14 @@ static int open_pcm_device(void) {
   }
 
   /* Set channel count: mono */
-  err = snd_pcm_hw_params_set_channels(pcm_handle, hw_params, AUDIO_CHANNELS);
+  err = snd_pcm_hw_params_set_channels(handle, hw_params, AUDIO_CHANNELS);
   if (err < 0) {
     fprintf(stderr, "HAL Audio: Cannot set channels: %s\n", snd_strerror(err));
     goto error;
   }
 
   /* Set sample rate (16kHz - matching Piper TTS) */
-  err = snd_pcm_hw_params_set_rate_near(pcm_handle, hw_params, &rate, NULL);
+  err = snd_pcm_hw_params_set_rate_near(handle, hw_params, &rate, NULL);
   if (err < 0) {
     fprintf(stderr, "HAL Audio: Cannot set rate: %s\n", snd_strerror(err));
     goto error;
@@ -244,36 +345,63 @@ static int open_pcm_device(void) {
             AUDIO_SAMPLE_RATE);
   }
 
-  /* Set buffer size: 100ms = 1600 samples at 16kHz */
-  buffer_frames = AUDIO_SAMPLE_RATE / 10; /* 100ms */
-  err = snd_pcm_hw_params_set_buffer_size_near(pcm_handle, hw_params,
-                                               &buffer_frames);
+  /* Period first, so a short one is not rounded up to suit the buffer
+   * (25 ms = 400 samples at 16kHz by default) */
+  period_frames = (snd_pcm_uframes_t)AUDIO_SAMPLE_RATE * config->period_ms /
+                  1000;
+  err = snd_pcm_hw_params_set_period_size_near(handle, hw_params,
+                                               &period_frames, NULL);
   if (err < 0) {
-    fprintf(stderr, "HAL Audio: Cannot set buffer size: %s\n",
+    fprintf(stderr, "HAL Audio: Cannot set period size: %s\n",
             snd_strerror(err));
     goto error;
   }
 
-  /* Set period size: 25ms = 400 samples (4 periods per buffer) */
-  period_frames = buffer_frames / 4;
-  err = snd_pcm_hw_params_set_period_size_near(pcm_handle, hw_params,
-                                               &period_frames, NULL);
+  /* Buffer size: 100 ms = 1600 samples by default */
+  buffer_frames = (snd_pcm_uframes_t)AUDIO_SAMPLE_RATE * config->buffer_ms /
+                  1000;
+  err = snd_pcm_hw_params_set_buffer_size_near(handle, hw_params,
+                                               &buffer_frames);
   if (err < 0) {
-    fprintf(stderr, "HAL Audio: Cannot set period size: %s\n",
+    fprintf(stderr, "HAL Audio: Cannot set buffer size: %s\n",
             snd_strerror(err));
     goto error;
   }
 
   /* Apply hardware parameters */
-  err = snd_pcm_hw_params(pcm_handle, hw_params);
+  err = snd_pcm_hw_params(handle, hw_params);
   if (err < 0) {
     fprintf(stderr, "HAL Audio: Cannot apply hw params: %s\n",
             snd_strerror(err));
     goto error;
   }
 
+  /* What the device settled on; the mixer keeps up to two periods queued */
+  snd_pcm_hw_params_get_period_size(hw_params, &period_frames, NULL);
+  snd_pcm_hw_params_get_buffer_size(hw_params, &buffer_frames);
+  if (buffer_frames < 2 * period_frames) {
+    fprintf(stderr, "HAL Audio: Buffer of %lu frames cannot hold two "
+            "periods of %lu\n",
+            buffer_frames, period_frames);
+    goto error;
+  }
+
+  /* Start as soon as one period is queued; the mixer never queues more
+   * than a few periods, so the default (a full buffer) would never start */
+  snd_pcm_sw_params_t *sw_params = NULL;
+  snd_pcm_sw_params_malloc(&sw_params);
+  snd_pcm_sw_params_current(handle, sw_params);
+  snd_pcm_sw_params_set_start_threshold(handle, sw_params, period_frames);
+  err = snd_pcm_sw_params(handle, sw_params);
+  snd_pcm_sw_params_free(sw_params);
+  if (err < 0) {
+    fprintf(stderr, "HAL Audio: Cannot apply sw params: %s\n",
+            snd_strerror(err));
+    goto error;
+  }
+
   /* Prepare device for playback */
-  err = snd_pcm_prepare(pcm_handle);
+  err = snd_pcm_prepare(handle);
   if (err < 0) {
     fprintf(stderr, "HAL Audio: Cannot prepare device: %s\n",
             snd_strerror(err));
@@ -281,30 +409,518 @@ static int open_pcm_device(void) {
   }
 
   snd_pcm_hw_params_free(hw_params);
+  *handle_out = handle;
+  *period_out = period_frames;
+  pthread_mutex_lock(&mixer_lock);
+  output_good = *config;
+  pthread_mutex_unlock(&mixer_lock);
   printf("HAL Audio: ALSA PCM device opened (device=%s, rate=%u, buffer=%lu, "
-         "period=%lu)\n",
-         audio_device, rate, buffer_frames, period_frames);
+         "period=%lu%s)\n",
+         device, rate, buffer_frames, period_frames,
+         config->mmap ? ", mmap" : "");
   return 0;
 
 error:
   if (hw_params)
     snd_pcm_hw_params_free(hw_params);
-  if (pcm_handle) {
-    snd_pcm_close(pcm_handle);
-    pcm_handle = NULL;
+  if (handle) {
+    snd_pcm_close(handle);
   }
   return -1;
 }
 
+static int alsa_open(const char *device, unsigned int rate,
+                     size_t *period_frames) {
+  pthread_mutex_lock(&mixer_lock);
+  OutputConfig config = output_config;
+  pthread_mutex_unlock(&mixer_lock);
+
+  if (alsa_open_handle(device, rate, &config, &pcm_handle, period_frames) !=
+      0) {
+    return -1;
+  }
+  pcm_mmap = config.mmap;
+  return 0;
+}
+
 /**
  * @brief Close the ALSA PCM device
  */
+static void alsa_close(void) {
+  snd_pcm_drain(pcm_handle);
+  snd_pcm_close(pcm_handle);
+  pcm_handle = NULL;
+  printf("HAL Audio: PCM device closed\n");
+}
+
+/* Start a mapped stream once something is committed; unlike writei,
+ * snd_pcm_mmap_commit() does not apply the start threshold itself */
+static void alsa_mmap_start(void) {
+  if (snd_pcm_state(pcm_handle) == SND_PCM_STATE_PREPARED) {
+    snd_pcm_start(pcm_handle);
+  }
+}
+
+/* Copy into the mapped buffer: the fallback when the mixer could not mix
+ * in place (the period wraps the buffer end, or there was no room yet) */
+static long alsa_mmap_write(const int16_t *samples, size_t frames) {
+  size_t done = 0;
+
+  while (done < frames) {
+    snd_pcm_sframes_t avail = snd_pcm_avail_update(pcm_handle);
+    if (avail < 0) {
+      return avail;
+    }
+    if (avail == 0) {
+      int err = snd_pcm_wait(pcm_handle, MIXER_SPACE_WAIT_MS);
+      if (err < 0) {
+        return err;
+      }
+      continue;
+    }
+
+    const snd_pcm_channel_area_t *areas;
+    snd_pcm_uframes_t offset;
+    snd_pcm_uframes_t count = frames - done;
+    int err = snd_pcm_mmap_begin(pcm_handle, &areas, &offset, &count);
+    if (err < 0) {
+      return err;
+    }
+    char *base = (char *)areas[0].addr;
+    for (snd_pcm_uframes_t i = 0; i < count; i++) {
+      size_t bit = areas[0].first + (offset + i) * areas[0].step;
+      *(int16_t *)(base + bit / 8) = samples[done + i];
+    }
+    snd_pcm_sframes_t committed =
+        snd_pcm_mmap_commit(pcm_handle, offset, count);
+    if (committed < 0) {
+      return committed;
+    }
+    done += (size_t)committed;
+    alsa_mmap_start();
+  }
+  return (long)frames;
+}
+
+static long alsa_write(const int16_t *samples, size_t frames) {
+  if (pcm_mmap) {
+    return alsa_mmap_write(samples, frames);
+  }
+  return snd_pcm_writei(pcm_handle, samples, frames);
+}
+
+static int16_t *alsa_map(size_t frames) {
+  const snd_pcm_channel_area_t *areas;
+  snd_pcm_uframes_t count = frames;
+
+  if (!pcm_mmap) {
+    return NULL;
+  }
+  snd_pcm_sframes_t avail = snd_pcm_avail_update(pcm_handle);
+  if (avail < (snd_pcm_sframes_t)frames) {
+    return NULL; /* Full, or an xrun for write() to report */
+  }
+  if (snd_pcm_mmap_begin(pcm_handle, &areas, &map_offset, &count) < 0) {
+    return NULL;
+  }
+  /* Mono S16 is 16 bits a frame; anything else goes through write() */
+  if (count < frames || areas[0].step != 16 || areas[0].first % 16 != 0) {
+    snd_pcm_mmap_commit(pcm_handle, map_offset, 0);
+    return NULL;
+  }
+  return (int16_t *)areas[0].addr + areas[0].first / 16 + map_offset;
+}
+
+static long alsa_commit(size_t frames) {
+  snd_pcm_sframes_t committed =
+      snd_pcm_mmap_commit(pcm_handle, map_offset, frames);
+  if (committed > 0) {
+    alsa_mmap_start();
+  }
+  return committed;
+}
+
+static int alsa_recover(long err) {
+  return snd_pcm_recover(pcm_handle, (int)err, 0);
+}
+
+static int alsa_delay(long *frames) {
+  snd_pcm_sframes_t delay;
+  int err = snd_pcm_delay(pcm_handle, &delay);
+  *frames = delay;
+  return err;
+}
+
+static void alsa_drain(void) {
+  snd_pcm_drain(pcm_handle);
+  snd_pcm_prepare(pcm_handle);
+}
+
+static const AudioSink alsa_sink = {
+    .name = "USB Audio (Direct ALSA PCM, mixed)",
+    .uses_card = 1,
+    .open = alsa_open,
+    .close = alsa_close,
+    .write = alsa_write,
+    .recover = alsa_recover,
+    .delay = alsa_delay,
+    .drain = alsa_drain,
+    .map = alsa_map,
+    .commit = alsa_commit,
+};
+
+/**
+ * @brief Open the selected sink on audio_device
+ *
+ * @return 0 on success, -1 on failure
+ */
+static int open_pcm_device(void) {
+  size_t period_frames = 0;
+
+  if (device_open) {
+    return 0; /* Already open */
+  }
+  if (sink->open(audio_device, AUDIO_SAMPLE_RATE, &period_frames) != 0) {
+    return -1;
+  }
+  pcm_period_frames = period_frames;
+  device_open = 1;
+  return 0;
+}
+
 static void close_pcm_device(void) {
-  if (pcm_handle != NULL) {
-    snd_pcm_drain(pcm_handle);
+  if (device_open) {
+    device_open = 0;
+    sink->close();
+  }
+}
+
+/* ============================================================================
+ * Mixer Thread (Phase 4)
+ * ============================================================================
+ */
+
+static void mixer_wait_ms(pthread_cond_t *cond, int timeout_ms) {
+  struct timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  deadline.tv_sec += timeout_ms / 1000;
+  deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+  if (deadline.tv_nsec >= 1000000000L) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000L;
+  }
+  pthread_cond_timedwait(cond, &mixer_lock, &deadline);
+}
+
+static size_t mixer_pending(void) {
+  size_t pending = 0;
+  for (int v = 0; v < VOICE_COUNT; v++) {
+    pending += hal_mix_voice_pending(&voices[v]);
+  }
+  return pending;
+}
+
+/**
+ * @brief Wait until at most MIXER_LEAD_PERIODS - 1 periods are queued
+ *
+ * Keeps the device fed without letting mixed audio pile up ahead of a beep.
+ */
+static void mixer_pace(void) {
+  long delay;
+  long lead = (long)pcm_period_frames * (MIXER_LEAD_PERIODS - 1);
+
+  if (sink->delay(&delay) < 0 || delay <= lead) {
+    return;
+  }
+  long wait_us = (long)(delay - lead) * 1000000L / AUDIO_SAMPLE_RATE;
+  struct timespec pause = {wait_us / 1000000L, (wait_us % 1000000L) * 1000L};
+  nanosleep(&pause, NULL);
+}
+
+/**
+ * @brief Start a latency measurement if a voice is about to start sounding
+ *
+ * Called before the samples are queued, so the mixer cannot see the samples
+ * without the stamp. Voices that are already playing are not stamped: their
+ * new samples wait behind the old ones by design.
+ */
+static void stamp_arrival(int voice, uint64_t now_us) {
+  uint64_t none = 0;
+  if (hal_mix_voice_pending(&voices[voice]) == 0) {
+    atomic_compare_exchange_strong(&voice_arrival[voice], &none, now_us);
+  }
+}
+
+/**
+ * @brief Record when the first samples of newly started voices will be heard
+ *
+ * They were mixed at the start of the period just written, so they play
+ * once everything queued ahead of that period has played.
+ */
+static void record_arrivals(const uint64_t *arrivals, size_t frames,
+                            long delay) {
+  long ahead = delay > (long)frames ? delay - (long)frames : 0;
+  uint64_t due_us =
+      hal_stats_now_us() + (uint64_t)ahead * 1000000u / AUDIO_SAMPLE_RATE;
+  for (int v = 0; v < VOICE_COUNT; v++) {
+    if (arrivals[v] != 0) {
+      hal_stats_record_us(v == VOICE_BEEP ? AUDIO_LAT_BEEP_START
+                                          : AUDIO_LAT_PCM_TO_DEVICE,
+                          due_us > arrivals[v] ? due_us - arrivals[v] : 0);
+    }
+  }
+}
+
+static int detect_usb_audio(void);
+
+/**
+ * @brief Go back to the last output geometry a device accepted
+ *
+ * @return 1 if it differs from the one just refused (worth reopening)
+ */
+static int restore_output_config(void) {
+  pthread_mutex_lock(&mixer_lock);
+  int changed = memcmp(&output_config, &output_good, sizeof(output_config));
+  output_config = output_good;
+  pthread_mutex_unlock(&mixer_lock);
+  if (changed) {
+    fprintf(stderr, "HAL Audio: Output settings refused, back to %d ms "
+            "periods, %d ms buffer\n",
+            output_good.period_ms, output_good.buffer_ms);
+  }
+  return changed != 0;
+}
+
+/**
+ * @brief Swap in a PCM the hotplug thread opened (mixer thread)
+ *
+ * The old handle is closed without draining: its card is usually gone,
+ * and at most MIXER_LEAD_PERIODS of audio were queued in it. The voice
+ * rings are untouched, so playback resumes with the next period.
+ */
+static void adopt_pending_pcm(void) {
+  snd_pcm_t *fresh = atomic_exchange(&pending_pcm, NULL);
+  if (fresh == NULL) {
+    return;
+  }
+  if (device_pinned) {
+    snd_pcm_close(fresh); /* hal_audio_set_device() won the race */
+    return;
+  }
+  if (device_open) {
     snd_pcm_close(pcm_handle);
-    pcm_handle = NULL;
-    printf("HAL Audio: PCM device closed\n");
+  }
+  pcm_handle = fresh;
+  pcm_mmap = pending_mmap;
+  pcm_period_frames = pending_period;
+  device_queued = 0;
+  device_open = 1;
+
+  pthread_mutex_lock(&mixer_lock);
+  selected_audio_device = pending_device;
+  strncpy(audio_device, pending_device.device_path, sizeof(audio_device) - 1);
+  audio_device[sizeof(audio_device) - 1] = '\0';
+  pthread_mutex_unlock(&mixer_lock);
+  printf("HAL Audio: Switched to %s (%s)\n", pending_device.card_name,
+         audio_device);
+}
+
+static void *mixer_func(void *arg) {
+  (void)arg;
+  int16_t period[AUDIO_SAMPLE_RATE / 10]; /* Never more than the buffer */
+  size_t idle_frames = 0;
+
+  while (mixer_running) {
+    adopt_pending_pcm();
+    if (mixer_reopen) {
+      mixer_reopen = 0;
+      close_pcm_device();
+      if (open_pcm_device() != 0 && restore_output_config()) {
+        open_pcm_device();
+      }
+    }
+    if (!device_open) {
+      /* Device missing - retry once a second */
+      pthread_mutex_lock(&mixer_lock);
+      mixer_wait_ms(&mixer_wake, 1000);
+      pthread_mutex_unlock(&mixer_lock);
+      if (!mixer_reopen && atomic_load(&pending_pcm) == NULL) {
+        /* The card may be back under another number */
+        if (sink->uses_card && !device_pinned && !hotplug_running) {
+          pthread_mutex_lock(&mixer_lock);
+          detect_usb_audio();
+          pthread_mutex_unlock(&mixer_lock);
+        }
+        open_pcm_device();
+      }
+      continue;
+    }
+
+    size_t frames = pcm_period_frames;
+    if (frames == 0 || frames > sizeof(period) / sizeof(period[0])) {
+      frames = sizeof(period) / sizeof(period[0]);
+    }
+    /* Wait before mixing, not after, so a sound queued meanwhile still
+     * makes this period */
+    mixer_pace();
+    uint64_t arrivals[VOICE_COUNT];
+    int started = 0;
+    for (int v = 0; v < VOICE_COUNT; v++) {
+      arrivals[v] = 0;
+      if (atomic_load(&voice_arrival[v]) != 0 &&
+          hal_mix_voice_pending(&voices[v]) > 0) {
+        arrivals[v] = atomic_exchange(&voice_arrival[v], 0);
+        started = 1;
+      }
+    }
+    /* Duck under beeps; the voice gains ramp, so this never clicks */
+    int duck = duck_mode && hal_mix_voice_pending(&voices[VOICE_BEEP]) > 0;
+    hal_mix_gain_set(&voices[VOICE_SPEECH].gain,
+                     duck ? MIXER_DUCK_GAIN : MIX_GAIN_UNITY);
+    hal_mix_gain_set(&voices[VOICE_FILE].gain,
+                     duck ? MIXER_DUCK_GAIN : MIX_GAIN_UNITY);
+    /* Straight into the device buffer when the sink maps it */
+    int16_t *mapped = sink->map != NULL ? sink->map(frames) : NULL;
+    int16_t *out = mapped != NULL ? mapped : period;
+    int active = hal_mix_voices(voices, VOICE_COUNT, out, frames);
+    hal_mix_gain_apply(&output_gain, out, frames);
+
+    /* Wake writers waiting for ring space */
+    pthread_mutex_lock(&mixer_lock);
+    pthread_cond_broadcast(&voice_space);
+    pthread_mutex_unlock(&mixer_lock);
+
+    if (active > 0) {
+      idle_frames = 0;
+    } else if (!hot_pipeline &&
+               (idle_frames += frames) > MIXER_IDLE_FRAMES) {
+      /* Nothing to play: let the last silence out and sleep */
+      if (mapped != NULL) {
+        sink->commit(0);
+      }
+      sink->drain();
+      device_queued = 0;
+      pthread_mutex_lock(&mixer_lock);
+      while (mixer_running && !mixer_reopen && !hot_pipeline &&
+             mixer_pending() == 0) {
+        pthread_cond_wait(&mixer_wake, &mixer_lock);
+      }
+      pthread_mutex_unlock(&mixer_lock);
+      idle_frames = 0;
+      continue;
+    }
+
+    long written = mapped != NULL ? sink->commit(frames)
+                                  : sink->write(period, frames);
+    if (written < 0) {
+      /* Underrun (we were late) or suspend - recover and carry on */
+      hal_stats_count(AUDIO_COUNT_XRUNS);
+      if (mapped != NULL) {
+        /* Keep the period: recovery resets the device buffer */
+        memcpy(period, mapped, frames * sizeof(int16_t));
+      }
+      int err = sink->recover(written);
+      if (err < 0) {
+        /* Unplugged: close it, and wait for it (or hotplug) to come back */
+        fprintf(stderr, "HAL Audio: Mixer write failed: %s, closing device\n",
+                snd_strerror(err));
+        close_pcm_device();
+        device_queued = 0;
+        continue;
+      }
+      hal_stats_count(AUDIO_COUNT_RECOVERIES);
+      /* The voice rings have moved past this period: write it again
+       * rather than lose it */
+      if (sink->write(period, frames) < 0) {
+        hal_stats_count(AUDIO_COUNT_DROPS);
+      }
+    }
+
+    long delay;
+    if (sink->delay(&delay) == 0 && delay > 0) {
+      device_queued = delay;
+    } else {
+      device_queued = 0;
+    }
+    hal_stats_note_queue_ms(
+        (uint32_t)(((device_queued + (long)mixer_pending()) * 1000) /
+                   AUDIO_SAMPLE_RATE));
+    if (started) {
+      record_arrivals(arrivals, frames, device_queued);
+    }
+  }
+  return NULL;
+}
+
+static int start_mixer(void) {
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&mixer_wake, &attr);
+  pthread_cond_init(&voice_space, &attr);
+  pthread_condattr_destroy(&attr);
+
+  if (hal_mix_voice_init(&voices[VOICE_SPEECH], MIXER_SPEECH_SAMPLES) != 0 ||
+      hal_mix_voice_init(&voices[VOICE_BEEP], MIXER_BEEP_SAMPLES) != 0 ||
+      hal_mix_voice_init(&voices[VOICE_FILE], MIXER_FILE_SAMPLES) != 0) {
+    fprintf(stderr, "HAL Audio: Failed to allocate voice rings\n");
+    return -1;
+  }
+
+  mixer_running = 1;
+  if (pthread_create(&mixer_thread, NULL, mixer_func, NULL) != 0) {
+    fprintf(stderr, "HAL Audio: Failed to start mixer thread\n");
+    mixer_running = 0;
+    return -1;
+  }
+  return 0;
+}
+
+static void stop_mixer(void) {
+  if (!mixer_running) {
+    return;
+  }
+  pthread_mutex_lock(&mixer_lock);
+  mixer_running = 0;
+  pthread_cond_broadcast(&mixer_wake);
+  pthread_cond_broadcast(&voice_space);
+  pthread_mutex_unlock(&mixer_lock);
+  pthread_join(mixer_thread, NULL);
+
+  for (int v = 0; v < VOICE_COUNT; v++) {
+    hal_mix_voice_free(&voices[v]);
+  }
+  pthread_cond_destroy(&mixer_wake);
+  pthread_cond_destroy(&voice_space);
+}
+
+/**
+ * @brief Queue samples on a voice, waiting for ring space as needed
+ *
+ * Returns early (dropping the rest) if playback is interrupted.
+ */
+static void queue_samples(MixVoice *voice, const int16_t *samples,
+                          size_t num_samples) {
+  if (num_samples > 0) {
+    stamp_arrival((int)(voice - voices), hal_stats_now_us());
+  }
+  while (num_samples > 0 && !audio_interrupted && mixer_running) {
+    size_t queued = hal_mix_voice_write(voice, samples, num_samples);
+    samples += queued;
+    num_samples -= queued;
+
+    pthread_mutex_lock(&mixer_lock);
+    if (queued > 0) {
+      pthread_cond_signal(&mixer_wake);
+    }
+    if (num_samples > 0 && !audio_interrupted &&
+        hal_mix_voice_space(voice) == 0) {
+      mixer_wait_ms(&voice_space, MIXER_SPACE_WAIT_MS);
+    }
+    pthread_mutex_unlock(&mixer_lock);
+  }
+  if (num_samples > 0) {
+    hal_stats_count(AUDIO_COUNT_DROPS); /* Cut short by an interrupt */
   }
 }
 
@@ -336,6 +952,129 @@ static int detect_usb_audio(void) {
   return -1;
 }
 
+/* ============================================================================
+ * Hotplug (Phase 10)
+ * ============================================================================
+ */
+
+/**
+ * @brief Wait for a sound card uevent, then for the burst to settle
+ *
+ * @param current_gone Set if the card in use was removed
+ * @return 1 if sound cards changed, 0 on timeout or shutdown
+ */
+static int hotplug_wait(int *current_gone) {
+  char msg[4096];
+  struct pollfd pfd = {hotplug_fd, POLLIN, 0};
+  int changed = 0;
+  int timeout_ms = 250; /* Re-check hotplug_running this often */
+
+  while (hotplug_running && poll(&pfd, 1, timeout_ms) > 0) {
+    SoundCardEvent event;
+    ssize_t len;
+    while ((len = recv(hotplug_fd, msg, sizeof(msg), 0)) > 0) {
+      if (!hal_usb_parse_uevent(msg, (size_t)len, &event)) {
+        continue;
+      }
+      pthread_mutex_lock(&mixer_lock);
+      if (!event.added &&
+          event.card_number == selected_audio_device.card_number) {
+        *current_gone = 1;
+      }
+      pthread_mutex_unlock(&mixer_lock);
+      changed = 1;
+    }
+    if (changed) {
+      timeout_ms = HOTPLUG_SETTLE_MS;
+    }
+  }
+  return changed;
+}
+
+/**
+ * @brief Re-rank the cards and hand the mixer a PCM on the best one
+ *
+ * @param force Reopen even if the best card is the one in use (it was
+ *              unplugged and has come back)
+ */
+static void hotplug_reselect(int force) {
+  AudioDeviceInfo best;
+  snd_pcm_t *handle = NULL;
+  size_t period = 0;
+  OutputConfig config;
+
+  if (hal_usb_find_audio("USB2.0 Device", &best) != 0) {
+    fprintf(stderr, "HAL Audio: Hotplug: no audio device left\n");
+    return;
+  }
+  pthread_mutex_lock(&mixer_lock);
+  int same = strcmp(best.device_path, audio_device) == 0;
+  config = output_config;
+  pthread_mutex_unlock(&mixer_lock);
+  if (same && device_open && !force) {
+    return;
+  }
+
+  printf("HAL Audio: Hotplug: opening %s (%s)\n", best.card_name,
+         best.device_path);
+  for (int tries = 0; tries < HOTPLUG_OPEN_TRIES && hotplug_running; tries++) {
+    if (alsa_open_handle(best.device_path, AUDIO_SAMPLE_RATE, &config,
+                         &handle, &period) == 0) {
+      break;
+    }
+    usleep(HOTPLUG_SETTLE_MS * 1000);
+  }
+  if (handle == NULL) {
+    return;
+  }
+
+  /* pending_pcm is NULL here: only this thread fills it */
+  pending_device = best;
+  pending_period = period;
+  pending_mmap = config.mmap;
+  atomic_store(&pending_pcm, handle);
+  pthread_mutex_lock(&mixer_lock);
+  pthread_cond_signal(&mixer_wake);
+  pthread_mutex_unlock(&mixer_lock);
+}
+
+static void *hotplug_func(void *arg) {
+  (void)arg;
+  while (hotplug_running) {
+    int current_gone = 0;
+    if (hotplug_wait(&current_gone) && !device_pinned) {
+      /* Not if the mixer has yet to take the last one */
+      if (atomic_load(&pending_pcm) == NULL) {
+        hotplug_reselect(current_gone);
+      }
+    }
+  }
+  return NULL;
+}
+
+static void start_hotplug(void) {
+  hotplug_fd = hal_usb_uevent_open();
+  if (hotplug_fd < 0) {
+    fprintf(stderr, "HAL Audio: No uevents, hotplug disabled\n");
+    return;
+  }
+  hotplug_running = 1;
+  if (pthread_create(&hotplug_thread, NULL, hotplug_func, NULL) != 0) {
+    hotplug_running = 0;
+    close(hotplug_fd);
+    hotplug_fd = -1;
+  }
+}
+
+static void stop_hotplug(void) {
+  if (hotplug_running) {
+    hotplug_running = 0;
+    pthread_join(hotplug_thread, NULL);
+    close(hotplug_fd);
+    hotplug_fd = -1;
+  }
+}
+
 /* ============================================================================
  * Public HAL API Functions
  * ============================================================================
@@ -346,8 +1085,10 @@ int hal_audio_init(void) {
     return 0; /* Already initialized */
   }
 
-  /* Attempt to detect USB audio device */
-  if (detect_usb_audio() != 0) {
+  /* Attempt to detect USB audio device (headless sinks need none) */
+  if (!sink->uses_card) {
+    printf("HAL Audio: %s\n", sink->name);
+  } else if (detect_usb_audio() != 0) {
     fprintf(stderr, "HAL Audio: Using default device: %s\n", audio_device);
     /* Continue anyway with default, don't fail */
   } else {
@@ -358,19 +1099,34 @@ int hal_audio_init(void) {
   if (open_pcm_device() != 0) {
     fprintf(stderr,
             "HAL Audio: Failed to open PCM device, audio will not work\n");
-    /* Don't fail - we'll try again on first write */
+    /* Don't fail - the mixer thread retries once a second */
   }
 
   /* Load beep sounds into RAM cache */
   printf("HAL Audio: Loading beep sounds...\n");
-  if (load_wav_to_cache(BEEP_KEYPRESS_PATH, &beep_keypress) != 0) {
-    fprintf(stderr, "HAL Audio: Warning - keypress beep not loaded\n");
+  load_beep(BEEP_KEYPRESS_PATH, &beep_keypress);
+  load_beep(BEEP_HOLD_PATH, &beep_hold);
+  load_beep(BEEP_ERROR_PATH, &beep_error);
+
+  /* And every prompt, so 'p' requests play from memory */
+  hal_audio_bank_init((size_t)PROMPT_BANK_BUDGET_KB * 1024);
+  int prompts = hal_audio_bank_load_dir(PROMPT_BANK_DIR);
+  if (prompts < 0) {
+    fprintf(stderr, "HAL Audio: Cannot read prompt directory %s\n",
+            PROMPT_BANK_DIR);
+  } else {
+    AudioBankStats stats;
+    hal_audio_bank_get_stats(&stats);
+    printf("HAL Audio: Prompt bank holds %d prompts (%zu KB of %zu KB)\n",
+           prompts, stats.bytes / 1024, stats.budget / 1024);
   }
-  if (load_wav_to_cache(BEEP_HOLD_PATH, &beep_hold) != 0) {
-    fprintf(stderr, "HAL Audio: Warning - hold beep not loaded\n");
+
+  if (start_mixer() != 0) {
+    close_pcm_device();
+    return -1;
   }
-  if (load_wav_to_cache(BEEP_ERROR_PATH, &beep_error) != 0) {
-    fprintf(stderr, "HAL Audio: Warning - error beep not loaded\n");
+  if (sink->uses_card) {
+    start_hotplug();
   }
 
   initialized = 1;
@@ -382,13 +1138,19 @@ int hal_audio_set_device(const char *device_name) {
     return -1;
   }
 
+  /* An explicit choice: hotplug stops re-ranking cards */
+  device_pinned = 1;
+  pthread_mutex_lock(&mixer_lock);
   strncpy(audio_device, device_name, sizeof(audio_device) - 1);
   audio_device[sizeof(audio_device) - 1] = '\0';
+  pthread_mutex_unlock(&mixer_lock);
 
-  /* Restart PCM device with new device if already initialized */
-  if (initialized && pcm_handle != NULL) {
-    close_pcm_device();
-    open_pcm_device();
+  /* The mixer thread owns the handle; have it reopen on the new device */
+  if (initialized) {
+    pthread_mutex_lock(&mixer_lock);
+    mixer_reopen = 1;
+    pthread_cond_signal(&mixer_wake);
+    pthread_mutex_unlock(&mixer_lock);
   }
 
   printf("HAL Audio: Device set to: %s\n", audio_device);
@@ -397,17 +1159,49 @@ int hal_audio_set_device(const char *device_name) {
 
 const char *hal_audio_get_device(void) { return audio_device; }
 
+int hal_audio_set_output(int period_ms, int buffer_ms, int use_mmap) {
+  if (period_ms < OUTPUT_PERIOD_MIN_MS || period_ms > OUTPUT_PERIOD_MAX_MS ||
+      buffer_ms < 2 * period_ms || buffer_ms > OUTPUT_BUFFER_MAX_MS) {
+    fprintf(stderr, "HAL Audio: Output %d ms periods, %d ms buffer out of "
+            "range\n",
+            period_ms, buffer_ms);
+    return -1;
+  }
+
+  pthread_mutex_lock(&mixer_lock);
+  if (output_config.period_ms == period_ms &&
+      output_config.buffer_ms == buffer_ms &&
+      output_config.mmap == (use_mmap ? 1 : 0)) {
+    pthread_mutex_unlock(&mixer_lock);
+    return 0; /* Nothing to reopen for */
+  }
+  output_config.period_ms = period_ms;
+  output_config.buffer_ms = buffer_ms;
+  output_config.mmap = use_mmap ? 1 : 0;
+  /* The mixer reopens between periods; queued audio carries on after */
+  if (initialized) {
+    mixer_reopen = 1;
+    pthread_cond_signal(&mixer_wake);
+  }
+  pthread_mutex_unlock(&mixer_lock);
+
+  printf("HAL Audio: Output set to %d ms periods, %d ms buffer%s\n",
+         period_ms, buffer_ms, use_mmap ? ", mmap" : "");
+  return 0;
+}
+
 /**
  * @brief Write raw PCM samples to the audio pipeline
  *
+ * Queues the samples on the speech voice. Blocks while the ring is full,
+ * which paces the TTS engine to the device.
+ *
  * @param samples Pointer to 16-bit signed samples
  * @param num_samples Number of samples to write
  * @return 0 on success, -1 on failure
  */
 int hal_audio_write_raw(const int16_t *samples, size_t num_samples) {
-  snd_pcm_sframes_t frames;
-
-  if (!initialized || pcm_handle == NULL) {
+  if (!initialized || !device_open) {
     fprintf(stderr, "HAL Audio: PCM device not available\n");
     return -1;
   }
@@ -421,32 +1215,19 @@ int hal_audio_write_raw(const int16_t *samples, size_t num_samples) {
     return 0; /* Silently drop audio - we're being interrupted */
   }
 
-  /* Write samples to ALSA PCM device */
-  frames = snd_pcm_writei(pcm_handle, samples, num_samples);
-
-  if (frames < 0) {
-    /* Try to recover from underrun or other errors */
-    frames = snd_pcm_recover(pcm_handle, frames, 0);
-    if (frames < 0) {
-      fprintf(stderr, "HAL Audio: Write failed: %s\n", snd_strerror(frames));
-      return -1;
-    }
-  }
-
+  queue_samples(&voices[VOICE_SPEECH], samples, num_samples);
   return 0;
 }
 
 int hal_audio_play_file(const char *filepath) {
   FILE *wav_file;
-  uint8_t header[44];
-  uint32_t data_size;
-  uint32_t sample_rate;
-  uint16_t num_channels;
-  uint16_t bits_per_sample;
+  WavFormat format;
+  AudioConverter conv;
   uint8_t *chunk_buffer;
-  size_t bytes_remaining;
-  size_t bytes_to_read;
-  size_t bytes_read;
+  int16_t *converted;
+  size_t chunk_frames;
+  size_t frames_remaining;
+  size_t frames_read;
 
   if (!initialized) {
     fprintf(stderr, "HAL Audio: Not initialized\n");
@@ -457,6 +1238,24 @@ int hal_audio_play_file(const char *filepath) {
     return -1;
   }
 
+  /* Check if PCM device is available */
+  if (!device_open) {
+    fprintf(stderr, "HAL Audio: PCM device not available\n");
+    return -1;
+  }
+
+  /* Prompt bank first: no file I/O on a hit */
+  const CachedAudio *prompt = hal_audio_bank_acquire(filepath);
+  if (prompt != NULL) {
+    audio_playing = 1;
+    audio_interrupted = 0;
+    queue_samples(&voices[VOICE_FILE], prompt->samples, prompt->num_samples);
+    audio_playing = 0;
+    audio_interrupted = 0;
+    hal_audio_bank_release(prompt);
+    return 0;
+  }
+
   /* Open WAV file */
   wav_file = fopen(filepath, "rb");
   if (wav_file == NULL) {
@@ -464,61 +1263,34 @@ int hal_audio_play_file(const char *filepath) {
     return -1;
   }
 
-  /* Read WAV header (44 bytes for standard WAV) */
-  if (fread(header, 1, 44, wav_file) != 44) {
-    fprintf(stderr, "HAL Audio: Failed to read WAV header: %s\n", filepath);
+  if (hal_wav_read_header(wav_file, &format) != 0) {
+    fprintf(stderr, "HAL Audio: Not a PCM WAV file: %s\n", filepath);
     fclose(wav_file);
     return -1;
   }
 
-  /* Verify RIFF header */
-  if (memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
-    fprintf(stderr, "HAL Audio: Not a valid WAV file: %s\n", filepath);
+  /* Any PCM rate, channel count and bit depth is converted to the pipeline
+   * format in-process, so it plays through the interruptible mixer path */
+  if (hal_convert_init(&conv, format.sample_rate, format.channels,
+                       format.bits_per_sample) != 0) {
+    fprintf(stderr, "HAL Audio: Unsupported format (%u Hz, %u ch, %u-bit): "
+                    "%s\n",
+            format.sample_rate, format.channels, format.bits_per_sample,
+            filepath);
     fclose(wav_file);
     return -1;
   }
 
-  /* Parse WAV header fields (little-endian) */
-  num_channels = header[22] | (header[23] << 8);
-  sample_rate =
-      header[24] | (header[25] << 8) | (header[26] << 16) | (header[27] << 24);
-  bits_per_sample = header[34] | (header[35] << 8);
-  data_size =
-      header[40] | (header[41] << 8) | (header[42] << 16) | (header[43] << 24);
-
-  /* Validate format matches our pipeline configuration */
-  if (sample_rate != AUDIO_SAMPLE_RATE) {
-    fprintf(stderr, "HAL Audio: Sample rate mismatch (%u vs %d): %s\n",
-            sample_rate, AUDIO_SAMPLE_RATE, filepath);
-    /* Fall back to system() for non-matching files */
-    fclose(wav_file);
-    goto fallback_system;
-  }
-
-  if (num_channels != AUDIO_CHANNELS) {
-    fprintf(stderr, "HAL Audio: Channel mismatch (%u vs %d): %s\n",
-            num_channels, AUDIO_CHANNELS, filepath);
-    fclose(wav_file);
-    goto fallback_system;
-  }
-
-  if (bits_per_sample != 16) {
-    fprintf(stderr, "HAL Audio: Bit depth mismatch (%u vs 16): %s\n",
-            bits_per_sample, filepath);
-    fclose(wav_file);
-    goto fallback_system;
-  }
-
-  /* Check if PCM device is available */
-  if (pcm_handle == NULL) {
-    fclose(wav_file);
-    goto fallback_system;
-  }
-
-  /* Allocate chunk buffer */
-  chunk_buffer = (uint8_t *)malloc(AUDIO_CHUNK_BYTES);
-  if (chunk_buffer == NULL) {
+  /* Allocate chunk buffers: AUDIO_CHUNK_MS of input, whole frames */
+  chunk_frames = (format.sample_rate * AUDIO_CHUNK_MS) / 1000 + 1;
+  chunk_buffer = (uint8_t *)malloc(chunk_frames * format.block_align);
+  converted = (int16_t *)malloc(hal_convert_max_output(&conv, chunk_frames) *
+                                sizeof(int16_t));
+  if (chunk_buffer == NULL || converted == NULL) {
     fprintf(stderr, "HAL Audio: Failed to allocate chunk buffer\n");
+    free(chunk_buffer);
+    free(converted);
+    hal_convert_free(&conv);
     fclose(wav_file);
     return -1;
   }
@@ -526,96 +1298,81 @@ int hal_audio_play_file(const char *filepath) {
   /* Stream audio data in chunks */
   audio_playing = 1;
   audio_interrupted = 0;
-  bytes_remaining = data_size;
+  frames_remaining = format.data_size / format.block_align;
 
-  while (bytes_remaining > 0 && !audio_interrupted) {
-    bytes_to_read = (bytes_remaining > AUDIO_CHUNK_BYTES) ? AUDIO_CHUNK_BYTES
-                                                          : bytes_remaining;
-    bytes_read = fread(chunk_buffer, 1, bytes_to_read, wav_file);
+  while (frames_remaining > 0 && !audio_interrupted) {
+    frames_read =
+        fread(chunk_buffer, format.block_align,
+              frames_remaining < chunk_frames ? frames_remaining : chunk_frames,
+              wav_file);
 
-    if (bytes_read == 0) {
+    if (frames_read == 0) {
       break; /* EOF or error */
     }
 
-    /* Write to ALSA PCM device */
-    snd_pcm_sframes_t frames =
-        snd_pcm_writei(pcm_handle, chunk_buffer, bytes_read / 2);
+    /* Hand to the mixer on the file voice */
+    queue_samples(&voices[VOICE_FILE], converted,
+                  hal_convert_process(&conv, chunk_buffer, frames_read,
+                                      converted));
 
-    if (frames < 0) {
-      frames = snd_pcm_recover(pcm_handle, frames, 0);
-      if (frames < 0) {
-        fprintf(stderr, "HAL Audio: Write error during streaming\n");
-        break;
-      }
-    }
-
-    bytes_remaining -= bytes_read;
+    frames_remaining -= frames_read;
   }
 
   audio_playing = 0;
   audio_interrupted = 0;
   free(chunk_buffer);
+  free(converted);
+  hal_convert_free(&conv);
   fclose(wav_file);
   return 0;
-
-fallback_system: {
-  /* Fallback to system() call for non-matching formats */
-  char command[1024];
-  int result;
-
-  snprintf(command, sizeof(command), "aplay -D %s '%s' 2>/dev/null",
-           audio_device, filepath);
-
-  audio_playing = 1;
-  result = system(command);
-  audio_playing = 0;
-
-  if (result != 0) {
-    fprintf(stderr, "HAL Audio: Failed to play file: %s\n", filepath);
-    return -1;
-  }
-  return 0;
-}
 }
 
 /**
  * @brief Interrupt current audio playback immediately
  *
- * Uses snd_pcm_drop() to immediately stop playback and discard any
- * buffered audio. This provides true interrupt capability.
+ * Flushes every voice ring, so silence follows within the periods already
+ * queued in the device (MIXER_LEAD_PERIODS). The next mixed period fades
+ * the cut-off audio out over MIX_FADE_SAMPLES rather than stopping it
+ * mid-waveform, so the stop does not click. The device itself keeps
+ * running and needs no re-prepare.
  */
 void hal_audio_interrupt(void) {
+  if (!audio_interrupted) {
+    hal_stats_count(AUDIO_COUNT_INTERRUPTS); /* Once per burst */
+  }
   audio_interrupted = 1;
 
-  /* Immediately stop playback and discard buffer */
-  if (pcm_handle != NULL) {
-    snd_pcm_drop(pcm_handle);
+  if (mixer_running) {
+    /* Speech and files only: a key beep queued just before the interrupt
+     * (keypress beep, then the speech cut) still plays in full */
+    static const int cut[] = {VOICE_SPEECH, VOICE_FILE};
+    for (size_t i = 0; i < sizeof(cut) / sizeof(cut[0]); i++) {
+      hal_mix_voice_fade_out(&voices[cut[i]]);
+      atomic_store(&voice_arrival[cut[i]], 0);
+    }
+    /* Release writers blocked on a full ring */
+    pthread_mutex_lock(&mixer_lock);
+    pthread_cond_broadcast(&voice_space);
+    pthread_mutex_unlock(&mixer_lock);
   }
 }
 
 /**
- * @brief Clear the interrupt flag and prepare device for new audio
+ * @brief Clear the interrupt flag
  *
  * This should be called at the start of a new audio operation
- * to reset from a previous interrupt. Only calls snd_pcm_prepare() if
- * we were actually interrupted (after snd_pcm_drop was called).
+ * to reset from a previous interrupt.
  */
-void hal_audio_clear_interrupt(void) {
-  /* Only call snd_pcm_prepare if we were actually interrupted.
-   * This prevents clearing the buffer when transitioning between
-   * audio packets (e.g., beep -> TTS) without an interrupt. */
-  if (audio_interrupted && pcm_handle != NULL) {
-    snd_pcm_prepare(pcm_handle);
-  }
-  audio_interrupted = 0;
-}
+void hal_audio_clear_interrupt(void) { audio_interrupted = 0; }
 
 /**
  * @brief Check if audio is currently playing
  *
- * @return 1 if playing, 0 otherwise
+ * @return 1 if playing or samples are still waiting to be mixed, 0 otherwise
  */
-int hal_audio_is_playing(void) { return audio_playing; }
+int hal_audio_is_playing(void) {
+  return (audio_playing || (mixer_running && mixer_pending() > 0)) ? 1 : 0;
+}
 
 /**
  * @brief Check if pipeline is ready for streaming
@@ -623,16 +1380,23 @@ int hal_audio_is_playing(void) { return audio_playing; }
  * @return 1 if ready, 0 otherwise
  */
 int hal_audio_pipeline_ready(void) {
-  return (initialized && pcm_handle != NULL) ? 1 : 0;
+  return (initialized && device_open) ? 1 : 0;
 }
 
 void hal_audio_cleanup(void) {
   /* Free cached beeps */
-  free_cached_audio(&beep_keypress);
-  free_cached_audio(&beep_hold);
-  free_cached_audio(&beep_error);
+  hal_audio_free_cached(&beep_keypress);
+  hal_audio_free_cached(&beep_hold);
+  hal_audio_free_cached(&beep_error);
+  hal_audio_bank_cleanup();
 
+  stop_hotplug();
+  stop_mixer();
   close_pcm_device();
+  snd_pcm_t *unused = atomic_exchange(&pending_pcm, NULL);
+  if (unused != NULL) {
+    snd_pcm_close(unused);
+  }
   initialized = 0;
   printf("HAL Audio: Cleaned up\n");
 }
@@ -640,13 +1404,15 @@ void hal_audio_cleanup(void) {
 /**
  * @brief Play a beep from RAM cache
  *
- * Plays a pre-loaded beep sound with minimal latency.
+ * Queues a pre-loaded beep on the beep voice and returns at once. The mixer
+ * lays it over any speech already playing.
  *
  * @param type Type of beep to play (BEEP_KEYPRESS, BEEP_HOLD, BEEP_ERROR)
  * @return 0 on success, -1 on failure
  */
 int hal_audio_play_beep(BeepType type) {
   CachedAudio *beep = NULL;
+  uint64_t requested_us = hal_stats_now_us();
 
   printf("HAL Audio: play_beep called, type=%d\n", type);
 
@@ -670,47 +1436,129 @@ int hal_audio_play_beep(BeepType type) {
     return -1;
   }
 
-  if (!initialized || pcm_handle == NULL) {
+  if (!initialized || !device_open) {
     fprintf(stderr, "HAL Audio: PCM device not ready for beep\n");
     return -1;
   }
 
-  /* Write beep samples directly to ALSA (fast, no file I/O) */
-  snd_pcm_sframes_t frames =
-      snd_pcm_writei(pcm_handle, beep->samples, beep->num_samples);
-
-  if (frames < 0) {
-    frames = snd_pcm_recover(pcm_handle, frames, 0);
-    if (frames < 0) {
-      fprintf(stderr, "HAL Audio: Beep write error: %s\n",
-              snd_strerror(frames));
-      return -1;
-    }
-    /* After recovery, we need to write again */
-    frames = snd_pcm_writei(pcm_handle, beep->samples, beep->num_samples);
-    if (frames < 0) {
-      fprintf(stderr, "HAL Audio: Beep write after recovery failed: %s\n",
-              snd_strerror(frames));
-      return -1;
-    }
+  /* Whole beeps only: a beep cut short sounds like a click */
+  pthread_mutex_lock(&beep_lock);
+  int queued = 0;
+  if (hal_mix_voice_space(&voices[VOICE_BEEP]) >= beep->num_samples) {
+    stamp_arrival(VOICE_BEEP, requested_us);
+    hal_mix_voice_write(&voices[VOICE_BEEP], beep->samples, beep->num_samples);
+    queued = 1;
   }
+  pthread_mutex_unlock(&beep_lock);
 
-  /* Ensure playback has started - device may be in prepared state */
-  snd_pcm_state_t state = snd_pcm_state(pcm_handle);
-  if (state == SND_PCM_STATE_PREPARED) {
-    snd_pcm_start(pcm_handle);
+  if (!queued) {
+    hal_stats_count(AUDIO_COUNT_DROPS);
+    fprintf(stderr, "HAL Audio: Beep dropped, too many queued\n");
+    return -1;
   }
 
-  /* Drain to ensure beep plays completely before returning.
-   * This prevents TTS from starting before the beep is heard. */
-  snd_pcm_drain(pcm_handle);
-  snd_pcm_prepare(pcm_handle); /* Prepare for next audio */
+  pthread_mutex_lock(&mixer_lock);
+  pthread_cond_signal(&mixer_wake);
+  pthread_mutex_unlock(&mixer_lock);
+  return 0;
+}
+
+const char *hal_audio_get_impl_name(void) { return sink->name; }
+
+void hal_audio_set_hot_pipeline(int enable) {
+  hot_pipeline = enable ? 1 : 0;
+  printf("HAL Audio: Hot pipeline %s\n", hot_pipeline ? "on" : "off");
+
+  /* Start feeding silence now rather than on the next sound */
+  pthread_mutex_lock(&mixer_lock);
+  pthread_cond_signal(&mixer_wake);
+  pthread_mutex_unlock(&mixer_lock);
+}
+
+int hal_audio_get_hot_pipeline(void) { return hot_pipeline; }
+
+void hal_audio_set_duck(int enable) {
+  duck_mode = enable ? 1 : 0;
+  printf("HAL Audio: Duck mode %s\n", duck_mode ? "on" : "off");
+}
+
+int hal_audio_get_duck(void) { return duck_mode; }
 
+int hal_audio_get_queued_ms(void) {
+  if (!initialized) {
+    return 0;
+  }
+  long frames = device_queued + (long)mixer_pending();
+  return (int)((frames * 1000) / AUDIO_SAMPLE_RATE);
+}
+
+int hal_audio_set_volume(int percent) {
+  if (percent < 0) {
+    percent = 0;
+  } else if (percent > 100) {
+    percent = 100;
+  }
+  volume_percent = percent;
+  hal_mix_gain_set(&output_gain, (percent * percent * MIX_GAIN_UNITY) / 10000);
   return 0;
 }
 
-const char *hal_audio_get_impl_name(void) {
-  return "USB Audio (Direct ALSA PCM)";
+int hal_audio_get_volume(void) { return volume_percent; }
+
+int hal_audio_set_mixer_volume(int percent) {
+  snd_mixer_t *mixer;
+  snd_mixer_selem_id_t *sid;
+  char card[32];
+  int result = -1;
+
+  if (percent < 0) {
+    percent = 0;
+  } else if (percent > 100) {
+    percent = 100;
+  }
+
+  if (selected_audio_device.device_path[0] != '\0') { /* Detected card */
+    snprintf(card, sizeof(card), "hw:%d", selected_audio_device.card_number);
+  } else {
+    snprintf(card, sizeof(card), "default");
+  }
+
+  if (snd_mixer_open(&mixer, 0) < 0) {
+    return -1;
+  }
+  if (snd_mixer_attach(mixer, card) < 0 ||
+      snd_mixer_selem_register(mixer, NULL, NULL) < 0 ||
+      snd_mixer_load(mixer) < 0) {
+    fprintf(stderr, "HAL Audio: Cannot open mixer for %s\n", card);
+    snd_mixer_close(mixer);
+    return -1;
+  }
+
+  snd_mixer_selem_id_alloca(&sid);
+  snd_mixer_selem_id_set_index(sid, 0);
+  for (size_t i = 0; i < sizeof(mixer_controls) / sizeof(mixer_controls[0]);
+       i++) {
+    snd_mixer_selem_id_set_name(sid, mixer_controls[i]);
+    snd_mixer_elem_t *elem = snd_mixer_find_selem(mixer, sid);
+    long min, max;
+    if (elem == NULL || !snd_mixer_selem_has_playback_volume(elem) ||
+        snd_mixer_selem_get_playback_volume_range(elem, &min, &max) < 0) {
+      continue;
+    }
+    if (snd_mixer_selem_set_playback_volume_all(
+            elem, min + ((max - min) * percent) / 100) == 0) {
+      printf("HAL Audio: %s mixer volume %d%% on %s\n", mixer_controls[i],
+             percent, card);
+      result = 0;
+    }
+    break;
+  }
+  if (result != 0) {
+    fprintf(stderr, "HAL Audio: No playback volume control on %s\n", card);
+  }
+
+  snd_mixer_close(mixer);
+  return result;
 }
 
 int hal_audio_get_card_number(void) {
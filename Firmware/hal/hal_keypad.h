@@ -10,6 +10,16 @@
  */
 
 #include <stdint.h>
+#include <sys/time.h>
+
+/**
+ * @brief Kind of key transition carried by a KeypadEvent
+ */
+typedef enum {
+  KEYPAD_ACTION_PRESS = 0,  /**< Key went down */
+  KEYPAD_ACTION_REPEAT = 1, /**< Key is still down (auto-repeat) */
+  KEYPAD_ACTION_RELEASE = 2 /**< Key came back up */
+} KeypadAction;
 
 /**
  * @brief Keypad event structure
@@ -22,6 +32,9 @@ typedef struct {
   int raw_code; /**< Raw keycode from device (implementation-specific) */
   unsigned char
       valid; /**< 1 if valid single key, 0 if invalid/multiple/no key */
+  KeypadAction action; /**< Press, repeat or release */
+  struct timeval time; /**< Kernel timestamp of the event (CLOCK_MONOTONIC
+                          when the device supports it) */
 } KeypadEvent;
 
 /**
@@ -44,6 +57,20 @@ int hal_keypad_init(void);
  */
 KeypadEvent hal_keypad_read(void);
 
+/**
+ * @brief Wait for the next keypad transition (blocking)
+ *
+ * Blocks on the input device until a press, repeat or release arrives,
+ * or until the timeout expires. Unlike hal_keypad_read(), release events
+ * are reported (with action KEYPAD_ACTION_RELEASE) so callers can measure
+ * hold duration from the kernel timestamps instead of polling.
+ *
+ * @param event Filled with the decoded event when 1 is returned
+ * @param timeout_ms Maximum time to wait, or -1 to wait forever
+ * @return 1 if an event was stored, 0 on timeout, -1 on device error
+ */
+int hal_keypad_wait_event(KeypadEvent *event, int timeout_ms);
+
 /**
  * @brief Cleanup keypad resources
  *
@@ -7,11 +7,15 @@
  */
 
 #include "hal_keypad.h"
+#include <errno.h>
 #include <fcntl.h>
 #include <glob.h>
 #include <linux/input.h>
+#include <poll.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
 #include <unistd.h>
 
 /* Implementation constants */
@@ -110,6 +114,82 @@ static char map_keycode_to_symbol(int keycode) {
   return '-'; /* Invalid/unmapped key */
 }
 
+/**
+ * @brief Decode a raw input event into a keypad event
+ *
+ * Applies '00' debouncing and hold tracking. Release events are only
+ * reported for the currently held key, so the duplicate release that
+ * follows a suppressed '00' press is swallowed.
+ *
+ * @param ev Raw event read from the input device
+ * @param event Output event (valid=0 if the event should be ignored)
+ */
+static void decode_input_event(const struct input_event *ev,
+                               KeypadEvent *event) {
+  event->time = ev->time;
+
+  if (ev->type != EV_KEY) {
+    return;
+  }
+
+  if (ev->value == 1) { /* Key press down */
+
+    /* Handle '00' key debouncing */
+    /* The '00' key on many keypads sends two KEY_KP0 events rapidly */
+    /* We suppress the second one if it comes within 50ms of the first */
+    if (ev->code == KEY_KP0 && debounce_state.last_key == KEY_KP0) {
+      /* Calculate time difference in microseconds */
+      long time_diff =
+          (ev->time.tv_sec - debounce_state.last_time.tv_sec) * 1000000L +
+          (ev->time.tv_usec - debounce_state.last_time.tv_usec);
+
+      /* If within 50ms (50000 microseconds), suppress this event */
+      if (time_diff < 50000) {
+        return;
+      }
+    }
+
+    /* Store this event for next debounce check */
+    debounce_state.last_key = ev->code;
+    debounce_state.last_time = ev->time;
+
+    /* Map the keycode to symbol */
+    char key_char = map_keycode_to_symbol(ev->code);
+
+    /* Update hold state */
+    hold_state.held_key = key_char;
+    hold_state.held_code = ev->code;
+
+    event->raw_code = ev->code;
+    event->key = key_char;
+    event->action = KEYPAD_ACTION_PRESS;
+    event->valid = (key_char != '-') ? 1 : 0;
+
+  } else if (ev->value == 0) { /* Key release */
+
+    /* Only report (and clear hold state) if this release matches the held
+     * key */
+    if (ev->code == hold_state.held_code) {
+      event->raw_code = hold_state.held_code;
+      event->key = hold_state.held_key;
+      event->action = KEYPAD_ACTION_RELEASE;
+      event->valid = (hold_state.held_key != '-') ? 1 : 0;
+      hold_state.held_key = '-';
+      hold_state.held_code = -1;
+    }
+
+  } else if (ev->value == 2) { /* Key repeat (held) */
+
+    /* Report the held key again */
+    if (hold_state.held_key != '-') {
+      event->raw_code = hold_state.held_code;
+      event->key = hold_state.held_key;
+      event->action = KEYPAD_ACTION_REPEAT;
+      event->valid = 1;
+    }
+  }
+}
+
 /* HAL Implementation Functions */
 
 int hal_keypad_init(void) {
@@ -128,12 +208,20 @@ int hal_keypad_init(void) {
     return -1;
   }
 
+  /* Ask evdev for CLOCK_MONOTONIC timestamps so event times can be compared
+   * with clock_gettime(CLOCK_MONOTONIC) in the Software layer. Older kernels
+   * keep wall-clock timestamps, which is still fine for hold durations. */
+  int clock_id = CLOCK_MONOTONIC;
+  if (ioctl(keypad_fd, EVIOCSCLOCKID, &clock_id) != 0) {
+    fprintf(stderr, "HAL Keypad: Monotonic timestamps unavailable\n");
+  }
+
   printf("HAL Keypad: Initialized USB keypad at %s\n", device_path);
   return 0;
 }
 
 KeypadEvent hal_keypad_read(void) {
-  KeypadEvent event = {'-', 0, 0}; /* Default: invalid event */
+  KeypadEvent event = {.key = '-'}; /* Default: invalid event */
   struct input_event ev;
   ssize_t bytes_read;
 
@@ -145,65 +233,67 @@ KeypadEvent hal_keypad_read(void) {
   /* Read input event (non-blocking) */
   bytes_read = read(keypad_fd, &ev, sizeof(ev));
 
-  if (bytes_read == sizeof(ev) && ev.type == EV_KEY) {
+  if (bytes_read == sizeof(ev)) {
+    decode_input_event(&ev, &event);
 
-    if (ev.value == 1) { /* Key press down */
-
-      /* Handle '00' key debouncing */
-      /* The '00' key on many keypads sends two KEY_KP0 events rapidly */
-      /* We suppress the second one if it comes within 50ms of the first */
-      if (ev.code == KEY_KP0 && debounce_state.last_key == KEY_KP0) {
-        /* Calculate time difference in microseconds */
-        long time_diff =
-            (ev.time.tv_sec - debounce_state.last_time.tv_sec) * 1000000L +
-            (ev.time.tv_usec - debounce_state.last_time.tv_usec);
-
-        /* If within 50ms (50000 microseconds), suppress this event */
-        if (time_diff < 50000) {
-          /* Return invalid event to suppress this duplicate '0' */
-          return event;
-        }
-      }
+    /* Don't report release events as key presses */
+    if (event.action == KEYPAD_ACTION_RELEASE) {
+      event.valid = 0;
+    }
+  }
+  /* If no event available (bytes_read <= 0), just return invalid event */
+  /* Linux input system provides ev.value == 2 (repeat) for held keys */
 
-      /* Store this event for next debounce check */
-      debounce_state.last_key = ev.code;
-      debounce_state.last_time = ev.time;
+  return event;
+}
 
-      /* Map the keycode to symbol */
-      char key_char = map_keycode_to_symbol(ev.code);
+int hal_keypad_wait_event(KeypadEvent *event, int timeout_ms) {
+  struct input_event ev;
+  struct pollfd pfd;
 
-      /* Update hold state */
-      hold_state.held_key = key_char;
-      hold_state.held_code = ev.code;
+  if (event == NULL || keypad_fd < 0) {
+    return -1;
+  }
 
-      /* Return the press event */
-      event.raw_code = ev.code;
-      event.key = key_char;
-      event.valid = (key_char != '-') ? 1 : 0;
+  pfd.fd = keypad_fd;
+  pfd.events = POLLIN;
 
-    } else if (ev.value == 0) { /* Key release */
+  /* Skip non-key events (EV_SYN, EV_MSC) until a usable one arrives */
+  for (;;) {
+    ssize_t bytes_read = read(keypad_fd, &ev, sizeof(ev));
 
-      /* Only clear hold state if this release matches the held key */
-      if (ev.code == hold_state.held_code) {
-        hold_state.held_key = '-';
-        hold_state.held_code = -1;
+    if (bytes_read == sizeof(ev)) {
+      KeypadEvent decoded = {.key = '-'};
+      decode_input_event(&ev, &decoded);
+      if (decoded.valid) {
+        *event = decoded;
+        return 1;
       }
-      /* Don't report release events as key presses */
+      continue;
+    }
 
-    } else if (ev.value == 2) { /* Key repeat (held) */
+    if (bytes_read < 0 && errno != EAGAIN && errno != EINTR) {
+      perror("HAL Keypad: Read failed");
+      return -1;
+    }
 
-      /* Report the held key again */
-      if (hold_state.held_key != '-') {
-        event.raw_code = hold_state.held_code;
-        event.key = hold_state.held_key;
-        event.valid = 1;
+    /* Nothing buffered - sleep in the kernel until the device has data */
+    int ready = poll(&pfd, 1, timeout_ms);
+    if (ready == 0) {
+      return 0;
+    }
+    if (ready < 0) {
+      if (errno == EINTR) {
+        continue;
       }
+      perror("HAL Keypad: poll failed");
+      return -1;
+    }
+    if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+      fprintf(stderr, "HAL Keypad: Device disconnected\n");
+      return -1;
     }
   }
-  /* If no event available (bytes_read <= 0), just return invalid event */
-  /* Linux input system provides ev.value == 2 (repeat) for held keys */
-
-  return event;
 }
 
 void hal_keypad_cleanup(void) {
@@ -58,8 +58,9 @@ const char *hal_tts_get_impl_name(void);
 /**
  * @brief Set speech speed
  *
- * Sets the speech rate for Piper TTS. If Piper is running, it will be
- * restarted with the new speed.
+ * Sets the speech rate. Piper keeps running at its build-time speed and
+ * its output is time-stretched to this one (pitch unchanged), so the change
+ * is immediate and applies from the next utterance.
  *
  * @param speed Speed multiplier (0.5 = faster, 1.0 = normal, 2.0 = slower)
  * @return 0 on success, -1 on failure
@@ -0,0 +1,979 @@
+/**
+ * @file hal_tts_cache.c
+ * @brief Synthesized speech cache (see hal_tts_cache.h)
+ *
+ * Store file layout, little-endian:
+ *
+ *   "HAMPTTS\n" version(u32) reserved(u32)
+ *   record*: magic(u32) key_bytes(u32) num_samples(u32) check(u32)
+ *            key, padded to 4 bytes
+ *            samples, padded to 4 bytes
+ *
+ * The key is "text\nmodel\nlength_scale", model without its directory.
+ * check is FNV-1a over the key and sample bytes. At init only the record
+ * headers and keys are read, so boot does not pull the whole store off the
+ * SD card: a header that runs past the end of the file (a power cut mid
+ * append) ends the store, and each record's check is verified the first
+ * time it is looked up. A record that fails is dropped then.
+ *
+ * When an append would take the store past TTS_CACHE_STORE_MB, the store is
+ * rewritten (aside, then renamed over it) with only the utterances looked up
+ * or stored this run, most used first, up to half the limit. What earlier
+ * runs said and this one has not expires, so the store follows the
+ * vocabulary in use instead of freezing once full.
+ *
+ * Phrase bundle layout (make phrases), little-endian:
+ *
+ *   BundleHeader
+ *   BundleEntry[count]: offsets from the start of the file
+ *   texts, then samples, each sample block 4-byte aligned
+ *
+ * The bundle is written whole and renamed into place, so it has no
+ * per-record check; offsets are bounds-checked when it is mapped.
+ */
+
+#include "hal_tts_cache.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CACHE_BUCKETS 256 /* Power of two */
+
+#define STORE_MAGIC "HAMPTTS\n"
+#define STORE_VERSION 1
+#define STORE_HEADER_BYTES 16
+#define RECORD_MAGIC 0x43525454u /* "TTRC" */
+
+#define BUNDLE_MAGIC "HAMPPHR\n"
+#define BUNDLE_VERSION 1
+
+/* Largest the store file may grow before it is compacted */
+#ifndef TTS_CACHE_STORE_MB
+#define TTS_CACHE_STORE_MB 64
+#endif
+
+typedef struct {
+  uint32_t magic;
+  uint32_t key_bytes;
+  uint32_t num_samples;
+  uint32_t check;
+} StoreRecord;
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t count;
+  float length_scale; /* Speed every phrase was synthesized at */
+  uint32_t sample_rate;
+  char model[64]; /* Voice model file name */
+} BundleHeader;
+
+typedef struct {
+  uint32_t text_offset;
+  uint32_t text_bytes;
+  uint32_t pcm_offset;
+  uint32_t num_samples;
+} BundleEntry;
+
+typedef struct CacheEntry {
+  CachedAudio audio; /* First, so a CachedAudio pointer is the entry */
+  char *key;
+  uint64_t hash;
+  unsigned long last_used; /* cache_clock at the last lookup or store */
+  unsigned long uses;      /* Lookups this run, for compaction */
+  int users;               /* Acquired and not yet released */
+  int mapped;              /* audio.samples points into the store or bundle */
+  int unchecked;           /* Mapped store record, check not yet verified */
+  long store_offset;       /* Record in the store file, -1 if none */
+  size_t store_samples;
+  struct CacheEntry *next; /* Bucket chain */
+} CacheEntry;
+
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static CacheEntry *buckets[CACHE_BUCKETS];
+static int cache_ready = 0;
+static size_t cache_budget = 0;
+static size_t cache_bytes = 0;
+static size_t cache_entries = 0;
+static unsigned long cache_clock = 0;
+static unsigned long cache_hits = 0;
+static unsigned long cache_disk_hits = 0;
+static unsigned long cache_misses = 0;
+static unsigned long cache_evictions = 0;
+static unsigned long store_compactions = 0;
+
+static char *store_name = NULL; /* Path, for compaction */
+static int store_fd = -1;
+static uint8_t *store_map = NULL; /* Store as it was at init */
+static size_t store_map_bytes = 0;
+static size_t store_bytes = 0; /* Valid length; records append here */
+static size_t store_records = 0;
+static int store_full = 0;
+
+static uint8_t *bundle_map = NULL; /* Phrase bundle, read-only */
+static size_t bundle_map_bytes = 0;
+static size_t bundle_phrases = 0;
+
+/* ============================================================================
+ * Keys and Checksums
+ * ============================================================================
+ */
+
+static size_t pad4(size_t bytes) { return (bytes + 3) & ~(size_t)3; }
+
+/* FNV-1a, 64-bit for the index */
+static uint64_t hash_key(const char *key) {
+  uint64_t hash = 14695981039346656037ull;
+  for (const unsigned char *p = (const unsigned char *)key; *p; p++) {
+    hash ^= *p;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+/* FNV-1a, 32-bit over a record's key and samples */
+static uint32_t record_check(const char *key, size_t key_bytes,
+                             const int16_t *samples, size_t num_samples) {
+  uint32_t hash = 2166136261u;
+  const unsigned char *p = (const unsigned char *)key;
+  for (size_t i = 0; i < key_bytes; i++) {
+    hash ^= p[i];
+    hash *= 16777619u;
+  }
+  p = (const unsigned char *)samples;
+  for (size_t i = 0; i < num_samples * sizeof(int16_t); i++) {
+    hash ^= p[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/* The voice, not where it is installed: Firmware and make unified find the
+ * model through different relative paths */
+static const char *model_name(const char *model) {
+  const char *slash = strrchr(model, '/');
+  return slash != NULL ? slash + 1 : model;
+}
+
+static char *make_key(const char *text, const char *model,
+                      float length_scale) {
+  model = model_name(model);
+  size_t size = strlen(text) + strlen(model) + 32;
+  char *key = (char *)malloc(size);
+  if (key != NULL) {
+    snprintf(key, size, "%s\n%s\n%.2f", text, model, length_scale);
+  }
+  return key;
+}
+
+/* ============================================================================
+ * RAM Tier
+ * ============================================================================
+ */
+
+static CacheEntry *find_entry(const char *key, uint64_t hash) {
+  for (CacheEntry *entry = buckets[hash & (CACHE_BUCKETS - 1)]; entry != NULL;
+       entry = entry->next) {
+    if (entry->hash == hash && strcmp(entry->key, key) == 0) {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+/* Takes ownership of key */
+static CacheEntry *add_entry(char *key, uint64_t hash) {
+  CacheEntry *entry = (CacheEntry *)calloc(1, sizeof(CacheEntry));
+  if (entry == NULL) {
+    free(key);
+    return NULL;
+  }
+  entry->key = key;
+  entry->hash = hash;
+  entry->store_offset = -1;
+  entry->next = buckets[hash & (CACHE_BUCKETS - 1)];
+  buckets[hash & (CACHE_BUCKETS - 1)] = entry;
+  return entry;
+}
+
+/**
+ * @brief Drop the least recently used idle utterance from the RAM tier
+ *
+ * The entry stays, so a stored utterance is read back on its next use.
+ *
+ * @return 1 if something was evicted, 0 if everything is in use
+ */
+static int evict_one(void) {
+  CacheEntry *oldest = NULL;
+  for (int b = 0; b < CACHE_BUCKETS; b++) {
+    for (CacheEntry *entry = buckets[b]; entry != NULL; entry = entry->next) {
+      if (entry->audio.loaded && !entry->mapped && entry->users == 0 &&
+          (oldest == NULL || entry->last_used < oldest->last_used)) {
+        oldest = entry;
+      }
+    }
+  }
+  if (oldest == NULL) {
+    return 0;
+  }
+  cache_bytes -= oldest->audio.num_samples * sizeof(int16_t);
+  cache_entries--;
+  cache_evictions++;
+  hal_audio_free_cached(&oldest->audio);
+  return 1;
+}
+
+/* Allocate num_samples of RAM tier, evicting to make room */
+static int16_t *reserve_samples(size_t num_samples) {
+  size_t bytes = num_samples * sizeof(int16_t);
+  if (bytes > cache_budget) {
+    return NULL;
+  }
+  while (cache_bytes + bytes > cache_budget) {
+    if (!evict_one()) {
+      return NULL;
+    }
+  }
+  return (int16_t *)malloc(bytes);
+}
+
+static void hold_samples(CacheEntry *entry, int16_t *samples,
+                         size_t num_samples) {
+  entry->audio.samples = samples;
+  entry->audio.num_samples = num_samples;
+  entry->audio.loaded = 1;
+  cache_bytes += num_samples * sizeof(int16_t);
+  cache_entries++;
+}
+
+/* ============================================================================
+ * Store File
+ * ============================================================================
+ */
+
+/**
+ * @brief Index the records of a mapped store from their headers
+ *
+ * Only headers and keys are read; checks wait for the first lookup.
+ *
+ * @return Valid length: where the first torn or foreign record starts
+ */
+static size_t index_store(void) {
+  size_t pos = STORE_HEADER_BYTES;
+
+  while (pos + sizeof(StoreRecord) <= store_map_bytes) {
+    StoreRecord record;
+    memcpy(&record, store_map + pos, sizeof(record));
+    size_t key_pad = pad4(record.key_bytes);
+    size_t pcm_pad = pad4((size_t)record.num_samples * sizeof(int16_t));
+    size_t left = store_map_bytes - pos - sizeof(record);
+    if (record.magic != RECORD_MAGIC || record.key_bytes == 0 ||
+        key_pad > left || pcm_pad > left - key_pad) {
+      break;
+    }
+
+    const char *key = (const char *)store_map + pos + sizeof(record);
+    const int16_t *samples = (const int16_t *)(key + key_pad);
+    char *copy = strndup(key, record.key_bytes);
+    if (copy == NULL) {
+      break;
+    }
+    uint64_t hash = hash_key(copy);
+    CacheEntry *entry = find_entry(copy, hash);
+    if (entry != NULL) {
+      free(copy); /* Stored twice; the first copy serves */
+    } else if ((entry = add_entry(copy, hash)) != NULL) {
+      entry->audio.samples = (int16_t *)samples;
+      entry->audio.num_samples = record.num_samples;
+      entry->audio.loaded = 1;
+      entry->mapped = 1;
+      entry->unchecked = 1;
+      entry->store_offset = (long)pos;
+      entry->store_samples = record.num_samples;
+      store_records++;
+    }
+    pos += sizeof(record) + key_pad + pcm_pad;
+  }
+  return pos;
+}
+
+/**
+ * @brief Open (or create) the store and map what is already in it
+ *
+ * @return Utterances found, or -1 on failure
+ */
+static int open_store(const char *path) {
+  uint8_t header[STORE_HEADER_BYTES] = STORE_MAGIC;
+  struct stat st;
+
+  store_fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (store_fd < 0 || fstat(store_fd, &st) != 0) {
+    fprintf(stderr, "HAL TTS: Cannot open cache store %s\n", path);
+    goto fail;
+  }
+
+  if ((size_t)st.st_size < STORE_HEADER_BYTES) {
+    /* New (or never got past its header) */
+    uint32_t version = STORE_VERSION;
+    memcpy(header + 8, &version, sizeof(version));
+    if (ftruncate(store_fd, 0) != 0 ||
+        pwrite(store_fd, header, sizeof(header), 0) != sizeof(header)) {
+      fprintf(stderr, "HAL TTS: Cannot write cache store %s\n", path);
+      goto fail;
+    }
+    store_bytes = STORE_HEADER_BYTES;
+    return 0;
+  }
+
+  store_map_bytes = (size_t)st.st_size;
+  store_map = (uint8_t *)mmap(NULL, store_map_bytes, PROT_READ, MAP_SHARED,
+                              store_fd, 0);
+  if (store_map == MAP_FAILED) {
+    store_map = NULL;
+    fprintf(stderr, "HAL TTS: Cannot map cache store %s\n", path);
+    goto fail;
+  }
+  uint32_t version;
+  memcpy(&version, store_map + 8, sizeof(version));
+  if (memcmp(store_map, STORE_MAGIC, 8) != 0 || version != STORE_VERSION) {
+    /* Not ours, or an older layout: leave it alone */
+    fprintf(stderr, "HAL TTS: %s is not a version %d cache store\n", path,
+            STORE_VERSION);
+    goto fail;
+  }
+  /* Walking the headers must not read ahead into the audio around them */
+  madvise(store_map, store_map_bytes, MADV_RANDOM);
+
+  store_bytes = index_store();
+  if (store_bytes < store_map_bytes) {
+    fprintf(stderr, "HAL TTS: Cache store %s cut at %zu bytes (torn record)\n",
+            path, store_bytes);
+    if (ftruncate(store_fd, (off_t)store_bytes) != 0) {
+      /* Appending after the torn record would hide it: serve the map only */
+      close(store_fd);
+      store_fd = -1;
+    }
+  }
+  return (int)store_records;
+
+fail:
+  if (store_map != NULL) {
+    munmap(store_map, store_map_bytes);
+    store_map = NULL;
+  }
+  store_map_bytes = 0;
+  if (store_fd >= 0) {
+    close(store_fd);
+    store_fd = -1;
+  }
+  return -1;
+}
+
+/* Write one record at offset; returns its size, or 0 on failure */
+static size_t put_record(int fd, size_t offset, const char *key,
+                         const int16_t *samples, size_t num_samples) {
+  size_t key_bytes = strlen(key);
+  size_t key_pad = pad4(key_bytes);
+  size_t pcm_bytes = num_samples * sizeof(int16_t);
+  size_t size = sizeof(StoreRecord) + key_pad + pad4(pcm_bytes);
+
+  uint8_t *buffer = (uint8_t *)calloc(1, size);
+  if (buffer == NULL) {
+    return 0;
+  }
+  StoreRecord record = {RECORD_MAGIC, (uint32_t)key_bytes,
+                        (uint32_t)num_samples,
+                        record_check(key, key_bytes, samples, num_samples)};
+  memcpy(buffer, &record, sizeof(record));
+  memcpy(buffer + sizeof(record), key, key_bytes);
+  memcpy(buffer + sizeof(record) + key_pad, samples, pcm_bytes);
+
+  ssize_t written = pwrite(fd, buffer, size, (off_t)offset);
+  free(buffer);
+  return written == (ssize_t)size ? size : 0;
+}
+
+static size_t record_size(const CacheEntry *entry, size_t num_samples) {
+  return sizeof(StoreRecord) + pad4(strlen(entry->key)) +
+         pad4(num_samples * sizeof(int16_t));
+}
+
+/* Audio of an entry whose samples point into the store map */
+static int store_mapped(const CacheEntry *entry) {
+  const uint8_t *samples = (const uint8_t *)entry->audio.samples;
+  return entry->mapped && store_map != NULL && samples >= store_map &&
+         samples < store_map + store_map_bytes;
+}
+
+/**
+ * @brief Verify a mapped record's check on its first lookup
+ *
+ * @return 0 if intact; otherwise the entry is dropped and -1 returned
+ */
+static int check_entry(CacheEntry *entry) {
+  StoreRecord record;
+  memcpy(&record, store_map + entry->store_offset, sizeof(record));
+  if (record_check(entry->key, record.key_bytes, entry->audio.samples,
+                   entry->audio.num_samples) == record.check) {
+    entry->unchecked = 0;
+    return 0;
+  }
+  fprintf(stderr, "HAL TTS: Cache store record at %ld damaged, dropped\n",
+          entry->store_offset);
+  entry->audio.samples = NULL;
+  entry->audio.num_samples = 0;
+  entry->audio.loaded = 0;
+  entry->mapped = 0;
+  entry->unchecked = 0;
+  entry->store_offset = -1;
+  store_records--;
+  return -1;
+}
+
+/* Read an entry's samples from the store file */
+static int read_samples(const CacheEntry *entry, int16_t *samples) {
+  size_t bytes = entry->store_samples * sizeof(int16_t);
+  off_t offset = entry->store_offset + (off_t)sizeof(StoreRecord) +
+                 (off_t)pad4(strlen(entry->key));
+  if (store_fd < 0 ||
+      pread(store_fd, samples, bytes, offset) != (ssize_t)bytes) {
+    return -1;
+  }
+  return 0;
+}
+
+/* Compaction order: most looked up first, then most recent */
+static int compare_use(const void *a, const void *b) {
+  const CacheEntry *x = *(CacheEntry *const *)a;
+  const CacheEntry *y = *(CacheEntry *const *)b;
+  if (x->uses != y->uses) {
+    return x->uses < y->uses ? 1 : -1;
+  }
+  if (x->last_used != y->last_used) {
+    return x->last_used < y->last_used ? 1 : -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Rewrite a full store with what this run has used
+ *
+ * Put off while a record is playing from the map, which goes away with the
+ * old file. If the rewrite itself fails the store is left as it was and
+ * marked full.
+ *
+ * @return 0 if records were dropped to make room, -1 if not
+ */
+static int compact_store(void) {
+  size_t limit = (size_t)TTS_CACHE_STORE_MB * 1024 * 1024 / 2;
+  size_t count = 0, kept = 0;
+
+  for (int b = 0; b < CACHE_BUCKETS; b++) {
+    for (CacheEntry *entry = buckets[b]; entry != NULL; entry = entry->next) {
+      if (store_mapped(entry) && entry->users > 0) {
+        return -1;
+      }
+      count += entry->store_offset >= 0;
+    }
+  }
+
+  CacheEntry **keep = (CacheEntry **)malloc((count + 1) * sizeof(*keep));
+  size_t *offsets = (size_t *)malloc((count + 1) * sizeof(*offsets));
+  size_t tmp_size = strlen(store_name) + 8;
+  char *tmp = (char *)malloc(tmp_size);
+  int fd = -1;
+  size_t pos = STORE_HEADER_BYTES;
+  int failed = keep == NULL || offsets == NULL || tmp == NULL;
+
+  if (!failed) {
+    count = 0;
+    for (int b = 0; b < CACHE_BUCKETS; b++) {
+      for (CacheEntry *entry = buckets[b]; entry != NULL;
+           entry = entry->next) {
+        if (entry->store_offset >= 0 && entry->last_used > 0 &&
+            !(entry->unchecked && check_entry(entry) != 0)) {
+          keep[count++] = entry;
+        }
+      }
+    }
+    qsort(keep, count, sizeof(*keep), compare_use);
+
+    uint8_t header[STORE_HEADER_BYTES] = STORE_MAGIC;
+    uint32_t version = STORE_VERSION;
+    memcpy(header + 8, &version, sizeof(version));
+    snprintf(tmp, tmp_size, "%s.tmp", store_name);
+    fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    failed = fd < 0 ||
+             pwrite(fd, header, sizeof(header), 0) != sizeof(header);
+  }
+
+  for (size_t i = 0; i < count && !failed; i++) {
+    CacheEntry *entry = keep[i];
+    if (pos + record_size(entry, entry->store_samples) > limit) {
+      continue; /* A smaller one may still fit */
+    }
+    const int16_t *samples = entry->audio.samples;
+    int16_t *copy = NULL;
+    if (!entry->audio.loaded) {
+      copy = (int16_t *)malloc(entry->store_samples * sizeof(int16_t));
+      if (copy == NULL || read_samples(entry, copy) != 0) {
+        free(copy);
+        continue;
+      }
+      samples = copy;
+    }
+    size_t written =
+        put_record(fd, pos, entry->key, samples, entry->store_samples);
+    free(copy);
+    if (written == 0) {
+      failed = 1;
+      break;
+    }
+    keep[kept] = entry;
+    offsets[kept++] = pos;
+    pos += written;
+  }
+
+  /* Synced before the rename, so a power cut leaves one store or the other */
+  if (failed || fsync(fd) != 0 || rename(tmp, store_name) != 0) {
+    fprintf(stderr, "HAL TTS: Cannot compact cache store, new speech kept "
+                    "in RAM\n");
+    if (fd >= 0) {
+      close(fd);
+      unlink(tmp);
+    }
+    store_full = 1;
+    free(keep);
+    free(offsets);
+    free(tmp);
+    return -1;
+  }
+
+  /* Everything pointing into the old file lets go of it */
+  for (int b = 0; b < CACHE_BUCKETS; b++) {
+    for (CacheEntry *entry = buckets[b]; entry != NULL; entry = entry->next) {
+      if (store_mapped(entry)) {
+        entry->audio.samples = NULL;
+        entry->audio.num_samples = 0;
+        entry->audio.loaded = 0;
+        entry->mapped = 0;
+      }
+      entry->unchecked = 0;
+      entry->store_offset = -1;
+    }
+  }
+  if (store_map != NULL) {
+    munmap(store_map, store_map_bytes);
+  }
+  close(store_fd);
+  store_fd = fd;
+  store_bytes = pos;
+  store_records = kept;
+  store_map_bytes = pos;
+  store_map =
+      (uint8_t *)mmap(NULL, pos, PROT_READ, MAP_SHARED, store_fd, 0);
+  if (store_map == MAP_FAILED) {
+    store_map = NULL; /* Kept records are read back instead */
+    store_map_bytes = 0;
+  }
+
+  for (size_t i = 0; i < kept; i++) {
+    CacheEntry *entry = keep[i];
+    entry->store_offset = (long)offsets[i];
+    if (!entry->audio.loaded && store_map != NULL) {
+      entry->audio.samples =
+          (int16_t *)(store_map + offsets[i] + sizeof(StoreRecord) +
+                      pad4(strlen(entry->key)));
+      entry->audio.num_samples = entry->store_samples;
+      entry->audio.loaded = 1;
+      entry->mapped = 1;
+    }
+  }
+  fprintf(stderr, "HAL TTS: Cache store full, kept %zu of %zu used this run\n",
+          kept, count);
+  store_compactions++;
+  free(keep);
+  free(offsets);
+  free(tmp);
+  return 0;
+}
+
+/* Append an utterance; on success the entry records where it went */
+static void append_record(CacheEntry *entry, const int16_t *samples,
+                          size_t num_samples) {
+  size_t limit = (size_t)TTS_CACHE_STORE_MB * 1024 * 1024;
+  size_t size = record_size(entry, num_samples);
+
+  if (store_fd < 0) {
+    return;
+  }
+  if (store_bytes + size > limit &&
+      (store_full || size > limit / 2 || compact_store() != 0)) {
+    return;
+  }
+
+  size_t written = put_record(store_fd, store_bytes, entry->key, samples,
+                              num_samples);
+  if (written > 0) {
+    entry->store_offset = (long)store_bytes;
+    entry->store_samples = num_samples;
+    store_bytes += written;
+    store_records++;
+  } else if (ftruncate(store_fd, (off_t)store_bytes) != 0) {
+    /* Cannot even undo a partial write: stop appending */
+    close(store_fd);
+    store_fd = -1;
+  }
+}
+
+/* Read an evicted utterance back from the store into the RAM tier */
+static int reload_entry(CacheEntry *entry) {
+  int16_t *samples = reserve_samples(entry->store_samples);
+  if (samples == NULL) {
+    return -1;
+  }
+  if (read_samples(entry, samples) != 0) {
+    free(samples);
+    return -1;
+  }
+  hold_samples(entry, samples, entry->store_samples);
+  return 0;
+}
+
+/* ============================================================================
+ * Phrase Bundle
+ * ============================================================================
+ */
+
+/**
+ * @brief Index the phrases of the mapped bundle
+ *
+ * Stops at the first table entry that points outside the file.
+ *
+ * @return Phrases added
+ */
+static int index_bundle(const BundleHeader *header) {
+  const BundleEntry *table =
+      (const BundleEntry *)(bundle_map + sizeof(BundleHeader));
+  int added = 0;
+
+  for (uint32_t i = 0; i < header->count; i++) {
+    BundleEntry item = table[i];
+    size_t pcm_bytes = (size_t)item.num_samples * sizeof(int16_t);
+    if (item.text_bytes == 0 || item.text_offset > bundle_map_bytes ||
+        item.text_bytes > bundle_map_bytes - item.text_offset ||
+        item.pcm_offset % 4 != 0 || item.pcm_offset > bundle_map_bytes ||
+        pcm_bytes > bundle_map_bytes - item.pcm_offset) {
+      fprintf(stderr, "HAL TTS: Phrase bundle damaged at entry %u\n", i);
+      break;
+    }
+    char *text = strndup((const char *)bundle_map + item.text_offset,
+                         item.text_bytes);
+    char *key = text != NULL
+                    ? make_key(text, header->model, header->length_scale)
+                    : NULL;
+    free(text);
+    if (key == NULL) {
+      continue;
+    }
+    uint64_t hash = hash_key(key);
+    CacheEntry *entry = find_entry(key, hash);
+    if (entry != NULL) {
+      free(key); /* Already cached */
+    } else if ((entry = add_entry(key, hash)) != NULL) {
+      entry->audio.samples = (int16_t *)(bundle_map + item.pcm_offset);
+      entry->audio.num_samples = item.num_samples;
+      entry->audio.loaded = 1;
+      entry->mapped = 1;
+      added++;
+    }
+  }
+  return added;
+}
+
+/* ============================================================================
+ * Public API
+ * ============================================================================
+ */
+
+int hal_tts_cache_init(size_t budget_bytes, const char *store_path) {
+  int found = 0;
+
+  hal_tts_cache_cleanup();
+  pthread_mutex_lock(&cache_lock);
+  cache_budget = budget_bytes;
+  if (store_path != NULL && (store_name = strdup(store_path)) != NULL) {
+    found = open_store(store_path);
+  }
+  cache_ready = 1;
+  pthread_mutex_unlock(&cache_lock);
+  return found;
+}
+
+const CachedAudio *hal_tts_cache_acquire(const char *text, const char *model,
+                                         float length_scale) {
+  if (text == NULL || model == NULL || !cache_ready) {
+    return NULL;
+  }
+  char *key = make_key(text, model, length_scale);
+  if (key == NULL) {
+    return NULL;
+  }
+  uint64_t hash = hash_key(key);
+
+  pthread_mutex_lock(&cache_lock);
+  const CachedAudio *audio = NULL;
+  CacheEntry *entry = find_entry(key, hash);
+  if (entry != NULL && entry->unchecked && check_entry(entry) != 0) {
+    entry = NULL;
+    cache_misses++;
+  } else if (entry != NULL && entry->audio.loaded) {
+    cache_hits++;
+  } else if (entry != NULL && entry->store_offset >= 0 &&
+             reload_entry(entry) == 0) {
+    cache_disk_hits++;
+  } else {
+    entry = NULL;
+    cache_misses++;
+  }
+  if (entry != NULL) {
+    entry->users++;
+    entry->uses++;
+    entry->last_used = ++cache_clock;
+    audio = &entry->audio;
+  }
+  pthread_mutex_unlock(&cache_lock);
+  free(key);
+  return audio;
+}
+
+void hal_tts_cache_release(const CachedAudio *audio) {
+  if (audio == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&cache_lock);
+  ((CacheEntry *)audio)->users--;
+  pthread_mutex_unlock(&cache_lock);
+}
+
+int hal_tts_cache_store(const char *text, const char *model,
+                        float length_scale, const int16_t *samples,
+                        size_t num_samples) {
+  if (text == NULL || model == NULL || samples == NULL || num_samples == 0 ||
+      !cache_ready) {
+    return -1;
+  }
+  char *key = make_key(text, model, length_scale);
+  if (key == NULL) {
+    return -1;
+  }
+  uint64_t hash = hash_key(key);
+
+  pthread_mutex_lock(&cache_lock);
+  CacheEntry *entry = find_entry(key, hash);
+  if (entry == NULL) {
+    entry = add_entry(key, hash);
+  } else {
+    free(key);
+  }
+  int result = -1;
+  if (entry != NULL) {
+    if (!entry->audio.loaded) {
+      int16_t *copy = reserve_samples(num_samples);
+      if (copy != NULL) {
+        memcpy(copy, samples, num_samples * sizeof(int16_t));
+        hold_samples(entry, copy, num_samples);
+      }
+    }
+    entry->last_used = ++cache_clock;
+    if (entry->store_offset < 0) {
+      append_record(entry, samples, num_samples);
+    }
+    result = entry->audio.loaded || entry->store_offset >= 0 ? 0 : -1;
+  }
+  pthread_mutex_unlock(&cache_lock);
+  return result;
+}
+
+int hal_tts_cache_load_bundle(const char *path) {
+  struct stat st;
+  int found = -1;
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+  pthread_mutex_lock(&cache_lock);
+  if (!cache_ready || bundle_map != NULL || fstat(fd, &st) != 0 ||
+      (size_t)st.st_size < sizeof(BundleHeader)) {
+    goto done;
+  }
+
+  bundle_map_bytes = (size_t)st.st_size;
+  bundle_map = (uint8_t *)mmap(NULL, bundle_map_bytes, PROT_READ, MAP_SHARED,
+                               fd, 0);
+  if (bundle_map == MAP_FAILED) {
+    bundle_map = NULL;
+    goto done;
+  }
+  BundleHeader header;
+  memcpy(&header, bundle_map, sizeof(header));
+  header.model[sizeof(header.model) - 1] = '\0';
+  if (memcmp(header.magic, BUNDLE_MAGIC, 8) != 0 ||
+      header.version != BUNDLE_VERSION || header.sample_rate != 16000 ||
+      header.count > (bundle_map_bytes - sizeof(header)) / sizeof(BundleEntry)) {
+    fprintf(stderr, "HAL TTS: %s is not a version %d phrase bundle\n", path,
+            BUNDLE_VERSION);
+    goto done;
+  }
+  madvise(bundle_map, bundle_map_bytes, MADV_WILLNEED);
+
+  found = index_bundle(&header);
+  bundle_phrases = (size_t)found;
+
+done:
+  if (found <= 0 && bundle_map != NULL) {
+    munmap(bundle_map, bundle_map_bytes);
+    bundle_map = NULL;
+    bundle_map_bytes = 0;
+  }
+  pthread_mutex_unlock(&cache_lock);
+  close(fd);
+  return found;
+}
+
+int hal_tts_cache_write_bundle(const char *path, const char *model,
+                               float length_scale, const char *const *texts,
+                               const int16_t *const *samples,
+                               const size_t *num_samples, size_t count) {
+  BundleHeader header;
+  size_t text_start = sizeof(header) + count * sizeof(BundleEntry);
+  size_t text_total = 0;
+  size_t pcm_total = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    text_total += strlen(texts[i]);
+    pcm_total += pad4(num_samples[i] * sizeof(int16_t));
+  }
+  size_t pcm_start = pad4(text_start + text_total);
+  if (pcm_start + pcm_total > UINT32_MAX) {
+    return -1;
+  }
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, BUNDLE_MAGIC, 8);
+  header.version = BUNDLE_VERSION;
+  header.count = (uint32_t)count;
+  header.length_scale = length_scale;
+  header.sample_rate = 16000;
+  snprintf(header.model, sizeof(header.model), "%s", model_name(model));
+
+  uint8_t *buffer = (uint8_t *)calloc(1, pcm_start + pcm_total);
+  if (buffer == NULL) {
+    return -1;
+  }
+  memcpy(buffer, &header, sizeof(header));
+  BundleEntry *table = (BundleEntry *)(buffer + sizeof(header));
+  size_t text_pos = text_start;
+  size_t pcm_pos = pcm_start;
+  for (size_t i = 0; i < count; i++) {
+    size_t text_bytes = strlen(texts[i]);
+    size_t pcm_bytes = num_samples[i] * sizeof(int16_t);
+    table[i].text_offset = (uint32_t)text_pos;
+    table[i].text_bytes = (uint32_t)text_bytes;
+    table[i].pcm_offset = (uint32_t)pcm_pos;
+    table[i].num_samples = (uint32_t)num_samples[i];
+    memcpy(buffer + text_pos, texts[i], text_bytes);
+    memcpy(buffer + pcm_pos, samples[i], pcm_bytes);
+    text_pos += text_bytes;
+    pcm_pos += pad4(pcm_bytes);
+  }
+
+  /* Written aside and renamed, so a running Firmware never maps half */
+  size_t tmp_size = strlen(path) + 8;
+  char *tmp = (char *)malloc(tmp_size);
+  int result = -1;
+  if (tmp != NULL) {
+    snprintf(tmp, tmp_size, "%s.tmp", path);
+    FILE *file = fopen(tmp, "wb");
+    if (file != NULL) {
+      size_t written = fwrite(buffer, 1, pcm_start + pcm_total, file);
+      if (fclose(file) == 0 && written == pcm_start + pcm_total &&
+          rename(tmp, path) == 0) {
+        result = 0;
+      } else {
+        unlink(tmp);
+      }
+    }
+    free(tmp);
+  }
+  free(buffer);
+  return result;
+}
+
+void hal_tts_cache_get_stats(TtsCacheStats *stats) {
+  pthread_mutex_lock(&cache_lock);
+  stats->entries = cache_entries;
+  stats->bytes = cache_bytes;
+  stats->budget = cache_budget;
+  stats->stored = store_records;
+  stats->store_bytes = store_fd >= 0 ? store_bytes : 0;
+  stats->bundled = bundle_phrases;
+  stats->hits = cache_hits;
+  stats->disk_hits = cache_disk_hits;
+  stats->misses = cache_misses;
+  stats->evictions = cache_evictions;
+  stats->compactions = store_compactions;
+  pthread_mutex_unlock(&cache_lock);
+}
+
+void hal_tts_cache_cleanup(void) {
+  pthread_mutex_lock(&cache_lock);
+  for (int b = 0; b < CACHE_BUCKETS; b++) {
+    CacheEntry *entry = buckets[b];
+    while (entry != NULL) {
+      CacheEntry *next = entry->next;
+      if (!entry->mapped) {
+        hal_audio_free_cached(&entry->audio);
+      }
+      free(entry->key);
+      free(entry);
+      entry = next;
+    }
+    buckets[b] = NULL;
+  }
+  if (store_map != NULL) {
+    munmap(store_map, store_map_bytes);
+    store_map = NULL;
+  }
+  store_map_bytes = 0;
+  if (store_fd >= 0) {
+    close(store_fd);
+    store_fd = -1;
+  }
+  free(store_name);
+  store_name = NULL;
+  if (bundle_map != NULL) {
+    munmap(bundle_map, bundle_map_bytes);
+    bundle_map = NULL;
+  }
+  bundle_map_bytes = 0;
+  bundle_phrases = 0;
+  store_bytes = 0;
+  store_records = 0;
+  store_full = 0;
+  cache_ready = 0;
+  cache_bytes = 0;
+  cache_entries = 0;
+  cache_hits = 0;
+  cache_disk_hits = 0;
+  cache_misses = 0;
+  cache_evictions = 0;
+  store_compactions = 0;
+  pthread_mutex_unlock(&cache_lock);
+}
@@ -0,0 +1,128 @@
+#ifndef HAL_TTS_CACHE_H
+#define HAL_TTS_CACHE_H
+
+/**
+ * @file hal_tts_cache.h
+ * @brief Synthesized speech cache in front of the TTS engine
+ *
+ * Most of what HAMPOD says is a small fixed vocabulary ("VFO A",
+ * "Frequency Mode", mode names), so the 16 kHz PCM of every utterance the
+ * engine produces is kept, keyed by the text, voice model and speed. A hit
+ * starts playback with no synthesis at all.
+ *
+ * Two tiers:
+ * - RAM: utterances synthesized this run, up to a byte budget, least
+ *   recently used dropped first (as in the prompt bank)
+ * - Disk: every utterance is also appended to a store file. The file is
+ *   mapped at init, so what earlier runs synthesized is played straight
+ *   from the page cache and costs no heap. Init reads only record headers;
+ *   a record torn by a power cut ends the store and is cut off, and each
+ *   record's checksum is verified on its first lookup. A full store is
+ *   rewritten with the utterances used this run, most used first; the
+ *   rest expire.
+ *
+ * A phrase bundle built by Software2's make phrases (every fixed UI string,
+ * synthesized offline) can be mapped on top, so those phrases hit even on a
+ * first boot.
+ *
+ * Nothing here touches ALSA or the engine, so the cache can be tested
+ * without either.
+ */
+
+#include "hal_audio_bank.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Set up the cache and map the store
+ *
+ * @param budget_bytes Most PCM the RAM tier may hold
+ * @param store_path Store file, created if missing; NULL for RAM only
+ * @return Utterances found in the store, or -1 if it cannot be opened
+ *         (the cache still works, in RAM only)
+ */
+int hal_tts_cache_init(size_t budget_bytes, const char *store_path);
+
+/**
+ * @brief Look up an utterance
+ *
+ * The audio cannot be evicted until released.
+ *
+ * @param text Text as sent to the engine
+ * @param model Voice model path
+ * @param length_scale Speed (compared to two decimal places)
+ * @return The PCM, or NULL on a miss
+ */
+const CachedAudio *hal_tts_cache_acquire(const char *text, const char *model,
+                                         float length_scale);
+
+/**
+ * @brief Release audio returned by hal_tts_cache_acquire()
+ */
+void hal_tts_cache_release(const CachedAudio *audio);
+
+/**
+ * @brief Add a complete utterance
+ *
+ * The samples are copied. Only whole utterances should be stored: an
+ * interrupted one would be replayed cut short.
+ *
+ * @return 0 on success, -1 if it does not fit the RAM budget
+ */
+int hal_tts_cache_store(const char *text, const char *model,
+                        float length_scale, const int16_t *samples,
+                        size_t num_samples);
+
+/**
+ * @brief Map a phrase bundle and add its phrases to the cache
+ *
+ * Phrases only hit while the engine runs the bundle's voice at the speed it
+ * was built for. Call after hal_tts_cache_init(); one bundle at a time.
+ *
+ * @param path Bundle written by hal_tts_cache_write_bundle()
+ * @return Phrases added, or -1 if the file is missing or not a bundle
+ */
+int hal_tts_cache_load_bundle(const char *path);
+
+/**
+ * @brief Write a phrase bundle (used by the make phrases tool)
+ *
+ * @param path Destination, replaced atomically
+ * @param model Voice model the phrases were synthesized with
+ * @param length_scale Speed they were synthesized at
+ * @param texts Phrase texts, exactly as they will be spoken
+ * @param samples 16 kHz mono PCM of each phrase
+ * @param num_samples Length of each phrase
+ * @param count Number of phrases
+ * @return 0 on success, -1 on error
+ */
+int hal_tts_cache_write_bundle(const char *path, const char *model,
+                               float length_scale, const char *const *texts,
+                               const int16_t *const *samples,
+                               const size_t *num_samples, size_t count);
+
+/**
+ * @brief Cache usage, for logging and tests
+ */
+typedef struct {
+  size_t entries;          /* Utterances in RAM */
+  size_t bytes;            /* RAM PCM in use */
+  size_t budget;           /* Budget given to hal_tts_cache_init() */
+  size_t stored;           /* Utterances in the store file */
+  size_t store_bytes;      /* Store file size */
+  size_t bundled;          /* Phrases from the phrase bundle */
+  unsigned long hits;      /* Served from RAM or the mapped store */
+  unsigned long disk_hits; /* Served by reading back the store file */
+  unsigned long misses;
+  unsigned long evictions;
+  unsigned long compactions; /* Full store rewritten to make room */
+} TtsCacheStats;
+
+void hal_tts_cache_get_stats(TtsCacheStats *stats);
+
+/**
+ * @brief Free the RAM tier and unmap the store
+ */
+void hal_tts_cache_cleanup(void);
+
+#endif /* HAL_TTS_CACHE_H */
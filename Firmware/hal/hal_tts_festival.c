@@ -6,6 +6,7 @@
  */
 
 #include "hal_audio.h"
+#include "hal_audio_stats.h"
 #include "hal_tts.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -42,6 +43,7 @@ int hal_tts_speak(const char *text, const char *output_file) {
 
   char command[1024];
   const char *out = output_file ? output_file : "/tmp/hampod_speak.wav";
+  uint64_t requested_us = hal_stats_now_us();
 
   /* Generate speech with text2wave */
   snprintf(command, sizeof(command),
@@ -53,6 +55,9 @@ int hal_tts_speak(const char *text, const char *output_file) {
     return -1;
   }
 
+  /* The whole utterance is ready before any of it plays */
+  hal_stats_record_since(AUDIO_LAT_TTS_FIRST_PCM, requested_us);
+
   /* Play the generated file */
   return hal_audio_play_file(out);
 }
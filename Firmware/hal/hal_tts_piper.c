@@ -7,10 +7,33 @@
  * This makes TTS interruptible and avoids audio device conflicts.
  *
  * Phase 2: Persistent Piper implementation
+ *
+ * Phase 3: Speech cache
+ * - Every complete utterance is kept (hal_tts_cache.c), keyed by text,
+ *   model and speed; repeated phrases play from RAM or the mapped on-disk
+ *   store without a Piper inference
+ * - The phrase bundle from Software2's make phrases seeds it with every
+ *   fixed UI string
+ * - Numbers, frequencies and meter readings are spliced from cached word
+ *   clips (hal_tts_splice.c) instead of synthesized
+ *
+ * Phase 4: Speed by time-stretch
+ * - Piper always runs at PIPER_SPEED; hal_tts_set_speed() sets a WSOLA
+ *   stretch (hal_audio_stretch.c) applied to everything spoken, so a speed
+ *   change never restarts Piper and cached speech serves every speed
+ *
+ * Phase 5: End of utterance from Piper's log
+ * - Piper logs "Real-time factor" on stderr once the last sample of a line
+ *   is on stdout, so the utterance ends as soon as that line is read and
+ *   the pipe drained, rather than after 100 ms without audio
  */
 
 #include "hal_audio.h"
+#include "hal_audio_stretch.h"
+#include "hal_audio_stats.h"
 #include "hal_tts.h"
+#include "hal_tts_cache.h"
+#include "hal_tts_splice.h"
 #include <errno.h>
 #include <fcntl.h>
 #include <signal.h>
@@ -26,7 +49,7 @@
 #define PIPER_MODEL_PATH "models/en_US-lessac-low.onnx"
 #endif
 
-/* Default speed - can be overridden by hal_tts_set_speed() */
+/* Speed Piper runs at; hal_tts_set_speed() stretches its output instead */
 #ifndef PIPER_SPEED
 #define PIPER_SPEED "1.0"
 #endif
@@ -35,34 +58,76 @@
 #define TTS_CHUNK_SAMPLES 800
 #define TTS_CHUNK_BYTES (TTS_CHUNK_SAMPLES * 2)
 
-/* Timeout for end-of-utterance detection (microseconds) */
-#define TTS_READ_TIMEOUT_US 100000 /* 100ms */
+/* Piper's log line after the last sample of each line of text */
+#define PIPER_END_MARKER "Real-time factor"
+
+/* How often a wait for Piper checks for an interrupt, and how long Piper
+ * may write nothing before it is taken to be hung and restarted */
+#define TTS_POLL_MS 20
+#define TTS_STALL_TIMEOUT_MS 10000
+
+/* Speech cache: RAM for this run's utterances, and the store file that
+ * keeps them across restarts */
+#ifndef TTS_CACHE_BUDGET_KB
+#define TTS_CACHE_BUDGET_KB 4096
+#endif
+#ifndef TTS_CACHE_PATH
+#define TTS_CACHE_PATH "tts_cache.bin"
+#endif
+#ifndef TTS_BUNDLE_PATH
+#define TTS_BUNDLE_PATH "phrases.bin" /* Software2: make phrases */
+#endif
+#define TTS_CACHE_MAX_SAMPLES (16000 * 10) /* Longer speech is not kept */
 
 /* Persistent Piper process state */
 static int initialized = 0;
 static volatile int tts_interrupted = 0;
 
-/* Runtime speech speed (can be changed via hal_tts_set_speed) */
+/* Piper's --length_scale, fixed for the life of the process */
 static char piper_speed[16] = PIPER_SPEED;
 
+/* Requested speed / PIPER_SPEED in hundredths, set from the IO thread and
+ * read once per utterance */
+static volatile int stretch_percent = 100;
+
+/* Only the speaking thread uses these */
+static AudioStretch stretch;
+static int16_t stretch_out[STRETCH_OUTPUT_MAX(TTS_CHUNK_SAMPLES)];
+
 /* Persistent Piper pipes and process ID */
 static FILE *piper_stdin = NULL; /* Write text to Piper here */
 static int piper_stdout_fd = -1; /* Read raw PCM from Piper here */
 static pid_t piper_pid = -1;     /* Piper process ID for cleanup */
+static int piper_stderr_fd = -1; /* Piper's log, non-blocking */
+
+/* Log text after the last complete line */
+static char piper_log[512];
+static size_t piper_log_len = 0;
+
+/* Lines sent to Piper whose end marker has not been read (an interrupted
+ * utterance whose audio is still coming) */
+static int piper_unfinished = 0;
+
+/* What piper_wait() found ready */
+#define PIPER_AUDIO 1
+#define PIPER_LOG 2
 
 /**
  * @brief Start the persistent Piper subprocess
  *
- * Forks and execs Piper with stdin for text and stdout for raw PCM audio.
+ * Forks and execs Piper with stdin for text, stdout for raw PCM audio and
+ * stderr for its log, which marks the end of each utterance.
  *
  * @return 0 on success, -1 on failure
  */
 static int start_persistent_piper(void) {
   int stdin_pipe[2];  /* Parent writes, child reads */
   int stdout_pipe[2]; /* Child writes, parent reads */
+  int stderr_pipe[2]; /* Child logs, parent reads */
 
   /* Create pipes */
-  if (pipe(stdin_pipe) != 0 || pipe(stdout_pipe) != 0) {
+  if (pipe(stdin_pipe) != 0 || pipe(stdout_pipe) != 0 ||
+      pipe(stderr_pipe) != 0) {
     perror("HAL TTS: pipe() failed");
     return -1;
   }
@@ -76,6 +141,8 @@ static int start_persistent_piper(void) {
     close(stdin_pipe[1]);
     close(stdout_pipe[0]);
     close(stdout_pipe[1]);
+    close(stderr_pipe[0]);
+    close(stderr_pipe[1]);
     return -1;
   }
 
@@ -91,7 +158,8 @@ static int start_persistent_piper(void) {
       max_fd = 1024; /* Fallback */
     for (int fd = 3; fd < max_fd; fd++) {
       /* Skip the pipe fds we need */
-      if (fd != stdin_pipe[0] && fd != stdout_pipe[1]) {
+      if (fd != stdin_pipe[0] && fd != stdout_pipe[1] &&
+          fd != stderr_pipe[1]) {
         close(fd);
       }
     }
@@ -106,12 +174,10 @@ static int start_persistent_piper(void) {
     close(stdout_pipe[0]); /* Close read end in child */
     close(stdout_pipe[1]);
 
-    /* Redirect stderr to /dev/null to suppress Piper's status messages */
-    int devnull = open("/dev/null", O_WRONLY);
-    if (devnull >= 0) {
-      dup2(devnull, STDERR_FILENO);
-      close(devnull);
-    }
+    /* Redirect stderr to the log pipe: its end-of-utterance lines */
+    dup2(stderr_pipe[1], STDERR_FILENO);
+    close(stderr_pipe[0]);
+    close(stderr_pipe[1]);
 
     /* Execute Piper with persistent read from stdin */
     execlp("piper", "piper", "--model", PIPER_MODEL_PATH, "--length_scale",
@@ -126,6 +192,7 @@ static int start_persistent_piper(void) {
   /* Close unused ends */
   close(stdin_pipe[0]);  /* Close read end of stdin pipe */
   close(stdout_pipe[1]); /* Close write end of stdout pipe */
+  close(stderr_pipe[1]); /* Close write end of stderr pipe */
 
   /* Wrap stdin pipe in FILE* for fprintf/fflush */
   piper_stdin = fdopen(stdin_pipe[1], "w");
@@ -133,6 +200,7 @@ static int start_persistent_piper(void) {
     perror("HAL TTS: fdopen() failed");
     close(stdin_pipe[1]);
     close(stdout_pipe[0]);
+    close(stderr_pipe[0]);
     kill(piper_pid, SIGTERM);
     waitpid(piper_pid, NULL, 0);
     piper_pid = -1;
@@ -142,9 +210,15 @@ static int start_persistent_piper(void) {
   /* Set line buffering for stdin to ensure text is sent immediately */
   setvbuf(piper_stdin, NULL, _IOLBF, 0);
 
-  /* Store stdout file descriptor (we use raw fd for select() timeout) */
+  /* Store stdout file descriptor (we use the raw fd with select()) */
   piper_stdout_fd = stdout_pipe[0];
 
+  /* The log is read only when select() says so, a line at a time */
+  piper_stderr_fd = stderr_pipe[0];
+  fcntl(piper_stderr_fd, F_SETFL, fcntl(piper_stderr_fd, F_GETFL) | O_NONBLOCK);
+  piper_log_len = 0;
+  piper_unfinished = 0;
+
   printf("HAL TTS: Started persistent Piper process (pid=%d)\n", piper_pid);
   return 0;
 }
@@ -163,6 +237,11 @@ static void stop_persistent_piper(void) {
     piper_stdout_fd = -1;
   }
 
+  if (piper_stderr_fd >= 0) {
+    close(piper_stderr_fd);
+    piper_stderr_fd = -1;
+  }
+
   if (piper_pid > 0) {
     /* Send SIGTERM and wait */
     kill(piper_pid, SIGTERM);
@@ -174,6 +253,200 @@ static void stop_persistent_piper(void) {
   }
 }
 
+/**
+ * @brief Read Piper's log, counting the utterances it has finished
+ *
+ * Piper logs PIPER_END_MARKER after the thread writing a line's audio has
+ * written its last sample, so by the time the marker can be read all of
+ * that utterance is in the stdout pipe. Errors and warnings are passed on.
+ *
+ * @return End markers read, or -1 if Piper closed its log
+ */
+static int read_piper_log(void) {
+  int finished = 0;
+
+  for (;;) {
+    ssize_t got = read(piper_stderr_fd, piper_log + piper_log_len,
+                       sizeof(piper_log) - 1 - piper_log_len);
+    if (got < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return finished;
+      }
+      return -1;
+    }
+    if (got == 0) {
+      return -1;
+    }
+    piper_log_len += (size_t)got;
+    piper_log[piper_log_len] = '\0';
+
+    char *line = piper_log;
+    char *newline;
+    while ((newline = strchr(line, '\n')) != NULL) {
+      *newline = '\0';
+      if (strstr(line, PIPER_END_MARKER) != NULL) {
+        finished++;
+      } else if (strstr(line, "[error]") != NULL ||
+                 strstr(line, "[warning]") != NULL) {
+        fprintf(stderr, "HAL TTS: Piper: %s\n", line);
+      }
+      line = newline + 1;
+    }
+    size_t rest = piper_log_len - (size_t)(line - piper_log);
+    if (rest == sizeof(piper_log) - 1) {
+      rest = 0; /* No newline in a full buffer: drop the line */
+    }
+    memmove(piper_log, line, rest);
+    piper_log_len = rest;
+  }
+}
+
+/**
+ * @brief Wait for Piper to write audio or log a line
+ *
+ * Checks for an interrupt every TTS_POLL_MS.
+ *
+ * @return PIPER_AUDIO and/or PIPER_LOG, 0 if interrupted, -1 if select()
+ *         failed or Piper wrote nothing for TTS_STALL_TIMEOUT_MS
+ */
+static int piper_wait(void) {
+  int waited_ms = 0;
+
+  while (!tts_interrupted) {
+    fd_set read_fds;
+    struct timeval timeout;
+
+    FD_ZERO(&read_fds);
+    FD_SET(piper_stdout_fd, &read_fds);
+    FD_SET(piper_stderr_fd, &read_fds);
+    timeout.tv_sec = 0;
+    timeout.tv_usec = TTS_POLL_MS * 1000;
+
+    int max_fd = piper_stdout_fd > piper_stderr_fd ? piper_stdout_fd
+                                                   : piper_stderr_fd;
+    int result = select(max_fd + 1, &read_fds, NULL, NULL, &timeout);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue; /* Interrupted by signal, retry */
+      }
+      perror("HAL TTS: select() error");
+      return -1;
+    }
+    if (result == 0) {
+      waited_ms += TTS_POLL_MS;
+      if (waited_ms >= TTS_STALL_TIMEOUT_MS) {
+        fprintf(stderr, "HAL TTS: Piper wrote nothing for %d ms\n",
+                TTS_STALL_TIMEOUT_MS);
+        return -1;
+      }
+      continue;
+    }
+    return (FD_ISSET(piper_stdout_fd, &read_fds) ? PIPER_AUDIO : 0) |
+           (FD_ISSET(piper_stderr_fd, &read_fds) ? PIPER_LOG : 0);
+  }
+  return 0;
+}
+
+/* Whether Piper's stdout can be read without blocking */
+static int audio_pending(void) {
+  fd_set read_fds;
+  struct timeval timeout = {0, 0};
+
+  FD_ZERO(&read_fds);
+  FD_SET(piper_stdout_fd, &read_fds);
+  return select(piper_stdout_fd + 1, &read_fds, NULL, NULL, &timeout) > 0;
+}
+
+/**
+ * @brief Drop audio left from interrupted utterances
+ *
+ * Piper speaks one line at a time, so the next utterance cannot start
+ * before an interrupted one ends anyway. Waiting for its end marker and
+ * draining the pipe means no stale audio is mistaken for the new text.
+ *
+ * @return 0 when the pipe is clear, -1 on interrupt or if Piper failed
+ */
+static int discard_unfinished(void) {
+  char scrap[TTS_CHUNK_BYTES];
+
+  while (piper_unfinished > 0) {
+    int ready = piper_wait();
+    if (ready <= 0) {
+      return -1;
+    }
+    if (ready & PIPER_LOG) {
+      int finished = read_piper_log();
+      if (finished < 0) {
+        return -1;
+      }
+      piper_unfinished -= finished;
+    }
+    if ((ready & PIPER_AUDIO) &&
+        read(piper_stdout_fd, scrap, sizeof(scrap)) == 0) {
+      return -1;
+    }
+  }
+  piper_unfinished = 0;
+  while (audio_pending()) {
+    ssize_t got = read(piper_stdout_fd, scrap, sizeof(scrap));
+    if (got == 0 || (got < 0 && errno != EINTR)) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Time-stretch speech to the requested speed and queue it
+ *
+ * @return 0 on success, -1 if the audio HAL refused it
+ */
+static int write_speech(const int16_t *samples, size_t count) {
+  for (size_t pos = 0; pos < count; pos += TTS_CHUNK_SAMPLES) {
+    size_t piece = count - pos;
+    if (piece > TTS_CHUNK_SAMPLES) {
+      piece = TTS_CHUNK_SAMPLES;
+    }
+    size_t out = hal_stretch_process(&stretch, samples + pos, piece,
+                                     stretch_out);
+    if (out > 0 && hal_audio_write_raw(stretch_out, out) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/* Queue what the stretch still holds at the end of an utterance */
+static void finish_speech(void) {
+  size_t out = hal_stretch_flush(&stretch, stretch_out);
+  if (out > 0 && hal_audio_write_raw(stretch_out, out) != 0) {
+    fprintf(stderr, "HAL TTS: Audio write failed\n");
+  }
+}
+
+/**
+ * @brief Play a cached utterance in chunks, stopping on interrupt
+ */
+static void play_cached(const CachedAudio *audio) {
+  for (size_t pos = 0; pos < audio->num_samples && !tts_interrupted;
+       pos += TTS_CHUNK_SAMPLES) {
+    size_t count = audio->num_samples - pos;
+    if (count > TTS_CHUNK_SAMPLES) {
+      count = TTS_CHUNK_SAMPLES;
+    }
+    if (write_speech(audio->samples + pos, count) != 0) {
+      fprintf(stderr, "HAL TTS: Audio write failed\n");
+      return;
+    }
+  }
+  if (!tts_interrupted) {
+    finish_speech();
+  }
+}
+
 /**
  * @brief Check if persistent Piper is running
  */
@@ -237,6 +510,16 @@ int hal_tts_init(void) {
     return -1;
   }
 
+  int cached = hal_tts_cache_init((size_t)TTS_CACHE_BUDGET_KB * 1024,
+                                  TTS_CACHE_PATH);
+  if (cached > 0) {
+    printf("HAL TTS: %d utterances in the speech cache\n", cached);
+  }
+  int bundled = hal_tts_cache_load_bundle(TTS_BUNDLE_PATH);
+  if (bundled > 0) {
+    printf("HAL TTS: %d phrases in %s\n", bundled, TTS_BUNDLE_PATH);
+  }
+
   printf("HAL TTS: Piper initialized (model=%s, speed=%s, persistent=yes)\n",
          PIPER_MODEL_PATH, PIPER_SPEED);
   initialized = 1;
@@ -249,6 +532,10 @@ int hal_tts_speak(const char *text, const char *output_file) {
   int16_t chunk_buffer[TTS_CHUNK_SAMPLES];
   ssize_t bytes_read;
   int received_any_audio = 0;
+  uint64_t requested_us = hal_stats_now_us();
+  int16_t *utterance = NULL; /* Everything Piper says, for the cache */
+  size_t utterance_samples = 0;
+  int complete = 1;
 
   if (!initialized) {
     if (hal_tts_init() != 0) {
@@ -256,6 +543,43 @@ int hal_tts_speak(const char *text, const char *output_file) {
     }
   }
 
+  hal_stretch_init(&stretch, stretch_percent / 100.0f);
+
+  /* Said before: no Piper round trip. Cached at Piper's own speed */
+  float speed = (float)atof(piper_speed);
+  const CachedAudio *cached =
+      hal_tts_cache_acquire(text, PIPER_MODEL_PATH, speed);
+  if (cached != NULL) {
+    if (!hal_audio_pipeline_ready()) {
+      hal_tts_cache_release(cached);
+      fprintf(stderr, "HAL TTS: Audio pipeline not ready\n");
+      return -1;
+    }
+    tts_interrupted = 0;
+    hal_stats_record_since(AUDIO_LAT_TTS_FIRST_PCM, requested_us);
+    play_cached(cached);
+    hal_tts_cache_release(cached);
+    return 0;
+  }
+
+  /* Numbers and frequencies: join word clips */
+  size_t spliced_samples = 0;
+  int16_t *spliced =
+      hal_tts_splice(text, PIPER_MODEL_PATH, speed, &spliced_samples);
+  if (spliced != NULL) {
+    if (!hal_audio_pipeline_ready()) {
+      free(spliced);
+      fprintf(stderr, "HAL TTS: Audio pipeline not ready\n");
+      return -1;
+    }
+    CachedAudio audio = {spliced, spliced_samples, 1};
+    tts_interrupted = 0;
+    hal_stats_record_since(AUDIO_LAT_TTS_FIRST_PCM, requested_us);
+    play_cached(&audio);
+    free(spliced);
+    return 0;
+  }
+
   /* Ensure Piper is still running, restart if needed */
   if (!is_piper_running()) {
     printf("HAL TTS: Piper process died, restarting...\n");
@@ -279,44 +603,57 @@ int hal_tts_speak(const char *text, const char *output_file) {
    */
   tts_interrupted = 0;
 
+  /* Let the last interrupted utterance finish and drop its audio */
+  if (discard_unfinished() != 0) {
+    if (!tts_interrupted) {
+      fprintf(stderr, "HAL TTS: Piper not responding, restarting it\n");
+      stop_persistent_piper();
+    }
+    return tts_interrupted ? 0 : -1;
+  }
+
   /* Send text to Piper via stdin (with newline to trigger processing) */
   if (fprintf(piper_stdin, "%s\n", text) < 0 || fflush(piper_stdin) != 0) {
     fprintf(stderr, "HAL TTS: Failed to write to Piper stdin\n");
     return -1;
   }
+  piper_unfinished = 1;
 
-  /* Stream Piper output through audio HAL in chunks.
-   * Use select() with timeout to detect end of utterance. */
+  /* Stream Piper output through audio HAL in chunks until Piper logs the
+   * end of the utterance and the pipe is empty */
   while (!tts_interrupted) {
-    fd_set read_fds;
-    struct timeval timeout;
-
-    FD_ZERO(&read_fds);
-    FD_SET(piper_stdout_fd, &read_fds);
-
-    /* Timeout: 100ms - if no data within this period after receiving some
-     * audio, we assume the utterance is complete */
-    timeout.tv_sec = 0;
-    timeout.tv_usec = TTS_READ_TIMEOUT_US;
-
-    int select_result =
-        select(piper_stdout_fd + 1, &read_fds, NULL, NULL, &timeout);
-
-    if (select_result < 0) {
-      if (errno == EINTR) {
-        continue; /* Interrupted by signal, retry */
+    int ready;
+    if (piper_unfinished == 0) {
+      /* Everything Piper said is in the pipe already */
+      if (!audio_pending()) {
+        break;
+      }
+      ready = PIPER_AUDIO;
+    } else {
+      ready = piper_wait();
+      if (ready < 0) {
+        fprintf(stderr, "HAL TTS: Piper not responding, restarting it\n");
+        stop_persistent_piper();
+        complete = 0;
+        break;
+      }
+      if (ready == 0) {
+        break; /* Interrupted */
       }
-      perror("HAL TTS: select() error");
-      break;
     }
 
-    if (select_result == 0) {
-      /* Timeout - no data available */
-      if (received_any_audio) {
-        /* We've received audio and now timed out - utterance complete */
+    if (ready & PIPER_LOG) {
+      int finished = read_piper_log();
+      if (finished < 0) {
+        fprintf(stderr, "HAL TTS: Piper closed its log (may have crashed)\n");
+        complete = 0;
         break;
       }
-      /* Still waiting for first audio data, continue waiting */
+      if (finished > 0) {
+        piper_unfinished = 0;
+      }
+    }
+    if (!(ready & PIPER_AUDIO)) {
       continue;
     }
 
@@ -330,21 +667,44 @@ int hal_tts_speak(const char *text, const char *output_file) {
       /* EOF or error - this shouldn't happen with persistent Piper */
       fprintf(stderr, "HAL TTS: Read returned %zd (Piper may have crashed)\n",
               bytes_read);
+      complete = 0;
       break;
     }
 
+    if (!received_any_audio) {
+      hal_stats_record_since(AUDIO_LAT_TTS_FIRST_PCM, requested_us);
+      utterance = (int16_t *)malloc(TTS_CACHE_MAX_SAMPLES * sizeof(int16_t));
+    }
     received_any_audio = 1;
 
+    size_t samples_read = (size_t)bytes_read / 2;
+    if (utterance != NULL &&
+        utterance_samples + samples_read <= TTS_CACHE_MAX_SAMPLES) {
+      memcpy(utterance + utterance_samples, chunk_buffer,
+             samples_read * sizeof(int16_t));
+      utterance_samples += samples_read;
+    } else {
+      complete = 0; /* Too long to keep */
+    }
+
     /* Write chunk to audio HAL */
-    if (hal_audio_write_raw(chunk_buffer, bytes_read / 2) != 0) {
+    if (write_speech(chunk_buffer, samples_read) != 0) {
       fprintf(stderr, "HAL TTS: Audio write failed\n");
+      complete = 0;
       break;
     }
   }
 
   if (tts_interrupted) {
     printf("HAL TTS: Speech interrupted\n");
+  } else if (received_any_audio) {
+    finish_speech();
   }
+  if (!tts_interrupted && complete && utterance_samples > 0) {
+    hal_tts_cache_store(text, PIPER_MODEL_PATH, speed, utterance,
+                        utterance_samples);
+  }
+  free(utterance);
 
   return 0;
 }
@@ -355,25 +715,13 @@ void hal_tts_interrupt(void) {
   hal_audio_interrupt();
   printf("HAL TTS: Interrupt requested\n");
 
-  /* Drain any buffered audio from Piper's stdout pipe.
-   * This prevents old audio from playing on the next TTS request.
-   * Limit iterations to prevent hangs during rapid interrupts. */
-  if (piper_stdout_fd >= 0) {
-    char drain_buf[4096];
-    int flags = fcntl(piper_stdout_fd, F_GETFL, 0);
-    fcntl(piper_stdout_fd, F_SETFL, flags | O_NONBLOCK);
-    int drain_count = 0;
-    while (read(piper_stdout_fd, drain_buf, sizeof(drain_buf)) > 0 &&
-           drain_count < 20) {
-      drain_count++;
-      /* Discard the data */
-    }
-    fcntl(piper_stdout_fd, F_SETFL, flags); /* Restore blocking mode */
-  }
+  /* Piper's audio for the interrupted text is dropped by the next
+   * hal_tts_speak(), which knows from the log where that audio ends */
 }
 
 void hal_tts_cleanup(void) {
   stop_persistent_piper();
+  hal_tts_cache_cleanup();
   initialized = 0;
   printf("HAL TTS: Piper cleaned up\n");
 }
@@ -389,19 +737,16 @@ int hal_tts_set_speed(float speed) {
   if (speed > 3.0f)
     speed = 3.0f;
 
-  /* Format speed as string */
-  snprintf(piper_speed, sizeof(piper_speed), "%.2f", speed);
-  printf("HAL TTS: Setting speech speed to %s\n", piper_speed);
-
-  /* If Piper is already running, restart it with new speed */
-  if (initialized && piper_pid > 0) {
-    printf("HAL TTS: Restarting Piper with new speed\n");
-    stop_persistent_piper();
-    if (start_persistent_piper() != 0) {
-      fprintf(stderr, "HAL TTS: Failed to restart Piper with new speed\n");
-      return -1;
-    }
+  /* Piper keeps running at its own speed; the next utterance is stretched */
+  float factor = speed / (float)atof(piper_speed);
+  if (factor < STRETCH_MIN_FACTOR) {
+    factor = STRETCH_MIN_FACTOR;
   }
-
+  if (factor > STRETCH_MAX_FACTOR) {
+    factor = STRETCH_MAX_FACTOR;
+  }
+  stretch_percent = (int)(factor * 100.0f + 0.5f);
+  printf("HAL TTS: Setting speech speed to %.2f (stretch %.2fx)\n", speed,
+         stretch_percent / 100.0f);
   return 0;
 }
@@ -0,0 +1,285 @@
+/**
+ * @file hal_tts_splice.c
+ * @brief Number and frequency splicer (see hal_tts_splice.h)
+ *
+ * Each clip is a whole Piper utterance, so it carries a silent lead-in and
+ * tail. Those are cut to SPLICE_PAD_SAMPLES either side of the first and
+ * last sample above SPLICE_SILENCE_LEVEL, and neighbouring clips overlap by
+ * SPLICE_FADE_SAMPLES under a linear crossfade so the joins do not click.
+ */
+
+#include "hal_tts_splice.h"
+#include "hal_tts_cache.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define SPLICE_SILENCE_LEVEL 300 /* |sample| below this counts as silence */
+#define SPLICE_PAD_SAMPLES 160   /* 10 ms kept around each word */
+#define SPLICE_FADE_SAMPLES 80   /* 5 ms crossfade */
+
+static const char *const ones[] = {
+    "zero",    "one",     "two",       "three",    "four",
+    "five",    "six",     "seven",     "eight",    "nine",
+    "ten",     "eleven",  "twelve",    "thirteen", "fourteen",
+    "fifteen", "sixteen", "seventeen", "eighteen", "nineteen"};
+
+static const char *const tens[] = {"",      "",      "twenty",  "thirty",
+                                   "forty", "fifty", "sixty",   "seventy",
+                                   "eighty", "ninety"};
+
+/* Words spoken as they are written (matched without case) */
+static const char *const units[] = {"point",     "plus",  "minus",
+                                    "megahertz", "kilohertz", "hertz",
+                                    "watts"};
+
+static const char *const vocabulary[] = {
+    "zero",     "one",      "two",       "three",     "four",    "five",
+    "six",      "seven",    "eight",     "nine",      "ten",     "eleven",
+    "twelve",   "thirteen", "fourteen",  "fifteen",   "sixteen", "seventeen",
+    "eighteen", "nineteen", "twenty",    "thirty",    "forty",   "fifty",
+    "sixty",    "seventy",  "eighty",    "ninety",    "hundred", "thousand",
+    "point",    "plus",     "minus",     "megahertz", "kilohertz",
+    "hertz",    "watts",    "D B",       "S"};
+
+#define SPLICE_DB "D B"
+#define SPLICE_S "S"
+
+/* ============================================================================
+ * Formatter
+ * ============================================================================
+ */
+
+static int push(const char **words, int *count, int max_words,
+                const char *word) {
+  if (*count >= max_words) {
+    return -1;
+  }
+  words[(*count)++] = word;
+  return 0;
+}
+
+/* Words for 0-999999, e.g. 1296 -> one thousand two hundred ninety six */
+static int push_number(const char **words, int *count, int max_words,
+                       long value) {
+  if (value >= 1000) {
+    if (push_number(words, count, max_words, value / 1000) != 0 ||
+        push(words, count, max_words, "thousand") != 0) {
+      return -1;
+    }
+    value %= 1000;
+    if (value == 0) {
+      return 0;
+    }
+  }
+  if (value >= 100) {
+    if (push(words, count, max_words, ones[value / 100]) != 0 ||
+        push(words, count, max_words, "hundred") != 0) {
+      return -1;
+    }
+    value %= 100;
+    if (value == 0) {
+      return 0;
+    }
+  }
+  if (value >= 20) {
+    if (push(words, count, max_words, tens[value / 10]) != 0) {
+      return -1;
+    }
+    value %= 10;
+    if (value == 0) {
+      return 0;
+    }
+  }
+  return push(words, count, max_words, ones[value]);
+}
+
+/* "-12.5" -> minus twelve point five; -1 if token is not a number */
+static int push_numeric(const char **words, int *count, int max_words,
+                        const char *token) {
+  const char *p = token;
+  if (*p == '-') {
+    if (push(words, count, max_words, "minus") != 0) {
+      return -1;
+    }
+    p++;
+  }
+  size_t whole = strspn(p, "0123456789");
+  if (whole == 0 || whole > 6) {
+    return -1;
+  }
+  const char *fraction = p + whole;
+  if (*fraction == '.') {
+    fraction++;
+    size_t digits = strspn(fraction, "0123456789");
+    if (digits == 0 || fraction[digits] != '\0') {
+      return -1;
+    }
+  } else if (*fraction != '\0') {
+    return -1;
+  } else {
+    fraction = NULL;
+  }
+
+  if (push_number(words, count, max_words, strtol(p, NULL, 10)) != 0) {
+    return -1;
+  }
+  if (fraction != NULL) {
+    if (push(words, count, max_words, "point") != 0) {
+      return -1;
+    }
+    for (; *fraction != '\0'; fraction++) {
+      if (push(words, count, max_words, ones[*fraction - '0']) != 0) {
+        return -1;
+      }
+    }
+  }
+  return 0;
+}
+
+int hal_tts_splice_words(const char *text, const char **words,
+                         int max_words) {
+  char copy[256];
+  char *save = NULL;
+  int count = 0;
+
+  if (text == NULL || strlen(text) >= sizeof(copy)) {
+    return -1;
+  }
+  strcpy(copy, text);
+
+  char *token = strtok_r(copy, " \t\r\n", &save);
+  while (token != NULL) {
+    char *next = strtok_r(NULL, " \t\r\n", &save);
+    int matched = 0;
+
+    for (size_t i = 0; i < sizeof(units) / sizeof(units[0]); i++) {
+      if (strcasecmp(token, units[i]) == 0) {
+        if (push(words, &count, max_words, units[i]) != 0) {
+          return -1;
+        }
+        matched = 1;
+        break;
+      }
+    }
+    if (matched) {
+      token = next;
+      continue;
+    }
+
+    if (strcasecmp(token, "dB") == 0) {
+      if (push(words, &count, max_words, SPLICE_DB) != 0) {
+        return -1;
+      }
+    } else if (strcmp(token, "D") == 0 && next != NULL &&
+               strcmp(next, "B") == 0) {
+      /* "Attenuation 6 D B" spells it out already */
+      if (push(words, &count, max_words, SPLICE_DB) != 0) {
+        return -1;
+      }
+      next = strtok_r(NULL, " \t\r\n", &save);
+    } else if (toupper((unsigned char)token[0]) == 'S' &&
+               isdigit((unsigned char)token[1]) && token[2] == '\0') {
+      /* S-meter: S9 -> S nine */
+      if (push(words, &count, max_words, SPLICE_S) != 0 ||
+          push(words, &count, max_words, ones[token[1] - '0']) != 0) {
+        return -1;
+      }
+    } else if (push_numeric(words, &count, max_words, token) != 0) {
+      return -1;
+    }
+    token = next;
+  }
+  return count > 0 ? count : -1;
+}
+
+/* ============================================================================
+ * Splicer
+ * ============================================================================
+ */
+
+/* Sample range of a clip without its silent lead-in and tail */
+static void trim(const CachedAudio *clip, size_t *start, size_t *end) {
+  size_t first = 0;
+  size_t last = clip->num_samples;
+
+  while (first < last && abs(clip->samples[first]) < SPLICE_SILENCE_LEVEL) {
+    first++;
+  }
+  while (last > first && abs(clip->samples[last - 1]) < SPLICE_SILENCE_LEVEL) {
+    last--;
+  }
+  if (first == last) {
+    /* All silence: keep it whole rather than lose the word's timing */
+    *start = 0;
+    *end = clip->num_samples;
+    return;
+  }
+  *start = first > SPLICE_PAD_SAMPLES ? first - SPLICE_PAD_SAMPLES : 0;
+  *end = last + SPLICE_PAD_SAMPLES < clip->num_samples
+             ? last + SPLICE_PAD_SAMPLES
+             : clip->num_samples;
+}
+
+int16_t *hal_tts_splice(const char *text, const char *model,
+                        float length_scale, size_t *num_samples) {
+  const char *words[SPLICE_MAX_WORDS];
+  const CachedAudio *clips[SPLICE_MAX_WORDS];
+  size_t starts[SPLICE_MAX_WORDS], ends[SPLICE_MAX_WORDS];
+  int16_t *out = NULL;
+  size_t total = 0;
+  int held = 0;
+
+  int count = hal_tts_splice_words(text, words, SPLICE_MAX_WORDS);
+  if (count < 0) {
+    return NULL;
+  }
+  for (; held < count; held++) {
+    clips[held] = hal_tts_cache_acquire(words[held], model, length_scale);
+    if (clips[held] == NULL) {
+      goto done; /* No clip for this word yet: the engine says it all */
+    }
+    trim(clips[held], &starts[held], &ends[held]);
+    total += ends[held] - starts[held];
+  }
+
+  out = (int16_t *)malloc(total * sizeof(int16_t));
+  if (out == NULL) {
+    goto done;
+  }
+  size_t length = 0;
+  for (int i = 0; i < count; i++) {
+    const int16_t *clip = clips[i]->samples + starts[i];
+    size_t clip_length = ends[i] - starts[i];
+    size_t fade = SPLICE_FADE_SAMPLES;
+    if (fade > length) {
+      fade = length;
+    }
+    if (fade > clip_length) {
+      fade = clip_length;
+    }
+    /* Overlap the previous word's tail with this word's lead-in */
+    int16_t *overlap = out + length - fade;
+    for (size_t j = 0; j < fade; j++) {
+      int32_t mixed = ((int32_t)overlap[j] * (int32_t)(fade - j) +
+                       (int32_t)clip[j] * (int32_t)j) /
+                      (int32_t)fade;
+      overlap[j] = (int16_t)mixed;
+    }
+    memcpy(out + length, clip + fade, (clip_length - fade) * sizeof(int16_t));
+    length += clip_length - fade;
+  }
+  *num_samples = length;
+
+done:
+  while (held > 0) {
+    hal_tts_cache_release(clips[--held]);
+  }
+  return out;
+}
+
+const char *const *hal_tts_splice_vocabulary(size_t *count) {
+  *count = sizeof(vocabulary) / sizeof(vocabulary[0]);
+  return vocabulary;
+}
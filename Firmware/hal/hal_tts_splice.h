@@ -0,0 +1,59 @@
+#ifndef HAL_TTS_SPLICE_H
+#define HAL_TTS_SPLICE_H
+
+/**
+ * @file hal_tts_splice.h
+ * @brief Numbers and frequencies spoken from pre-rendered word clips
+ *
+ * Frequency readouts ("14 point 2 5 0 0 0 megahertz"), typed digits,
+ * S-meter and power readings are the most frequent utterances and are
+ * fully predictable. Instead of a Piper inference each time, the text is
+ * rendered into a fixed vocabulary of words ("fourteen", "point", "two",
+ * ..., "megahertz") whose clips come from the speech cache, normally from
+ * the phrase bundle. The clips are trimmed of their silent lead-in and
+ * tail and joined with short crossfades into one PCM stream.
+ *
+ * Text with anything outside the vocabulary is left to the engine.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Most words one utterance may render to */
+#define SPLICE_MAX_WORDS 48
+
+/**
+ * @brief Render text into vocabulary words
+ *
+ * Integers become number words ("144" -> "one hundred forty four"),
+ * decimals are read digit by digit after "point", "S9" becomes "S nine"
+ * and "dB" becomes "D B".
+ *
+ * @param text Text as sent to the engine
+ * @param words Filled with pointers to static vocabulary strings
+ * @param max_words Size of words
+ * @return Number of words, or -1 if the text is not all vocabulary
+ */
+int hal_tts_splice_words(const char *text, const char **words, int max_words);
+
+/**
+ * @brief Speak text by joining cached clips
+ *
+ * @param text Text as sent to the engine
+ * @param model Voice model the clips must come from
+ * @param length_scale Speed the clips must have been synthesized at
+ * @param num_samples Set to the length of the result
+ * @return 16 kHz PCM (caller frees), or NULL if the text is not all
+ *         vocabulary or a word has no clip yet
+ */
+int16_t *hal_tts_splice(const char *text, const char *model,
+                        float length_scale, size_t *num_samples);
+
+/**
+ * @brief Every word a clip is needed for (make phrases bundles them all)
+ *
+ * @param count Set to the number of words
+ */
+const char *const *hal_tts_splice_vocabulary(size_t *count);
+
+#endif /* HAL_TTS_SPLICE_H */
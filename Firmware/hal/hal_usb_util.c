@@ -3,14 +3,17 @@
  * @brief USB Device Enumeration Utilities Implementation
  *
  * Enumerates audio devices by parsing /proc/asound/cards and resolving
- * USB port paths via /sys/class/sound symlinks.
+ * USB port paths via /sys/class/sound symlinks. Card arrivals and removals
+ * are watched through kernel uevents on a netlink socket.
  */
 
 #include "hal_usb_util.h"
 #include <dirent.h>
+#include <linux/netlink.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
 #include <unistd.h>
 
 /**
@@ -270,3 +273,72 @@ int hal_usb_find_audio(const char *preferred_name, AudioDeviceInfo *result) {
 
   return 0;
 }
+
+/**
+ * Open a netlink socket subscribed to kernel uevents
+ */
+int hal_usb_uevent_open(void) {
+  struct sockaddr_nl addr;
+  int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                  NETLINK_KOBJECT_UEVENT);
+  if (fd < 0) {
+    return -1;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = 1; /* Kernel events (udevd re-broadcasts on group 2) */
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/**
+ * Parse a uevent, keeping sound card adds and removes
+ */
+int hal_usb_parse_uevent(const char *msg, size_t len, SoundCardEvent *event) {
+  const char *action = NULL;
+  const char *devpath = NULL;
+  int is_sound = 0;
+  size_t pos = 0;
+
+  /* Skip the "action@devpath" summary; the pairs carry the same fields */
+  while (pos < len && msg[pos] != '\0') {
+    pos++;
+  }
+  while (++pos < len) {
+    const char *pair = msg + pos;
+    size_t pair_len = strnlen(pair, len - pos);
+    if (strncmp(pair, "ACTION=", 7) == 0) {
+      action = pair + 7;
+    } else if (strncmp(pair, "DEVPATH=", 8) == 0) {
+      devpath = pair + 8;
+    } else if (strcmp(pair, "SUBSYSTEM=sound") == 0) {
+      is_sound = 1;
+    }
+    pos += pair_len;
+  }
+  if (!is_sound || action == NULL || devpath == NULL) {
+    return 0;
+  }
+
+  if (strcmp(action, "add") == 0) {
+    event->added = 1;
+  } else if (strcmp(action, "remove") == 0) {
+    event->added = 0;
+  } else {
+    return 0;
+  }
+
+  /* .../sound/card2, .../sound/card2/controlC2, .../sound/card2/pcmC2D0p */
+  const char *name = strrchr(devpath, '/');
+  name = name ? name + 1 : devpath;
+  if (sscanf(name, "card%d", &event->card_number) == 1 ||
+      sscanf(name, "controlC%d", &event->card_number) == 1 ||
+      sscanf(name, "pcmC%d", &event->card_number) == 1) {
+    return 1;
+  }
+  return 0;
+}
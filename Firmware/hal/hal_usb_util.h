@@ -60,4 +60,35 @@ int hal_usb_find_audio(const char *preferred_name, AudioDeviceInfo *result);
  */
 int hal_usb_get_port_path(int card_number, char *port_path, size_t len);
 
+/**
+ * A sound card (or one of its devices) was added or removed
+ */
+typedef struct {
+  int added;       /* 1 = add, 0 = remove */
+  int card_number; /* ALSA card the device belongs to */
+} SoundCardEvent;
+
+/**
+ * Open a netlink socket that receives kernel device events (uevents)
+ *
+ * Non-blocking; poll() it and pass each message to hal_usb_parse_uevent().
+ *
+ * @return Socket descriptor, or -1 if uevents are unavailable
+ */
+int hal_usb_uevent_open(void);
+
+/**
+ * Parse one kernel uevent message
+ *
+ * Messages are "action@devpath" followed by NUL-separated KEY=value
+ * pairs. Only sound subsystem adds and removes are reported; sub-devices
+ * (controlC1, pcmC1D0p) report the card they belong to.
+ *
+ * @param msg Message as received
+ * @param len Message length in bytes
+ * @param event Output: what changed
+ * @return 1 if msg is a sound card event, 0 otherwise
+ */
+int hal_usb_parse_uevent(const char *msg, size_t len, SoundCardEvent *event);
+
 #endif /* HAL_USB_UTIL_H */
@@ -0,0 +1,252 @@
+/**
+ * @file test_hal_audio_bank.c
+ * @brief Unit tests for the RAM-resident prompt bank
+ *
+ * Runs without an audio device: writes a few WAV files to a private
+ * directory under /tmp and exercises hal_audio_bank.c directly.
+ */
+
+#include "../hal_audio_bank.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Test result counters */
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_PASS(name)                                                        \
+  do {                                                                         \
+    printf("  [PASS] %s\n", name);                                             \
+    tests_passed++;                                                            \
+  } while (0)
+
+#define TEST_FAIL(name, reason)                                                \
+  do {                                                                         \
+    printf("  [FAIL] %s: %s\n", name, reason);                                 \
+    tests_failed++;                                                            \
+  } while (0)
+
+#define CHECK(cond, name, reason)                                              \
+  do {                                                                         \
+    if (cond) {                                                                \
+      TEST_PASS(name);                                                         \
+    } else {                                                                   \
+      TEST_FAIL(name, reason);                                                 \
+    }                                                                          \
+  } while (0)
+
+static char test_dir[64];
+
+/* Write a mono 16-bit WAV of num_samples copies of value */
+static void write_wav(const char *name, uint32_t rate, size_t num_samples,
+                      int16_t value) {
+  char path[128];
+  snprintf(path, sizeof(path), "%s%s", test_dir, name);
+  FILE *file = fopen(path, "wb");
+
+  uint32_t data_size = (uint32_t)(num_samples * 2);
+  uint32_t riff_size = 36 + data_size;
+  uint32_t fmt_size = 16;
+  uint16_t pcm = 1, channels = 1, align = 2, bits = 16;
+  uint32_t byte_rate = rate * 2;
+
+  fwrite("RIFF", 1, 4, file);
+  fwrite(&riff_size, 4, 1, file);
+  fwrite("WAVEfmt ", 1, 8, file);
+  fwrite(&fmt_size, 4, 1, file);
+  fwrite(&pcm, 2, 1, file);
+  fwrite(&channels, 2, 1, file);
+  fwrite(&rate, 4, 1, file);
+  fwrite(&byte_rate, 4, 1, file);
+  fwrite(&align, 2, 1, file);
+  fwrite(&bits, 2, 1, file);
+  fwrite("data", 1, 4, file);
+  fwrite(&data_size, 4, 1, file);
+  for (size_t i = 0; i < num_samples; i++) {
+    fwrite(&value, 2, 1, file);
+  }
+  fclose(file);
+}
+
+static void key_for(char *path, size_t size, const char *name) {
+  snprintf(path, size, "%s%s", test_dir, name);
+}
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================
+ */
+
+/**
+ * Test: Directory preload and hits
+ */
+void test_preload(void) {
+  printf("\n=== Test: Preload Directory ===\n");
+
+  char path[128];
+  AudioBankStats stats;
+
+  hal_audio_bank_init(1024 * 1024);
+  int loaded = hal_audio_bank_load_dir(test_dir);
+  CHECK(loaded == 4, "four prompts preloaded", "wrong count");
+
+  key_for(path, sizeof(path), "one.wav");
+  const CachedAudio *prompt = hal_audio_bank_acquire(path);
+  CHECK(prompt != NULL && prompt->num_samples == 1000 &&
+            prompt->samples[0] == 1,
+        "preloaded prompt found", "missing or wrong samples");
+  hal_audio_bank_release(prompt);
+
+  key_for(path, sizeof(path), "cd.wav");
+  prompt = hal_audio_bank_acquire(path);
+  CHECK(prompt != NULL && prompt->num_samples >= 362 &&
+            prompt->num_samples <= 364,
+        "44.1 kHz file converted at load", "not resampled to 16 kHz");
+  size_t cd_samples = prompt != NULL ? prompt->num_samples : 0;
+  hal_audio_bank_release(prompt);
+
+  hal_audio_bank_get_stats(&stats);
+  CHECK(stats.hits == 2 && stats.loads == 0, "served without loading",
+        "unexpected file load");
+  CHECK(stats.bytes == 2 * (1000 + 2000 + 3000 + cd_samples),
+        "bytes accounted", "wrong byte count");
+
+  key_for(path, sizeof(path), "odd.wav");
+  CHECK(hal_audio_bank_acquire(path) == NULL &&
+            hal_audio_bank_acquire(path) == NULL,
+        "unconvertible file not cached", "should be refused");
+  hal_audio_bank_get_stats(&stats);
+  CHECK(stats.loads == 0, "unconvertible file not retried",
+        "reloaded on every lookup");
+  CHECK(hal_audio_bank_acquire("/nonexistent/prompt.wav") == NULL,
+        "missing file", "should be NULL");
+
+  hal_audio_bank_cleanup();
+}
+
+/**
+ * Test: Least recently used prompt is evicted, in-use prompts are not
+ */
+void test_eviction(void) {
+  printf("\n=== Test: LRU Eviction ===\n");
+
+  char one[128], two[128], three[128];
+  AudioBankStats stats;
+  key_for(one, sizeof(one), "one.wav");
+  key_for(two, sizeof(two), "two.wav");
+  key_for(three, sizeof(three), "three.wav");
+
+  /* Room for one.wav and two.wav (6000 bytes), but not all three */
+  hal_audio_bank_init(8500);
+
+  const CachedAudio *first = hal_audio_bank_acquire(one);
+  hal_audio_bank_release(first);
+  const CachedAudio *second = hal_audio_bank_acquire(two);
+  hal_audio_bank_release(second);
+  first = hal_audio_bank_acquire(one); /* one is now most recent */
+  hal_audio_bank_release(first);
+
+  const CachedAudio *third = hal_audio_bank_acquire(three);
+  hal_audio_bank_get_stats(&stats);
+  CHECK(third != NULL && stats.evictions == 1 && stats.prompts == 2,
+        "loading three evicts only two", "wrong prompt evicted");
+  CHECK(stats.bytes <= stats.budget, "stays within budget", "over budget");
+
+  /* three is in use, so loading two again cannot evict it */
+  second = hal_audio_bank_acquire(two);
+  CHECK(second == NULL, "in-use prompt pinned", "evicted a playing prompt");
+  hal_audio_bank_release(third);
+
+  second = hal_audio_bank_acquire(two);
+  CHECK(second != NULL && second->samples[0] == 2,
+        "reloaded after release", "reload failed");
+  hal_audio_bank_release(second);
+
+  hal_audio_bank_cleanup();
+}
+
+#define LOADERS 8
+
+static char shared_path[128];
+static const CachedAudio *loaded_by[LOADERS];
+
+static void *load_shared(void *arg) {
+  loaded_by[(long)arg] = hal_audio_bank_acquire(shared_path);
+  return NULL;
+}
+
+/**
+ * Test: Threads missing on the same prompt end up sharing one copy
+ *
+ * Files are read outside the bank lock, so several threads can load the
+ * same prompt at once; the first to insert it wins.
+ */
+void test_concurrent_load(void) {
+  printf("\n=== Test: Concurrent Load ===\n");
+
+  pthread_t threads[LOADERS];
+  AudioBankStats stats;
+  key_for(shared_path, sizeof(shared_path), "three.wav");
+  hal_audio_bank_init(1024 * 1024);
+
+  for (long i = 0; i < LOADERS; i++) {
+    pthread_create(&threads[i], NULL, load_shared, (void *)i);
+  }
+  int same = 1;
+  for (int i = 0; i < LOADERS; i++) {
+    pthread_join(threads[i], NULL);
+    same &= loaded_by[i] != NULL && loaded_by[i] == loaded_by[0];
+  }
+  hal_audio_bank_get_stats(&stats);
+  CHECK(same, "every thread gets the same prompt", "copies differ");
+  CHECK(stats.prompts == 1 && stats.bytes == 6000,
+        "one copy kept and accounted", "duplicate copy kept");
+
+  for (int i = 0; i < LOADERS; i++) {
+    hal_audio_bank_release(loaded_by[i]);
+  }
+  hal_audio_bank_cleanup();
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================
+ */
+
+int main(void) {
+  printf("=============================================\n");
+  printf("  HAMPOD Prompt Bank Unit Tests\n");
+  printf("=============================================\n");
+
+  snprintf(test_dir, sizeof(test_dir), "/tmp/hampod_bank_%d/", (int)getpid());
+  mkdir(test_dir, 0755);
+  write_wav("one.wav", 16000, 1000, 1);
+  write_wav("two.wav", 16000, 2000, 2);
+  write_wav("three.wav", 16000, 3000, 3);
+  write_wav("cd.wav", 44100, 1000, 4);
+  write_wav("odd.wav", 44056, 1000, 5); /* No practical L/M ratio */
+
+  test_preload();
+  test_eviction();
+  test_concurrent_load();
+
+  const char *names[] = {"one.wav", "two.wav", "three.wav", "cd.wav",
+                         "odd.wav"};
+  char path[128];
+  for (int i = 0; i < 5; i++) {
+    key_for(path, sizeof(path), names[i]);
+    unlink(path);
+  }
+  rmdir(test_dir);
+
+  printf("\n=============================================\n");
+  printf("  Results: %d passed, %d failed\n", tests_passed, tests_failed);
+  printf("=============================================\n");
+
+  return tests_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,289 @@
+/**
+ * @file test_hal_audio_convert.c
+ * @brief Unit tests for WAV parsing and conversion to the pipeline format
+ *
+ * Runs without an audio device: exercises hal_audio_convert.c directly.
+ */
+
+#include "../hal_audio_convert.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Test result counters */
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_PASS(name)                                                        \
+  do {                                                                         \
+    printf("  [PASS] %s\n", name);                                             \
+    tests_passed++;                                                            \
+  } while (0)
+
+#define TEST_FAIL(name, reason)                                                \
+  do {                                                                         \
+    printf("  [FAIL] %s: %s\n", name, reason);                                 \
+    tests_failed++;                                                            \
+  } while (0)
+
+#define CHECK(cond, name, reason)                                              \
+  do {                                                                         \
+    if (cond) {                                                                \
+      TEST_PASS(name);                                                         \
+    } else {                                                                   \
+      TEST_FAIL(name, reason);                                                 \
+    }                                                                          \
+  } while (0)
+
+static void put16(FILE *file, uint16_t value) { fwrite(&value, 2, 1, file); }
+static void put32(FILE *file, uint32_t value) { fwrite(&value, 4, 1, file); }
+
+/* Convert mono 16-bit samples at in_rate in one call */
+static size_t convert_mono(uint32_t in_rate, const int16_t *in, size_t frames,
+                           int16_t **out) {
+  AudioConverter conv;
+  if (hal_convert_init(&conv, in_rate, 1, 16) != 0) {
+    return 0;
+  }
+  *out = (int16_t *)malloc(hal_convert_max_output(&conv, frames) * 2);
+  size_t produced = hal_convert_process(&conv, (const uint8_t *)in, frames,
+                                        *out);
+  hal_convert_free(&conv);
+  return produced;
+}
+
+static int16_t *make_sine(uint32_t rate, double freq, double amplitude,
+                          size_t frames) {
+  int16_t *samples = (int16_t *)malloc(frames * 2);
+  for (size_t i = 0; i < frames; i++) {
+    samples[i] = (int16_t)lround(amplitude * sin(2 * M_PI * freq * i / rate));
+  }
+  return samples;
+}
+
+/* Peak level, skipping the filter's start-up */
+static int peak(const int16_t *samples, size_t count) {
+  int max = 0;
+  for (size_t i = 100; i < count; i++) {
+    if (abs(samples[i]) > max) {
+      max = abs(samples[i]);
+    }
+  }
+  return max;
+}
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================
+ */
+
+/**
+ * Test: RIFF chunk walking, extensible fmt chunk
+ */
+void test_header(void) {
+  printf("\n=== Test: WAV Header ===\n");
+
+  FILE *file = tmpfile();
+  uint8_t guid_tail[14] = {0};
+  WavFormat format;
+
+  /* 24-bit stereo 48 kHz, WAVE_FORMAT_EXTENSIBLE, with a LIST chunk */
+  fwrite("RIFF", 1, 4, file);
+  put32(file, 0);
+  fwrite("WAVE", 1, 4, file);
+  fwrite("LIST", 1, 4, file);
+  put32(file, 5);
+  fwrite("abcde\0", 1, 6, file); /* Odd size: padded */
+  fwrite("fmt ", 1, 4, file);
+  put32(file, 40);
+  put16(file, 0xFFFE);
+  put16(file, 2);
+  put32(file, 48000);
+  put32(file, 48000 * 6);
+  put16(file, 6);
+  put16(file, 24);
+  put16(file, 22);
+  put16(file, 24);
+  put32(file, 3);
+  put16(file, 1); /* SubFormat: PCM */
+  fwrite(guid_tail, 1, 14, file);
+  fwrite("data", 1, 4, file);
+  put32(file, 6);
+  fwrite("\x11\x22\x33\x44\x55\x66", 1, 6, file);
+  rewind(file);
+
+  int result = hal_wav_read_header(file, &format);
+  CHECK(result == 0, "extensible header parsed", "rejected");
+  CHECK(format.sample_rate == 48000 && format.channels == 2 &&
+            format.bits_per_sample == 24 && format.block_align == 6 &&
+            format.data_size == 6,
+        "format fields", "wrong fields");
+  CHECK(fgetc(file) == 0x11, "positioned at first sample",
+        "wrong file position");
+  fclose(file);
+
+  /* Compressed (format tag 2) is refused */
+  file = tmpfile();
+  fwrite("RIFF\0\0\0\0WAVEfmt ", 1, 16, file);
+  put32(file, 16);
+  put16(file, 2);
+  put16(file, 1);
+  put32(file, 16000);
+  put32(file, 8000);
+  put16(file, 1);
+  put16(file, 4);
+  fwrite("data\0\0\0\0", 1, 8, file);
+  rewind(file);
+  CHECK(hal_wav_read_header(file, &format) != 0, "ADPCM refused",
+        "accepted a compressed file");
+  fclose(file);
+
+  /* 16-bit stereo is 4 bytes a frame: 2 would overrun, 8 would garble */
+  const uint16_t wrong_align[] = {2, 8};
+  int refused = 1;
+  for (int i = 0; i < 2; i++) {
+    file = tmpfile();
+    fwrite("RIFF\0\0\0\0WAVEfmt ", 1, 16, file);
+    put32(file, 16);
+    put16(file, 1);
+    put16(file, 2);
+    put32(file, 16000);
+    put32(file, 16000 * wrong_align[i]);
+    put16(file, wrong_align[i]);
+    put16(file, 16);
+    fwrite("data\4\0\0\0\1\0\2\0", 1, 12, file);
+    rewind(file);
+    refused &= hal_wav_read_header(file, &format) == -2;
+    fclose(file);
+  }
+  CHECK(refused, "mismatched block_align refused",
+        "accepted a frame size the readers disagree on");
+}
+
+/**
+ * Test: Channel and bit-depth conversion at the pipeline rate
+ */
+void test_sample_formats(void) {
+  printf("\n=== Test: Sample Formats ===\n");
+
+  AudioConverter conv;
+  int16_t out[4];
+
+  uint8_t eight[3] = {128, 255, 0};
+  hal_convert_init(&conv, 16000, 1, 8);
+  size_t n = hal_convert_process(&conv, eight, 3, out);
+  CHECK(n == 3 && out[0] == 0 && out[1] == 127 * 256 && out[2] == -32768,
+        "8-bit unsigned", "wrong samples");
+  hal_convert_free(&conv);
+
+  /* Two stereo frames: (1000, 3000) and (-2, -4), 24-bit */
+  uint8_t stereo24[12] = {0x00, 0xE8, 0x03, 0x00, 0xB8, 0x0B,
+                          0x00, 0xFE, 0xFF, 0x00, 0xFC, 0xFF};
+  hal_convert_init(&conv, 16000, 2, 24);
+  n = hal_convert_process(&conv, stereo24, 2, out);
+  CHECK(n == 2 && out[0] == 2000 && out[1] == -3,
+        "24-bit stereo averaged to mono", "wrong samples");
+  hal_convert_free(&conv);
+
+  CHECK(hal_convert_init(&conv, 16000, 1, 0) != 0 &&
+            hal_convert_init(&conv, 16000, 1, 40) != 0 &&
+            hal_convert_init(&conv, 44056, 1, 16) != 0,
+        "unsupported formats refused", "accepted");
+}
+
+/**
+ * Test: Rate conversion keeps length, gain and rejects aliases
+ */
+void test_resample(void) {
+  printf("\n=== Test: Resampling ===\n");
+
+  int16_t *in, *out;
+  size_t n;
+
+  in = make_sine(48000, 1000, 16000, 4800);
+  n = convert_mono(48000, in, 4800, &out);
+  CHECK(n >= 1599 && n <= 1601, "48 kHz: 100 ms in, 100 ms out",
+        "wrong length");
+  CHECK(abs(peak(out, n) - 16000) < 400, "48 kHz: 1 kHz passband gain",
+        "level changed");
+  free(in);
+  free(out);
+
+  /* 12 kHz is above the new Nyquist; it would alias to 4 kHz */
+  in = make_sine(48000, 12000, 16000, 4800);
+  n = convert_mono(48000, in, 4800, &out);
+  CHECK(peak(out, n) < 160, "48 kHz: 12 kHz removed", "aliased");
+  free(in);
+  free(out);
+
+  in = make_sine(44100, 1000, 16000, 4410);
+  n = convert_mono(44100, in, 4410, &out);
+  CHECK(n >= 1599 && n <= 1601, "44.1 kHz: 100 ms in, 100 ms out",
+        "wrong length");
+  CHECK(abs(peak(out, n) - 16000) < 400, "44.1 kHz: 1 kHz passband gain",
+        "level changed");
+  free(in);
+  free(out);
+
+  in = make_sine(8000, 1000, 16000, 800);
+  n = convert_mono(8000, in, 800, &out);
+  CHECK(n == 1600, "8 kHz: doubled", "wrong length");
+  CHECK(abs(peak(out, n) - 16000) < 400, "8 kHz: 1 kHz passband gain",
+        "level changed");
+  free(in);
+  free(out);
+}
+
+/**
+ * Test: Converting in odd-sized blocks matches one call
+ */
+void test_streaming(void) {
+  printf("\n=== Test: Streaming ===\n");
+
+  int16_t *in = make_sine(22050, 440, 12000, 2205);
+  int16_t *whole;
+  size_t whole_count = convert_mono(22050, in, 2205, &whole);
+
+  AudioConverter conv;
+  hal_convert_init(&conv, 22050, 1, 16);
+  int16_t *pieces = (int16_t *)malloc(whole_count * 2 + 64);
+  size_t count = 0;
+  for (size_t start = 0; start < 2205; start += 97) {
+    size_t frames = 2205 - start < 97 ? 2205 - start : 97;
+    count += hal_convert_process(&conv, (const uint8_t *)(in + start), frames,
+                                 pieces + count);
+  }
+  hal_convert_free(&conv);
+
+  CHECK(count == whole_count &&
+            memcmp(pieces, whole, count * sizeof(int16_t)) == 0,
+        "blocks match one-shot", "filter state lost between blocks");
+
+  free(in);
+  free(whole);
+  free(pieces);
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================
+ */
+
+int main(void) {
+  printf("=============================================\n");
+  printf("  HAMPOD Audio Format Converter Unit Tests\n");
+  printf("=============================================\n");
+
+  test_header();
+  test_sample_formats();
+  test_resample();
+  test_streaming();
+
+  printf("\n=============================================\n");
+  printf("  Results: %d passed, %d failed\n", tests_passed, tests_failed);
+  printf("=============================================\n");
+
+  return tests_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,365 @@
+/**
+ * @file test_hal_audio_mix.c
+ * @brief Unit tests for the audio mixer's voice rings and mixing
+ *
+ * Runs without an audio device: exercises hal_audio_mix.c directly.
+ */
+
+#include "../hal_audio_mix.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Test result counters */
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_PASS(name)                                                        \
+  do {                                                                         \
+    printf("  [PASS] %s\n", name);                                             \
+    tests_passed++;                                                            \
+  } while (0)
+
+#define TEST_FAIL(name, reason)                                                \
+  do {                                                                         \
+    printf("  [FAIL] %s: %s\n", name, reason);                                 \
+    tests_failed++;                                                            \
+  } while (0)
+
+#define CHECK(cond, name, reason)                                              \
+  do {                                                                         \
+    if (cond) {                                                                \
+      TEST_PASS(name);                                                         \
+    } else {                                                                   \
+      TEST_FAIL(name, reason);                                                 \
+    }                                                                          \
+  } while (0)
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================
+ */
+
+/**
+ * Test: Ring capacity, partial writes and wrap-around
+ */
+void test_voice_ring(void) {
+  printf("\n=== Test: Voice Ring ===\n");
+
+  MixVoice voice;
+  int16_t in[96];
+  int16_t out[64];
+  for (int i = 0; i < 96; i++) {
+    in[i] = (int16_t)(i + 1);
+  }
+
+  CHECK(hal_mix_voice_init(&voice, 50) == 0, "init", "allocation failed");
+  CHECK(hal_mix_voice_space(&voice) == 64, "capacity rounded up",
+        "expected 64");
+  CHECK(hal_mix_voice_write(&voice, in, 96) == 64, "write stops when full",
+        "expected 64 samples queued");
+
+  hal_mix_voices(&voice, 1, out, 40);
+  CHECK(out[0] == 1 && out[39] == 40, "mixed in order", "wrong samples");
+
+  /* 24 left; the next 40 wrap around the end of the ring */
+  CHECK(hal_mix_voice_write(&voice, in, 40) == 40, "write after mixing",
+        "expected 40 samples queued");
+  hal_mix_voices(&voice, 1, out, 64);
+  CHECK(out[23] == 64 && out[24] == 1 && out[63] == 40,
+        "wrap-around keeps order", "wrong samples");
+  CHECK(hal_mix_voice_pending(&voice) == 0, "ring empty", "samples left");
+
+  hal_mix_voice_free(&voice);
+}
+
+/**
+ * Test: Mixing sums voices and saturates
+ */
+void test_mix_saturation(void) {
+  printf("\n=== Test: Mixing and Saturation ===\n");
+
+  MixVoice voices[2];
+  int16_t loud[4] = {30000, -30000, 1000, 5};
+  int16_t beep[2] = {10000, -10000};
+  int16_t out[4];
+
+  hal_mix_voice_init(&voices[0], 16);
+  hal_mix_voice_init(&voices[1], 16);
+  hal_mix_voice_write(&voices[0], loud, 4);
+  hal_mix_voice_write(&voices[1], beep, 2);
+
+  int active = hal_mix_voices(voices, 2, out, 4);
+  CHECK(active == 2, "both voices active", "expected 2");
+  CHECK(out[0] == INT16_MAX, "positive clip", "no saturation");
+  CHECK(out[1] == INT16_MIN, "negative clip", "no saturation");
+  CHECK(out[2] == 1000 && out[3] == 5, "short voice pads with silence",
+        "wrong tail");
+
+  active = hal_mix_voices(voices, 2, out, 4);
+  CHECK(active == 0 && out[0] == 0 && out[3] == 0, "silence when empty",
+        "expected silence");
+
+  hal_mix_voice_free(&voices[0]);
+  hal_mix_voice_free(&voices[1]);
+}
+
+/**
+ * Test: Flush drops queued samples but keeps later ones
+ */
+void test_flush(void) {
+  printf("\n=== Test: Flush ===\n");
+
+  MixVoice voice;
+  int16_t old_speech[8] = {7, 7, 7, 7, 7, 7, 7, 7};
+  int16_t new_speech[2] = {3, 3};
+  int16_t out[8];
+
+  hal_mix_voice_init(&voice, 16);
+  hal_mix_voice_write(&voice, old_speech, 8);
+  hal_mix_voice_flush(&voice);
+  CHECK(hal_mix_voice_pending(&voice) == 0, "flushed samples not pending",
+        "still pending");
+
+  /* Queued after the interrupt, before the mixer ran */
+  hal_mix_voice_write(&voice, new_speech, 2);
+  int active = hal_mix_voices(&voice, 1, out, 8);
+  CHECK(active == 1 && out[0] == 3 && out[1] == 3 && out[2] == 0,
+        "only samples after the flush play", "old samples played");
+  CHECK(hal_mix_voice_space(&voice) == 16, "space reclaimed", "space lost");
+
+  hal_mix_voice_free(&voice);
+}
+
+/**
+ * Test: A fade-out flush ramps the dropped audio down instead of cutting it
+ */
+void test_fade_out(void) {
+  printf("\n=== Test: Fade Out ===\n");
+
+  MixVoice voice;
+  int16_t speech[400];
+  int16_t new_speech[4] = {100, 100, 100, 100};
+  int16_t out[200];
+
+  for (int i = 0; i < 400; i++) {
+    speech[i] = 20000;
+  }
+  hal_mix_voice_init(&voice, 512);
+  hal_mix_voice_write(&voice, speech, 400);
+  hal_mix_voices(&voice, 1, out, 100);
+
+  /* Interrupted mid-utterance, and the next utterance already queued */
+  hal_mix_voice_fade_out(&voice);
+  hal_mix_voice_write(&voice, new_speech, 4);
+  CHECK(hal_mix_voice_pending(&voice) == 4, "only new samples pending",
+        "faded samples counted as pending");
+  int active = hal_mix_voices(&voice, 1, out, 200);
+
+  int max_step = 0;
+  for (int i = 5; i < MIX_FADE_SAMPLES; i++) {
+    if (out[i - 1] - out[i] > max_step) {
+      max_step = out[i - 1] - out[i];
+    }
+  }
+  CHECK(active == 2, "fade counted as active", "fade not reported");
+  CHECK(out[0] > 20000 && out[4] < out[0], "fade starts at full level",
+        "fade started low");
+  CHECK(out[MIX_FADE_SAMPLES - 1] == 0 && out[MIX_FADE_SAMPLES] == 0 &&
+            out[199] == 0,
+        "silent after MIX_FADE_SAMPLES", "dropped audio still playing");
+  CHECK(max_step <= 20000 / (MIX_FADE_SAMPLES - 1) + 2, "ramp has no jumps",
+        "step too large");
+  /* The new utterance adds 100 to the first four samples of the fade */
+  int extra = (out[3] - out[4]) - (out[20] - out[21]);
+  CHECK(extra >= 98 && extra <= 102, "new samples overlap the fade",
+        "new utterance delayed");
+  CHECK(hal_mix_voice_space(&voice) == 512, "space reclaimed", "space lost");
+
+  /* A plain flush still cuts without a fade */
+  hal_mix_voice_write(&voice, speech, 100);
+  hal_mix_voice_flush(&voice);
+  active = hal_mix_voices(&voice, 1, out, 100);
+  CHECK(active == 0 && out[0] == 0, "flush does not fade", "faded");
+
+  /* Only 10 samples left: the whole ramp fits in them, ending at 0 */
+  hal_mix_voice_write(&voice, speech, 10);
+  hal_mix_voice_fade_out(&voice);
+  hal_mix_voices(&voice, 1, out, 100);
+  CHECK(out[0] > 19000 && out[5] < out[0] && out[9] == 0,
+        "short tail fades to silence", "tail cut at non-zero gain");
+
+  /* Fading an empty voice leaves nothing behind for a later flush */
+  hal_mix_voice_fade_out(&voice);
+  hal_mix_voice_write(&voice, speech, 100);
+  hal_mix_voice_flush(&voice);
+  active = hal_mix_voices(&voice, 1, out, 100);
+  CHECK(active == 0 && out[0] == 0, "empty fade does not linger",
+        "later flush faded");
+
+  hal_mix_voice_free(&voice);
+}
+
+/**
+ * Test: An interrupt fades speech but leaves a queued beep whole
+ *
+ * The keypad sends its beep before the speech interrupt, so the beep is
+ * already queued when hal_audio_interrupt() fades the speech and file
+ * voices.
+ */
+void test_interrupt_keeps_beep(void) {
+  printf("\n=== Test: Interrupt Keeps Beep ===\n");
+
+  MixVoice voices[3]; /* Speech, beep, file, as in hal_audio_usb.c */
+  int16_t speech[1600];
+  int16_t beep[800];
+  int16_t out[1600];
+
+  for (int i = 0; i < 1600; i++) {
+    speech[i] = 10000;
+  }
+  for (int i = 0; i < 800; i++) {
+    beep[i] = 1000;
+  }
+  for (int v = 0; v < 3; v++) {
+    hal_mix_voice_init(&voices[v], 2048);
+  }
+  hal_mix_voice_write(&voices[0], speech, 1600);
+  hal_mix_voice_write(&voices[1], beep, 800);
+
+  hal_mix_voice_fade_out(&voices[0]);
+  hal_mix_voice_fade_out(&voices[2]);
+  hal_mix_voices(voices, 3, out, 1600);
+
+  int whole = 1;
+  for (int i = MIX_FADE_SAMPLES; i < 800; i++) {
+    whole &= out[i] == 1000;
+  }
+  CHECK(whole && out[799] == 1000 && out[800] == 0,
+        "beep mixed in full after interrupt", "beep cut short");
+
+  for (int v = 0; v < 3; v++) {
+    hal_mix_voice_free(&voices[v]);
+  }
+}
+
+/**
+ * Test: Per-voice gain (ducking) scales one voice only
+ */
+void test_voice_gain(void) {
+  printf("\n=== Test: Voice Gain ===\n");
+
+  MixVoice voices[2];
+  int16_t speech[400];
+  int16_t beep[400];
+  int16_t out[400];
+
+  for (int i = 0; i < 400; i++) {
+    speech[i] = 8000;
+    beep[i] = 1000;
+  }
+  hal_mix_voice_init(&voices[0], 512);
+  hal_mix_voice_init(&voices[1], 512);
+  hal_mix_voice_write(&voices[0], speech, 400);
+  hal_mix_voice_write(&voices[1], beep, 400);
+
+  hal_mix_gain_set(&voices[0].gain, MIX_GAIN_UNITY / 4);
+  hal_mix_voices(voices, 2, out, 400);
+  CHECK(out[0] > 8900 && out[399] == 3000, "ducked voice settles at 1/4",
+        "wrong level");
+  int max_step = 0;
+  for (int i = 1; i < 400; i++) {
+    if (out[i - 1] - out[i] > max_step) {
+      max_step = out[i - 1] - out[i];
+    }
+  }
+  CHECK(max_step <= 8000 / MIX_GAIN_RAMP_SAMPLES + 1, "duck ramps",
+        "duck jumped");
+
+  hal_mix_voice_free(&voices[0]);
+  hal_mix_voice_free(&voices[1]);
+}
+
+/**
+ * Test: Output gain, ramps and the fixed-point multiply
+ */
+void test_gain(void) {
+  printf("\n=== Test: Output Gain ===\n");
+
+  MixGain gain;
+  int16_t block[1000];
+
+  hal_mix_gain_init(&gain, MIX_GAIN_UNITY);
+  for (int i = 0; i < 1000; i++) {
+    block[i] = (int16_t)(i * 37 - 18000);
+  }
+  hal_mix_gain_apply(&gain, block, 1000);
+  CHECK(block[0] == -18000 && block[999] == 999 * 37 - 18000,
+        "unity leaves samples untouched", "samples changed");
+
+  /* Steady half gain, including the SIMD body and scalar tail */
+  hal_mix_gain_init(&gain, MIX_GAIN_UNITY / 2);
+  int16_t odd[11] = {-32768, -3, -1, 0, 1, 3, 1000, 32767, 5, 7, -7};
+  hal_mix_gain_apply(&gain, odd, 11);
+  CHECK(odd[0] == -16384 && odd[1] == -1 && odd[2] == 0 && odd[4] == 1 &&
+            odd[5] == 2 && odd[6] == 500 && odd[7] == 16384 && odd[10] == -3,
+        "half gain rounds to nearest", "wrong samples");
+
+  /* Mute to unity on a constant signal: rises evenly, no jump */
+  hal_mix_gain_init(&gain, 0);
+  hal_mix_gain_set(&gain, MIX_GAIN_UNITY);
+  for (int i = 0; i < 1000; i++) {
+    block[i] = 10000;
+  }
+  hal_mix_gain_apply(&gain, block, 1000);
+  int max_step = block[0];
+  for (int i = 1; i < 1000; i++) {
+    if (block[i] - block[i - 1] > max_step) {
+      max_step = block[i] - block[i - 1];
+    }
+  }
+  CHECK(block[0] < 100 && block[MIX_GAIN_RAMP_SAMPLES] == 10000 &&
+            block[999] == 10000,
+        "ramp reaches unity in MIX_GAIN_RAMP_SAMPLES", "wrong ramp");
+  CHECK(max_step <= 10000 / MIX_GAIN_RAMP_SAMPLES + 1, "ramp has no jumps",
+        "step too large");
+
+  /* Ramp carries over between periods */
+  hal_mix_gain_set(&gain, 0);
+  for (int i = 0; i < 200; i++) {
+    block[i] = 10000;
+  }
+  hal_mix_gain_apply(&gain, block, 100);
+  hal_mix_gain_apply(&gain, block + 100, 100);
+  CHECK(block[99] > block[100] && block[100] > block[199] && block[199] > 0,
+        "ramp spans periods", "ramp restarted");
+
+  hal_mix_gain_set(&gain, -5);
+  CHECK(atomic_load(&gain.target) == 0, "gain clamped", "negative gain");
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================
+ */
+
+int main(void) {
+  printf("=============================================\n");
+  printf("  HAMPOD Audio Mixer Unit Tests\n");
+  printf("=============================================\n");
+
+  test_voice_ring();
+  test_mix_saturation();
+  test_flush();
+  test_fade_out();
+  test_interrupt_keeps_beep();
+  test_voice_gain();
+  test_gain();
+
+  printf("\n=============================================\n");
+  printf("  Results: %d passed, %d failed\n", tests_passed, tests_failed);
+  printf("=============================================\n");
+
+  return tests_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,187 @@
+/**
+ * @file test_hal_audio_sink.c
+ * @brief Unit tests for the headless audio sinks (null and capture)
+ *
+ * Runs without an audio device: exercises hal_audio_null.c and
+ * hal_audio_capture.c directly, the way the mixer thread drives them.
+ */
+
+#include "../hal_audio_convert.h"
+#include "../hal_audio_sink.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Test result counters */
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_PASS(name)                                                        \
+  do {                                                                         \
+    printf("  [PASS] %s\n", name);                                             \
+    tests_passed++;                                                            \
+  } while (0)
+
+#define TEST_FAIL(name, reason)                                                \
+  do {                                                                         \
+    printf("  [FAIL] %s: %s\n", name, reason);                                 \
+    tests_failed++;                                                            \
+  } while (0)
+
+#define CHECK(cond, name, reason)                                              \
+  do {                                                                         \
+    if (cond) {                                                                \
+      TEST_PASS(name);                                                         \
+    } else {                                                                   \
+      TEST_FAIL(name, reason);                                                 \
+    }                                                                          \
+  } while (0)
+
+#define RATE 16000
+#define CAPTURE_PATH "/tmp/hampod_test_capture.wav"
+
+static uint64_t now_ms(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000u + (uint64_t)now.tv_nsec / 1000000u;
+}
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================
+ */
+
+/**
+ * Test: Null sink plays at the real-time rate from a 100 ms buffer
+ */
+void test_null_timing(void) {
+  printf("\n=== Test: Null Sink Timing ===\n");
+
+  const AudioSink *sink = &hal_audio_null_sink;
+  int16_t period[400] = {0};
+  size_t period_frames = 0;
+  long delay = -1;
+
+  CHECK(sink->open("default", RATE, &period_frames) == 0 &&
+            period_frames == 400,
+        "opens with 25 ms periods", "wrong period");
+  CHECK(!sink->uses_card, "needs no sound card", "asks for a card");
+
+  uint64_t start = now_ms();
+  for (int i = 0; i < 4; i++) {
+    sink->write(period, 400);
+  }
+  sink->delay(&delay);
+  CHECK(now_ms() - start < 20 && delay > 1400 && delay <= 1600,
+        "buffer fills without blocking", "blocked or lost frames");
+
+  /* 20 more periods: 500 ms of audio, gated by the clock */
+  for (int i = 0; i < 20; i++) {
+    sink->write(period, 400);
+  }
+  uint64_t elapsed = now_ms() - start;
+  CHECK(elapsed >= 480 && elapsed <= 560, "writes paced in real time",
+        "not real time");
+
+  sink->drain();
+  sink->delay(&delay);
+  elapsed = now_ms() - start;
+  CHECK(delay == 0 && elapsed >= 580 && elapsed <= 660,
+        "drain waits for the buffer to play out", "drain did not wait");
+
+  /* Restart after a drain is not an underrun */
+  usleep(50000);
+  CHECK(sink->write(period, 400) == 400, "restart after drain",
+        "restart refused");
+
+  /* Falling behind is */
+  usleep(50000);
+  long result = sink->write(period, 400);
+  CHECK(result == -EPIPE, "late write is an underrun", "no underrun");
+  CHECK(sink->recover(result) == 0 && sink->write(period, 400) == 400,
+        "recovers", "did not recover");
+  sink->close();
+}
+
+/**
+ * Test: Capture sink writes a WAV on the playback timeline
+ */
+void test_capture(void) {
+  printf("\n=== Test: Capture Sink ===\n");
+
+  const AudioSink *sink = &hal_audio_capture_sink;
+  int16_t period[400];
+  size_t period_frames = 0;
+
+  for (int i = 0; i < 400; i++) {
+    period[i] = 1000;
+  }
+  CHECK(sink->open(CAPTURE_PATH, RATE, &period_frames) == 0, "opens",
+        "cannot create file");
+  for (int i = 0; i < 4; i++) {
+    sink->write(period, 400);
+  }
+  sink->drain();
+  usleep(100000); /* Stream stopped for 100 ms */
+  sink->write(period, 400);
+  sink->close();
+
+  FILE *file = fopen(CAPTURE_PATH, "rb");
+  WavFormat format;
+  CHECK(file != NULL && hal_wav_read_header(file, &format) == 0 &&
+            format.sample_rate == RATE && format.channels == 1 &&
+            format.bits_per_sample == 16,
+        "readable 16 kHz mono WAV", "bad header");
+
+  /* 1600 played, ~1600 of silence for the gap, 400 more */
+  size_t frames = format.data_size / 2;
+  CHECK(frames >= 3500 && frames <= 3800, "gap filled with silence",
+        "wrong length");
+
+  int16_t samples[4000];
+  size_t got = fread(samples, 2, frames < 4000 ? frames : 4000, file);
+  CHECK(got == frames && samples[0] == 1000 && samples[1599] == 1000 &&
+            samples[1700] == 0 && samples[frames - 1] == 1000,
+        "audio at its playback position", "samples misplaced");
+
+  /* The hpts chunk holds when sample 0 played */
+  uint8_t header[64];
+  uint64_t first_us = 0;
+  rewind(file);
+  fread(header, 1, sizeof(header), file);
+  if (memcmp(header + 36, "hpts", 4) == 0) {
+    for (int i = 7; i >= 0; i--) {
+      first_us = (first_us << 8) | header[44 + i];
+    }
+  }
+  CHECK(first_us / 1000 > 0 && first_us / 1000 <= now_ms(),
+        "start timestamp recorded", "no timestamp");
+
+  if (file != NULL) {
+    fclose(file);
+  }
+  unlink(CAPTURE_PATH);
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================
+ */
+
+int main(void) {
+  printf("=============================================\n");
+  printf("  HAMPOD Headless Audio Sink Unit Tests\n");
+  printf("=============================================\n");
+
+  test_null_timing();
+  test_capture();
+
+  printf("\n=============================================\n");
+  printf("  Results: %d passed, %d failed\n", tests_passed, tests_failed);
+  printf("=============================================\n");
+
+  return tests_failed > 0 ? 1 : 0;
+}
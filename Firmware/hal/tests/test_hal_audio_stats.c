@@ -0,0 +1,218 @@
+/**
+ * @file test_hal_audio_stats.c
+ * @brief Unit tests for the audio pipeline counters and latency histograms
+ *
+ * Runs without an audio device: exercises hal_audio_stats.c directly.
+ */
+
+#include "../hal_audio_stats.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Test result counters */
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_PASS(name)                                                        \
+  do {                                                                         \
+    printf("  [PASS] %s\n", name);                                             \
+    tests_passed++;                                                            \
+  } while (0)
+
+#define TEST_FAIL(name, reason)                                                \
+  do {                                                                         \
+    printf("  [FAIL] %s: %s\n", name, reason);                                 \
+    tests_failed++;                                                            \
+  } while (0)
+
+#define CHECK(cond, name, reason)                                              \
+  do {                                                                         \
+    if (cond) {                                                                \
+      TEST_PASS(name);                                                         \
+    } else {                                                                   \
+      TEST_FAIL(name, reason);                                                 \
+    }                                                                          \
+  } while (0)
+
+#define THREADS 4
+#define PER_THREAD 10000
+
+/* True if reported is at or above actual and no more than 25% above it */
+static int within_bucket(uint32_t reported, uint32_t actual) {
+  return reported >= actual && reported <= actual + actual / 4;
+}
+
+static void *hammer(void *arg) {
+  (void)arg;
+  for (int i = 0; i < PER_THREAD; i++) {
+    hal_stats_count(AUDIO_COUNT_DROPS);
+    hal_stats_record_us(AUDIO_LAT_BEEP_START, (uint64_t)(i % 1000) + 1);
+  }
+  return NULL;
+}
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================
+ */
+
+/**
+ * Test: Counters and queue high-water mark
+ */
+void test_counters(void) {
+  printf("\n=== Test: Counters ===\n");
+
+  AudioStatsSnapshot snapshot;
+  hal_stats_reset();
+  hal_stats_count(AUDIO_COUNT_XRUNS);
+  hal_stats_count(AUDIO_COUNT_XRUNS);
+  hal_stats_count(AUDIO_COUNT_RECOVERIES);
+  hal_stats_note_queue_ms(40);
+  hal_stats_note_queue_ms(250);
+  hal_stats_note_queue_ms(75);
+  hal_stats_snapshot(&snapshot);
+
+  CHECK(snapshot.counters[AUDIO_COUNT_XRUNS] == 2 &&
+            snapshot.counters[AUDIO_COUNT_RECOVERIES] == 1 &&
+            snapshot.counters[AUDIO_COUNT_INTERRUPTS] == 0,
+        "counters", "wrong counts");
+  CHECK(snapshot.queue_max_ms == 250, "queue high-water mark",
+        "deepest backlog not kept");
+}
+
+/**
+ * Test: Single values land in a bucket within 25%
+ */
+void test_buckets(void) {
+  printf("\n=== Test: Bucket Accuracy ===\n");
+
+  static const uint32_t values[] = {0,    1,     3,      5,       7,
+                                    100,  999,   1024,   25000,   77777,
+                                    5000000};
+  int ok = 1;
+  for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+    hal_stats_reset();
+    hal_stats_record_us(AUDIO_LAT_PCM_TO_DEVICE, values[i]);
+    uint32_t p50 = hal_stats_percentile(AUDIO_LAT_PCM_TO_DEVICE, 0.5);
+    /* One sample: the bucket edge is clipped to the exact max */
+    if (p50 != values[i]) {
+      printf("    %u us reported as %u\n", values[i], p50);
+      ok = 0;
+    }
+  }
+  CHECK(ok, "single sample reported exactly", "wrong value");
+
+  ok = 1;
+  for (uint32_t micros = 1; micros < 2000000; micros = micros * 5 / 4 + 1) {
+    hal_stats_reset();
+    hal_stats_record_us(AUDIO_LAT_PCM_TO_DEVICE, micros);
+    hal_stats_record_us(AUDIO_LAT_PCM_TO_DEVICE, 100000000);
+    if (!within_bucket(hal_stats_percentile(AUDIO_LAT_PCM_TO_DEVICE, 0.5),
+                       micros)) {
+      ok = 0;
+    }
+  }
+  CHECK(ok, "bucket edge within 25%", "bucket too wide");
+}
+
+/**
+ * Test: Percentiles of a known distribution
+ */
+void test_percentiles(void) {
+  printf("\n=== Test: Percentiles ===\n");
+
+  AudioStatsSnapshot snapshot;
+  hal_stats_reset();
+  CHECK(hal_stats_percentile(AUDIO_LAT_TTS_FIRST_PCM, 0.5) == 0,
+        "empty histogram reads 0", "nonzero");
+
+  /* 1..1000 ms in 1 ms steps */
+  for (uint32_t ms = 1; ms <= 1000; ms++) {
+    hal_stats_record_us(AUDIO_LAT_TTS_FIRST_PCM, ms * 1000);
+  }
+  hal_stats_snapshot(&snapshot);
+  LatencySummary *summary = &snapshot.latency[AUDIO_LAT_TTS_FIRST_PCM];
+
+  CHECK(summary->count == 1000, "count", "wrong count");
+  CHECK(within_bucket(summary->p50_us, 500000), "p50", "wrong p50");
+  CHECK(within_bucket(summary->p90_us, 900000), "p90", "wrong p90");
+  CHECK(within_bucket(summary->p99_us, 990000), "p99", "wrong p99");
+  CHECK(summary->max_us == 1000000, "max is exact", "wrong max");
+  CHECK(summary->p99_us <= summary->max_us, "p99 clipped to max",
+        "p99 above max");
+  CHECK(snapshot.latency[AUDIO_LAT_BEEP_START].count == 0,
+        "histograms independent", "sample leaked into another histogram");
+}
+
+/**
+ * Test: Reset zeroes everything
+ */
+void test_reset(void) {
+  printf("\n=== Test: Reset ===\n");
+
+  AudioStatsSnapshot snapshot;
+  hal_stats_count(AUDIO_COUNT_INTERRUPTS);
+  hal_stats_record_us(AUDIO_LAT_BEEP_START, 1234);
+  hal_stats_note_queue_ms(99);
+  hal_stats_reset();
+  hal_stats_snapshot(&snapshot);
+
+  int zero = snapshot.queue_max_ms == 0;
+  for (int c = 0; c < AUDIO_COUNT_TOTAL; c++) {
+    zero = zero && snapshot.counters[c] == 0;
+  }
+  for (int l = 0; l < AUDIO_LAT_TOTAL; l++) {
+    zero = zero && snapshot.latency[l].count == 0 &&
+           snapshot.latency[l].max_us == 0 && snapshot.latency[l].p99_us == 0;
+  }
+  CHECK(zero, "everything zeroed", "value survived reset");
+}
+
+/**
+ * Test: Updates from several threads are not lost
+ */
+void test_threads(void) {
+  printf("\n=== Test: Concurrent Updates ===\n");
+
+  pthread_t threads[THREADS];
+  AudioStatsSnapshot snapshot;
+  hal_stats_reset();
+  for (int i = 0; i < THREADS; i++) {
+    pthread_create(&threads[i], NULL, hammer, NULL);
+  }
+  for (int i = 0; i < THREADS; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  hal_stats_snapshot(&snapshot);
+
+  CHECK(snapshot.counters[AUDIO_COUNT_DROPS] == THREADS * PER_THREAD,
+        "no lost counts", "counter updates lost");
+  CHECK(snapshot.latency[AUDIO_LAT_BEEP_START].count == THREADS * PER_THREAD,
+        "no lost samples", "histogram updates lost");
+  CHECK(snapshot.latency[AUDIO_LAT_BEEP_START].max_us == 1000,
+        "max across threads", "wrong max");
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================
+ */
+
+int main(void) {
+  printf("=============================================\n");
+  printf("  HAMPOD Audio Statistics Unit Tests\n");
+  printf("=============================================\n");
+
+  test_counters();
+  test_buckets();
+  test_percentiles();
+  test_reset();
+  test_threads();
+
+  printf("\n=============================================\n");
+  printf("  Results: %d passed, %d failed\n", tests_passed, tests_failed);
+  printf("=============================================\n");
+
+  return tests_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,189 @@
+/**
+ * @file test_hal_audio_stretch.c
+ * @brief Unit tests for the WSOLA time-stretch
+ *
+ * Runs without an audio device: stretches synthetic tones through
+ * hal_audio_stretch.c and measures length, pitch and level.
+ */
+
+#include "../hal_audio_stretch.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* Test result counters */
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_PASS(name)                                                        \
+  do {                                                                         \
+    printf("  [PASS] %s\n", name);                                             \
+    tests_passed++;                                                            \
+  } while (0)
+
+#define TEST_FAIL(name, reason)                                                \
+  do {                                                                         \
+    printf("  [FAIL] %s: %s\n", name, reason);                                 \
+    tests_failed++;                                                            \
+  } while (0)
+
+#define CHECK(cond, name, reason)                                              \
+  do {                                                                         \
+    if (cond) {                                                                \
+      TEST_PASS(name);                                                         \
+    } else {                                                                   \
+      TEST_FAIL(name, reason);                                                 \
+    }                                                                          \
+  } while (0)
+
+#define TONE_SAMPLES 16000 /* One second */
+#define CHUNK 800          /* As Piper delivers it */
+
+static int16_t tone[TONE_SAMPLES];
+static int16_t
+    output[TONE_SAMPLES * (size_t)STRETCH_MAX_FACTOR + 4 * STRETCH_FRAME];
+static AudioStretch stretch;
+
+static void make_tone(double hz, double amplitude) {
+  for (int i = 0; i < TONE_SAMPLES; i++) {
+    tone[i] = (int16_t)(amplitude * sin(2.0 * M_PI * hz * i / 16000.0));
+  }
+}
+
+/* Stretch the tone in Piper-sized chunks; returns the output length */
+static size_t run(float factor) {
+  size_t written = 0;
+  hal_stretch_init(&stretch, factor);
+  for (int pos = 0; pos < TONE_SAMPLES; pos += CHUNK) {
+    written += hal_stretch_process(&stretch, tone + pos, CHUNK,
+                                   output + written);
+  }
+  return written + hal_stretch_flush(&stretch, output + written);
+}
+
+/* Frequency by rising zero crossings over the middle half */
+static double pitch_of(size_t length) {
+  size_t start = length / 4, end = 3 * length / 4;
+  int crossings = 0;
+  for (size_t i = start + 1; i < end; i++) {
+    if (output[i - 1] < 0 && output[i] >= 0) {
+      crossings++;
+    }
+  }
+  return crossings / ((end - start) / 16000.0);
+}
+
+static double rms_of(size_t length) {
+  size_t start = length / 4, end = 3 * length / 4;
+  double sum = 0.0;
+  for (size_t i = start; i < end; i++) {
+    sum += (double)output[i] * output[i];
+  }
+  return sqrt(sum / (end - start));
+}
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================
+ */
+
+/**
+ * Test: Output length is the input length times the factor
+ */
+void test_length(void) {
+  printf("\n=== Test: Length ===\n");
+
+  make_tone(200.0, 8000.0);
+  const float factors[] = {0.5f, 0.8f, 1.3f, 2.0f};
+  int exact = 1;
+  for (int i = 0; i < 4; i++) {
+    size_t length = run(factors[i]);
+    if (length != (size_t)lround(TONE_SAMPLES * factors[i])) {
+      printf("    factor %.2f: %zu samples\n", factors[i], length);
+      exact = 0;
+    }
+  }
+  CHECK(exact, "length scales exactly", "wrong output length");
+
+  size_t length = run(1.0f);
+  CHECK(length == TONE_SAMPLES &&
+            memcmp(output, tone, sizeof(tone)) == 0,
+        "factor 1 is a passthrough", "changed the samples");
+
+  CHECK(run(0.01f) == TONE_SAMPLES / 4 && run(9.0f) == TONE_SAMPLES * 4,
+        "factor clamped to 0.25-4", "clamp not applied");
+}
+
+/**
+ * Test: Pitch and level are kept while the duration changes
+ */
+void test_pitch(void) {
+  printf("\n=== Test: Pitch ===\n");
+
+  const double tones[] = {120.0, 200.0, 310.0};
+  const float factors[] = {0.5f, 0.8f, 1.5f, 2.0f};
+  int pitch_ok = 1, level_ok = 1;
+
+  for (int t = 0; t < 3; t++) {
+    make_tone(tones[t], 8000.0);
+    for (int f = 0; f < 4; f++) {
+      size_t length = run(factors[f]);
+      double pitch = pitch_of(length);
+      double rms = rms_of(length);
+      if (fabs(pitch - tones[t]) > tones[t] * 0.03) {
+        printf("    %.0f Hz at %.2f: %.1f Hz\n", tones[t], factors[f], pitch);
+        pitch_ok = 0;
+      }
+      if (fabs(rms - 8000.0 / sqrt(2.0)) > 8000.0 / sqrt(2.0) * 0.05) {
+        printf("    %.0f Hz at %.2f: rms %.0f\n", tones[t], factors[f], rms);
+        level_ok = 0;
+      }
+    }
+  }
+  CHECK(pitch_ok, "pitch within 3%", "pitch moved");
+  CHECK(level_ok, "level within 5%", "frames cancelled or doubled");
+}
+
+/**
+ * Test: Full-scale input does not wrap around
+ */
+void test_clipping(void) {
+  printf("\n=== Test: Clipping ===\n");
+
+  make_tone(200.0, 32767.0);
+  size_t length = run(1.5f);
+  int wrapped = 0;
+  for (size_t i = 1; i < length; i++) {
+    if (abs(output[i] - output[i - 1]) > 20000) {
+      wrapped = 1;
+    }
+  }
+  CHECK(!wrapped, "full scale saturates", "sample wrapped");
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================
+ */
+
+int main(void) {
+  printf("=============================================\n");
+  printf("  HAMPOD Time-Stretch Unit Tests\n");
+  printf("=============================================\n");
+
+  test_length();
+  test_pitch();
+  test_clipping();
+
+  printf("\n=============================================\n");
+  printf("  Results: %d passed, %d failed\n", tests_passed, tests_failed);
+  printf("=============================================\n");
+
+  return tests_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,363 @@
+/**
+ * @file test_hal_tts_cache.c
+ * @brief Unit tests for the synthesized speech cache
+ *
+ * Runs without an audio device or Piper: stores made-up utterances and
+ * exercises hal_tts_cache.c directly, with its store file under /tmp.
+ */
+
+#include "../hal_tts_cache.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Test result counters */
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_PASS(name)                                                        \
+  do {                                                                         \
+    printf("  [PASS] %s\n", name);                                             \
+    tests_passed++;                                                            \
+  } while (0)
+
+#define TEST_FAIL(name, reason)                                                \
+  do {                                                                         \
+    printf("  [FAIL] %s: %s\n", name, reason);                                 \
+    tests_failed++;                                                            \
+  } while (0)
+
+#define CHECK(cond, name, reason)                                              \
+  do {                                                                         \
+    if (cond) {                                                                \
+      TEST_PASS(name);                                                         \
+    } else {                                                                   \
+      TEST_FAIL(name, reason);                                                 \
+    }                                                                          \
+  } while (0)
+
+#define MODEL "en_US-lessac-low.onnx"
+
+static char store_path[64];
+
+/* Store num_samples copies of value as the speech for text */
+static int store(const char *text, float speed, size_t num_samples,
+                 int16_t value) {
+  int16_t *samples = (int16_t *)malloc(num_samples * sizeof(int16_t));
+  for (size_t i = 0; i < num_samples; i++) {
+    samples[i] = value;
+  }
+  int result = hal_tts_cache_store(text, MODEL, speed, samples, num_samples);
+  free(samples);
+  return result;
+}
+
+/* Acquire, check the first sample, release */
+static int holds(const char *text, float speed, int16_t value) {
+  const CachedAudio *audio = hal_tts_cache_acquire(text, MODEL, speed);
+  int ok = audio != NULL && audio->num_samples > 0 &&
+           audio->samples[0] == value &&
+           audio->samples[audio->num_samples - 1] == value;
+  hal_tts_cache_release(audio);
+  return ok;
+}
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================
+ */
+
+/**
+ * Test: Hits return what was stored, under the exact text, model and speed
+ */
+void test_lookup(void) {
+  printf("\n=== Test: Lookup ===\n");
+
+  TtsCacheStats stats;
+  hal_tts_cache_init(64 * 1024, NULL);
+
+  CHECK(hal_tts_cache_acquire("VFO A", MODEL, 1.0f) == NULL,
+        "empty cache misses", "hit on an empty cache");
+  CHECK(store("VFO A", 1.0f, 1000, 7) == 0, "store utterance",
+        "store failed");
+  CHECK(holds("VFO A", 1.0f, 7), "hit returns stored PCM",
+        "wrong or missing PCM");
+  CHECK(hal_tts_cache_acquire("VFO B", MODEL, 1.0f) == NULL,
+        "other text misses", "hit on the wrong text");
+  CHECK(hal_tts_cache_acquire("VFO A", MODEL, 0.8f) == NULL,
+        "other speed misses", "hit at the wrong speed");
+  CHECK(hal_tts_cache_acquire("VFO A", "other.onnx", 1.0f) == NULL,
+        "other model misses", "hit with the wrong voice");
+
+  hal_tts_cache_get_stats(&stats);
+  CHECK(stats.hits == 1 && stats.misses == 4, "hits and misses counted",
+        "wrong counters");
+
+  hal_tts_cache_cleanup();
+}
+
+/**
+ * Test: Least recently used utterance leaves RAM, in-use ones do not
+ */
+void test_eviction(void) {
+  printf("\n=== Test: LRU Eviction ===\n");
+
+  TtsCacheStats stats;
+
+  /* Room for one and two (6000 bytes), but not all three */
+  hal_tts_cache_init(8500, NULL);
+  store("one", 1.0f, 1000, 1);
+  store("two", 1.0f, 2000, 2);
+  holds("one", 1.0f, 1); /* one is now most recent */
+
+  store("three", 1.0f, 3000, 3);
+  hal_tts_cache_get_stats(&stats);
+  CHECK(stats.evictions == 1 && stats.entries == 2 && holds("one", 1.0f, 1) &&
+            holds("three", 1.0f, 3),
+        "storing three evicts only two", "wrong utterance evicted");
+  CHECK(stats.bytes <= stats.budget, "stays within budget", "over budget");
+
+  /* three is playing, so four cannot push it out */
+  const CachedAudio *playing = hal_tts_cache_acquire("three", MODEL, 1.0f);
+  store("four", 1.0f, 3000, 4);
+  CHECK(holds("three", 1.0f, 3), "in-use utterance pinned",
+        "evicted a playing utterance");
+  hal_tts_cache_release(playing);
+
+  CHECK(store("huge", 1.0f, 5000, 5) == -1, "over-budget store refused",
+        "stored more than the budget");
+
+  hal_tts_cache_cleanup();
+}
+
+/**
+ * Test: The store outlives the process and is served from the map
+ */
+void test_store(void) {
+  printf("\n=== Test: Store File ===\n");
+
+  TtsCacheStats stats;
+  unlink(store_path);
+
+  CHECK(hal_tts_cache_init(64 * 1024, store_path) == 0, "new store is empty",
+        "found utterances in a new store");
+  store("Frequency Mode", 1.0f, 1200, 11);
+  store("USB", 1.0f, 801, 12); /* Odd length exercises the padding */
+  hal_tts_cache_cleanup();
+
+  CHECK(hal_tts_cache_init(64 * 1024, store_path) == 2, "reopen finds both",
+        "store not reloaded");
+  CHECK(holds("Frequency Mode", 1.0f, 11) && holds("USB", 1.0f, 12),
+        "stored PCM intact", "store contents wrong");
+  hal_tts_cache_get_stats(&stats);
+  CHECK(stats.hits == 2 && stats.bytes == 0, "served from the map, no heap",
+        "copied into RAM");
+  hal_tts_cache_cleanup();
+
+  /* Evicted from RAM this run: read back from the file */
+  hal_tts_cache_init(3000, store_path);
+  store("LSB", 1.0f, 1000, 13);
+  store("CW", 1.0f, 1000, 14); /* Evicts LSB */
+  CHECK(holds("LSB", 1.0f, 13), "evicted utterance read back",
+        "lost after eviction");
+  hal_tts_cache_get_stats(&stats);
+  CHECK(stats.disk_hits == 1 && stats.stored == 4, "read back counted",
+        "wrong store counters");
+  hal_tts_cache_cleanup();
+}
+
+/**
+ * Test: A record torn by a power cut is cut off, earlier ones survive
+ */
+void test_torn_record(void) {
+  printf("\n=== Test: Torn Record ===\n");
+
+  struct stat st;
+  stat(store_path, &st);
+  off_t intact = st.st_size;
+
+  /* Half a record header, as if power failed mid-write */
+  int fd = open(store_path, O_WRONLY | O_APPEND);
+  const uint8_t torn[10] = {0x54, 0x54, 0x52, 0x43, 9, 0, 0, 0, 0x40, 0x1f};
+  if (write(fd, torn, sizeof(torn)) != (ssize_t)sizeof(torn)) {
+    perror("write");
+  }
+  close(fd);
+
+  CHECK(hal_tts_cache_init(64 * 1024, store_path) == 4,
+        "intact records kept", "lost good records");
+  stat(store_path, &st);
+  CHECK(st.st_size == intact, "torn tail truncated", "torn bytes left");
+
+  store("AM", 1.0f, 500, 15);
+  hal_tts_cache_cleanup();
+  CHECK(hal_tts_cache_init(64 * 1024, store_path) == 5 && holds("AM", 1.0f, 15),
+        "appends after the cut", "append after repair lost");
+  hal_tts_cache_cleanup();
+
+  /* Corrupt PCM in the last record: its check fails, but only the lookup
+   * reads the audio to find out */
+  fd = open(store_path, O_WRONLY);
+  stat(store_path, &st);
+  pwrite(fd, "\xff\xff", 2, st.st_size - 4);
+  close(fd);
+  CHECK(hal_tts_cache_init(64 * 1024, store_path) == 5,
+        "init reads headers only", "checked audio at init");
+  CHECK(hal_tts_cache_acquire("AM", MODEL, 1.0f) == NULL &&
+            hal_tts_cache_acquire("AM", MODEL, 1.0f) == NULL,
+        "bad checksum dropped on lookup", "served corrupt audio");
+  TtsCacheStats stats;
+  hal_tts_cache_get_stats(&stats);
+  CHECK(stats.stored == 4 && holds("USB", 1.0f, 12), "other records still served",
+        "good record lost");
+  CHECK(store("AM", 1.0f, 500, 15) == 0 && holds("AM", 1.0f, 15),
+        "dropped utterance stored again", "could not replace it");
+  hal_tts_cache_cleanup();
+}
+
+/**
+ * Test: A full store keeps what this run used and drops the rest
+ *
+ * Built with a 1 MB store: eight 120 KB utterances fill it.
+ */
+void test_compaction(void) {
+  printf("\n=== Test: Store Compaction ===\n");
+
+  TtsCacheStats stats;
+  char text[8];
+  struct stat st;
+  unlink(store_path);
+
+  /* RAM holds two at a time; the rest are served from the store */
+  hal_tts_cache_init(256 * 1024, store_path);
+  for (int i = 0; i < 8; i++) {
+    snprintf(text, sizeof(text), "p%d", i);
+    store(text, 1.0f, 60000, (int16_t)(30 + i));
+  }
+  hal_tts_cache_cleanup();
+
+  CHECK(hal_tts_cache_init(256 * 1024, store_path) == 8, "store filled",
+        "wrong record count");
+  holds("p2", 1.0f, 32);
+  holds("p5", 1.0f, 35);
+  holds("p5", 1.0f, 35);
+  CHECK(store("p8", 1.0f, 60000, 38) == 0, "full store takes a new phrase",
+        "new phrase refused");
+  hal_tts_cache_get_stats(&stats);
+  CHECK(stats.compactions == 1 && stats.stored == 3, "unused records dropped",
+        "wrong records kept");
+  CHECK(holds("p2", 1.0f, 32) && holds("p5", 1.0f, 35) &&
+            holds("p8", 1.0f, 38) &&
+            hal_tts_cache_acquire("p0", MODEL, 1.0f) == NULL,
+        "used phrases survive, stale ones miss", "wrong phrases served");
+  hal_tts_cache_cleanup();
+
+  stat(store_path, &st);
+  CHECK(hal_tts_cache_init(256 * 1024, store_path) == 3 &&
+            st.st_size < 512 * 1024 && holds("p5", 1.0f, 35),
+        "compacted store reopens", "compacted store unreadable");
+
+  /* p5 is playing from the map: the rewrite waits until it is released */
+  const CachedAudio *playing = hal_tts_cache_acquire("p5", MODEL, 1.0f);
+  for (int i = 9; i < 15; i++) {
+    snprintf(text, sizeof(text), "p%d", i);
+    store(text, 1.0f, 60000, (int16_t)(30 + i));
+  }
+  hal_tts_cache_get_stats(&stats);
+  CHECK(stats.compactions == 0 && stats.stored == 8 &&
+            playing->samples[0] == 35,
+        "compaction waits for playback", "rewrote a playing record");
+  hal_tts_cache_release(playing);
+  CHECK(store("p15", 1.0f, 60000, 45) == 0 && holds("p5", 1.0f, 35) &&
+            holds("p15", 1.0f, 45),
+        "compacts once released", "still full after release");
+  hal_tts_cache_cleanup();
+  unlink(store_path);
+}
+
+/**
+ * Test: A phrase bundle is mapped and hit under its voice and speed
+ */
+void test_bundle(void) {
+  printf("\n=== Test: Phrase Bundle ===\n");
+
+  char bundle_path[80];
+  TtsCacheStats stats;
+  int16_t ready[700], cancelled[1001];
+  for (int i = 0; i < 700; i++) {
+    ready[i] = 21;
+  }
+  for (int i = 0; i < 1001; i++) {
+    cancelled[i] = 22;
+  }
+  const char *texts[] = {"Ready", "Cancelled"};
+  const int16_t *samples[] = {ready, cancelled};
+  size_t lengths[] = {700, 1001};
+  snprintf(bundle_path, sizeof(bundle_path), "%s.phrases", store_path);
+
+  /* Built with a different path to the same voice, as make phrases does */
+  CHECK(hal_tts_cache_write_bundle(bundle_path, "../Firmware/models/" MODEL,
+                                   1.0f, texts, samples, lengths, 2) == 0,
+        "write bundle", "write failed");
+
+  hal_tts_cache_init(64 * 1024, NULL);
+  CHECK(hal_tts_cache_load_bundle(bundle_path) == 2, "load bundle",
+        "wrong phrase count");
+  CHECK(holds("Ready", 1.0f, 21) && holds("Cancelled", 1.0f, 22),
+        "phrases hit under another model path", "bundle phrase missed");
+  CHECK(hal_tts_cache_acquire("Ready", MODEL, 1.5f) == NULL,
+        "other speed misses", "hit at the wrong speed");
+  hal_tts_cache_get_stats(&stats);
+  CHECK(stats.bundled == 2 && stats.bytes == 0, "served from the map",
+        "copied into RAM");
+  hal_tts_cache_cleanup();
+
+  /* Table pointing past the end of a truncated file */
+  struct stat st;
+  stat(bundle_path, &st);
+  CHECK(truncate(bundle_path, st.st_size - 8) == 0, "truncate bundle",
+        "truncate failed");
+  hal_tts_cache_init(64 * 1024, NULL);
+  CHECK(hal_tts_cache_load_bundle(bundle_path) == 1 && holds("Ready", 1.0f, 21),
+        "damaged bundle keeps intact phrases", "damaged bundle mishandled");
+  hal_tts_cache_cleanup();
+
+  hal_tts_cache_init(64 * 1024, NULL);
+  CHECK(hal_tts_cache_load_bundle(store_path) == -1, "store is not a bundle",
+        "accepted a foreign file");
+  hal_tts_cache_cleanup();
+  unlink(bundle_path);
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================
+ */
+
+int main(void) {
+  printf("=============================================\n");
+  printf("  HAMPOD TTS Cache Unit Tests\n");
+  printf("=============================================\n");
+
+  snprintf(store_path, sizeof(store_path), "/tmp/hampod_tts_cache_%d.bin",
+           (int)getpid());
+
+  test_lookup();
+  test_eviction();
+  test_store();
+  test_torn_record();
+  test_compaction();
+  test_bundle();
+
+  unlink(store_path);
+
+  printf("\n=============================================\n");
+  printf("  Results: %d passed, %d failed\n", tests_passed, tests_failed);
+  printf("=============================================\n");
+
+  return tests_failed > 0 ? 1 : 0;
+}
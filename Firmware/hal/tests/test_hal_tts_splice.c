@@ -0,0 +1,203 @@
+/**
+ * @file test_hal_tts_splice.c
+ * @brief Unit tests for the number and frequency splicer
+ *
+ * Runs without an audio device or Piper: word clips are made up and put in
+ * the speech cache, then spliced by hal_tts_splice.c.
+ */
+
+#include "../hal_tts_cache.h"
+#include "../hal_tts_splice.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Test result counters */
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_PASS(name)                                                        \
+  do {                                                                         \
+    printf("  [PASS] %s\n", name);                                             \
+    tests_passed++;                                                            \
+  } while (0)
+
+#define TEST_FAIL(name, reason)                                                \
+  do {                                                                         \
+    printf("  [FAIL] %s: %s\n", name, reason);                                 \
+    tests_failed++;                                                            \
+  } while (0)
+
+#define CHECK(cond, name, reason)                                              \
+  do {                                                                         \
+    if (cond) {                                                                \
+      TEST_PASS(name);                                                         \
+    } else {                                                                   \
+      TEST_FAIL(name, reason);                                                 \
+    }                                                                          \
+  } while (0)
+
+#define MODEL "en_US-lessac-low.onnx"
+
+/* Clip layout: 1000 samples of silence, the word, 1000 of silence */
+#define LEAD 1000
+#define WORD 2000
+
+/* Render text and compare with the expected space-separated words */
+static int renders(const char *text, const char *expected) {
+  const char *words[SPLICE_MAX_WORDS];
+  char joined[512] = "";
+  int count = hal_tts_splice_words(text, words, SPLICE_MAX_WORDS);
+  if (count < 0) {
+    return expected == NULL;
+  }
+  for (int i = 0; i < count; i++) {
+    if (i > 0) {
+      strcat(joined, " ");
+    }
+    strcat(joined, words[i]);
+  }
+  if (expected == NULL || strcmp(joined, expected) != 0) {
+    printf("    \"%s\" -> \"%s\"\n", text, joined);
+    return 0;
+  }
+  return 1;
+}
+
+/* Cache a clip for word whose speech is a constant level */
+static void store_clip(const char *word, int16_t level) {
+  int16_t clip[LEAD + WORD + LEAD] = {0};
+  for (int i = 0; i < WORD; i++) {
+    clip[LEAD + i] = level;
+  }
+  hal_tts_cache_store(word, MODEL, 1.0f, clip, LEAD + WORD + LEAD);
+}
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================
+ */
+
+/**
+ * Test: Text is rendered into vocabulary words, or refused
+ */
+void test_words(void) {
+  printf("\n=== Test: Formatter ===\n");
+
+  CHECK(renders("14 point 2 5 0 0 0  megahertz",
+                "fourteen point two five zero zero zero megahertz"),
+        "frequency readout", "wrong words");
+  CHECK(renders("144 megahertz", "one hundred forty four megahertz"),
+        "hundreds", "wrong words");
+  CHECK(renders("1296", "one thousand two hundred ninety six"),
+        "thousands", "wrong words");
+  CHECK(renders("7", "seven") && renders("0", "zero"), "single digit",
+        "wrong words");
+  CHECK(renders("S9 plus 10 dB", "S nine plus ten D B"), "S-meter reading",
+        "wrong words");
+  CHECK(renders("6 D B", "six D B") && renders("-3.5", "minus three point five"),
+        "D B, negatives and decimals", "wrong words");
+  CHECK(renders("50 watts", "fifty watts") &&
+            renders("2 kilohertz", "two kilohertz"),
+        "units", "wrong words");
+  CHECK(renders("Tuning step is 5 kilohertz", NULL) && renders("", NULL) &&
+            renders("1.", NULL) && renders("VFO A", NULL),
+        "other text refused", "spliced text outside the vocabulary");
+}
+
+/**
+ * Test: Clips are trimmed and crossfaded into one stream
+ */
+void test_splice(void) {
+  printf("\n=== Test: Splicer ===\n");
+
+  size_t num_samples = 0;
+  hal_tts_cache_init(1024 * 1024, NULL);
+  store_clip("fourteen", 1000);
+  store_clip("point", 2000);
+
+  CHECK(hal_tts_splice("14 point 2", MODEL, 1.0f, &num_samples) == NULL,
+        "missing clip falls back", "spliced without a clip for two");
+
+  store_clip("two", 3000);
+  int16_t *pcm = hal_tts_splice("14 point 2", MODEL, 1.0f, &num_samples);
+  /* Each clip keeps 10 ms either side; two 5 ms overlaps */
+  size_t expected = 3 * (160 + WORD + 160) - 2 * 80;
+  CHECK(pcm != NULL && num_samples == expected, "trimmed and overlapped",
+        "wrong length");
+
+  if (pcm != NULL) {
+    int in_range = 1;
+    int saw[3] = {0, 0, 0};
+    for (size_t i = 0; i < num_samples; i++) {
+      if (pcm[i] < 0 || pcm[i] > 3000) {
+        in_range = 0;
+      }
+      if (pcm[i] == 1000) {
+        saw[0] = 1;
+      } else if (pcm[i] == 2000) {
+        saw[1] = 1;
+      } else if (pcm[i] == 3000) {
+        saw[2] = 1;
+      }
+    }
+    CHECK(in_range && saw[0] && saw[1] && saw[2], "words in order, no overshoot",
+          "crossfade out of range");
+    CHECK(pcm[0] == 0 && pcm[160] == 1000 && pcm[num_samples - 1] == 0,
+          "lead-in and tail padding kept", "padding wrong");
+    free(pcm);
+  }
+
+  CHECK(hal_tts_splice("14 point 2", MODEL, 1.5f, &num_samples) == NULL,
+        "other speed falls back", "spliced clips of the wrong speed");
+  hal_tts_cache_cleanup();
+}
+
+/**
+ * Test: Every rendered word is in the vocabulary make phrases bundles
+ */
+void test_vocabulary(void) {
+  printf("\n=== Test: Vocabulary ===\n");
+
+  size_t count = 0;
+  const char *const *vocabulary = hal_tts_splice_vocabulary(&count);
+  const char *words[SPLICE_MAX_WORDS];
+  int n = hal_tts_splice_words(
+      "0 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20 30 40 50 60 70 "
+      "80 90 100 1000 point plus minus megahertz kilohertz hertz watts dB S9",
+      words, SPLICE_MAX_WORDS);
+  int covered = n > 0;
+  for (int i = 0; i < n; i++) {
+    int found = 0;
+    for (size_t j = 0; j < count; j++) {
+      found |= strcmp(words[i], vocabulary[j]) == 0;
+    }
+    if (!found) {
+      printf("    missing: %s\n", words[i]);
+      covered = 0;
+    }
+  }
+  CHECK(covered, "vocabulary covers every word", "word without a clip");
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================
+ */
+
+int main(void) {
+  printf("=============================================\n");
+  printf("  HAMPOD TTS Splicer Unit Tests\n");
+  printf("=============================================\n");
+
+  test_words();
+  test_splice();
+  test_vocabulary();
+
+  printf("\n=============================================\n");
+  printf("  Results: %d passed, %d failed\n", tests_passed, tests_failed);
+  printf("=============================================\n");
+
+  return tests_failed > 0 ? 1 : 0;
+}
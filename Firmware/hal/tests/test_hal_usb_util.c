@@ -112,6 +112,41 @@ void test_get_port_path(void) {
   printf("  [SKIP] No USB devices available to test port path\n");
 }
 
+void test_parse_uevent(void) {
+  printf("\n=== Test: Parse Sound Uevents ===\n");
+
+  static const char card_add[] =
+      "add@/devices/platform/usb/1-1/1-1:1.0/sound/card2\0ACTION=add\0"
+      "DEVPATH=/devices/platform/usb/1-1/1-1:1.0/sound/card2\0"
+      "SUBSYSTEM=sound\0SEQNUM=1234";
+  static const char pcm_remove[] =
+      "remove@/devices/x/sound/card1/pcmC1D0p\0ACTION=remove\0"
+      "DEVPATH=/devices/x/sound/card1/pcmC1D0p\0SUBSYSTEM=sound\0"
+      "DEVNAME=snd/pcmC1D0p";
+  static const char usb_add[] =
+      "add@/devices/platform/usb/1-1\0ACTION=add\0"
+      "DEVPATH=/devices/platform/usb/1-1\0SUBSYSTEM=usb";
+  static const char sound_change[] =
+      "change@/devices/x/sound/card1\0ACTION=change\0"
+      "DEVPATH=/devices/x/sound/card1\0SUBSYSTEM=sound";
+  SoundCardEvent event = {0, -1};
+
+  TEST_ASSERT(hal_usb_parse_uevent(card_add, sizeof(card_add), &event) == 1 &&
+                  event.added == 1 && event.card_number == 2,
+              "Card add parsed");
+  TEST_ASSERT(hal_usb_parse_uevent(pcm_remove, sizeof(pcm_remove), &event) ==
+                      1 &&
+                  event.added == 0 && event.card_number == 1,
+              "PCM removal reports its card");
+  TEST_ASSERT(hal_usb_parse_uevent(usb_add, sizeof(usb_add), &event) == 0,
+              "Non-sound event ignored");
+  TEST_ASSERT(hal_usb_parse_uevent(sound_change, sizeof(sound_change),
+                                   &event) == 0,
+              "Change event ignored");
+  TEST_ASSERT(hal_usb_parse_uevent(card_add, 20, &event) == 0,
+              "Truncated message ignored");
+}
+
 int main(void) {
   printf("=============================================\n");
   printf("  HAMPOD USB Utility Unit Tests\n");
@@ -121,6 +156,7 @@ int main(void) {
   test_find_audio_preferred();
   test_find_audio_any_usb();
   test_get_port_path();
+  test_parse_uevent();
 
   printf("\n=============================================\n");
   printf("  Results: %d passed, %d failed\n", tests_passed, tests_failed);
@@ -7,6 +7,8 @@ Inst_packet* create_inst_packet(Packet_type new_type, unsigned short new_len, un
     new->type = new_type;
     new->data_len = new_len;
     new->tag = tag;
+    /* Callers that received a class byte overwrite this */
+    new->priority = frame_default_class(new_type, new_data, new_len);
     new->data = malloc(new_len);
     memcpy(new->data, new_data, new_len);
     return new;
@@ -1,6 +1,8 @@
 #ifndef HAMPOD_PACKET
 #define HAMPOD_PACKET
 
+#include "hampod_frame.h"
+
 typedef enum {
     KEYPAD,
     AUDIO,
@@ -12,11 +14,63 @@ typedef struct Inst_packet {
     Packet_type type;
     unsigned short data_len;
     unsigned short tag;
+    unsigned char priority; /* FRAME_CLASS_*, picks the Packet_queue lane */
     unsigned char *data;
 } Inst_packet;
 
 Inst_packet* create_inst_packet(Packet_type new_type, unsigned short new_len, unsigned char *new_data, unsigned short tag);
 void destroy_inst_packet(Inst_packet** packet);
+
+/* Keypad requests (first data byte of a KEYPAD packet sent to the Firmware) */
+#define KEYPAD_REQUEST_READ 'r'      /* Poll: reply with one key char */
+#define KEYPAD_REQUEST_SUBSCRIBE 's' /* Push: stream events as they occur */
+
+/* Push-mode keypad event actions */
+#define KEYPAD_EVENT_PRESS 'p'
+#define KEYPAD_EVENT_REPEAT 'h'
+#define KEYPAD_EVENT_RELEASE 'u'
+#define KEYPAD_EVENT_SUBSCRIBED 's' /* Ack for KEYPAD_REQUEST_SUBSCRIBE */
+
+/* Payload of a push-mode KEYPAD packet. Poll replies stay one byte long, so
+ * the two can be told apart by data_len. Timestamps come straight from the
+ * kernel input event (CLOCK_MONOTONIC when the device supports it). */
+typedef struct Keypad_event_payload {
+    unsigned char key;
+    unsigned char action;
+    unsigned short reserved;
+    unsigned int sec;
+    unsigned int usec;
+} Keypad_event_payload;
+
+/* Audio requests answered with something other than an int */
+#define AUDIO_REQUEST_STATS 'm' /* "m" reads, "mr" reads then zeroes */
+
+/* One latency histogram in an Audio_stats_payload, in microseconds.
+ * Percentiles are bucket upper edges (within 25%); max is exact. */
+typedef struct Audio_latency_wire {
+    unsigned int count;
+    unsigned int p50_us;
+    unsigned int p90_us;
+    unsigned int p99_us;
+    unsigned int max_us;
+} Audio_latency_wire;
+
+/* Reply to AUDIO_REQUEST_STATS (see hal/hal_audio_stats.h), little-endian.
+ * Counters run from audio process start or the last "mr". */
+#define AUDIO_STATS_VERSION 1
+typedef struct Audio_stats_payload {
+    unsigned char version; /* AUDIO_STATS_VERSION */
+    unsigned char reserved[3];
+    unsigned int xruns;
+    unsigned int recoveries;
+    unsigned int interrupts;
+    unsigned int drops;
+    unsigned int queue_ms;     /* Backlog right now */
+    unsigned int queue_max_ms; /* Deepest backlog seen */
+    Audio_latency_wire tts_first_pcm; /* TTS request -> first PCM */
+    Audio_latency_wire pcm_to_device; /* Speech/file PCM -> speaker */
+    Audio_latency_wire beep_start;    /* Beep request -> speaker */
+} Audio_stats_payload;
 #ifndef SHAREDLIB
 #include "hampod_firm_packet.c"
 #endif
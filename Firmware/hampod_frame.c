@@ -0,0 +1,235 @@
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "hampod_frame.h"
+
+#define FRAME_READER_MASK (FRAME_READER_BUFFER_SIZE - 1)
+
+int frame_write(int fd, int type, unsigned short tag, const void *data,
+                unsigned short data_len) {
+    unsigned char header[FRAME_HEADER_SIZE];
+    int32_t wire_type = type;
+    memcpy(header, &wire_type, 4);
+    memcpy(header + 4, &data_len, 2);
+    memcpy(header + 6, &tag, 2);
+
+    struct iovec iov[2];
+    iov[0].iov_base = header;
+    iov[0].iov_len = sizeof(header);
+    iov[1].iov_base = (void *)data;
+    iov[1].iov_len = data_len;
+    struct iovec *next = iov;
+    int count = data_len > 0 ? 2 : 1;
+
+    while (count > 0) {
+        ssize_t written = writev(fd, next, count);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        /* Skip past whatever made it out and retry with the rest */
+        while (count > 0 && (size_t)written >= next->iov_len) {
+            written -= next->iov_len;
+            next++;
+            count--;
+        }
+        if (count > 0) {
+            next->iov_base = (unsigned char *)next->iov_base + written;
+            next->iov_len -= written;
+        }
+    }
+    return 0;
+}
+
+int frame_write_message(int fd, int type, unsigned short tag, const void *data,
+                        size_t data_len, size_t max_frame) {
+    const unsigned char *next = data;
+    if (data_len > FRAME_MAX_MESSAGE || max_frame == 0) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    /* A message that fits goes out as one plain frame, which version 1
+     * receivers can read */
+    while (data_len > max_frame) {
+        int more = type | (FRAME_FLAG_MORE << FRAME_FLAGS_SHIFT);
+        if (frame_write(fd, more, tag, next, (unsigned short)max_frame) != 0) {
+            return -1;
+        }
+        next += max_frame;
+        data_len -= max_frame;
+    }
+    return frame_write(fd, type, tag, next, (unsigned short)data_len);
+}
+
+int frame_default_class(int type, const unsigned char *data,
+                        size_t data_len) {
+    switch (type) {
+    case 0: /* KEYPAD */
+        return FRAME_CLASS_KEYPAD;
+    case 1: /* AUDIO */
+        if (data_len == 0) {
+            return FRAME_CLASS_BULK;
+        }
+        switch (data[0]) {
+        case 'i':
+            return FRAME_CLASS_INTERRUPT;
+        case 'b':
+            return FRAME_CLASS_BEEP;
+        case 's':
+        case 'q':
+        case 'v':
+        case 'm':
+        case 'o':
+            return FRAME_CLASS_CONTROL;
+        default:
+            return FRAME_CLASS_BULK;
+        }
+    case 3: /* CONFIG */
+        return FRAME_CLASS_CONTROL;
+    default:
+        return FRAME_CLASS_BULK;
+    }
+}
+
+void frame_decode_type(Frame_header *header, int wire_type) {
+    header->type = wire_type & FRAME_TYPE_MASK;
+    header->flags = (unsigned char)((unsigned int)wire_type >>
+                                    FRAME_FLAGS_SHIFT);
+    header->priority = (unsigned char)((unsigned int)wire_type >>
+                                       FRAME_CLASS_SHIFT);
+}
+
+void frame_reader_init(Frame_reader *reader, int fd) {
+    reader->fd = fd;
+    reader->head = 0;
+    reader->tail = 0;
+    reader->discard = 0;
+}
+
+size_t frame_reader_buffered(const Frame_reader *reader) {
+    return reader->tail - reader->head;
+}
+
+/* Copy len bytes starting offset bytes past head, handling wrap-around */
+static void ring_copy(const Frame_reader *reader, size_t offset,
+                      unsigned char *out, size_t len) {
+    if (len == 0) {
+        return;
+    }
+    size_t start = (reader->head + offset) & FRAME_READER_MASK;
+    size_t first = FRAME_READER_BUFFER_SIZE - start;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(out, reader->buffer + start, first);
+    memcpy(out + first, reader->buffer, len - first);
+}
+
+/* Fill all free space (both sides of the wrap) with one readv() */
+static int ring_fill(Frame_reader *reader) {
+    size_t free_space = FRAME_READER_BUFFER_SIZE - frame_reader_buffered(reader);
+    size_t start = reader->tail & FRAME_READER_MASK;
+    size_t first = FRAME_READER_BUFFER_SIZE - start;
+    if (first > free_space) {
+        first = free_space;
+    }
+
+    struct iovec iov[2];
+    iov[0].iov_base = reader->buffer + start;
+    iov[0].iov_len = first;
+    iov[1].iov_base = reader->buffer;
+    iov[1].iov_len = free_space - first;
+
+    for (;;) {
+        ssize_t got = readv(reader->fd, iov, iov[1].iov_len > 0 ? 2 : 1);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0) {
+            return FRAME_ERROR;
+        }
+        if (got == 0) {
+            return FRAME_EOF;
+        }
+        reader->tail += got;
+        return FRAME_OK;
+    }
+}
+
+int frame_read(Frame_reader *reader, Frame_header *header,
+               unsigned char *data, size_t data_size) {
+    for (;;) {
+        size_t available = frame_reader_buffered(reader);
+
+        if (reader->discard > 0) {
+            size_t skip = available < reader->discard ? available
+                                                      : reader->discard;
+            reader->head += skip;
+            reader->discard -= skip;
+            available -= skip;
+        }
+
+        if (reader->discard == 0 && available >= FRAME_HEADER_SIZE) {
+            unsigned char raw[FRAME_HEADER_SIZE];
+            int32_t wire_type;
+            ring_copy(reader, 0, raw, sizeof(raw));
+            memcpy(&wire_type, raw, 4);
+            memcpy(&header->data_len, raw + 4, 2);
+            memcpy(&header->tag, raw + 6, 2);
+            frame_decode_type(header, wire_type);
+
+            if (header->data_len > data_size ||
+                (size_t)header->data_len >
+                    (size_t)(FRAME_READER_BUFFER_SIZE - FRAME_HEADER_SIZE)) {
+                reader->head += FRAME_HEADER_SIZE;
+                reader->discard = header->data_len;
+                return FRAME_TOO_LARGE;
+            }
+
+            if (available >= (size_t)FRAME_HEADER_SIZE + header->data_len) {
+                ring_copy(reader, FRAME_HEADER_SIZE, data, header->data_len);
+                reader->head += FRAME_HEADER_SIZE + header->data_len;
+                return FRAME_OK;
+            }
+        }
+
+        int result = ring_fill(reader);
+        if (result != FRAME_OK) {
+            return result;
+        }
+    }
+}
+
+int frame_read_message(Frame_reader *reader, Frame_header *header,
+                       unsigned char *data, size_t data_size) {
+    size_t total = 0;
+    int overflow = 0;
+
+    for (;;) {
+        /* Once the message has overflowed, later chunks are only skipped */
+        size_t room = overflow ? 0 : data_size - total;
+        int result = frame_read(reader, header, overflow ? NULL : data + total,
+                                room);
+        if (result == FRAME_TOO_LARGE) {
+            overflow = 1;
+        } else if (result != FRAME_OK) {
+            return result;
+        } else {
+            total += header->data_len;
+        }
+
+        if (!(header->flags & FRAME_FLAG_MORE)) {
+            if (overflow) {
+                return FRAME_TOO_LARGE;
+            }
+            header->data_len = (unsigned short)total;
+            return FRAME_OK;
+        }
+    }
+}
@@ -0,0 +1,192 @@
+/**
+ * hampod_frame.h - Packet framing for the HAMPOD pipe protocol
+ *
+ * Every packet on the Firmware_i/o, Keypad_i/o and Speaker_i/o pipes is an
+ * 8-byte header followed by data_len bytes of data:
+ *
+ *   | type (4) | data_len (2) | tag (2) | data (data_len) |
+ *
+ * frame_write() sends header and data with a single writev(), so packets up
+ * to PIPE_BUF bytes are atomic even when several threads share one FIFO.
+ * Frame_reader parses packets out of a ring buffer, so a burst of packets is
+ * pulled in with one read() instead of four read() calls per packet.
+ *
+ * The type field is split into three parts:
+ *
+ *   | class (8) | flags (8) | packet type (16) |
+ *
+ * The class is the packet's scheduling class (FRAME_CLASS_*). Senders that
+ * do not set one send 0 there, and the receiver classifies the packet from
+ * its contents with frame_default_class(). FRAME_FLAG_MORE marks a chunk of
+ * a message larger than one frame; frame_write_message() splits messages
+ * and frame_read_message() puts them back together.
+ *
+ * The Firmware's CONFIG 'R' ready packet carries a Frame_hello describing
+ * what it supports. Firmware older than protocol version 2 sends the 'R'
+ * byte alone.
+ *
+ * Shared by the Firmware and Software2 (which builds this file directly), so
+ * it only depends on libc and does not use Inst_packet or CommPacket.
+ */
+
+#ifndef HAMPOD_FRAME_H
+#define HAMPOD_FRAME_H
+
+#include <stddef.h>
+
+#define FRAME_HEADER_SIZE 8
+
+/* Ring buffer capacity. Must be a power of two and larger than any frame. */
+#define FRAME_READER_BUFFER_SIZE 4096
+
+/* Scheduling classes, most urgent first. Every queue in the Firmware serves
+ * a lower class before a higher one, so control, interrupt, beep and keypad
+ * traffic never waits behind queued speech or file playback. */
+#define FRAME_CLASS_NONE 0      /* Not set by the sender */
+#define FRAME_CLASS_CONTROL 1   /* Settings and queries ('s' speed, 'q') */
+#define FRAME_CLASS_INTERRUPT 2 /* Stop playback ('i') */
+#define FRAME_CLASS_BEEP 3      /* Key feedback ('b') */
+#define FRAME_CLASS_KEYPAD 4    /* Keypad reads and subscribes */
+#define FRAME_CLASS_BULK 5      /* Speech and file playback */
+#define FRAME_CLASS_COUNT 6
+
+#define FRAME_CLASS_SHIFT 24
+#define FRAME_FLAGS_SHIFT 16
+#define FRAME_TYPE_MASK 0x0000ffff
+
+/* Frame flags */
+#define FRAME_FLAG_MORE 0x01 /* Another chunk of this message follows */
+
+/* Type field value carrying a class: frame_write(fd, FRAME_TYPE_WITH_CLASS(
+ * AUDIO, FRAME_CLASS_BEEP), ...) */
+#define FRAME_TYPE_WITH_CLASS(type, cls)                                       \
+  (((type) & FRAME_TYPE_MASK) | ((cls) << FRAME_CLASS_SHIFT))
+
+/* Message sizes. Version 1 peers take at most FRAME_LEGACY_MAX_DATA bytes
+ * in one frame and do not understand chunks. */
+#define FRAME_LEGACY_MAX_DATA 256
+#define FRAME_CHUNK_SIZE 1024   /* Data bytes per chunk the Firmware accepts */
+#define FRAME_MAX_MESSAGE 4096  /* Largest reassembled message */
+
+/* Ready handshake */
+#define HAMPOD_PROTOCOL_VERSION 2
+
+/* Capability bits in Frame_hello.caps */
+#define HAMPOD_CAP_PUSH_KEYPAD 0x01 /* Keypad 's' subscribe */
+#define HAMPOD_CAP_PCM_CACHE 0x02   /* Beeps play from RAM */
+#define HAMPOD_CAP_SHM 0x04         /* Shared-memory region is available */
+#define HAMPOD_CAP_CHUNKED 0x08     /* FRAME_FLAG_MORE messages */
+#define HAMPOD_CAP_CLASSES 0x10     /* Scheduling class byte is honored */
+#define HAMPOD_CAP_VOLUME 0x20      /* Audio 'v' sets a software gain */
+#define HAMPOD_CAP_AUDIO_STATS 0x40 /* Audio 'm' returns pipeline stats */
+#define HAMPOD_CAP_AUDIO_OUTPUT 0x80 /* Audio 'o' sets period/buffer/mmap */
+
+/* Payload of the CONFIG ready packet, all fields little-endian */
+typedef struct Frame_hello {
+    unsigned char ready;       /* 'R', same first byte as version 1 */
+    unsigned char version;     /* HAMPOD_PROTOCOL_VERSION */
+    unsigned short max_frame;  /* Largest data_len of a single frame */
+    unsigned short max_message; /* Largest message after reassembly */
+    unsigned short reserved;
+    unsigned int caps;         /* HAMPOD_CAP_* */
+} Frame_hello;
+
+/* frame_read() return codes */
+#define FRAME_OK 1
+#define FRAME_EOF 0
+#define FRAME_ERROR -1
+#define FRAME_TOO_LARGE -2 /* Header valid, data did not fit and was dropped */
+
+typedef struct Frame_header {
+    int type;                /* Packet type with the class byte removed */
+    unsigned char priority;  /* FRAME_CLASS_*, FRAME_CLASS_NONE if unset */
+    unsigned char flags;     /* FRAME_FLAG_* */
+    unsigned short data_len;
+    unsigned short tag;
+} Frame_header;
+
+typedef struct Frame_reader {
+    int fd;
+    unsigned char buffer[FRAME_READER_BUFFER_SIZE];
+    size_t head;    /* Total bytes consumed (masked to index the buffer) */
+    size_t tail;    /* Total bytes read in (masked to index the buffer) */
+    size_t discard; /* Data bytes of an oversized frame still to skip */
+} Frame_reader;
+
+/**
+ * Write one packet with a single writev() call.
+ *
+ * Partial writes (only possible above PIPE_BUF) and EINTR are retried until
+ * the whole packet is out.
+ *
+ * @return 0 on success, -1 on error (errno set)
+ */
+int frame_write(int fd, int type, unsigned short tag, const void *data,
+                unsigned short data_len);
+
+/**
+ * Write a message of any size up to FRAME_MAX_MESSAGE, split into frames of
+ * at most max_frame data bytes. Every chunk but the last carries
+ * FRAME_FLAG_MORE. Callers sharing the fd must serialize whole messages,
+ * since only the individual frames are atomic.
+ *
+ * @return 0 on success, -1 on error (errno set)
+ */
+int frame_write_message(int fd, int type, unsigned short tag, const void *data,
+                        size_t data_len, size_t max_frame);
+
+/**
+ * Prepare a reader for a pipe. No system calls are made.
+ */
+void frame_reader_init(Frame_reader *reader, int fd);
+
+/**
+ * Read the next packet, blocking until a whole frame is buffered.
+ *
+ * Any packets that arrived in the same read() stay buffered for the next
+ * call. If data_len exceeds data_size the header is still returned, the data
+ * is skipped and FRAME_TOO_LARGE is returned so the stream stays in sync.
+ *
+ * @param header    Receives type, data_len and tag
+ * @param data      Receives the packet data (may be NULL if data_size is 0)
+ * @param data_size Capacity of data in bytes
+ * @return FRAME_OK, FRAME_EOF, FRAME_ERROR or FRAME_TOO_LARGE
+ */
+int frame_read(Frame_reader *reader, Frame_header *header,
+               unsigned char *data, size_t data_size);
+
+/**
+ * Read the next message, joining chunks sent by frame_write_message().
+ *
+ * header describes the last chunk, with data_len set to the message length.
+ * If the message does not fit in data_size bytes, the remaining chunks are
+ * still consumed and FRAME_TOO_LARGE is returned.
+ *
+ * @return FRAME_OK, FRAME_EOF, FRAME_ERROR or FRAME_TOO_LARGE
+ */
+int frame_read_message(Frame_reader *reader, Frame_header *header,
+                       unsigned char *data, size_t data_size);
+
+/**
+ * Class for a packet whose sender did not set one.
+ *
+ * The packet type values mirror Packet_type / PacketType (KEYPAD 0,
+ * AUDIO 1, CONFIG 3); audio packets are classified by their first byte.
+ *
+ * @return FRAME_CLASS_CONTROL .. FRAME_CLASS_BULK
+ */
+int frame_default_class(int type, const unsigned char *data, size_t data_len);
+
+/**
+ * Split a wire type field into header->type, header->flags and
+ * header->priority.
+ */
+void frame_decode_type(Frame_header *header, int wire_type);
+
+/**
+ * Number of bytes already buffered (a following frame_read() may not need
+ * to touch the pipe).
+ */
+size_t frame_reader_buffered(const Frame_reader *reader);
+
+#endif
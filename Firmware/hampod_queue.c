@@ -5,16 +5,63 @@
 #include "hampod_queue.h"
 
 Packet_queue *create_packet_queue() {
+  return create_bounded_packet_queue(PACKET_QUEUE_DEFAULT_CAPACITY);
+}
+
+Packet_queue *create_bounded_packet_queue(int capacity) {
   Packet_queue *new = malloc(sizeof(Packet_queue));
   if (!new) {
     perror("Queue memory allocation failed");
     exit(1);
   }
-  new->head = NULL;
-  new->tail = NULL;
+  for (int lane = 0; lane < FRAME_CLASS_COUNT; lane++) {
+    new->head[lane] = NULL;
+    new->tail[lane] = NULL;
+    new->lane_count[lane] = 0;
+  }
+  new->count = 0;
+  new->capacity = capacity > 0 ? capacity : PACKET_QUEUE_DEFAULT_CAPACITY;
+  new->closed = 0;
+  if (pthread_mutex_init(&new->lock, NULL) != 0 ||
+      pthread_cond_init(&new->not_empty, NULL) != 0 ||
+      pthread_cond_init(&new->not_full, NULL) != 0) {
+    perror("Queue synchronization init failed");
+    exit(1);
+  }
   return new;
 }
 
+/* Packets without a valid class are treated as bulk work */
+static int lane_of(const Inst_packet *packet) {
+  if (packet->priority <= FRAME_CLASS_NONE ||
+      packet->priority >= FRAME_CLASS_COUNT) {
+    return FRAME_CLASS_BULK;
+  }
+  return packet->priority;
+}
+
+/* Unlink the head node of the most urgent non-empty lane. Caller holds the
+ * lock and has checked count > 0. */
+static Inst_packet *pop_locked(Packet_queue *queue) {
+  int lane = FRAME_CLASS_CONTROL;
+  while (queue->head[lane] == NULL) {
+    lane++;
+  }
+  Node *removed_node = queue->head[lane];
+  Inst_packet *packet = removed_node->packet;
+  queue->head[lane] = removed_node->next;
+
+  if (queue->head[lane] == NULL) {
+    queue->tail[lane] = NULL;
+  }
+  queue->lane_count[lane]--;
+  queue->count--;
+  free(removed_node);
+  /* Producers of every lane share not_full */
+  pthread_cond_broadcast(&queue->not_full);
+  return packet;
+}
+
 void enqueue(Packet_queue *queue, Inst_packet *packet) {
   Node *new_node = malloc(sizeof(Node));
   if (!new_node) {
@@ -24,44 +71,79 @@ void enqueue(Packet_queue *queue, Inst_packet *packet) {
   new_node->packet = packet;
   new_node->next = NULL;
 
-  if (queue->tail == NULL) {
-    queue->head = new_node;
-    queue->tail = new_node;
+  int lane = lane_of(packet);
+
+  pthread_mutex_lock(&queue->lock);
+  while (queue->lane_count[lane] >= queue->capacity && !queue->closed) {
+    pthread_cond_wait(&queue->not_full, &queue->lock);
+  }
+  if (queue->closed) {
+    /* Nobody will ever consume it */
+    pthread_mutex_unlock(&queue->lock);
+    free(new_node);
+    destroy_inst_packet(&packet);
+    return;
+  }
+
+  if (queue->tail[lane] == NULL) {
+    queue->head[lane] = new_node;
+    queue->tail[lane] = new_node;
   } else {
-    queue->tail->next = new_node;
-    queue->tail = new_node;
+    queue->tail[lane]->next = new_node;
+    queue->tail[lane] = new_node;
   }
+  queue->lane_count[lane]++;
+  queue->count++;
+  pthread_cond_signal(&queue->not_empty);
+  pthread_mutex_unlock(&queue->lock);
 }
 
 Inst_packet *dequeue(Packet_queue *queue) {
-  if (queue->head == NULL) {
-    return NULL;
-  }
-
-  Node *removed_node = queue->head;
-  Inst_packet *packet = removed_node->packet;
-  queue->head = removed_node->next;
+  pthread_mutex_lock(&queue->lock);
+  Inst_packet *packet = queue->count > 0 ? pop_locked(queue) : NULL;
+  pthread_mutex_unlock(&queue->lock);
+  return packet;
+}
 
-  if (queue->head == NULL) {
-    queue->tail = NULL;
+Inst_packet *dequeue_wait(Packet_queue *queue) {
+  pthread_mutex_lock(&queue->lock);
+  while (queue->count == 0 && !queue->closed) {
+    pthread_cond_wait(&queue->not_empty, &queue->lock);
   }
-  free(removed_node);
+  /* Packets queued before close are still handed out */
+  Inst_packet *packet = queue->count > 0 ? pop_locked(queue) : NULL;
+  pthread_mutex_unlock(&queue->lock);
   return packet;
 }
 
+void close_queue(Packet_queue *queue) {
+  pthread_mutex_lock(&queue->lock);
+  queue->closed = 1;
+  pthread_cond_broadcast(&queue->not_empty);
+  pthread_cond_broadcast(&queue->not_full);
+  pthread_mutex_unlock(&queue->lock);
+}
+
 void destroy_queue(Packet_queue *queue) {
-  while (queue->tail != NULL) {
-    Inst_packet *temp = dequeue(queue);
-    destroy_inst_packet(&temp);
-  }
+  clear_queue(queue);
+  pthread_mutex_destroy(&queue->lock);
+  pthread_cond_destroy(&queue->not_empty);
+  pthread_cond_destroy(&queue->not_full);
   free(queue);
 }
 
-int is_empty(Packet_queue *queue) { return queue->head == NULL; }
+int is_empty(Packet_queue *queue) {
+  pthread_mutex_lock(&queue->lock);
+  int empty = queue->count == 0;
+  pthread_mutex_unlock(&queue->lock);
+  return empty;
+}
 
 void clear_queue(Packet_queue *queue) {
-  while (!is_empty(queue)) {
-    Inst_packet *temp = dequeue(queue);
+  pthread_mutex_lock(&queue->lock);
+  while (queue->count > 0) {
+    Inst_packet *temp = pop_locked(queue);
     destroy_inst_packet(&temp);
   }
+  pthread_mutex_unlock(&queue->lock);
 }
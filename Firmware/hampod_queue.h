@@ -1,20 +1,41 @@
 #ifndef HAMPOD_QUEUE
 #define HAMPOD_QUEUE
+#include <pthread.h>
+
 #include "hampod_firm_packet.h"
 
+/* Default bound used by create_packet_queue() */
+#define PACKET_QUEUE_DEFAULT_CAPACITY 64
+
 typedef struct Node {
   Inst_packet *packet;
   struct Node *next;
 } Node;
 
+/* Thread-safe bounded priority queue with one FIFO lane per scheduling
+ * class (FRAME_CLASS_*, taken from packet->priority). dequeue() hands out the
+ * oldest packet of the most urgent non-empty lane, so a keypad request or an
+ * interrupt never waits behind queued speech. Consumers block in
+ * dequeue_wait() until a packet arrives and producers block in enqueue() only
+ * while their own lane is full, so neither side has to poll. */
 typedef struct Packet_queue {
-  Node *head;
-  Node *tail;
+  Node *head[FRAME_CLASS_COUNT];
+  Node *tail[FRAME_CLASS_COUNT];
+  int lane_count[FRAME_CLASS_COUNT];
+  int count; /* Total over all lanes */
+  int capacity; /* Per lane */
+  int closed;
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty;
+  pthread_cond_t not_full;
 } Packet_queue;
 
 Packet_queue *create_packet_queue();
+Packet_queue *create_bounded_packet_queue(int capacity);
 void enqueue(Packet_queue *queue, Inst_packet *packet);
 Inst_packet *dequeue(Packet_queue *queue);
+Inst_packet *dequeue_wait(Packet_queue *queue);
+void close_queue(Packet_queue *queue);
 void destroy_queue(Packet_queue *queue);
 int is_empty(Packet_queue *queue);
 void clear_queue(Packet_queue *queue);
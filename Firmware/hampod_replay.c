@@ -0,0 +1,594 @@
+/* hampod_replay - Play back a packet trace recorded with HAMPOD_TRACE
+ *
+ * Usage (from the Firmware directory, like firmware.elf):
+ *
+ *   ./hampod_replay [-f] trace
+ *       Send the recorded Software2 requests to the Firmware listening on
+ *       Firmware_i/Firmware_o and report how long each reply took, next to
+ *       the latency in the recording.
+ *
+ *   ./hampod_replay -F [-f] trace
+ *       Stand in for the Firmware, like imitation_software stands in for
+ *       Software: create the pipes, send the recorded ready packet and answer
+ *       each request with the reply recorded for it, after the recorded
+ *       delay. Recorded keypad events are pushed at their recorded times.
+ *       Software2 or a second hampod_replay can run against it without any
+ *       radio, keypad or audio hardware.
+ *
+ * -f replays as fast as possible instead of at the recorded pace.
+ *
+ * If both sides recorded into the trace, the Software2 records are used.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hampod_frame.h"
+#include "hampod_trace.h"
+
+#define INPUT_PIPE "Firmware_i"
+#define OUTPUT_PIPE "Firmware_o"
+
+/* Packet types, as in hampod_firm_packet.h */
+#define TYPE_KEYPAD 0
+#define TYPE_AUDIO 1
+#define TYPE_CONFIG 3
+
+/* How long to wait for replies after the last request */
+#define DRAIN_TIMEOUT_MS 5000
+
+typedef struct Replay_packet {
+    Trace_record record;
+    unsigned char *data;
+    int used; /* Fake Firmware: already answered */
+} Replay_packet;
+
+static Replay_packet *packets = NULL;
+static size_t packet_count = 0;
+static int fast = 0;
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+static void sleep_until_ns(uint64_t when) {
+    if (fast) {
+        return;
+    }
+    struct timespec target;
+    target.tv_sec = when / 1000000000ull;
+    target.tv_nsec = when % 1000000000ull;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &target, NULL) ==
+           EINTR) {
+    }
+}
+
+static double ms(uint64_t ns) { return ns / 1e6; }
+
+/* Load the records written by one side of the link */
+static int load_trace(const char *path) {
+    Trace_reader reader;
+    if (trace_reader_open(&reader, path) != 0) {
+        perror(path);
+        return -1;
+    }
+
+    size_t capacity = 0;
+    int have_software = 0;
+    Trace_record record;
+    unsigned char data[FRAME_MAX_MESSAGE];
+    int result;
+    while ((result = trace_read(&reader, &record, data, sizeof(data))) ==
+           TRACE_OK) {
+        if (packet_count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            packets = realloc(packets, capacity * sizeof(Replay_packet));
+            if (packets == NULL) {
+                perror("realloc");
+                exit(1);
+            }
+        }
+        Replay_packet *packet = &packets[packet_count++];
+        packet->record = record;
+        packet->used = 0;
+        packet->data = malloc(record.data_len > 0 ? record.data_len : 1);
+        memcpy(packet->data, data, record.data_len);
+        have_software |= record.source == TRACE_SOURCE_SOFTWARE;
+    }
+    trace_reader_close(&reader);
+    if (result == TRACE_ERROR) {
+        printf("Warning: trace is truncated or damaged, using the first %zu "
+               "records\n", packet_count);
+    }
+
+    /* Both sides see the same packets; keep one side's view */
+    uint8_t source = have_software ? TRACE_SOURCE_SOFTWARE
+                                   : TRACE_SOURCE_FIRMWARE;
+    size_t kept = 0;
+    for (size_t i = 0; i < packet_count; i++) {
+        if (packets[i].record.source == source) {
+            packets[kept++] = packets[i];
+        } else {
+            free(packets[i].data);
+        }
+    }
+    packet_count = kept;
+    printf("Loaded %zu packets recorded by %s\n", packet_count,
+           have_software ? "Software2" : "the Firmware");
+    return 0;
+}
+
+/* First reply recorded for the request at index, or NULL */
+static Replay_packet *recorded_reply(size_t index) {
+    const Trace_record *request = &packets[index].record;
+    for (size_t i = index + 1; i < packet_count; i++) {
+        const Trace_record *record = &packets[i].record;
+        if (record->direction == TRACE_FROM_FIRMWARE &&
+            record->tag == request->tag && record->tag != 0) {
+            return &packets[i];
+        }
+    }
+    return NULL;
+}
+
+// ============================================================================
+// Replaying requests against a Firmware
+// ============================================================================
+
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stats_changed;
+static uint64_t sent_at[65536]; /* By tag, 0 when nothing is outstanding */
+static uint64_t expected_ns[65536];
+static int outstanding = 0;
+static int replies = 0;
+static int events = 0;
+static uint64_t latency_total = 0;
+static uint64_t latency_max = 0;
+static uint64_t recorded_total = 0;
+static uint64_t recorded_max = 0;
+static int recorded_replies = 0;
+static int link_closed = 0;
+
+static void *reply_reader(void *arg) {
+    Frame_reader *reader = (Frame_reader *)arg;
+    unsigned char data[FRAME_MAX_MESSAGE];
+    Frame_header header;
+    int result;
+
+    while ((result = frame_read_message(reader, &header, data,
+                                        sizeof(data))) != FRAME_EOF &&
+           result != FRAME_ERROR) {
+        if (result != FRAME_OK) {
+            continue;
+        }
+        uint64_t now = trace_now_ns();
+        pthread_mutex_lock(&stats_lock);
+        if (header.tag == 0) {
+            events++;
+        } else if (sent_at[header.tag] != 0) {
+            uint64_t latency = now - sent_at[header.tag];
+            sent_at[header.tag] = 0;
+            replies++;
+            latency_total += latency;
+            if (latency > latency_max) {
+                latency_max = latency;
+            }
+            if (expected_ns[header.tag] != 0) {
+                recorded_replies++;
+                recorded_total += expected_ns[header.tag];
+                if (expected_ns[header.tag] > recorded_max) {
+                    recorded_max = expected_ns[header.tag];
+                }
+            }
+            outstanding--;
+            pthread_cond_broadcast(&stats_changed);
+        }
+        pthread_mutex_unlock(&stats_lock);
+    }
+
+    pthread_mutex_lock(&stats_lock);
+    link_closed = 1; /* Nothing more is coming */
+    pthread_cond_broadcast(&stats_changed);
+    pthread_mutex_unlock(&stats_lock);
+    return NULL;
+}
+
+static int replay_requests(void) {
+    printf("Connecting to %s\n", OUTPUT_PIPE);
+    int input_pipe = open(OUTPUT_PIPE, O_RDONLY);
+    if (input_pipe == -1) {
+        perror("open");
+        return 1;
+    }
+    /* Non-blocking like comm.c, so a stale Firmware_i left by an earlier
+     * run cannot hold us up after the Firmware replaces it */
+    int output_pipe = -1;
+    for (int i = 0; i < 1000 && output_pipe == -1; i++) {
+        output_pipe = open(INPUT_PIPE, O_WRONLY | O_NONBLOCK);
+        if (output_pipe == -1) {
+            usleep(10000);
+        }
+    }
+    if (output_pipe != -1) {
+        fcntl(output_pipe, F_SETFL, fcntl(output_pipe, F_GETFL) & ~O_NONBLOCK);
+    }
+    if (output_pipe == -1) {
+        perror("open");
+        return 1;
+    }
+
+    Frame_reader reader;
+    frame_reader_init(&reader, input_pipe);
+    Frame_header header;
+    unsigned char data[FRAME_MAX_MESSAGE];
+    if (frame_read_message(&reader, &header, data, sizeof(data)) != FRAME_OK ||
+        header.type != TYPE_CONFIG || header.data_len == 0 ||
+        data[0] != 'R') {
+        printf("No ready packet from the Firmware\n");
+        return 1;
+    }
+
+    size_t max_frame = FRAME_LEGACY_MAX_DATA;
+    unsigned int caps = 0;
+    if (header.data_len >= sizeof(Frame_hello)) {
+        Frame_hello hello;
+        memcpy(&hello, data, sizeof(hello));
+        caps = hello.caps;
+        if ((caps & HAMPOD_CAP_CHUNKED) && hello.max_frame > 0) {
+            max_frame = hello.max_frame;
+        }
+    }
+    printf("Firmware ready (caps 0x%02x), replaying%s\n", caps,
+           fast ? " as fast as possible" : " at the recorded pace");
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&stats_changed, &attr);
+    pthread_condattr_destroy(&attr);
+
+    pthread_t reader_thread;
+    pthread_create(&reader_thread, NULL, reply_reader, &reader);
+
+    uint64_t start = trace_now_ns();
+    uint64_t first = 0;
+    int sent = 0;
+    for (size_t i = 0; i < packet_count; i++) {
+        const Trace_record *record = &packets[i].record;
+        if (record->direction != TRACE_TO_FIRMWARE) {
+            continue;
+        }
+        if (sent == 0) {
+            first = record->time_ns;
+        }
+        sleep_until_ns(start + (record->time_ns - first));
+
+        /* Older Firmware reads the class byte as part of the type */
+        int type = record->type;
+        if (!(caps & HAMPOD_CAP_CLASSES)) {
+            type &= FRAME_TYPE_MASK;
+        }
+        Replay_packet *reply = recorded_reply(i);
+
+        pthread_mutex_lock(&stats_lock);
+        if (sent_at[record->tag] == 0) {
+            outstanding++;
+        }
+        sent_at[record->tag] = trace_now_ns();
+        expected_ns[record->tag] =
+            reply ? reply->record.time_ns - record->time_ns : 0;
+        pthread_mutex_unlock(&stats_lock);
+
+        if (frame_write_message(output_pipe, type, record->tag,
+                                packets[i].data, record->data_len,
+                                max_frame) != 0) {
+            perror("write");
+            break;
+        }
+        sent++;
+    }
+
+    /* Give the last requests time to finish */
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += DRAIN_TIMEOUT_MS / 1000;
+    pthread_mutex_lock(&stats_lock);
+    while (outstanding > 0 && !link_closed) {
+        if (pthread_cond_timedwait(&stats_changed, &stats_lock, &deadline) ==
+            ETIMEDOUT) {
+            break;
+        }
+    }
+    int missing = outstanding;
+    uint64_t elapsed = trace_now_ns() - start;
+
+    /* Closing Firmware_i ends the session, as when Software2 exits. The
+     * Firmware may keep Firmware_o open a while longer, so the reader is
+     * left to exit with the process. */
+    close(output_pipe);
+    pthread_detach(reader_thread);
+
+    printf("\n=== Replay Summary ===\n");
+    printf("Requests sent:     %d\n", sent);
+    printf("Replies received:  %d (%d missing)\n", replies, missing);
+    printf("Keypad events:     %d\n", events);
+    printf("Elapsed:           %.1f ms\n", ms(elapsed));
+    if (replies > 0) {
+        printf("Reply latency:     mean %.2f ms, max %.2f ms\n",
+               ms(latency_total / replies), ms(latency_max));
+    }
+    if (recorded_replies > 0) {
+        printf("Recorded latency:  mean %.2f ms, max %.2f ms\n",
+               ms(recorded_total / recorded_replies), ms(recorded_max));
+    }
+    pthread_mutex_unlock(&stats_lock);
+    return missing == 0 ? 0 : 1;
+}
+
+// ============================================================================
+// Fake Firmware
+// ============================================================================
+
+typedef struct Scheduled {
+    uint64_t due;
+    int type;
+    unsigned short tag;
+    const Replay_packet *reply; /* NULL: send fallback_result instead */
+    int fallback_result;
+} Scheduled;
+
+static Scheduled *schedule = NULL;
+static size_t scheduled_count = 0;
+static size_t scheduled_capacity = 0;
+static pthread_mutex_t schedule_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t schedule_changed;
+static int serving = 1;
+
+static void schedule_reply(uint64_t due, int type, unsigned short tag,
+                           const Replay_packet *reply, int fallback_result) {
+    pthread_mutex_lock(&schedule_lock);
+    if (scheduled_count == scheduled_capacity) {
+        scheduled_capacity = scheduled_capacity ? scheduled_capacity * 2 : 64;
+        schedule = realloc(schedule, scheduled_capacity * sizeof(Scheduled));
+        if (schedule == NULL) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    Scheduled *entry = &schedule[scheduled_count++];
+    entry->due = due;
+    entry->type = type;
+    entry->tag = tag;
+    entry->reply = reply;
+    entry->fallback_result = fallback_result;
+    pthread_cond_signal(&schedule_changed);
+    pthread_mutex_unlock(&schedule_lock);
+}
+
+/* Sends replies and pushed events when they fall due */
+static void *reply_sender(void *arg) {
+    int output_pipe = *(int *)arg;
+
+    pthread_mutex_lock(&schedule_lock);
+    while (serving) {
+        size_t next = scheduled_count;
+        for (size_t i = 0; i < scheduled_count; i++) {
+            if (next == scheduled_count || schedule[i].due < schedule[next].due) {
+                next = i;
+            }
+        }
+        if (next == scheduled_count) {
+            pthread_cond_wait(&schedule_changed, &schedule_lock);
+            continue;
+        }
+        if (schedule[next].due > trace_now_ns()) {
+            struct timespec until;
+            until.tv_sec = schedule[next].due / 1000000000ull;
+            until.tv_nsec = schedule[next].due % 1000000000ull;
+            pthread_cond_timedwait(&schedule_changed, &schedule_lock, &until);
+            continue;
+        }
+
+        Scheduled entry = schedule[next];
+        schedule[next] = schedule[--scheduled_count];
+        pthread_mutex_unlock(&schedule_lock);
+        if (entry.reply != NULL) {
+            frame_write_message(output_pipe, entry.type, entry.tag,
+                                entry.reply->data, entry.reply->record.data_len,
+                                FRAME_CHUNK_SIZE);
+        } else if (entry.type == TYPE_KEYPAD) {
+            unsigned char no_key = '-';
+            frame_write(output_pipe, entry.type, entry.tag, &no_key, 1);
+        } else {
+            frame_write(output_pipe, entry.type, entry.tag,
+                        &entry.fallback_result, sizeof(int));
+        }
+        pthread_mutex_lock(&schedule_lock);
+    }
+    pthread_mutex_unlock(&schedule_lock);
+    return NULL;
+}
+
+/* Next unanswered recorded request that looks like this one: same type and
+ * first data byte, or failing that the same type */
+static long match_request(int type, const unsigned char *data,
+                          unsigned short data_len) {
+    long same_type = -1;
+    for (size_t i = 0; i < packet_count; i++) {
+        Replay_packet *packet = &packets[i];
+        if (packet->used || packet->record.direction != TRACE_TO_FIRMWARE ||
+            (packet->record.type & FRAME_TYPE_MASK) != type) {
+            continue;
+        }
+        if (data_len > 0 && packet->record.data_len > 0 &&
+            packet->data[0] == data[0]) {
+            return (long)i;
+        }
+        if (same_type == -1) {
+            same_type = (long)i;
+        }
+    }
+    return same_type;
+}
+
+static int serve_as_firmware(void) {
+    unlink(OUTPUT_PIPE);
+    unlink(INPUT_PIPE);
+    if (mkfifo(OUTPUT_PIPE, 0666) == -1 || mkfifo(INPUT_PIPE, 0666) == -1) {
+        perror("mkfifo");
+        return 1;
+    }
+
+    printf("Waiting for Software on %s\n", OUTPUT_PIPE);
+    int output_pipe = open(OUTPUT_PIPE, O_WRONLY);
+    int input_pipe = open(INPUT_PIPE, O_RDONLY);
+    if (output_pipe == -1 || input_pipe == -1) {
+        perror("open");
+        return 1;
+    }
+
+    /* The recorded hello, so Software picks the same modes as before */
+    const Replay_packet *hello = NULL;
+    for (size_t i = 0; i < packet_count && hello == NULL; i++) {
+        if (packets[i].record.direction == TRACE_FROM_FIRMWARE &&
+            (packets[i].record.type & FRAME_TYPE_MASK) == TYPE_CONFIG &&
+            packets[i].record.data_len > 0 && packets[i].data[0] == 'R') {
+            hello = &packets[i];
+        }
+    }
+    uint64_t start = trace_now_ns();
+    if (hello != NULL) {
+        /* Minus the shared-memory transport: this tool only serves the
+         * pipes, and a stale /hampod_transport must not be attached */
+        unsigned char payload[FRAME_MAX_MESSAGE];
+        size_t length = hello->record.data_len;
+        memcpy(payload, hello->data, length);
+        if (length >= sizeof(Frame_hello)) {
+            Frame_hello copy;
+            memcpy(&copy, payload, sizeof(copy));
+            copy.caps &= ~HAMPOD_CAP_SHM;
+            memcpy(payload, &copy, sizeof(copy));
+        }
+        frame_write(output_pipe, TYPE_CONFIG, 0, payload, length);
+    } else {
+        unsigned char ready = 'R';
+        frame_write(output_pipe, TYPE_CONFIG, 0, &ready, 1);
+    }
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&schedule_changed, &attr);
+    pthread_condattr_destroy(&attr);
+
+    /* Pushed keypad events keep their place relative to the ready packet */
+    uint64_t origin = hello != NULL ? hello->record.time_ns
+                                    : (packet_count ? packets[0].record.time_ns
+                                                    : 0);
+    int pushed = 0;
+    for (size_t i = 0; i < packet_count; i++) {
+        const Trace_record *record = &packets[i].record;
+        if (record->direction == TRACE_FROM_FIRMWARE && record->tag == 0 &&
+            (record->type & FRAME_TYPE_MASK) == TYPE_KEYPAD &&
+            record->time_ns >= origin) {
+            schedule_reply(fast ? start : start + (record->time_ns - origin),
+                           TYPE_KEYPAD, 0, &packets[i], 0);
+            pushed++;
+        }
+    }
+
+    pthread_t sender_thread;
+    pthread_create(&sender_thread, NULL, reply_sender, &output_pipe);
+    printf("Serving as Firmware (%d recorded keypad events queued)\n", pushed);
+
+    Frame_reader reader;
+    frame_reader_init(&reader, input_pipe);
+    unsigned char data[FRAME_MAX_MESSAGE];
+    Frame_header header;
+    int requests = 0;
+    int unmatched = 0;
+    int result;
+    while ((result = frame_read_message(&reader, &header, data,
+                                        sizeof(data))) != FRAME_EOF &&
+           result != FRAME_ERROR) {
+        if (result != FRAME_OK) {
+            continue;
+        }
+        requests++;
+        uint64_t now = trace_now_ns();
+        long index = match_request(header.type, data, header.data_len);
+        const Replay_packet *reply = NULL;
+        uint64_t delay = 0;
+        if (index >= 0) {
+            packets[index].used = 1;
+            reply = recorded_reply((size_t)index);
+            if (reply != NULL) {
+                delay = reply->record.time_ns - packets[index].record.time_ns;
+            }
+        }
+        if (reply == NULL) {
+            unmatched++;
+        }
+        schedule_reply(now + (fast ? 0 : delay), header.type, header.tag,
+                       reply, 0);
+    }
+
+    pthread_mutex_lock(&schedule_lock);
+    serving = 0;
+    pthread_cond_signal(&schedule_changed);
+    pthread_mutex_unlock(&schedule_lock);
+    pthread_join(sender_thread, NULL);
+    close(input_pipe);
+    close(output_pipe);
+
+    printf("\nSoftware closed %s after %d requests (%d without a recorded "
+           "reply)\n", INPUT_PIPE, requests, unmatched);
+    return 0;
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+static void usage(const char *name) {
+    printf("Usage: %s [-f] trace       replay requests against the Firmware\n",
+           name);
+    printf("       %s -F [-f] trace    act as the Firmware\n", name);
+    printf("  -f  as fast as possible instead of the recorded pace\n");
+}
+
+int main(int argc, char **argv) {
+    int fake_firmware = 0;
+    int option;
+    while ((option = getopt(argc, argv, "fFh")) != -1) {
+        switch (option) {
+        case 'f':
+            fast = 1;
+            break;
+        case 'F':
+            fake_firmware = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return option == 'h' ? 0 : 2;
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (load_trace(argv[optind]) != 0) {
+        return 1;
+    }
+    return fake_firmware ? serve_as_firmware() : replay_requests();
+}
@@ -0,0 +1,122 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hampod_ring.h"
+
+Packet_ring *create_packet_ring(size_t capacity) {
+  /* Round up to a power of two so indices can be masked */
+  size_t slots = 1;
+  while (slots < capacity) {
+    slots <<= 1;
+  }
+
+  /* The struct is 64-byte aligned, so its size is a multiple of 64 */
+  Packet_ring *ring = aligned_alloc(64, sizeof(Packet_ring));
+  Packet_slot *slot_array = calloc(slots, sizeof(Packet_slot));
+  if (!ring || !slot_array) {
+    perror("Packet ring allocation failed");
+    exit(1);
+  }
+
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  atomic_init(&ring->flush, 0);
+  atomic_init(&ring->closed, 0);
+  ring->mask = slots - 1;
+  ring->slots = slot_array;
+  for (size_t i = 0; i < slots; i++) {
+    ring->slots[i].packet.data = ring->slots[i].payload;
+  }
+
+  if (sem_init(&ring->items, 0, 0) != 0 ||
+      sem_init(&ring->spaces, 0, 0) != 0) {
+    perror("Packet ring semaphore init failed");
+    exit(1);
+  }
+  return ring;
+}
+
+void destroy_packet_ring(Packet_ring *ring) {
+  sem_destroy(&ring->items);
+  sem_destroy(&ring->spaces);
+  free(ring->slots);
+  free(ring);
+}
+
+/* sem_wait() that ignores signals */
+static void ring_sleep(sem_t *sem) {
+  while (sem_wait(sem) != 0 && errno == EINTR) {
+  }
+}
+
+int packet_ring_push(Packet_ring *ring, Packet_type type, unsigned short tag,
+                     const unsigned char *data, unsigned short len) {
+  if (len > PACKET_RING_DATA_SIZE) {
+    return -1;
+  }
+
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  for (;;) {
+    if (atomic_load_explicit(&ring->closed, memory_order_acquire)) {
+      return -1;
+    }
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (tail - head <= ring->mask) {
+      break;
+    }
+    ring_sleep(&ring->spaces);
+  }
+
+  Packet_slot *slot = &ring->slots[tail & ring->mask];
+  slot->packet.type = type;
+  slot->packet.tag = tag;
+  slot->packet.data_len = len;
+  slot->packet.priority = frame_default_class(type, data, len);
+  memcpy(slot->payload, data, len);
+
+  atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+  sem_post(&ring->items);
+  return 0;
+}
+
+void packet_ring_flush(Packet_ring *ring) {
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  atomic_store_explicit(&ring->flush, tail, memory_order_release);
+}
+
+void packet_ring_close(Packet_ring *ring) {
+  atomic_store_explicit(&ring->closed, 1, memory_order_release);
+  sem_post(&ring->items);
+  sem_post(&ring->spaces);
+}
+
+Inst_packet *packet_ring_wait(Packet_ring *ring) {
+  size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  for (;;) {
+    /* Drop anything the producer flushed since we last looked */
+    size_t flush = atomic_load_explicit(&ring->flush, memory_order_acquire);
+    if ((ptrdiff_t)(flush - head) > 0) {
+      head = flush;
+      atomic_store_explicit(&ring->head, head, memory_order_release);
+      sem_post(&ring->spaces);
+    }
+
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (tail != head) {
+      return &ring->slots[head & ring->mask].packet;
+    }
+    /* Packets pushed before close are still handed out */
+    if (atomic_load_explicit(&ring->closed, memory_order_acquire)) {
+      return NULL;
+    }
+    ring_sleep(&ring->items);
+  }
+}
+
+void packet_ring_release(Packet_ring *ring) {
+  size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+  sem_post(&ring->spaces);
+}
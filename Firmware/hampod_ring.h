@@ -0,0 +1,57 @@
+#ifndef HAMPOD_RING
+#define HAMPOD_RING
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "hampod_firm_packet.h"
+
+/* Largest payload a slot can hold (a whole reassembled message) */
+#define PACKET_RING_DATA_SIZE FRAME_MAX_MESSAGE
+/* Default slot count used by create_packet_ring(). Must be a power of two. */
+#define PACKET_RING_DEFAULT_CAPACITY 32
+
+/* A preallocated Inst_packet whose data pointer always points at payload */
+typedef struct Packet_slot {
+  Inst_packet packet;
+  unsigned char payload[PACKET_RING_DATA_SIZE];
+} Packet_slot;
+
+/* Lock-free single-producer/single-consumer ring of packet slots.
+ *
+ * Replaces Packet_queue for the IO thread -> worker handoff inside the audio
+ * and keypad processes: the IO thread copies each packet into a slot and the
+ * worker uses it in place, so the hot path never calls malloc() or free().
+ * The semaphores are only doorbells for sleeping; the indices are the source
+ * of truth, so extra posts just cause a harmless re-check.
+ *
+ * head is written only by the consumer; tail and flush only by the producer.
+ * They live on separate cache lines so the two threads do not false-share. */
+typedef struct Packet_ring {
+  _Alignas(64) atomic_size_t head; /* Next slot the consumer will read */
+  _Alignas(64) atomic_size_t tail; /* Next slot the producer will fill */
+  atomic_size_t flush;             /* Consumer skips everything before this */
+  atomic_int closed;
+  size_t mask;
+  sem_t items;  /* Posted by the producer after each push */
+  sem_t spaces; /* Posted by the consumer after each release */
+  Packet_slot *slots;
+} Packet_ring;
+
+Packet_ring *create_packet_ring(size_t capacity);
+void destroy_packet_ring(Packet_ring *ring);
+
+/* Producer side */
+int packet_ring_push(Packet_ring *ring, Packet_type type, unsigned short tag,
+                     const unsigned char *data, unsigned short len);
+void packet_ring_flush(Packet_ring *ring);
+void packet_ring_close(Packet_ring *ring);
+
+/* Consumer side */
+Inst_packet *packet_ring_wait(Packet_ring *ring);
+void packet_ring_release(Packet_ring *ring);
+#ifndef SHAREDLIB
+#include "hampod_ring.c"
+#endif
+
+#endif
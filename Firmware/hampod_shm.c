@@ -0,0 +1,304 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hampod_shm.h"
+
+#define SHM_RING_MASK (SHM_RING_SIZE - 1)
+
+// ============================================================================
+// Futex doorbells (shared between processes, so no FUTEX_PRIVATE_FLAG)
+// ============================================================================
+
+static void futex_wait(_Atomic uint32_t *word, uint32_t expected,
+                       int timeout_ms) {
+    struct timespec timeout;
+    struct timespec *timeout_ptr = NULL;
+    if (timeout_ms >= 0) {
+        timeout.tv_sec = timeout_ms / 1000;
+        timeout.tv_nsec = (long)(timeout_ms % 1000) * 1000000L;
+        timeout_ptr = &timeout;
+    }
+    /* EAGAIN (word already changed), EINTR and ETIMEDOUT all just mean
+     * "check the ring again" to the callers */
+    syscall(SYS_futex, (uint32_t *)word, FUTEX_WAIT, expected, timeout_ptr,
+            NULL, 0);
+}
+
+static void futex_ring(_Atomic uint32_t *waiting, _Atomic uint32_t *word) {
+    if (atomic_load(waiting)) {
+        atomic_fetch_add(word, 1);
+        syscall(SYS_futex, (uint32_t *)word, FUTEX_WAKE, INT_MAX, NULL, NULL,
+                0);
+    }
+}
+
+/* Milliseconds left before deadline, or -1 for "no deadline" */
+static int remaining_ms(const struct timespec *deadline) {
+    if (deadline == NULL) {
+        return -1;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long ms = (deadline->tv_sec - now.tv_sec) * 1000 +
+              (deadline->tv_nsec - now.tv_nsec) / 1000000;
+    return ms > 0 ? (int)ms : 0;
+}
+
+static struct timespec *make_deadline(struct timespec *deadline,
+                                      int timeout_ms) {
+    if (timeout_ms < 0) {
+        return NULL;
+    }
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_sec += timeout_ms / 1000;
+    deadline->tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+    return deadline;
+}
+
+// ============================================================================
+// Ring copies (positions are free-running and masked on access)
+// ============================================================================
+
+static void ring_write(Shm_ring *ring, uint32_t pos, const void *src,
+                       size_t len) {
+    if (len == 0) {
+        return;
+    }
+    size_t start = pos & SHM_RING_MASK;
+    size_t first = SHM_RING_SIZE - start;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(ring->data + start, src, first);
+    memcpy(ring->data, (const unsigned char *)src + first, len - first);
+}
+
+static void ring_read(const Shm_ring *ring, uint32_t pos, void *dst,
+                      size_t len) {
+    if (len == 0) {
+        return;
+    }
+    size_t start = pos & SHM_RING_MASK;
+    size_t first = SHM_RING_SIZE - start;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(dst, ring->data + start, first);
+    memcpy((unsigned char *)dst + first, ring->data, len - first);
+}
+
+// ============================================================================
+// Setup
+// ============================================================================
+
+static int map_region(Shm_link *link, int fd) {
+    void *addr = mmap(NULL, sizeof(Shm_region), PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return -1;
+    }
+    link->region = (Shm_region *)addr;
+    pthread_mutex_init(&link->tx_lock, NULL);
+    return 0;
+}
+
+int shm_link_create(Shm_link *link, const char *name) {
+    memset(link, 0, sizeof(*link));
+    snprintf(link->name, sizeof(link->name), "%s", name);
+
+    shm_unlink(name); /* Remove a region left by a crashed Firmware */
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0660);
+    if (fd == -1) {
+        return -1;
+    }
+    if (ftruncate(fd, sizeof(Shm_region)) == -1) {
+        close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+    if (map_region(link, fd) != 0) {
+        shm_unlink(name);
+        return -1;
+    }
+
+    /* ftruncate() zero-filled the rings; publish the header last */
+    link->owner = 1;
+    link->tx = &link->region->to_software;
+    link->rx = &link->region->to_firmware;
+    link->region->version = HAMPOD_SHM_VERSION;
+    atomic_store(&link->region->attached, 0);
+    atomic_thread_fence(memory_order_release);
+    link->region->magic = HAMPOD_SHM_MAGIC;
+    return 0;
+}
+
+int shm_link_attach(Shm_link *link, const char *name) {
+    memset(link, 0, sizeof(*link));
+    snprintf(link->name, sizeof(link->name), "%s", name);
+
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd == -1) {
+        return -1;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == -1 || (size_t)info.st_size < sizeof(Shm_region)) {
+        close(fd);
+        errno = EPROTO;
+        return -1;
+    }
+    if (map_region(link, fd) != 0) {
+        return -1;
+    }
+
+    atomic_thread_fence(memory_order_acquire);
+    if (link->region->magic != HAMPOD_SHM_MAGIC ||
+        link->region->version != HAMPOD_SHM_VERSION) {
+        munmap(link->region, sizeof(Shm_region));
+        link->region = NULL;
+        errno = EPROTO;
+        return -1;
+    }
+
+    link->tx = &link->region->to_firmware;
+    link->rx = &link->region->to_software;
+    atomic_store(&link->region->attached, 1);
+    return 0;
+}
+
+void shm_link_close(Shm_link *link) {
+    if (link->region == NULL) {
+        return;
+    }
+    if (!link->owner) {
+        /* Hand replies back to the FIFOs */
+        atomic_store(&link->region->attached, 0);
+    }
+    munmap(link->region, sizeof(Shm_region));
+    link->region = NULL;
+    pthread_mutex_destroy(&link->tx_lock);
+    if (link->owner) {
+        shm_unlink(link->name);
+    }
+}
+
+int shm_link_is_attached(const Shm_link *link) {
+    return link->region != NULL && atomic_load(&link->region->attached);
+}
+
+// ============================================================================
+// Data path
+// ============================================================================
+
+int shm_link_send(Shm_link *link, int type, unsigned short tag,
+                  const void *data, unsigned short data_len) {
+    size_t frame_len = FRAME_HEADER_SIZE + (size_t)data_len;
+    if (link->region == NULL || frame_len > SHM_RING_SIZE) {
+        return -1;
+    }
+
+    unsigned char header[FRAME_HEADER_SIZE];
+    int32_t wire_type = type;
+    memcpy(header, &wire_type, 4);
+    memcpy(header + 4, &data_len, 2);
+    memcpy(header + 6, &tag, 2);
+
+    Shm_ring *ring = link->tx;
+    struct timespec deadline_storage;
+    struct timespec *deadline =
+        make_deadline(&deadline_storage, SHM_SEND_TIMEOUT_MS);
+
+    pthread_mutex_lock(&link->tx_lock);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    for (;;) {
+        uint32_t head = atomic_load(&ring->head);
+        if (SHM_RING_SIZE - (tail - head) >= frame_len) {
+            break;
+        }
+        int wait_ms = remaining_ms(deadline);
+        if (wait_ms == 0) {
+            pthread_mutex_unlock(&link->tx_lock);
+            errno = EAGAIN;
+            return -1;
+        }
+        uint32_t seq = atomic_load(&ring->space_seq);
+        atomic_store(&ring->space_waiting, 1);
+        if (atomic_load(&ring->head) == head) {
+            futex_wait(&ring->space_seq, seq, wait_ms);
+        }
+        atomic_store(&ring->space_waiting, 0);
+    }
+
+    ring_write(ring, tail, header, FRAME_HEADER_SIZE);
+    ring_write(ring, tail + FRAME_HEADER_SIZE, data, data_len);
+    /* Whole frame becomes visible at once */
+    atomic_store(&ring->tail, tail + (uint32_t)frame_len);
+    futex_ring(&ring->data_waiting, &ring->data_seq);
+    pthread_mutex_unlock(&link->tx_lock);
+    return 0;
+}
+
+int shm_link_recv(Shm_link *link, Frame_header *header, unsigned char *data,
+                  size_t data_size, int timeout_ms) {
+    if (link->region == NULL) {
+        return FRAME_ERROR;
+    }
+
+    Shm_ring *ring = link->rx;
+    struct timespec deadline_storage;
+    struct timespec *deadline = make_deadline(&deadline_storage, timeout_ms);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    for (;;) {
+        uint32_t tail = atomic_load(&ring->tail);
+        if (tail != head) {
+            unsigned char raw[FRAME_HEADER_SIZE];
+            int32_t wire_type;
+            ring_read(ring, head, raw, sizeof(raw));
+            memcpy(&wire_type, raw, 4);
+            memcpy(&header->data_len, raw + 4, 2);
+            memcpy(&header->tag, raw + 6, 2);
+            frame_decode_type(header, wire_type);
+
+            size_t frame_len = FRAME_HEADER_SIZE + header->data_len;
+            if (frame_len > tail - head) {
+                /* Senders publish whole frames, so this is corruption */
+                return FRAME_ERROR;
+            }
+
+            int result = FRAME_TOO_LARGE;
+            if (header->data_len <= data_size) {
+                ring_read(ring, head + FRAME_HEADER_SIZE, data,
+                          header->data_len);
+                result = FRAME_OK;
+            }
+            atomic_store(&ring->head, head + (uint32_t)frame_len);
+            futex_ring(&ring->space_waiting, &ring->space_seq);
+            return result;
+        }
+
+        int wait_ms = remaining_ms(deadline);
+        if (wait_ms == 0) {
+            return SHM_TIMEOUT;
+        }
+        uint32_t seq = atomic_load(&ring->data_seq);
+        atomic_store(&ring->data_waiting, 1);
+        if (atomic_load(&ring->tail) == tail) {
+            futex_wait(&ring->data_seq, seq, wait_ms);
+        }
+        atomic_store(&ring->data_waiting, 0);
+    }
+}
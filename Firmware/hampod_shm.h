@@ -0,0 +1,115 @@
+/**
+ * hampod_shm.h - Shared-memory transport between Software2 and the Firmware
+ *
+ * An optional replacement for the Firmware_i/Firmware_o FIFOs. The Firmware
+ * creates one POSIX shared-memory region at start-up holding two
+ * single-producer/single-consumer byte rings, one per direction. Packets use
+ * the same 8-byte header + data framing as the pipes (hampod_frame.h), so
+ * the payloads are identical whichever transport carries them.
+ *
+ * Each ring has futex doorbells for "data available" and "space available".
+ * A side only makes the wake syscall when the other side has said it is
+ * sleeping, so a busy link exchanges packets without entering the kernel.
+ *
+ * The FIFOs remain the default and the fallback: Software2 always opens
+ * them and reads the ready packet from Firmware_o, then calls
+ * shm_link_attach(). Once it has attached, the Firmware sends every reply
+ * through the region instead of Firmware_o.
+ *
+ * Shared by the Firmware and Software2 (which builds this file directly).
+ */
+
+#ifndef HAMPOD_SHM_H
+#define HAMPOD_SHM_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hampod_frame.h"
+
+#define HAMPOD_SHM_NAME "/hampod_transport"
+#define HAMPOD_SHM_MAGIC 0x444d5048u /* "HPMD" */
+#define HAMPOD_SHM_VERSION 1
+
+/* Bytes per direction. Must be a power of two. */
+#define SHM_RING_SIZE 16384
+
+/* shm_link_recv() result when nothing arrived before the timeout */
+#define SHM_TIMEOUT -3
+
+/* How long a sender waits for ring space before dropping the packet */
+#define SHM_SEND_TIMEOUT_MS 1000
+
+typedef struct Shm_ring {
+    /* Consumer-owned */
+    _Alignas(64) _Atomic uint32_t head;
+    _Atomic uint32_t space_seq;     /* Futex word: bumped when space frees */
+    _Atomic uint32_t space_waiting; /* Producer is asleep on space_seq */
+    /* Producer-owned */
+    _Alignas(64) _Atomic uint32_t tail;
+    _Atomic uint32_t data_seq;     /* Futex word: bumped on new data */
+    _Atomic uint32_t data_waiting; /* Consumer is asleep on data_seq */
+    _Alignas(64) unsigned char data[SHM_RING_SIZE];
+} Shm_ring;
+
+typedef struct Shm_region {
+    uint32_t magic;
+    uint32_t version;
+    _Atomic uint32_t attached; /* Software2 is using the region */
+    Shm_ring to_firmware;
+    Shm_ring to_software;
+} Shm_region;
+
+/* One process's handle on the region */
+typedef struct Shm_link {
+    Shm_region *region;
+    Shm_ring *tx;
+    Shm_ring *rx;
+    pthread_mutex_t tx_lock; /* Serializes senders within this process */
+    char name[64];
+    int owner; /* Created the region, unlinks it on close */
+} Shm_link;
+
+/**
+ * Create (or recreate) the region. Called by the Firmware.
+ * @return 0 on success, -1 on error
+ */
+int shm_link_create(Shm_link *link, const char *name);
+
+/**
+ * Map an existing region and mark it attached. Called by Software2.
+ * @return 0 on success, -1 if the region is missing or incompatible
+ */
+int shm_link_attach(Shm_link *link, const char *name);
+
+/**
+ * Unmap the region (and unlink it if this side created it).
+ */
+void shm_link_close(Shm_link *link);
+
+/**
+ * True once Software2 has attached to the region.
+ */
+int shm_link_is_attached(const Shm_link *link);
+
+/**
+ * Send one packet. Thread-safe.
+ * @return 0 on success, -1 if the packet is too large or the ring stayed
+ *         full for SHM_SEND_TIMEOUT_MS
+ */
+int shm_link_send(Shm_link *link, int type, unsigned short tag,
+                  const void *data, unsigned short data_len);
+
+/**
+ * Receive one packet. Only one thread per process may receive.
+ *
+ * @param timeout_ms Maximum wait, or -1 to wait forever
+ * @return FRAME_OK, FRAME_TOO_LARGE (packet skipped), SHM_TIMEOUT or
+ *         FRAME_ERROR
+ */
+int shm_link_recv(Shm_link *link, Frame_header *header, unsigned char *data,
+                  size_t data_size, int timeout_ms);
+
+#endif
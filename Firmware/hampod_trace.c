@@ -0,0 +1,178 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hampod_trace.h"
+
+uint64_t trace_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+// ============================================================================
+// Recording
+// ============================================================================
+
+int trace_open(Trace_writer *writer, const char *path, int source) {
+    writer->fd = -1;
+    writer->source = (uint8_t)source;
+
+    /* The header is written to a temporary file that is then linked in
+     * under the real name, so no other process can append records to a
+     * file that has no header yet. link() refuses to replace a file, so
+     * whoever links first creates the trace and the other side of the
+     * link just appends to it. */
+    char temp[4096];
+    if (snprintf(temp, sizeof(temp), "%s.XXXXXX", path) >= (int)sizeof(temp)) {
+        return -1;
+    }
+    int fd = mkstemp(temp);
+    if (fd == -1) {
+        return -1;
+    }
+    Trace_file_header header = {HAMPOD_TRACE_MAGIC, HAMPOD_TRACE_VERSION, 0};
+    if (fchmod(fd, 0644) != 0 ||
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_APPEND) != 0 ||
+        write(fd, &header, sizeof(header)) != sizeof(header)) {
+        close(fd);
+        unlink(temp);
+        return -1;
+    }
+
+    int linked = link(temp, path);
+    int link_errno = errno;
+    unlink(temp);
+    if (linked != 0) {
+        close(fd);
+        if (link_errno != EEXIST) {
+            return -1;
+        }
+        fd = open(path, O_WRONLY | O_APPEND);
+        if (fd == -1) {
+            return -1;
+        }
+    }
+
+    writer->fd = fd;
+    return 0;
+}
+
+int trace_open_from_env(Trace_writer *writer, int source) {
+    const char *path = getenv(HAMPOD_TRACE_ENV);
+    if (path == NULL || path[0] == '\0') {
+        writer->fd = -1;
+        writer->source = (uint8_t)source;
+        return -1;
+    }
+    return trace_open(writer, path, source);
+}
+
+void trace_record(Trace_writer *writer, int direction, int type,
+                  unsigned short tag, const void *data, size_t data_len) {
+    if (writer->fd == -1) {
+        return;
+    }
+
+    Trace_record record;
+    memset(&record, 0, sizeof(record));
+    record.time_ns = trace_now_ns();
+    record.direction = (uint8_t)direction;
+    record.source = writer->source;
+    record.tag = tag;
+    record.type = type;
+    record.data_len = (uint16_t)data_len;
+
+    struct iovec iov[2];
+    iov[0].iov_base = &record;
+    iov[0].iov_len = sizeof(record);
+    iov[1].iov_base = (void *)data;
+    iov[1].iov_len = data_len;
+
+    /* One writev() on an O_APPEND descriptor lands as one piece. A failed
+     * write only loses this record; tracing must never stall the link. */
+    ssize_t ignored = writev(writer->fd, iov, data_len > 0 ? 2 : 1);
+    (void)ignored;
+}
+
+void trace_close(Trace_writer *writer) {
+    if (writer->fd != -1) {
+        close(writer->fd);
+        writer->fd = -1;
+    }
+}
+
+// ============================================================================
+// Reading
+// ============================================================================
+
+/* Read exactly len bytes. Returns len, 0 at a clean end of file, or -1 */
+static ssize_t read_full(int fd, void *buffer, size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t got = read(fd, (unsigned char *)buffer + done, len - done);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0) {
+            return -1;
+        }
+        if (got == 0) {
+            return done == 0 ? 0 : -1;
+        }
+        done += got;
+    }
+    return (ssize_t)done;
+}
+
+int trace_reader_open(Trace_reader *reader, const char *path) {
+    reader->fd = open(path, O_RDONLY);
+    if (reader->fd == -1) {
+        return -1;
+    }
+
+    Trace_file_header header;
+    if (read_full(reader->fd, &header, sizeof(header)) != sizeof(header) ||
+        header.magic != HAMPOD_TRACE_MAGIC ||
+        header.version != HAMPOD_TRACE_VERSION) {
+        close(reader->fd);
+        reader->fd = -1;
+        errno = EPROTO;
+        return -1;
+    }
+    return 0;
+}
+
+int trace_read(Trace_reader *reader, Trace_record *record,
+               unsigned char *data, size_t data_size) {
+    ssize_t got = read_full(reader->fd, record, sizeof(*record));
+    if (got == 0) {
+        return TRACE_END;
+    }
+    if (got != sizeof(*record)) {
+        return TRACE_ERROR; /* Truncated, e.g. the recorder was killed */
+    }
+
+    if (record->data_len > data_size) {
+        lseek(reader->fd, record->data_len, SEEK_CUR);
+        return TRACE_ERROR;
+    }
+    if (record->data_len > 0 &&
+        read_full(reader->fd, data, record->data_len) != record->data_len) {
+        return TRACE_ERROR;
+    }
+    return TRACE_OK;
+}
+
+void trace_reader_close(Trace_reader *reader) {
+    if (reader->fd != -1) {
+        close(reader->fd);
+        reader->fd = -1;
+    }
+}
@@ -0,0 +1,117 @@
+/**
+ * hampod_trace.h - Packet trace recorder for the Software2 <-> Firmware link
+ *
+ * Opt-in: when the HAMPOD_TRACE environment variable names a file, comm.c
+ * and firmware.c append every packet that crosses Firmware_i/Firmware_o
+ * (or the shared-memory rings) to it. Both processes may share one file;
+ * each record says which side wrote it.
+ *
+ * File layout (host byte order, which is little-endian on the Pi):
+ *
+ *   Trace_file_header, then per packet a Trace_record followed by
+ *   data_len bytes of payload.
+ *
+ * Each record goes out in a single write() on an O_APPEND descriptor, so
+ * records from several threads and processes never interleave.
+ *
+ * hampod_replay reads these files back (see hampod_replay.c).
+ *
+ * Shared by the Firmware and Software2 (which builds this file directly).
+ */
+
+#ifndef HAMPOD_TRACE_H
+#define HAMPOD_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HAMPOD_TRACE_ENV "HAMPOD_TRACE"
+#define HAMPOD_TRACE_MAGIC 0x52545048u /* "HPTR" */
+#define HAMPOD_TRACE_VERSION 1
+
+/* Trace_record.direction */
+#define TRACE_TO_FIRMWARE 0   /* Software2 -> Firmware request */
+#define TRACE_FROM_FIRMWARE 1 /* Firmware -> Software2 reply or event */
+
+/* Trace_record.source: which side recorded the packet */
+#define TRACE_SOURCE_SOFTWARE 0
+#define TRACE_SOURCE_FIRMWARE 1
+
+/* trace_read() return codes */
+#define TRACE_OK 1
+#define TRACE_END 0
+#define TRACE_ERROR -1
+
+typedef struct Trace_file_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+} Trace_file_header;
+
+typedef struct Trace_record {
+    uint64_t time_ns;  /* CLOCK_MONOTONIC, comparable across processes */
+    uint8_t direction; /* TRACE_TO_FIRMWARE / TRACE_FROM_FIRMWARE */
+    uint8_t source;    /* TRACE_SOURCE_* */
+    uint16_t tag;
+    int32_t type;      /* Wire type field: packet type and class byte */
+    uint16_t data_len; /* Whole message, chunks already joined */
+    uint16_t reserved;
+    uint32_t reserved2;
+} Trace_record;
+
+typedef struct Trace_writer {
+    int fd; /* -1 when tracing is off */
+    uint8_t source;
+} Trace_writer;
+
+typedef struct Trace_reader {
+    int fd;
+} Trace_reader;
+
+/**
+ * Open path for appending, writing the file header if the file is new.
+ * @return 0 on success, -1 on error (writer stays disabled)
+ */
+int trace_open(Trace_writer *writer, const char *path, int source);
+
+/**
+ * trace_open() on $HAMPOD_TRACE. Leaves the writer disabled when the
+ * variable is unset or empty.
+ * @return 0 if tracing, -1 otherwise
+ */
+int trace_open_from_env(Trace_writer *writer, int source);
+
+/**
+ * Append one packet. Does nothing when the writer is disabled. Thread-safe.
+ */
+void trace_record(Trace_writer *writer, int direction, int type,
+                  unsigned short tag, const void *data, size_t data_len);
+
+void trace_close(Trace_writer *writer);
+
+static inline int trace_enabled(const Trace_writer *writer) {
+    return writer->fd != -1;
+}
+
+/**
+ * Open a trace for reading and check its header.
+ * @return 0 on success, -1 on error (errno set)
+ */
+int trace_reader_open(Trace_reader *reader, const char *path);
+
+/**
+ * Read the next record. If data_len exceeds data_size the payload is
+ * skipped and TRACE_ERROR is returned.
+ * @return TRACE_OK, TRACE_END or TRACE_ERROR
+ */
+int trace_read(Trace_reader *reader, Trace_record *record,
+               unsigned char *data, size_t data_size);
+
+void trace_reader_close(Trace_reader *reader);
+
+/**
+ * Current CLOCK_MONOTONIC time in nanoseconds.
+ */
+uint64_t trace_now_ns(void);
+
+#endif
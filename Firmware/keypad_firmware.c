@@ -15,24 +15,54 @@
 #include <unistd.h>
 #include <time.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "hal/hal_keypad.h"
 #include "hampod_firm_packet.h"
-#include "hampod_queue.h"
+#include "hampod_frame.h"
+#include "hampod_ring.h"
 #include "keypad_firmware.h"
 
 extern pid_t controller_pid;
 
 unsigned char keypad_running = 1;
 
-pthread_mutex_t keypad_queue_lock;
-pthread_mutex_t keypad_queue_available;
+
+/* Set once Software subscribes; from then on the push thread owns the HAL */
+static volatile bool keypad_push_mode = false;
+static pthread_t keypad_push_thread_id;
+
 static int64_t elapsed_ns(struct timespec start, struct timespec end)
 {
     return (end.tv_sec - start.tv_sec) * 1000000000LL +
            (end.tv_nsec - start.tv_nsec);
 }
+static double elapsed_ms(struct timespec start, struct timespec end)
+{
+    return elapsed_ns(start, end) / 1000000.0;
+}
 void *keypad_io_thread(void *arg);
+void *keypad_push_thread(void *arg);
+
+/* Send a KEYPAD packet to the Firmware controller. Both the request loop and
+ * the push thread write to Keypad_o; frame_write() sends each packet in one
+ * atomic write so they cannot interleave. */
+static void keypad_send(int output_pipe_fd, unsigned short tag,
+                        const void *data, unsigned short len) {
+  frame_write(output_pipe_fd, KEYPAD, tag, data, len);
+}
+
+static void keypad_send_event(int output_pipe_fd, unsigned short tag,
+                              char key, unsigned char action,
+                              struct timeval time) {
+  Keypad_event_payload payload;
+  memset(&payload, 0, sizeof(payload));
+  payload.key = (unsigned char)key;
+  payload.action = action;
+  payload.sec = (unsigned int)time.tv_sec;
+  payload.usec = (unsigned int)time.tv_usec;
+  keypad_send(output_pipe_fd, tag, &payload, sizeof(payload));
+}
 
 // Debug print statements from this process are White (\033[0;m)
 
@@ -54,7 +84,7 @@ void keypad_process() {
   clock_gettime(CLOCK_MONOTONIC, &end);
   printf("Elapsed = %.3f ms\n",
        elapsed_ms(start, end));
-  KEYPAD_PRINTF("[LATENCY][KEYPAD] intializationtime: %.3f ms\n",
+  KEYPAD_PRINTF("[LATENCY][KEYPAD] initialization time: %.3f ms\n",
               elapsed_ms(start, end));
   KEYPAD_PRINTF("Connecting to input/output pipes\n");
 
@@ -73,30 +103,15 @@ void keypad_process() {
   }
 
   KEYPAD_PRINTF("Pipes successfully connected\n");
-  KEYPAD_PRINTF("Creating input queue\n");
+  KEYPAD_PRINTF("Creating input ring\n");
 
-  Packet_queue *input_queue = create_packet_queue();
-
-  KEYPAD_PRINTF("Creating queue mutex lock\n");
-
-  if (pthread_mutex_init(&keypad_queue_lock, NULL) != 0) {
-    perror("pthread_mutex_init");
-    // kill(controller_pid, SIGINT);
-    exit(1);
-  }
-  KEYPAD_PRINTF("Creating queue availibility mutex lock\n");
-
-  if (pthread_mutex_init(&keypad_queue_available, NULL) != 0) {
-    perror("pthread_mutex_init");
-    // kill(controller_pid, SIGINT);
-    exit(1);
-  }
+  Packet_ring *input_ring = create_packet_ring(PACKET_RING_DEFAULT_CAPACITY);
 
   pthread_t keypad_io_buffer;
 
   keypad_io_packet thread_input;
   thread_input.pipe_fd = input_pipe_fd;
-  thread_input.queue = input_queue;
+  thread_input.ring = input_ring;
 
   KEYPAD_PRINTF("Launching IO thread\n");
 
@@ -106,23 +121,14 @@ void keypad_process() {
     // kill(controller_pid, SIGINT);
     exit(1);
   }
-  usleep(500000); // Half sec sleep to let child thread take control
 while (keypad_running) {
-    pthread_mutex_lock(&keypad_queue_available);
-    pthread_mutex_lock(&keypad_queue_lock);
-
-    if (is_empty(input_queue)) {
-        pthread_mutex_unlock(&keypad_queue_available);
-        pthread_mutex_unlock(&keypad_queue_lock);
-        usleep(500);
-        continue;
+    /* Sleeps until the IO thread pushes a packet */
+    Inst_packet *received_packet = packet_ring_wait(input_ring);
+    if (received_packet == NULL) {
+        KEYPAD_PRINTF("Input ring closed\n");
+        break;
     }
 
-    Inst_packet *received_packet = dequeue(input_queue);
-
-    pthread_mutex_unlock(&keypad_queue_lock);
-    pthread_mutex_unlock(&keypad_queue_available);
-
     char read_value = '-';
     bool key_pressed = false;
 
@@ -130,7 +136,28 @@ while (keypad_running) {
     struct timespec t_keypad_after_read;
     struct timespec t_keypad_after_write;
 
-    if (received_packet->data[0] == 'r') {
+    if (received_packet->data[0] == KEYPAD_REQUEST_SUBSCRIBE) {
+        /* Switch to push mode: a dedicated thread blocks on the input
+         * device and streams every transition to Software. */
+        if (!keypad_push_mode) {
+            KEYPAD_PRINTF("Software subscribed, starting push thread\n");
+            keypad_push_mode = true;
+            if (pthread_create(&keypad_push_thread_id, NULL,
+                               keypad_push_thread,
+                               (void *)(intptr_t)output_pipe_fd) != 0) {
+                perror("Keypad push thread failed");
+                keypad_push_mode = false;
+            }
+        }
+        struct timeval now = {0, 0};
+        keypad_send_event(output_pipe_fd, received_packet->tag, '-',
+                          keypad_push_mode ? KEYPAD_EVENT_SUBSCRIBED : 0,
+                          now);
+        packet_ring_release(input_ring);
+        continue;
+    }
+
+    if (received_packet->data[0] == KEYPAD_REQUEST_READ && !keypad_push_mode) {
 
         clock_gettime(CLOCK_MONOTONIC, &t_keypad_start);
 
@@ -145,23 +172,17 @@ while (keypad_running) {
             read_value = event.key;
 
             KEYPAD_PRINTF(
-                "[LATENCY][KEYPAD] Key '%c' HAL read: %.3f ns\n",
+                "[LATENCY][KEYPAD] Key '%c' HAL read: %ld ns\n",
                 read_value,
-                elapsed_ns(t_keypad_start, t_keypad_after_read));
+                (long)elapsed_ns(t_keypad_start, t_keypad_after_read));
         }
     }
 
-    Inst_packet *packet_to_send =
-        create_inst_packet(KEYPAD, 1,
-                           (unsigned char *)&read_value,
-                           received_packet->tag);
-
     KEYPAD_PRINTF("Sending back value of %x ('%c')\n",
                   read_value,
                   (char)read_value);
 
-    write(output_pipe_fd, packet_to_send, 8);
-    write(output_pipe_fd, packet_to_send->data, 1);
+    keypad_send(output_pipe_fd, received_packet->tag, &read_value, 1);
 
     if (key_pressed) {
 
@@ -173,10 +194,10 @@ while (keypad_running) {
             elapsed_ms(t_keypad_start, t_keypad_after_write));
     }
 
-    destroy_inst_packet(&packet_to_send);
+    packet_ring_release(input_ring);
 }
   pthread_join(keypad_io_buffer, NULL);
-  destroy_queue(input_queue);
+  destroy_packet_ring(input_ring);
   close(input_pipe_fd);
   close(output_pipe_fd); // Graceful closing is always nice :)
 
@@ -191,49 +212,28 @@ void *keypad_io_thread(void *arg) {
 
   keypad_io_packet *new_packet = (keypad_io_packet *)arg;
   int i_pipe = new_packet->pipe_fd;
-  Packet_queue *queue = new_packet->queue;
+  Packet_ring *ring = new_packet->ring;
   unsigned char buffer[256];
+  Frame_reader reader;
+  frame_reader_init(&reader, i_pipe);
 
-  KEYPAD_IO_PRINTF("Input pipe = %d, queue ptr = %p\n", i_pipe, queue);
+  KEYPAD_IO_PRINTF("Input pipe = %d, ring ptr = %p\n", i_pipe, ring);
 
   while (keypad_running) {
-    pthread_mutex_lock(&keypad_queue_lock);
-    int queue_empty = is_empty(queue);
-    pthread_mutex_unlock(&keypad_queue_lock);
-    if (queue_empty) {
-      KEYPAD_IO_PRINTF("Making queue inaccessible\n");
-      pthread_mutex_lock(&keypad_queue_available);
-    }
-
-    Packet_type type;
-    unsigned short size;
-    unsigned short tag;
-    ssize_t bytes_read;
-
-    /* Read packet header with error checking */
-    bytes_read = read(i_pipe, &type, sizeof(Packet_type));
-    if (bytes_read <= 0) {
-      KEYPAD_IO_PRINTF("Pipe closed or read error (type), exiting thread\n");
-      break;
-    }
-
-    bytes_read = read(i_pipe, &size, sizeof(unsigned short));
-    if (bytes_read <= 0) {
-      KEYPAD_IO_PRINTF("Pipe closed or read error (size), exiting thread\n");
-      break;
-    }
-
-    bytes_read = read(i_pipe, &tag, sizeof(unsigned short));
-    if (bytes_read <= 0) {
-      KEYPAD_IO_PRINTF("Pipe closed or read error (tag), exiting thread\n");
-      break;
+    Frame_header header;
+    int result = frame_read_message(&reader, &header, buffer, sizeof(buffer));
+    if (result == FRAME_TOO_LARGE) {
+      KEYPAD_IO_PRINTF("Dropped oversized packet (%d bytes)\n",
+                       header.data_len);
+      continue;
     }
-
-    bytes_read = read(i_pipe, buffer, size);
-    if (bytes_read <= 0) {
-      KEYPAD_IO_PRINTF("Pipe closed or read error (data), exiting thread\n");
+    if (result != FRAME_OK) {
+      KEYPAD_IO_PRINTF("Pipe closed or read error, exiting thread\n");
       break;
     }
+    Packet_type type = (Packet_type)header.type;
+    unsigned short size = header.data_len;
+    unsigned short tag = header.tag;
 
     KEYPAD_IO_PRINTF("Found packet with type %d, size %d\n", type, size);
     KEYPAD_IO_PRINTF("Buffer holds: %s: with size %d\n", buffer, size);
@@ -243,20 +243,44 @@ void *keypad_io_thread(void *arg) {
       continue;
     }
 
-    Inst_packet *new_packet = create_inst_packet(type, size, buffer, tag);
+    KEYPAD_IO_PRINTF("Queueing packet\n");
+    packet_ring_push(ring, type, tag, buffer, size);
+  }
+  /* Wake the request loop so it can shut down */
+  packet_ring_close(ring);
+  return NULL;
+}
 
-    KEYPAD_IO_PRINTF("Locking queue\n");
-    pthread_mutex_lock(&keypad_queue_lock);
+// Debug print statements from this thread use the IO thread color
+void *keypad_push_thread(void *arg) {
+  int output_pipe_fd = (int)(intptr_t)arg;
 
-    KEYPAD_IO_PRINTF("Queueing packet\n");
-    enqueue(queue, new_packet);
+  KEYPAD_IO_PRINTF("Keypad push thread created\n");
+
+  while (keypad_running) {
+    KeypadEvent event;
+    int result = hal_keypad_wait_event(&event, -1);
+
+    if (result < 0) {
+      /* Device missing or unplugged - retry once a second */
+      hal_keypad_cleanup();
+      sleep(1);
+      hal_keypad_init();
+      continue;
+    }
+    if (result == 0) {
+      continue;
+    }
 
-    KEYPAD_IO_PRINTF("Releasing queue & making it accessible\n");
-    pthread_mutex_unlock(&keypad_queue_lock);
-    if (queue_empty) {
-      pthread_mutex_unlock(&keypad_queue_available);
+    unsigned char action = KEYPAD_EVENT_PRESS;
+    if (event.action == KEYPAD_ACTION_REPEAT) {
+      action = KEYPAD_EVENT_REPEAT;
+    } else if (event.action == KEYPAD_ACTION_RELEASE) {
+      action = KEYPAD_EVENT_RELEASE;
     }
-    usleep(100);
+
+    KEYPAD_IO_PRINTF("Pushing key '%c' action '%c'\n", event.key, action);
+    keypad_send_event(output_pipe_fd, 0, event.key, action, event.time);
   }
   return NULL;
 }
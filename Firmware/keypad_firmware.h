@@ -16,6 +16,7 @@
 #include <signal.h>
 
 #include "hampod_queue.h"
+#include "hampod_ring.h"
 #include "hampod_firm_packet.h"
 
 #define KEYPAD_O "../Firmware/Keypad_o"
@@ -52,7 +53,7 @@
 
 typedef struct keypad_io_packet {
     int pipe_fd;
-    Packet_queue* queue;
+    Packet_ring* ring; /* IO thread -> worker handoff */
 } keypad_io_packet;
 
 void keypadTurnon();
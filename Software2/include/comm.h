@@ -8,12 +8,24 @@
  * - Firmware_i: Software -> Firmware (we write audio requests)
  * - Keypad_o: (Legacy) Direct keypad output - NOT USED in packet mode
  *
+ * With COMM_TRANSPORT_SHM the pipes are still opened (the ready packet and
+ * end-of-session detection use them), but packets then travel through the
+ * shared-memory rings in Firmware/hampod_shm.h.
+ *
+ * With COMM_TRANSPORT_LOCAL (unified build) no pipes are used and no
+ * firmware.elf runs: comm_local.c calls the Firmware HAL directly and its
+ * replies are routed into the same response queues.
+ *
  * Communication uses binary packets (see Firmware/hampod_firm_packet.h):
  * - Packet_type (4 bytes): KEYPAD=0, AUDIO=1, SERIAL=2, CONFIG=3
  * - data_len (2 bytes): Length of payload
  * - tag (2 bytes): Sequence tag for matching requests/responses
  * - data (variable): Payload bytes
  *
+ * The ready packet tells us the Firmware's protocol version and
+ * capabilities (comm_get_firmware_info()). Messages longer than one frame
+ * are sent as chunks when the Firmware supports it.
+ *
  * Part of Phase 0: Core Infrastructure (Step 1.1, 1.2)
  */
 
@@ -21,6 +33,7 @@
 #define COMM_H
 
 #include "hampod_core.h"
+#include "hampod_frame.h"
 
 // ============================================================================
 // Packet Types (mirrored from Firmware/hampod_firm_packet.h)
@@ -37,7 +50,9 @@ typedef enum {
 // Packet Structure
 // ============================================================================
 
-#define COMM_MAX_DATA_LEN 256
+// Largest payload in either direction. The Firmware may accept less, see
+// comm_max_payload().
+#define COMM_MAX_DATA_LEN FRAME_MAX_MESSAGE
 
 typedef struct {
   PacketType type;
@@ -46,6 +61,57 @@ typedef struct {
   unsigned char data[COMM_MAX_DATA_LEN];
 } CommPacket;
 
+// ============================================================================
+// Transport Selection
+// ============================================================================
+
+typedef enum {
+  COMM_TRANSPORT_FIFO = 0, // Named pipes only
+  COMM_TRANSPORT_SHM = 1,  // Shared memory once Firmware is ready
+  COMM_TRANSPORT_LOCAL = 2 // Firmware HAL linked in ('make unified' only)
+} CommTransport;
+
+/**
+ * Choose the transport. Must be called before comm_init().
+ * Defaults to COMM_TRANSPORT_FIFO. COMM_TRANSPORT_LOCAL falls back to the
+ * pipes in builds without HAMPOD_UNIFIED.
+ */
+void comm_set_transport(CommTransport transport);
+
+/**
+ * Transport actually in use. This is COMM_TRANSPORT_FIFO when another
+ * transport was requested but could not be used.
+ */
+CommTransport comm_get_transport(void);
+
+// ============================================================================
+// Firmware Capabilities
+// ============================================================================
+
+// What the Firmware advertised in its ready packet (Frame_hello)
+typedef struct {
+  int version;        // 1 for Firmware that sends a bare 'R'
+  unsigned int caps;  // HAMPOD_CAP_* bits
+  size_t max_frame;   // Largest data_len of one frame on the pipes
+  size_t max_message; // Largest payload comm_send_packet() will send
+} CommFirmwareInfo;
+
+/**
+ * Firmware description from the last comm_wait_ready(). Before that it
+ * describes a version 1 Firmware (no capabilities, 256-byte payloads).
+ */
+const CommFirmwareInfo *comm_get_firmware_info(void);
+
+/**
+ * Check for one HAMPOD_CAP_* capability.
+ */
+bool comm_firmware_has(unsigned int cap);
+
+/**
+ * Largest packet payload the Firmware accepts, in bytes.
+ */
+size_t comm_max_payload(void);
+
 // ============================================================================
 // Initialization & Cleanup
 // ============================================================================
@@ -75,7 +141,9 @@ bool comm_is_connected(void);
  * Wait for Firmware "ready" signal.
  *
  * After comm_init(), the Firmware sends a CONFIG packet with 'R' to indicate
- * it's ready for commands. Call this before sending any requests.
+ * it's ready for commands, followed by its capabilities. Call this before
+ * sending any requests. If the shared-memory transport was requested and
+ * the Firmware offers it, it is attached here.
  *
  * @return HAMPOD_OK if ready signal received, HAMPOD_ERROR otherwise
  */
@@ -87,6 +155,7 @@ int comm_wait_ready(void);
 
 /**
  * Read a packet from Firmware (blocking).
+ * Not available with COMM_TRANSPORT_LOCAL, which has no packet stream.
  *
  * @param packet Pointer to packet structure to fill
  * @return HAMPOD_OK on success, HAMPOD_ERROR on read failure
@@ -106,6 +175,105 @@ int comm_read_packet(CommPacket *packet);
  */
 int comm_read_keypad(char *key_out);
 
+// ============================================================================
+// Push-mode Keypad Events (mirrored from Firmware/hampod_firm_packet.h)
+// ============================================================================
+
+#define COMM_KEYPAD_EVENT_PRESS 'p'
+#define COMM_KEYPAD_EVENT_REPEAT 'h'
+#define COMM_KEYPAD_EVENT_RELEASE 'u'
+#define COMM_KEYPAD_EVENT_SUBSCRIBED 's'
+
+/**
+ * Wire format of a push-mode KEYPAD packet. Poll replies are a single byte,
+ * so event packets are recognised by data_len == sizeof(CommKeypadEventWire).
+ */
+typedef struct {
+  unsigned char key;
+  unsigned char action;
+  unsigned short reserved;
+  unsigned int sec;
+  unsigned int usec;
+} CommKeypadEventWire;
+
+/**
+ * A decoded keypad transition pushed by Firmware.
+ */
+typedef struct {
+  char key;      // Key character ('0'-'9', 'A'-'D', '*', '#')
+  char action;   // COMM_KEYPAD_EVENT_PRESS / _REPEAT / _RELEASE
+  long time_ms;  // Kernel timestamp in milliseconds (CLOCK_MONOTONIC)
+} CommKeypadEvent;
+
+/**
+ * Ask Firmware to push keypad events instead of answering polls.
+ *
+ * Firmware replies with a COMM_KEYPAD_EVENT_SUBSCRIBED event. Older
+ * Firmware answers with a one-byte poll reply instead, in which case
+ * this returns HAMPOD_ERROR and the caller should keep polling.
+ *
+ * @return HAMPOD_OK if push mode is active, HAMPOD_ERROR otherwise
+ */
+int comm_subscribe_keypad(void);
+
+/**
+ * Wait for the next pushed keypad event.
+ *
+ * @param event Pointer to store the decoded event
+ * @param timeout_ms Maximum time to wait
+ * @return HAMPOD_OK on event, HAMPOD_TIMEOUT if none arrived, HAMPOD_ERROR on
+ * failure
+ */
+int comm_wait_keypad_event(CommKeypadEvent *event, int timeout_ms);
+
+// ============================================================================
+// Request Tracking
+// ============================================================================
+
+// Outstanding requests that can be waited on at once
+#define COMM_MAX_PENDING 16
+
+/**
+ * Handle for a request whose reply the caller wants.
+ *
+ * Firmware echoes the request's tag in its reply. The router looks the tag
+ * up in a pending table and hands the reply to that request only. A stale
+ * beep ack or a pushed keypad event can never satisfy a different request,
+ * and several requests can be outstanding at once. Tag 0 is never handed
+ * out because Firmware uses it for unsolicited packets.
+ */
+typedef struct {
+  unsigned short tag;
+} CommRequest;
+
+/**
+ * Assign a fresh tag to packet, register it and send it.
+ *
+ * @param packet Packet to send (its tag is overwritten)
+ * @param request Receives the handle
+ * @return HAMPOD_OK on success, HAMPOD_ERROR if the send failed or
+ *         COMM_MAX_PENDING requests are already outstanding
+ */
+int comm_send_request(CommPacket *packet, CommRequest *request);
+
+/**
+ * Wait for the reply to a request. The handle is released on return, so
+ * call this (or comm_cancel_request()) exactly once per request.
+ *
+ * @param request Handle from comm_send_request()
+ * @param reply Receives the reply packet
+ * @param timeout_ms Maximum time to wait
+ * @return HAMPOD_OK, HAMPOD_TIMEOUT (a late reply is dropped),
+ *         HAMPOD_NOT_FOUND for an unknown handle, or HAMPOD_ERROR if the
+ *         router stopped
+ */
+int comm_wait_request(CommRequest *request, CommPacket *reply, int timeout_ms);
+
+/**
+ * Give up on a request without waiting; its reply will be dropped.
+ */
+void comm_cancel_request(CommRequest *request);
+
 // ============================================================================
 // Writing to Firmware
 // ============================================================================
@@ -119,7 +287,10 @@ int comm_read_keypad(char *key_out);
 int comm_send_packet(const CommPacket *packet);
 
 /**
- * Send an audio request to Firmware.
+ * Send an audio request to Firmware (fire-and-forget).
+ *
+ * Firmware's acknowledgment is dropped by the router. Use
+ * comm_send_audio_request() to wait for it.
  *
  * @param audio_type One of: AUDIO_TYPE_TTS ('d'), AUDIO_TYPE_FILE ('p'),
  *                   AUDIO_TYPE_SPELL ('s')
@@ -132,6 +303,17 @@ int comm_send_packet(const CommPacket *packet);
  */
 int comm_send_audio(char audio_type, const char *payload);
 
+/**
+ * Send an audio request and get a handle for its acknowledgment.
+ *
+ * @param audio_type Audio type character
+ * @param payload Text or file path
+ * @param request Receives the handle; pass it to comm_wait_request()
+ * @return HAMPOD_OK on success, HAMPOD_ERROR on failure
+ */
+int comm_send_audio_request(char audio_type, const char *payload,
+                            CommRequest *request);
+
 /**
  * Send audio and wait for Firmware acknowledgment.
  *
@@ -184,14 +366,86 @@ int comm_play_beep(CommBeepType beep_type);
  */
 int comm_set_speech_speed(float speed);
 
+/**
+ * Set the output volume.
+ *
+ * The Firmware applies it as a software gain in its audio mixer, ramped so
+ * the change does not click. Works on any card and needs no amixer.
+ *
+ * @param percent Volume 0-100 (100 = unchanged level)
+ * @return HAMPOD_OK on success, HAMPOD_ERROR on failure
+ */
+int comm_set_volume(int percent);
+
+/**
+ * Set the Firmware's audio output period and buffer.
+ *
+ * Needs HAMPOD_CAP_AUDIO_OUTPUT. The Firmware reopens the device between
+ * periods, or keeps its current settings if the device refuses these.
+ *
+ * @param period_ms Period, 4-50 ms (shorter = beeps and interrupts heard
+ *                  sooner, more CPU wake-ups)
+ * @param buffer_ms Device buffer, two periods to 500 ms
+ * @param use_mmap Mix straight into the mapped device buffer
+ * @return HAMPOD_OK on success, HAMPOD_ERROR on failure
+ */
+int comm_set_audio_output(int period_ms, int buffer_ms, bool use_mmap);
+
+// ============================================================================
+// Audio Pipeline Statistics (mirrored from Firmware/hampod_firm_packet.h)
+// ============================================================================
+
+#define COMM_AUDIO_STATS_VERSION 1
+
+/** One latency histogram summary, in microseconds */
+typedef struct {
+  unsigned int count;
+  unsigned int p50_us;
+  unsigned int p90_us;
+  unsigned int p99_us;
+  unsigned int max_us;
+} CommAudioLatencyWire;
+
+/**
+ * Wire format of the reply to an AUDIO_TYPE_STATS query. Percentiles are
+ * histogram bucket upper edges, so within 25% of the true value.
+ */
+typedef struct {
+  unsigned char version;
+  unsigned char reserved[3];
+  unsigned int xruns;        // Device ran dry
+  unsigned int recoveries;   // Successful snd_pcm_recover() calls
+  unsigned int interrupts;   // Interrupts that stopped audio
+  unsigned int drops;        // Sounds refused or cut short
+  unsigned int queue_ms;     // Audio backlog now
+  unsigned int queue_max_ms; // Deepest backlog seen
+  CommAudioLatencyWire tts_first_pcm; // Speak request -> first PCM
+  CommAudioLatencyWire pcm_to_device; // Speech/file PCM -> speaker
+  CommAudioLatencyWire beep_start;    // Beep request -> speaker
+} CommAudioStatsWire;
+
+/**
+ * Read the Firmware's audio pipeline statistics.
+ *
+ * Needs HAMPOD_CAP_AUDIO_STATS. Counters run from Firmware start or the
+ * last reset.
+ *
+ * @param stats_out Filled in on success
+ * @param reset Zero the counters and histograms after reading
+ * @return HAMPOD_OK on success, HAMPOD_ERROR on failure or no reply
+ */
+int comm_query_audio_stats(CommAudioStatsWire *stats_out, bool reset);
+
 /**
  * Query the audio card number from Firmware.
  *
  * Sends an AUDIO_TYPE_INFO request and waits for the response
  * containing the ALSA card number of the selected audio device.
  *
- * @param card_number_out Pointer to store the card number (0-255)
- * @return HAMPOD_OK on success, HAMPOD_ERROR on failure
+ * @param card_number_out Pointer to store the card number (0-255); set to
+ *                        the default card 2 if the query fails
+ * @return HAMPOD_OK on success, HAMPOD_ERROR if the send failed or no reply
+ *         came within 5 seconds
  */
 int comm_query_audio_card_number(int *card_number_out);
 
@@ -204,14 +458,16 @@ int comm_query_audio_card_number(int *card_number_out);
 
 // Timeout values for waiting on responses (in milliseconds)
 #define COMM_KEYPAD_TIMEOUT_MS 5000 // 5 seconds for keypad
+#define COMM_KEYPAD_SUBSCRIBE_TIMEOUT_MS 1000 // Old Firmware never answers
 #define COMM_AUDIO_TIMEOUT_MS 30000 // 30 seconds for audio (speech can be long)
 
 /**
  * Start the router thread.
  *
- * The router thread reads ALL packets from Firmware_o and dispatches them
- * to type-specific queues. This allows keypad and speech threads to operate
- * concurrently without packet conflicts.
+ * The router thread reads ALL packets from Firmware_o. Replies go to the
+ * request that owns their tag (see comm_wait_request()); everything else is
+ * dispatched to type-specific queues. This allows keypad and speech threads
+ * to operate concurrently without packet conflicts.
  *
  * Called automatically by comm_init().
  *
@@ -233,7 +489,8 @@ void comm_stop_router(void);
 bool comm_router_is_running(void);
 
 /**
- * Wait for a KEYPAD response packet from the router queue.
+ * Wait for an unsolicited KEYPAD packet (a pushed key event) from the
+ * router queue. Replies to requests go through comm_wait_request().
  *
  * @param packet Pointer to packet structure to fill
  * @param timeout_ms Maximum time to wait (use COMM_KEYPAD_TIMEOUT_MS)
@@ -242,14 +499,4 @@ bool comm_router_is_running(void);
  */
 int comm_wait_keypad_response(CommPacket *packet, int timeout_ms);
 
-/**
- * Wait for an AUDIO response packet from the router queue.
- *
- * @param packet Pointer to packet structure to fill
- * @param timeout_ms Maximum time to wait (use COMM_AUDIO_TIMEOUT_MS)
- * @return HAMPOD_OK on success, HAMPOD_TIMEOUT on timeout, HAMPOD_ERROR on
- * failure
- */
-int comm_wait_audio_response(CommPacket *packet, int timeout_ms);
-
 #endif // COMM_H
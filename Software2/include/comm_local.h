@@ -0,0 +1,53 @@
+/**
+ * comm_local.h - In-process Firmware Backend
+ *
+ * Used by comm.c when Software2 is built with 'make unified' and the
+ * transport is COMM_TRANSPORT_LOCAL. Instead of writing packets to
+ * firmware.elf, comm_send_packet() hands them to comm_local_send(), which
+ * calls the Firmware HAL (hal_audio_*, hal_tts_*, hal_keypad_*) directly.
+ *
+ * Replies are built in the same format firmware.elf sends (an int result
+ * for AUDIO, a key byte or CommKeypadEventWire for KEYPAD) and passed to
+ * the deliver callback, which puts them on comm.c's response queues. Code
+ * above comm.h cannot tell the two deployments apart.
+ *
+ * Only compiled with HAMPOD_UNIFIED.
+ */
+
+#ifndef COMM_LOCAL_H
+#define COMM_LOCAL_H
+
+#include "comm.h"
+
+/**
+ * Receives every reply the backend produces. Called from the sender's
+ * thread, the audio worker thread and the keypad push thread.
+ */
+typedef void (*CommLocalDeliver)(const CommPacket *packet);
+
+/**
+ * Initialize the audio, TTS and keypad HALs and start the audio worker.
+ *
+ * @param deliver Reply callback
+ * @return HAMPOD_OK on success, HAMPOD_ERROR on failure
+ */
+int comm_local_init(CommLocalDeliver deliver);
+
+/**
+ * Stop the worker threads and release the HALs.
+ */
+void comm_local_close(void);
+
+/**
+ * Handle one request packet, as firmware.elf would.
+ *
+ * Requests more urgent than speech (interrupts, beeps, speed changes,
+ * queries) and keypad requests are handled in the caller's thread. Speech
+ * and file playback go to the audio worker so the caller never waits for
+ * playback.
+ *
+ * @return HAMPOD_OK if accepted, HAMPOD_ERROR otherwise
+ */
+int comm_local_send(const CommPacket *packet);
+
+#endif // COMM_LOCAL_H
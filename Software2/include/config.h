@@ -23,6 +23,14 @@
 #define CONFIG_DEFAULT_VOLUME 25
 #define CONFIG_DEFAULT_SPEECH_SPEED 1.0f
 #define CONFIG_DEFAULT_KEY_BEEP true
+#define CONFIG_DEFAULT_AUDIO_PERIOD_MS 25
+#define CONFIG_DEFAULT_AUDIO_BUFFER_MS 100
+#define CONFIG_DEFAULT_AUDIO_MMAP false
+#ifdef HAMPOD_UNIFIED
+#define CONFIG_DEFAULT_COMM_TRANSPORT "local" // make unified: no firmware.elf
+#else
+#define CONFIG_DEFAULT_COMM_TRANSPORT "fifo"
+#endif
 
 // Default config file path (relative to Software2 directory)
 #define CONFIG_DEFAULT_PATH "config/hampod.conf"
@@ -53,6 +61,9 @@ typedef struct {
   int volume;                // 0-100
   float speech_speed;        // 0.5-2.0
   bool key_beep_enabled;
+  int period_ms;             // Output period, 4-50 (sent to Firmware)
+  int buffer_ms;             // Output buffer, 2 periods to 500
+  bool mmap;                 // Mix straight into the device buffer
 } AudioSettings;
 
 /**
@@ -63,6 +74,13 @@ typedef struct {
   char device_name[128]; // Actual name detected
 } KeypadSettings;
 
+/**
+ * @brief Firmware link settings
+ */
+typedef struct {
+  char transport[16]; // "fifo", "shm" (FIFO fallback) or "local" (unified)
+} CommSettings;
+
 /**
  * @brief Main configuration structure
  */
@@ -70,6 +88,7 @@ typedef struct {
   RadioSettings radios[MAX_RADIOS];
   AudioSettings audio;
   KeypadSettings keypad;
+  CommSettings comm;
 } HampodConfig;
 
 // ============================================================================
@@ -156,6 +175,9 @@ const char *config_get_audio_preferred_device(void);
 const char *config_get_audio_device_name(void);
 const char *config_get_audio_port(void);
 int config_get_audio_card_number(void);
+int config_get_audio_period_ms(void);
+int config_get_audio_buffer_ms(void);
+bool config_get_audio_mmap(void);
 
 // ============================================================================
 // Keypad Getters
@@ -164,6 +186,12 @@ int config_get_audio_card_number(void);
 const char *config_get_keypad_port(void);
 const char *config_get_keypad_device_name(void);
 
+// ============================================================================
+// Comm Getters (read at startup, no setter)
+// ============================================================================
+
+const char *config_get_comm_transport(void);
+
 // ============================================================================
 // Radio Setters (Act on the currently active radio, auto-save after each)
 // ============================================================================
@@ -105,6 +105,9 @@ typedef struct {
 #define AUDIO_TYPE_BEEP 'b'      // Play pre-cached beep
 #define AUDIO_TYPE_INTERRUPT 'i' // Interrupt current playback
 #define AUDIO_TYPE_INFO 'q' // Query audio device info (returns card number)
+#define AUDIO_TYPE_VOLUME 'v' // Set output volume (software gain)
+#define AUDIO_TYPE_STATS 'm'  // Query pipeline statistics
+#define AUDIO_TYPE_OUTPUT 'o' // Set output period/buffer/mmap
 
 // ============================================================================
 // Common Return Codes
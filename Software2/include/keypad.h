@@ -2,7 +2,7 @@
  * keypad.h - Keypad Input Module
  * 
  * Handles keypad input from Firmware with:
- * - Polling loop for key events
+ * - Pushed key events from Firmware (polling fallback for older Firmware)
  * - Hold detection (long press)
  * - Callback system for key handlers
  * 
@@ -38,7 +38,8 @@ typedef void (*KeypadCallback)(const KeyPressEvent* event);
 /**
  * Initialize the keypad system.
  * 
- * Starts a background thread that polls for keypad input.
+ * Starts a background thread that subscribes to pushed keypad events,
+ * falling back to polling if the Firmware does not support push mode.
  * Must be called after comm_init() and comm_wait_ready().
  * 
  * @return HAMPOD_OK on success, HAMPOD_ERROR on failure
@@ -89,7 +90,19 @@ void keypad_register_callback(KeypadCallback callback);
 void keypad_set_hold_threshold(int ms);
 
 /**
- * Set the polling interval.
+ * Enable or disable push mode.
+ * 
+ * When disabled, the keypad thread always polls even if Firmware supports
+ * pushed events. Must be called before keypad_init().
+ * 
+ * Default: enabled
+ * 
+ * @param enabled true to subscribe to pushed events
+ */
+void keypad_set_push_enabled(bool enabled);
+
+/**
+ * Set the polling interval (polling mode only).
  * 
  * How often to query the Firmware for key state.
  * Lower values = more responsive, but more CPU/pipe usage.
@@ -18,6 +18,13 @@
 #include <unistd.h>
 
 #include "comm.h"
+#include "hampod_frame.h"
+#include "hampod_shm.h"
+#include "hampod_trace.h"
+
+#ifdef HAMPOD_UNIFIED
+#include "comm_local.h"
+#endif
 
 // ============================================================================
 // Pipe Paths (relative to Software2 directory)
@@ -33,7 +40,31 @@
 
 static int fd_firmware_out = -1; // File descriptor for reading from Firmware
 static int fd_firmware_in = -1;  // File descriptor for writing to Firmware
-static unsigned short packet_tag = 0; // Incrementing tag for packet matching
+static Frame_reader firmware_reader; // Buffered packet parser for Firmware_o
+static unsigned short packet_tag = 0; // Last tag handed out (0 is reserved)
+
+static CommTransport requested_transport = COMM_TRANSPORT_FIFO;
+static Shm_link shm_link;            // Shared-memory rings (when attached)
+static bool shm_attached = false;
+static bool local_backend = false;   // Firmware HAL linked in (unified build)
+// Chunks of one message must not interleave with another sender's
+static pthread_mutex_t send_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Until the ready packet says otherwise, assume a version 1 Firmware
+static const CommFirmwareInfo legacy_firmware = {
+    .version = 1,
+    .caps = 0,
+    .max_frame = FRAME_LEGACY_MAX_DATA,
+    .max_message = FRAME_LEGACY_MAX_DATA};
+static CommFirmwareInfo firmware_info = legacy_firmware;
+
+// Packet trace, only recording when $HAMPOD_TRACE is set
+static Trace_writer trace = {.fd = -1, .source = TRACE_SOURCE_SOFTWARE};
+
+// How long the router blocks before re-checking router_running
+#define ROUTER_READ_SLICE_MS 100
+
+static int read_packet(CommPacket *packet, int timeout_ms);
 
 // ============================================================================
 // Response Queue Structure (Thread-safe circular buffer)
@@ -48,13 +79,29 @@ typedef struct {
   pthread_cond_t not_empty; // Signaled when item added
 } ResponseQueue;
 
-// Response queues for each packet type
+// Queues for packets nobody asked for: pushed keypad events and CONFIG.
+// Replies to requests go to the pending table instead.
 static ResponseQueue keypad_queue;
-static ResponseQueue audio_queue;
 static ResponseQueue config_queue;
 
+// ============================================================================
+// Pending Request Table (keyed by packet tag)
+// ============================================================================
+
+typedef struct {
+  bool in_use;          // Slot holds an outstanding request
+  bool done;            // Reply has arrived
+  unsigned short tag;   // Tag the reply will carry
+  CommPacket reply;     // Filled in by the router
+} PendingRequest;
+
+static PendingRequest pending[COMM_MAX_PENDING];
+static pthread_mutex_t pending_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pending_done = PTHREAD_COND_INITIALIZER;
+
 // Router thread state
 static pthread_t router_thread;
+static bool router_thread_started = false;
 static volatile bool router_running = false;
 
 // ============================================================================
@@ -139,10 +186,108 @@ static int response_queue_pop_timeout(ResponseQueue *q, CommPacket *packet,
   return HAMPOD_OK;
 }
 
+// ============================================================================
+// Pending Request Functions
+// ============================================================================
+
+static PendingRequest *pending_find_locked(unsigned short tag) {
+  for (int i = 0; i < COMM_MAX_PENDING; i++) {
+    if (pending[i].in_use && pending[i].tag == tag) {
+      return &pending[i];
+    }
+  }
+  return NULL;
+}
+
+// Next tag, skipping 0 (unsolicited packets) and tags still outstanding
+static unsigned short next_tag_locked(void) {
+  do {
+    packet_tag++;
+  } while (packet_tag == 0 || pending_find_locked(packet_tag) != NULL);
+  return packet_tag;
+}
+
+static unsigned short next_tag(void) {
+  pthread_mutex_lock(&pending_mutex);
+  unsigned short tag = next_tag_locked();
+  pthread_mutex_unlock(&pending_mutex);
+  return tag;
+}
+
+// Claim a slot and a tag. Done before sending so the reply cannot beat us.
+static int pending_register(unsigned short *tag_out) {
+  pthread_mutex_lock(&pending_mutex);
+  for (int i = 0; i < COMM_MAX_PENDING; i++) {
+    if (!pending[i].in_use) {
+      pending[i].in_use = true;
+      pending[i].done = false;
+      pending[i].tag = next_tag_locked();
+      *tag_out = pending[i].tag;
+      pthread_mutex_unlock(&pending_mutex);
+      return HAMPOD_OK;
+    }
+  }
+  pthread_mutex_unlock(&pending_mutex);
+  LOG_ERROR("Too many outstanding requests (%d)", COMM_MAX_PENDING);
+  return HAMPOD_ERROR;
+}
+
+static void pending_release(unsigned short tag) {
+  pthread_mutex_lock(&pending_mutex);
+  PendingRequest *slot = pending_find_locked(tag);
+  if (slot != NULL) {
+    slot->in_use = false;
+  }
+  pthread_mutex_unlock(&pending_mutex);
+}
+
+// Returns true if the packet answered an outstanding request
+static bool pending_complete(const CommPacket *packet) {
+  if (packet->tag == 0) {
+    return false;
+  }
+  pthread_mutex_lock(&pending_mutex);
+  PendingRequest *slot = pending_find_locked(packet->tag);
+  if (slot != NULL && !slot->done) {
+    slot->reply = *packet;
+    slot->done = true;
+    pthread_cond_broadcast(&pending_done);
+  }
+  pthread_mutex_unlock(&pending_mutex);
+  return slot != NULL;
+}
+
 // ============================================================================
 // Router Thread
 // ============================================================================
 
+// Hand a reply from Firmware (or the in-process backend) to its waiter
+static void route_packet(const CommPacket *packet) {
+  if (pending_complete(packet)) {
+    return;
+  }
+
+  switch (packet->type) {
+  case PACKET_KEYPAD:
+    if (response_queue_push(&keypad_queue, packet) != HAMPOD_OK) {
+      LOG_ERROR("Router: Keypad queue full, dropping packet");
+    }
+    break;
+  case PACKET_AUDIO:
+    // Ack for a fire-and-forget request (beep, speed) or a cancelled wait
+    LOG_DEBUG("Router: Dropping unrequested audio ack (tag=%u)", packet->tag);
+    break;
+  case PACKET_CONFIG:
+    if (response_queue_push(&config_queue, packet) != HAMPOD_OK) {
+      LOG_ERROR("Router: Config queue full, dropping packet");
+    }
+    break;
+  default:
+    LOG_ERROR("Router: Unknown packet type %d", packet->type);
+    break;
+  }
+}
+
 static void *router_thread_func(void *arg) {
   (void)arg;
 
@@ -150,8 +295,11 @@ static void *router_thread_func(void *arg) {
 
   while (router_running) {
     CommPacket packet;
-    int result = comm_read_packet(&packet);
+    int result = read_packet(&packet, ROUTER_READ_SLICE_MS);
 
+    if (result == HAMPOD_TIMEOUT) {
+      continue;
+    }
     if (result != HAMPOD_OK) {
       if (!router_running)
         break; // Expected shutdown
@@ -160,26 +308,7 @@ static void *router_thread_func(void *arg) {
       continue;
     }
 
-    switch (packet.type) {
-    case PACKET_KEYPAD:
-      if (response_queue_push(&keypad_queue, &packet) != HAMPOD_OK) {
-        LOG_ERROR("Router: Keypad queue full, dropping packet");
-      }
-      break;
-    case PACKET_AUDIO:
-      if (response_queue_push(&audio_queue, &packet) != HAMPOD_OK) {
-        LOG_ERROR("Router: Audio queue full, dropping packet");
-      }
-      break;
-    case PACKET_CONFIG:
-      if (response_queue_push(&config_queue, &packet) != HAMPOD_OK) {
-        LOG_ERROR("Router: Config queue full, dropping packet");
-      }
-      break;
-    default:
-      LOG_ERROR("Router: Unknown packet type %d", packet.type);
-      break;
-    }
+    route_packet(&packet);
   }
 
   LOG_INFO("Router thread exiting");
@@ -196,16 +325,23 @@ int comm_start_router(void) {
 
   // Initialize response queues
   response_queue_init(&keypad_queue);
-  response_queue_init(&audio_queue);
   response_queue_init(&config_queue);
 
-  // Start router thread
   router_running = true;
+
+  // The in-process backend delivers straight into the queues
+  if (local_backend) {
+    LOG_INFO("Router queues ready (in-process backend, no thread)");
+    return HAMPOD_OK;
+  }
+
+  // Start router thread
   if (pthread_create(&router_thread, NULL, router_thread_func, NULL) != 0) {
     LOG_ERROR("Failed to create router thread");
     router_running = false;
     return HAMPOD_ERROR;
   }
+  router_thread_started = true;
 
   LOG_INFO("Router thread started");
   return HAMPOD_OK;
@@ -223,17 +359,21 @@ void comm_stop_router(void) {
 
   // Wake up any threads waiting on queues
   pthread_cond_broadcast(&keypad_queue.not_empty);
-  pthread_cond_broadcast(&audio_queue.not_empty);
   pthread_cond_broadcast(&config_queue.not_empty);
+  pthread_mutex_lock(&pending_mutex);
+  pthread_cond_broadcast(&pending_done);
+  pthread_mutex_unlock(&pending_mutex);
 
   // Wait for thread to finish
   // Note: pthread_join is blocking, but router_running=false should cause
   // the thread to exit quickly after its next read attempt
-  pthread_join(router_thread, NULL);
+  if (router_thread_started) {
+    pthread_join(router_thread, NULL);
+    router_thread_started = false;
+  }
 
   // Destroy queues
   response_queue_destroy(&keypad_queue);
-  response_queue_destroy(&audio_queue);
   response_queue_destroy(&config_queue);
 
   LOG_INFO("Router thread stopped");
@@ -245,17 +385,180 @@ int comm_wait_keypad_response(CommPacket *packet, int timeout_ms) {
   return response_queue_pop_timeout(&keypad_queue, packet, timeout_ms);
 }
 
-int comm_wait_audio_response(CommPacket *packet, int timeout_ms) {
-  return response_queue_pop_timeout(&audio_queue, packet, timeout_ms);
+// ============================================================================
+// Request Tracking
+// ============================================================================
+
+int comm_send_request(CommPacket *packet, CommRequest *request) {
+  if (packet == NULL || request == NULL) {
+    LOG_ERROR("comm_send_request: NULL argument");
+    return HAMPOD_ERROR;
+  }
+
+  if (pending_register(&packet->tag) != HAMPOD_OK) {
+    return HAMPOD_ERROR;
+  }
+  if (comm_send_packet(packet) != HAMPOD_OK) {
+    pending_release(packet->tag);
+    return HAMPOD_ERROR;
+  }
+
+  request->tag = packet->tag;
+  return HAMPOD_OK;
+}
+
+int comm_wait_request(CommRequest *request, CommPacket *reply,
+                      int timeout_ms) {
+  if (request == NULL || reply == NULL) {
+    LOG_ERROR("comm_wait_request: NULL argument");
+    return HAMPOD_ERROR;
+  }
+
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += timeout_ms / 1000;
+  deadline.tv_nsec += (timeout_ms % 1000) * 1000000;
+  if (deadline.tv_nsec >= 1000000000) {
+    deadline.tv_sec += 1;
+    deadline.tv_nsec -= 1000000000;
+  }
+
+  pthread_mutex_lock(&pending_mutex);
+  PendingRequest *slot = pending_find_locked(request->tag);
+  if (slot == NULL) {
+    pthread_mutex_unlock(&pending_mutex);
+    LOG_ERROR("comm_wait_request: Unknown request (tag=%u)", request->tag);
+    return HAMPOD_NOT_FOUND;
+  }
+
+  int result = HAMPOD_OK;
+  while (!slot->done) {
+    if (!router_running) {
+      result = HAMPOD_ERROR;
+      break;
+    }
+    if (pthread_cond_timedwait(&pending_done, &pending_mutex, &deadline) ==
+        ETIMEDOUT) {
+      result = slot->done ? HAMPOD_OK : HAMPOD_TIMEOUT;
+      break;
+    }
+  }
+
+  // Either way the request is finished; a late reply will just be dropped
+  if (result == HAMPOD_OK) {
+    *reply = slot->reply;
+  }
+  slot->in_use = false;
+  pthread_mutex_unlock(&pending_mutex);
+  return result;
+}
+
+void comm_cancel_request(CommRequest *request) {
+  if (request != NULL) {
+    pending_release(request->tag);
+  }
+}
+
+// ============================================================================
+// Transport Selection
+// ============================================================================
+
+void comm_set_transport(CommTransport transport) {
+  requested_transport = transport;
+}
+
+CommTransport comm_get_transport(void) {
+  if (local_backend) {
+    return COMM_TRANSPORT_LOCAL;
+  }
+  return shm_attached ? COMM_TRANSPORT_SHM : COMM_TRANSPORT_FIFO;
+}
+
+// ============================================================================
+// Firmware Capabilities
+// ============================================================================
+
+const CommFirmwareInfo *comm_get_firmware_info(void) { return &firmware_info; }
+
+bool comm_firmware_has(unsigned int cap) {
+  return (firmware_info.caps & cap) == cap;
+}
+
+size_t comm_max_payload(void) { return firmware_info.max_message; }
+
+// Fill firmware_info from the ready packet's payload
+static void parse_hello(const CommPacket *packet) {
+  firmware_info = legacy_firmware;
+  if (packet->data_len < sizeof(Frame_hello)) {
+    LOG_INFO("Firmware protocol version 1 (no capabilities)");
+    return;
+  }
+
+  Frame_hello hello;
+  memcpy(&hello, packet->data, sizeof(hello));
+  firmware_info.version = hello.version;
+  firmware_info.caps = hello.caps;
+  if (hello.caps & HAMPOD_CAP_CHUNKED) {
+    firmware_info.max_frame = hello.max_frame;
+    firmware_info.max_message = hello.max_message;
+  } else if (hello.max_frame > 0) {
+    firmware_info.max_frame = hello.max_frame;
+    firmware_info.max_message = hello.max_frame;
+  }
+  // Never more than our own buffers hold
+  if (firmware_info.max_message > COMM_MAX_DATA_LEN) {
+    firmware_info.max_message = COMM_MAX_DATA_LEN;
+  }
+  if (firmware_info.max_frame > firmware_info.max_message) {
+    firmware_info.max_frame = firmware_info.max_message;
+  }
+  LOG_INFO("Firmware protocol version %d, caps 0x%02x, %zu-byte frames, "
+           "%zu-byte messages",
+           firmware_info.version, firmware_info.caps, firmware_info.max_frame,
+           firmware_info.max_message);
 }
 
 // ============================================================================
 // Initialization & Cleanup
 // ============================================================================
 
+#ifdef HAMPOD_UNIFIED
+// Replies from the in-process backend never pass through read_packet()
+static void local_deliver(const CommPacket *packet) {
+  trace_record(&trace, TRACE_FROM_FIRMWARE, packet->type, packet->tag,
+               packet->data, packet->data_len);
+  route_packet(packet);
+}
+#endif
+
 int comm_init(void) {
   LOG_INFO("Initializing Firmware communication...");
 
+  if (trace_open_from_env(&trace, TRACE_SOURCE_SOFTWARE) == 0) {
+    LOG_INFO("Recording packet trace to %s", getenv(HAMPOD_TRACE_ENV));
+  }
+
+  if (requested_transport == COMM_TRANSPORT_LOCAL) {
+#ifdef HAMPOD_UNIFIED
+    if (comm_local_init(local_deliver) != HAMPOD_OK) {
+      LOG_ERROR("Failed to start the in-process Firmware backend");
+      return HAMPOD_ERROR;
+    }
+    local_backend = true;
+    // The HAL is ours, so everything it offers is available
+    firmware_info.version = HAMPOD_PROTOCOL_VERSION;
+    firmware_info.caps = HAMPOD_CAP_PUSH_KEYPAD | HAMPOD_CAP_PCM_CACHE |
+                         HAMPOD_CAP_CLASSES | HAMPOD_CAP_VOLUME |
+                         HAMPOD_CAP_AUDIO_STATS | HAMPOD_CAP_AUDIO_OUTPUT;
+    firmware_info.max_frame = COMM_MAX_DATA_LEN;
+    firmware_info.max_message = COMM_MAX_DATA_LEN;
+    LOG_INFO("Using in-process Firmware backend");
+    return HAMPOD_OK;
+#else
+    LOG_ERROR("Local transport needs 'make unified', using pipes");
+#endif
+  }
+
   // Open Firmware_o for reading (Firmware -> Software)
   LOG_DEBUG("Opening %s for reading...", FIRMWARE_OUTPUT_PIPE);
   fd_firmware_out = open(FIRMWARE_OUTPUT_PIPE, O_RDONLY);
@@ -266,6 +569,7 @@ int comm_init(void) {
     return HAMPOD_ERROR;
   }
   LOG_DEBUG("Opened %s (fd=%d)", FIRMWARE_OUTPUT_PIPE, fd_firmware_out);
+  frame_reader_init(&firmware_reader, fd_firmware_out);
 
   // Open Firmware_i for writing (Software -> Firmware)
   // Retry loop since Firmware may not have opened its read end yet
@@ -299,11 +603,25 @@ int comm_init(void) {
 void comm_close(void) {
   LOG_INFO("Closing Firmware communication...");
 
-  // Stop router thread first (if running)
+#ifdef HAMPOD_UNIFIED
+  // Stop the backend threads before the queues they deliver into go away
+  if (local_backend) {
+    comm_local_close();
+    local_backend = false;
+  }
+#endif
+
+  // Stop router thread (if running)
   if (router_running) {
     comm_stop_router();
   }
 
+  // Detaching hands Firmware's replies back to Firmware_o
+  if (shm_attached) {
+    shm_link_close(&shm_link);
+    shm_attached = false;
+  }
+
   if (fd_firmware_out != -1) {
     close(fd_firmware_out);
     fd_firmware_out = -1;
@@ -314,16 +632,23 @@ void comm_close(void) {
     fd_firmware_in = -1;
   }
 
+  trace_close(&trace);
   LOG_INFO("Firmware communication closed");
 }
 
 bool comm_is_connected(void) {
-  return (fd_firmware_out != -1 && fd_firmware_in != -1);
+  return local_backend || (fd_firmware_out != -1 && fd_firmware_in != -1);
 }
 
 int comm_wait_ready(void) {
   LOG_INFO("Waiting for Firmware ready signal...");
 
+  // The HAL was initialized in comm_init(), so there is nothing to wait for
+  if (local_backend) {
+    LOG_INFO("Firmware ready (in-process)");
+    return comm_start_router();
+  }
+
   // Read the ready packet directly (router not started yet)
   CommPacket packet;
   if (comm_read_packet(&packet) != HAMPOD_OK) {
@@ -339,6 +664,21 @@ int comm_wait_ready(void) {
 
   if (packet.data_len > 0 && packet.data[0] == 'R') {
     LOG_INFO("Firmware ready!");
+    parse_hello(&packet);
+
+    // Attach before the router starts so it reads from the right place
+    if (requested_transport == COMM_TRANSPORT_SHM &&
+        !comm_firmware_has(HAMPOD_CAP_SHM)) {
+      LOG_INFO("Firmware does not offer shared memory, using pipes");
+    } else if (requested_transport == COMM_TRANSPORT_SHM) {
+      if (shm_link_attach(&shm_link, HAMPOD_SHM_NAME) == 0) {
+        shm_attached = true;
+        LOG_INFO("Using shared-memory transport");
+      } else {
+        LOG_ERROR("Shared-memory attach failed (%s), using pipes",
+                  strerror(errno));
+      }
+    }
 
     // NOW start the router thread (after ready signal received)
     if (comm_start_router() != HAMPOD_OK) {
@@ -357,7 +697,11 @@ int comm_wait_ready(void) {
 // Reading from Firmware
 // ============================================================================
 
-int comm_read_packet(CommPacket *packet) {
+/*
+ * Read one packet from whichever transport is active. timeout_ms only
+ * applies to shared memory; pipe reads always block (-1 blocks for both).
+ */
+static int read_packet(CommPacket *packet, int timeout_ms) {
   if (!comm_is_connected()) {
     LOG_ERROR("comm_read_packet: Not connected");
     return HAMPOD_ERROR;
@@ -368,42 +712,44 @@ int comm_read_packet(CommPacket *packet) {
     return HAMPOD_ERROR;
   }
 
-  // Read packet header fields (matching Firmware's write order)
-  // 1. Packet_type (enum, typically 4 bytes on 32/64-bit systems)
-  ssize_t n = read(fd_firmware_out, &packet->type, sizeof(PacketType));
-  if (n != sizeof(PacketType)) {
-    LOG_ERROR("comm_read_packet: Failed to read type (%zd bytes)", n);
-    return HAMPOD_ERROR;
-  }
-
-  // 2. data_len (unsigned short, 2 bytes)
-  n = read(fd_firmware_out, &packet->data_len, sizeof(unsigned short));
-  if (n != sizeof(unsigned short)) {
-    LOG_ERROR("comm_read_packet: Failed to read data_len");
+  if (local_backend) {
+    LOG_ERROR("comm_read_packet: No packet stream with the in-process "
+              "backend, use the router queues");
     return HAMPOD_ERROR;
   }
 
-  // 3. tag (unsigned short, 2 bytes)
-  n = read(fd_firmware_out, &packet->tag, sizeof(unsigned short));
-  if (n != sizeof(unsigned short)) {
-    LOG_ERROR("comm_read_packet: Failed to read tag");
-    return HAMPOD_ERROR;
-  }
-
-  // 4. data (variable length)
-  if (packet->data_len > 0) {
-    if (packet->data_len > COMM_MAX_DATA_LEN) {
-      LOG_ERROR("comm_read_packet: data_len %u exceeds max %d",
-                packet->data_len, COMM_MAX_DATA_LEN);
-      return HAMPOD_ERROR;
+  // Parse the next packet; packets that arrived in the same read() stay
+  // buffered for the following call
+  for (;;) {
+    Frame_header header;
+    int result;
+    if (shm_attached) {
+      result = shm_link_recv(&shm_link, &header, packet->data,
+                             COMM_MAX_DATA_LEN, timeout_ms);
+      if (result == SHM_TIMEOUT) {
+        return HAMPOD_TIMEOUT;
+      }
+    } else {
+      result = frame_read_message(&firmware_reader, &header, packet->data,
+                                  COMM_MAX_DATA_LEN);
     }
-
-    n = read(fd_firmware_out, packet->data, packet->data_len);
-    if (n != packet->data_len) {
-      LOG_ERROR("comm_read_packet: Failed to read data (expected %u, got %zd)",
-                packet->data_len, n);
+    if (result == FRAME_TOO_LARGE) {
+      LOG_ERROR("comm_read_packet: data_len %u exceeds max %d, dropped",
+                header.data_len, COMM_MAX_DATA_LEN);
+      continue;
+    }
+    if (result != FRAME_OK) {
+      LOG_ERROR("comm_read_packet: Failed to read packet (%s)",
+                result == FRAME_EOF ? "pipe closed" : strerror(errno));
       return HAMPOD_ERROR;
     }
+    packet->type = (PacketType)header.type;
+    packet->data_len = header.data_len;
+    packet->tag = header.tag;
+    trace_record(&trace, TRACE_FROM_FIRMWARE,
+                 FRAME_TYPE_WITH_CLASS(header.type, header.priority),
+                 header.tag, packet->data, header.data_len);
+    break;
   }
 
   LOG_DEBUG("comm_read_packet: type=%d, len=%u, tag=%u", packet->type,
@@ -412,6 +758,8 @@ int comm_read_packet(CommPacket *packet) {
   return HAMPOD_OK;
 }
 
+int comm_read_packet(CommPacket *packet) { return read_packet(packet, -1); }
+
 int comm_read_keypad(char *key_out) {
   if (key_out == NULL) {
     LOG_ERROR("comm_read_keypad: NULL key_out pointer");
@@ -419,18 +767,19 @@ int comm_read_keypad(char *key_out) {
   }
 
   // Send a keypad request to Firmware
-  CommPacket request = {
-      .type = PACKET_KEYPAD, .data_len = 1, .tag = packet_tag++, .data = {'r'}
+  CommPacket packet = {
+      .type = PACKET_KEYPAD, .data_len = 1, .data = {'r'}
       // 'r' = read request
   };
+  CommRequest request;
 
-  if (comm_send_packet(&request) != HAMPOD_OK) {
+  if (comm_send_request(&packet, &request) != HAMPOD_OK) {
     return HAMPOD_ERROR;
   }
 
-  // Wait for response from router queue
+  // The reply carries our tag, so pushed events cannot be mistaken for it
   CommPacket response;
-  int result = comm_wait_keypad_response(&response, COMM_KEYPAD_TIMEOUT_MS);
+  int result = comm_wait_request(&request, &response, COMM_KEYPAD_TIMEOUT_MS);
 
   if (result == HAMPOD_TIMEOUT) {
     LOG_ERROR("comm_read_keypad: Timeout waiting for response");
@@ -454,6 +803,69 @@ int comm_read_keypad(char *key_out) {
   return HAMPOD_OK;
 }
 
+// ============================================================================
+// Push-mode Keypad Events
+// ============================================================================
+
+int comm_subscribe_keypad(void) {
+  CommPacket packet = {
+      .type = PACKET_KEYPAD, .data_len = 1, .data = {'s'}
+      // 's' = subscribe to pushed events
+  };
+  CommRequest request;
+
+  if (comm_send_request(&packet, &request) != HAMPOD_OK) {
+    return HAMPOD_ERROR;
+  }
+
+  CommPacket response;
+  if (comm_wait_request(&request, &response,
+                        COMM_KEYPAD_SUBSCRIBE_TIMEOUT_MS) != HAMPOD_OK) {
+    LOG_ERROR("comm_subscribe_keypad: No response from Firmware");
+    return HAMPOD_ERROR;
+  }
+
+  if (response.data_len != sizeof(CommKeypadEventWire) ||
+      response.data[1] != COMM_KEYPAD_EVENT_SUBSCRIBED) {
+    LOG_INFO("Firmware does not support keypad push mode");
+    return HAMPOD_ERROR;
+  }
+
+  LOG_INFO("Keypad push mode active");
+  return HAMPOD_OK;
+}
+
+int comm_wait_keypad_event(CommKeypadEvent *event, int timeout_ms) {
+  if (event == NULL) {
+    LOG_ERROR("comm_wait_keypad_event: NULL event pointer");
+    return HAMPOD_ERROR;
+  }
+
+  for (;;) {
+    CommPacket packet;
+    int result = comm_wait_keypad_response(&packet, timeout_ms);
+    if (result != HAMPOD_OK) {
+      return result;
+    }
+
+    // Skip stray poll replies and subscribe acks
+    if (packet.data_len != sizeof(CommKeypadEventWire)) {
+      continue;
+    }
+
+    CommKeypadEventWire wire;
+    memcpy(&wire, packet.data, sizeof(wire));
+    if (wire.action == COMM_KEYPAD_EVENT_SUBSCRIBED) {
+      continue;
+    }
+
+    event->key = (char)wire.key;
+    event->action = (char)wire.action;
+    event->time_ms = (long)wire.sec * 1000 + wire.usec / 1000;
+    return HAMPOD_OK;
+  }
+}
+
 // ============================================================================
 // Writing to Firmware
 // ============================================================================
@@ -472,41 +884,61 @@ int comm_send_packet(const CommPacket *packet) {
   LOG_DEBUG("comm_send_packet: type=%d, len=%u, tag=%u", packet->type,
             packet->data_len, packet->tag);
 
-  // Write packet header fields (matching Firmware's read order)
-  // 1. Packet_type
-  ssize_t n = write(fd_firmware_in, &packet->type, sizeof(PacketType));
-  if (n != sizeof(PacketType)) {
-    LOG_ERROR("comm_send_packet: Failed to write type");
+  if (packet->data_len > firmware_info.max_message) {
+    LOG_ERROR("comm_send_packet: %u bytes exceeds the Firmware's %zu-byte "
+              "limit",
+              packet->data_len, firmware_info.max_message);
     return HAMPOD_ERROR;
   }
 
-  // 2. data_len
-  n = write(fd_firmware_in, &packet->data_len, sizeof(unsigned short));
-  if (n != sizeof(unsigned short)) {
-    LOG_ERROR("comm_send_packet: Failed to write data_len");
-    return HAMPOD_ERROR;
+  // The class byte lets every Firmware queue serve interrupts, beeps and
+  // keypad requests ahead of speech that is already waiting. Version 1
+  // Firmware would read it as part of the type, so it only goes to Firmware
+  // that said it understands it.
+  int wire_type = packet->type;
+  if (comm_firmware_has(HAMPOD_CAP_CLASSES)) {
+    wire_type = FRAME_TYPE_WITH_CLASS(
+        packet->type,
+        frame_default_class(packet->type, packet->data, packet->data_len));
   }
 
-  // 3. tag
-  n = write(fd_firmware_in, &packet->tag, sizeof(unsigned short));
-  if (n != sizeof(unsigned short)) {
-    LOG_ERROR("comm_send_packet: Failed to write tag");
-    return HAMPOD_ERROR;
+  trace_record(&trace, TRACE_TO_FIRMWARE, wire_type, packet->tag,
+               packet->data, packet->data_len);
+
+#ifdef HAMPOD_UNIFIED
+  if (local_backend) {
+    return comm_local_send(packet);
   }
+#endif
 
-  // 4. data
-  if (packet->data_len > 0) {
-    n = write(fd_firmware_in, packet->data, packet->data_len);
-    if (n != packet->data_len) {
-      LOG_ERROR("comm_send_packet: Failed to write data");
+  // A whole message fits in one shared-memory frame
+  if (shm_attached) {
+    if (shm_link_send(&shm_link, wire_type, packet->tag, packet->data,
+                      packet->data_len) != 0) {
+      LOG_ERROR("comm_send_packet: Shared-memory ring full or packet too big");
       return HAMPOD_ERROR;
     }
+    return HAMPOD_OK;
+  }
+
+  // Each frame goes out in one write; the mutex keeps the chunks of a long
+  // message together
+  pthread_mutex_lock(&send_mutex);
+  int result = frame_write_message(fd_firmware_in, wire_type, packet->tag,
+                                   packet->data, packet->data_len,
+                                   firmware_info.max_frame);
+  pthread_mutex_unlock(&send_mutex);
+  if (result != 0) {
+    LOG_ERROR("comm_send_packet: Failed to write packet: %s", strerror(errno));
+    return HAMPOD_ERROR;
   }
 
   return HAMPOD_OK;
 }
 
-int comm_send_audio(char audio_type, const char *payload) {
+// Build "<type><payload>\0"; the tag is filled in by the sender
+static int build_audio_packet(CommPacket *packet, char audio_type,
+                              const char *payload) {
   if (payload == NULL) {
     LOG_ERROR("comm_send_audio: NULL payload");
     return HAMPOD_ERROR;
@@ -523,31 +955,53 @@ int comm_send_audio(char audio_type, const char *payload) {
     return HAMPOD_ERROR;
   }
 
-  CommPacket packet = {
-      .type = PACKET_AUDIO,
-      .data_len = (unsigned short)(payload_len + 2), // +1 for type, +1 for null
-      .tag = packet_tag++};
+  packet->type = PACKET_AUDIO;
+  packet->data_len = (unsigned short)(payload_len + 2); // +1 type, +1 null
 
   // First byte is audio type, then payload, then null terminator
-  packet.data[0] = (unsigned char)audio_type;
-  memcpy(packet.data + 1, payload, payload_len);
-  packet.data[payload_len + 1] = '\0'; // Null terminate
+  packet->data[0] = (unsigned char)audio_type;
+  memcpy(packet->data + 1, payload, payload_len);
+  packet->data[payload_len + 1] = '\0'; // Null terminate
 
   LOG_DEBUG("comm_send_audio: type='%c', payload='%s', len=%u", audio_type,
-            payload, packet.data_len);
+            payload, packet->data_len);
+  return HAMPOD_OK;
+}
 
+int comm_send_audio(char audio_type, const char *payload) {
+  CommPacket packet;
+  if (build_audio_packet(&packet, audio_type, payload) != HAMPOD_OK) {
+    return HAMPOD_ERROR;
+  }
+
+  // Not in the pending table, so the router drops Firmware's ack
+  packet.tag = next_tag();
   return comm_send_packet(&packet);
 }
 
-int comm_send_audio_sync(char audio_type, const char *payload) {
-  // Send the audio request
-  if (comm_send_audio(audio_type, payload) != HAMPOD_OK) {
+int comm_send_audio_request(char audio_type, const char *payload,
+                            CommRequest *request) {
+  CommPacket packet;
+  if (build_audio_packet(&packet, audio_type, payload) != HAMPOD_OK) {
     return HAMPOD_ERROR;
   }
+  return comm_send_request(&packet, request);
+}
 
-  // Wait for acknowledgment
+int comm_send_audio_sync(char audio_type, const char *payload) {
   CommPacket response;
-  if (comm_read_packet(&response) != HAMPOD_OK) {
+
+  // Once the router runs it owns the packet stream, so the ack has to come
+  // through the pending table
+  if (router_running) {
+    CommRequest request;
+    if (comm_send_audio_request(audio_type, payload, &request) != HAMPOD_OK ||
+        comm_wait_request(&request, &response, COMM_AUDIO_TIMEOUT_MS) !=
+            HAMPOD_OK) {
+      return HAMPOD_ERROR;
+    }
+  } else if (comm_send_audio(audio_type, payload) != HAMPOD_OK ||
+             comm_read_packet(&response) != HAMPOD_OK) {
     return HAMPOD_ERROR;
   }
 
@@ -613,28 +1067,89 @@ int comm_set_speech_speed(float speed) {
   return comm_send_audio('s', payload);
 }
 
+int comm_set_volume(int percent) {
+  /*
+   * Protocol: 'v' + percent (e.g. "v80"). The Firmware scales its mixed
+   * output, so no card number or mixer control is involved.
+   */
+  char payload[16];
+  snprintf(payload, sizeof(payload), "%d", percent);
+
+  LOG_INFO("comm_set_volume: Setting volume to %s%%", payload);
+
+  return comm_send_audio(AUDIO_TYPE_VOLUME, payload);
+}
+
+int comm_set_audio_output(int period_ms, int buffer_ms, bool use_mmap) {
+  /*
+   * Protocol: 'o' + "period,buffer" (e.g. "o10,40"), with ",m" appended
+   * for mmap access
+   */
+  char payload[32];
+  snprintf(payload, sizeof(payload), "%d,%d%s", period_ms, buffer_ms,
+           use_mmap ? ",m" : "");
+
+  LOG_INFO("comm_set_audio_output: %s", payload);
+
+  return comm_send_audio(AUDIO_TYPE_OUTPUT, payload);
+}
+
 // ============================================================================
 // Audio Device Query
 // ============================================================================
 
+int comm_query_audio_stats(CommAudioStatsWire *stats_out, bool reset) {
+  if (stats_out == NULL) {
+    LOG_ERROR("comm_query_audio_stats: NULL output pointer");
+    return HAMPOD_ERROR;
+  }
+  if (!comm_firmware_has(HAMPOD_CAP_AUDIO_STATS)) {
+    LOG_DEBUG("comm_query_audio_stats: Firmware does not report stats");
+    return HAMPOD_ERROR;
+  }
+
+  CommRequest request;
+  if (comm_send_audio_request(AUDIO_TYPE_STATS, reset ? "r" : "", &request) !=
+      HAMPOD_OK) {
+    LOG_ERROR("comm_query_audio_stats: Send failed");
+    return HAMPOD_ERROR;
+  }
+
+  CommPacket response;
+  if (comm_wait_request(&request, &response, 5000) != HAMPOD_OK) {
+    LOG_ERROR("comm_query_audio_stats: No response");
+    return HAMPOD_ERROR;
+  }
+  if (response.data_len < sizeof(CommAudioStatsWire) ||
+      response.data[0] != COMM_AUDIO_STATS_VERSION) {
+    LOG_ERROR("comm_query_audio_stats: Unexpected reply (%d bytes)",
+              response.data_len);
+    return HAMPOD_ERROR;
+  }
+
+  memcpy(stats_out, response.data, sizeof(CommAudioStatsWire));
+  return HAMPOD_OK;
+}
+
 int comm_query_audio_card_number(int *card_number_out) {
   if (card_number_out == NULL) {
     LOG_ERROR("comm_query_audio_card_number: NULL output pointer");
     return HAMPOD_ERROR;
   }
 
-  // Send audio info query (non-blocking)
+  // Send audio info query, then wait up to 5 s for its tagged reply
   LOG_DEBUG("comm_query_audio_card_number: Querying Firmware...");
 
-  if (comm_send_audio(AUDIO_TYPE_INFO, "") != HAMPOD_OK) {
+  CommRequest request;
+  if (comm_send_audio_request(AUDIO_TYPE_INFO, "", &request) != HAMPOD_OK) {
     LOG_ERROR("comm_query_audio_card_number: Send failed");
     *card_number_out = 2; // Fallback
     return HAMPOD_ERROR;
   }
 
-  // Wait for response from router
+  // Wait for the reply to this query (not just any audio ack)
   CommPacket response;
-  if (comm_wait_audio_response(&response, 5000) == HAMPOD_OK) {
+  if (comm_wait_request(&request, &response, 5000) == HAMPOD_OK) {
     if (response.data_len >= sizeof(int)) {
       *card_number_out = *(int *)response.data;
       LOG_DEBUG("comm_query_audio_card_number: Got card number %d",
@@ -643,8 +1158,8 @@ int comm_query_audio_card_number(int *card_number_out) {
     }
   }
 
-  // Fallback - use a reasonable default
+  // Still fill in a usable default, but let the caller see the failure
   LOG_ERROR("comm_query_audio_card_number: No response, defaulting to card 2");
   *card_number_out = 2;
-  return HAMPOD_OK;
+  return HAMPOD_ERROR;
 }
@@ -0,0 +1,375 @@
+/**
+ * comm_local.c - In-process Firmware Backend Implementation
+ *
+ * Mirrors what firmware.elf's audio and keypad processes do with each
+ * request, but calls the HAL from inside Software2. Only built by
+ * 'make unified' (HAMPOD_UNIFIED); the regular build compiles this file
+ * to nothing.
+ *
+ * Threads:
+ * - Caller: every request more urgent than speech (interrupts, beeps, speed
+ *   changes, queries) and keypad reads, like Firmware's audio_io_thread
+ * - Audio worker: speech and file playback, one at a time
+ * - Keypad push: started by a subscribe request, streams key transitions
+ */
+
+#ifdef HAMPOD_UNIFIED
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "comm_local.h"
+#include "hal/hal_audio.h"
+#include "hal/hal_audio_stats.h"
+#include "hal/hal_keypad.h"
+#include "hal/hal_tts.h"
+#include "hampod_frame.h"
+#include "hampod_queue.h"
+
+// Relative paths in requests are relative to the Firmware directory, which
+// was firmware.elf's working directory
+#define LOCAL_FIRMWARE_DIR "../Firmware/"
+
+// How often the keypad push thread re-checks local_running
+#define LOCAL_KEYPAD_WAIT_MS 100
+
+// ============================================================================
+// Module State
+// ============================================================================
+
+static CommLocalDeliver deliver = NULL;
+static volatile bool local_running = false;
+
+static Packet_queue *audio_requests = NULL;
+static pthread_t audio_thread;
+
+static pthread_mutex_t keypad_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t keypad_push_thread;
+static bool keypad_push_mode = false;
+
+// ============================================================================
+// Replies
+// ============================================================================
+
+static void reply_result(PacketType type, unsigned short tag, int result) {
+  CommPacket reply = {.type = type, .data_len = sizeof(int), .tag = tag};
+  memcpy(reply.data, &result, sizeof(int));
+  deliver(&reply);
+}
+
+static void copy_latency(CommAudioLatencyWire *wire,
+                         const LatencySummary *summary) {
+  wire->count = summary->count;
+  wire->p50_us = summary->p50_us;
+  wire->p90_us = summary->p90_us;
+  wire->p99_us = summary->p99_us;
+  wire->max_us = summary->max_us;
+}
+
+// Same reply as Firmware's audio_send_stats()
+static void reply_stats(unsigned short tag, bool reset) {
+  AudioStatsSnapshot snapshot;
+  CommAudioStatsWire wire;
+
+  hal_stats_snapshot(&snapshot);
+  if (reset) {
+    hal_stats_reset();
+  }
+
+  memset(&wire, 0, sizeof(wire));
+  wire.version = COMM_AUDIO_STATS_VERSION;
+  wire.xruns = snapshot.counters[AUDIO_COUNT_XRUNS];
+  wire.recoveries = snapshot.counters[AUDIO_COUNT_RECOVERIES];
+  wire.interrupts = snapshot.counters[AUDIO_COUNT_INTERRUPTS];
+  wire.drops = snapshot.counters[AUDIO_COUNT_DROPS];
+  wire.queue_ms = (unsigned int)hal_audio_get_queued_ms();
+  wire.queue_max_ms = snapshot.queue_max_ms;
+  copy_latency(&wire.tts_first_pcm, &snapshot.latency[AUDIO_LAT_TTS_FIRST_PCM]);
+  copy_latency(&wire.pcm_to_device, &snapshot.latency[AUDIO_LAT_PCM_TO_DEVICE]);
+  copy_latency(&wire.beep_start, &snapshot.latency[AUDIO_LAT_BEEP_START]);
+
+  CommPacket reply = {.type = PACKET_AUDIO, .data_len = sizeof(wire), .tag = tag};
+  memcpy(reply.data, &wire, sizeof(wire));
+  deliver(&reply);
+}
+
+static void reply_key(unsigned short tag, char key) {
+  CommPacket reply = {.type = PACKET_KEYPAD, .data_len = 1, .tag = tag};
+  reply.data[0] = (unsigned char)key;
+  deliver(&reply);
+}
+
+static void reply_key_event(unsigned short tag, char key, unsigned char action,
+                            struct timeval time) {
+  CommKeypadEventWire wire;
+  memset(&wire, 0, sizeof(wire));
+  wire.key = (unsigned char)key;
+  wire.action = action;
+  wire.sec = (unsigned int)time.tv_sec;
+  wire.usec = (unsigned int)time.tv_usec;
+
+  CommPacket reply = {
+      .type = PACKET_KEYPAD, .data_len = sizeof(wire), .tag = tag};
+  memcpy(reply.data, &wire, sizeof(wire));
+  deliver(&reply);
+}
+
+// ============================================================================
+// Audio
+// ============================================================================
+
+static BeepType beep_type_from_char(char c) {
+  switch (c) {
+  case 'h':
+    return BEEP_HOLD;
+  case 'e':
+    return BEEP_ERROR;
+  default:
+    return BEEP_KEYPRESS;
+  }
+}
+
+// Same request handling as Firmware's audio_execute(). Runs on the audio
+// worker for speech and file playback and in the caller's thread for every
+// more urgent class; only the latter may flush the worker's queue.
+static int audio_execute(const unsigned char *data, unsigned short data_len,
+                         bool from_caller) {
+  char text[COMM_MAX_DATA_LEN + 1];
+  memcpy(text, data, data_len);
+  text[data_len] = '\0';
+
+  char audio_type = text[0];
+  const char *payload = text + 1;
+
+  if (audio_type == AUDIO_TYPE_TTS) {
+    hal_audio_clear_interrupt();
+    LOG_DEBUG("comm_local: speak '%s'", payload);
+    return hal_tts_speak(payload, NULL);
+  }
+  if (audio_type == AUDIO_TYPE_FILE) {
+    hal_audio_clear_interrupt();
+    char path[COMM_MAX_DATA_LEN + sizeof(LOCAL_FIRMWARE_DIR) + 8];
+    snprintf(path, sizeof(path), "%s%s.wav",
+             payload[0] == '/' ? "" : LOCAL_FIRMWARE_DIR, payload);
+    LOG_DEBUG("comm_local: play '%s'", path);
+    return hal_audio_play_file(path);
+  }
+  if (audio_type == 's') {
+    return hal_tts_set_speed((float)atof(payload));
+  }
+  if (audio_type == AUDIO_TYPE_VOLUME) {
+    if (payload[0] == 'm') {
+      return hal_audio_set_mixer_volume(atoi(payload + 1));
+    }
+    return hal_audio_set_volume(atoi(payload));
+  }
+  if (audio_type == AUDIO_TYPE_OUTPUT) {
+    int period_ms = 0;
+    int buffer_ms = 0;
+    char mode = '\0';
+    sscanf(payload, "%d,%d,%c", &period_ms, &buffer_ms, &mode);
+    return hal_audio_set_output(period_ms, buffer_ms, mode == 'm');
+  }
+  if (audio_type == AUDIO_TYPE_BEEP) {
+    hal_audio_clear_interrupt();
+    return hal_audio_play_beep(beep_type_from_char(payload[0]));
+  }
+  if (audio_type == AUDIO_TYPE_INTERRUPT) {
+    hal_audio_interrupt();
+    hal_tts_interrupt();
+    if (from_caller) {
+      clear_queue(audio_requests); // Nothing queued may play afterwards
+    }
+    return 0;
+  }
+  if (audio_type == AUDIO_TYPE_INFO) {
+    return hal_audio_get_card_number();
+  }
+  LOG_ERROR("comm_local: Unrecognized audio request '%c'", audio_type);
+  return -1;
+}
+
+static void *audio_worker(void *arg) {
+  (void)arg;
+
+  for (;;) {
+    Inst_packet *request = dequeue_wait(audio_requests);
+    if (request == NULL) {
+      break; // Closed by comm_local_close()
+    }
+    int result = audio_execute(request->data, request->data_len, false);
+    reply_result(PACKET_AUDIO, request->tag, result);
+    destroy_inst_packet(&request);
+  }
+  return NULL;
+}
+
+static int send_audio(const CommPacket *packet) {
+  if (packet->data_len == 0) {
+    LOG_ERROR("comm_local: Empty audio request");
+    return HAMPOD_ERROR;
+  }
+
+  // Same split as Firmware's audio_io_thread: anything more urgent than
+  // speech and file playback is handled now, in the caller's thread
+  if (frame_default_class(PACKET_AUDIO, packet->data, packet->data_len) <
+      FRAME_CLASS_BULK) {
+    if (packet->data[0] == AUDIO_TYPE_STATS) {
+      reply_stats(packet->tag, packet->data_len > 1 && packet->data[1] == 'r');
+      return HAMPOD_OK;
+    }
+    reply_result(PACKET_AUDIO, packet->tag,
+                 audio_execute(packet->data, packet->data_len, true));
+    return HAMPOD_OK;
+  }
+
+  enqueue(audio_requests,
+          create_inst_packet(AUDIO, packet->data_len,
+                             (unsigned char *)packet->data, packet->tag));
+  return HAMPOD_OK;
+}
+
+// ============================================================================
+// Keypad
+// ============================================================================
+
+static void *keypad_push_func(void *arg) {
+  (void)arg;
+
+  while (local_running) {
+    KeypadEvent event;
+    int result = hal_keypad_wait_event(&event, LOCAL_KEYPAD_WAIT_MS);
+    if (result < 0) {
+      // Device missing or unplugged - retry once a second
+      hal_keypad_cleanup();
+      sleep(1);
+      hal_keypad_init();
+      continue;
+    }
+    if (result == 0) {
+      continue;
+    }
+
+    unsigned char action = COMM_KEYPAD_EVENT_PRESS;
+    if (event.action == KEYPAD_ACTION_REPEAT) {
+      action = COMM_KEYPAD_EVENT_REPEAT;
+    } else if (event.action == KEYPAD_ACTION_RELEASE) {
+      action = COMM_KEYPAD_EVENT_RELEASE;
+    }
+    reply_key_event(0, event.key, action, event.time);
+  }
+  return NULL;
+}
+
+static int send_keypad(const CommPacket *packet) {
+  char request = packet->data_len > 0 ? (char)packet->data[0] : 'r';
+
+  pthread_mutex_lock(&keypad_lock);
+  if (request == 's') {
+    if (!keypad_push_mode &&
+        pthread_create(&keypad_push_thread, NULL, keypad_push_func, NULL) ==
+            0) {
+      keypad_push_mode = true;
+    }
+    struct timeval none = {0, 0};
+    reply_key_event(packet->tag, '-',
+                    keypad_push_mode ? COMM_KEYPAD_EVENT_SUBSCRIBED : 0, none);
+    pthread_mutex_unlock(&keypad_lock);
+    return HAMPOD_OK;
+  }
+
+  // Once the push thread owns the device, polls just get "no key"
+  char key = '-';
+  if (!keypad_push_mode) {
+    KeypadEvent event = hal_keypad_read();
+    if (event.valid) {
+      key = event.key;
+    }
+  }
+  pthread_mutex_unlock(&keypad_lock);
+
+  reply_key(packet->tag, key);
+  return HAMPOD_OK;
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+int comm_local_init(CommLocalDeliver deliver_fn) {
+  if (deliver_fn == NULL) {
+    return HAMPOD_ERROR;
+  }
+  deliver = deliver_fn;
+
+  // Like the Firmware, keep going without a device; it may be plugged in
+  if (hal_audio_init() != 0) {
+    LOG_ERROR("comm_local: Audio HAL init failed");
+  }
+  if (hal_tts_init() != 0) {
+    LOG_ERROR("comm_local: TTS HAL init failed");
+  } else {
+    LOG_INFO("comm_local: TTS engine %s", hal_tts_get_impl_name());
+  }
+  if (hal_keypad_init() != 0) {
+    LOG_ERROR("comm_local: Keypad HAL init failed");
+  }
+
+  audio_requests = create_packet_queue();
+  local_running = true;
+  if (pthread_create(&audio_thread, NULL, audio_worker, NULL) != 0) {
+    LOG_ERROR("comm_local: Failed to create audio worker");
+    local_running = false;
+    destroy_queue(audio_requests);
+    audio_requests = NULL;
+    return HAMPOD_ERROR;
+  }
+  return HAMPOD_OK;
+}
+
+void comm_local_close(void) {
+  if (!local_running) {
+    return;
+  }
+  local_running = false;
+
+  // Cut any utterance short so the worker can exit
+  hal_audio_interrupt();
+  hal_tts_interrupt();
+  close_queue(audio_requests);
+  pthread_join(audio_thread, NULL);
+  destroy_queue(audio_requests);
+  audio_requests = NULL;
+
+  if (keypad_push_mode) {
+    pthread_join(keypad_push_thread, NULL);
+    keypad_push_mode = false;
+  }
+
+  hal_tts_cleanup();
+  hal_audio_cleanup();
+  hal_keypad_cleanup();
+}
+
+int comm_local_send(const CommPacket *packet) {
+  if (!local_running) {
+    LOG_ERROR("comm_local_send: Backend not running");
+    return HAMPOD_ERROR;
+  }
+
+  switch (packet->type) {
+  case PACKET_AUDIO:
+    return send_audio(packet);
+  case PACKET_KEYPAD:
+    return send_keypad(packet);
+  default:
+    LOG_ERROR("comm_local_send: Unsupported packet type %d", packet->type);
+    return HAMPOD_ERROR;
+  }
+}
+
+#endif // HAMPOD_UNIFIED
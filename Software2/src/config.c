@@ -239,6 +239,27 @@ const char *config_get_audio_device_name(void) {
 
 const char *config_get_audio_port(void) { return g_config.audio.port; }
 
+int config_get_audio_period_ms(void) {
+  pthread_mutex_lock(&g_config_mutex);
+  int val = g_config.audio.period_ms;
+  pthread_mutex_unlock(&g_config_mutex);
+  return val;
+}
+
+int config_get_audio_buffer_ms(void) {
+  pthread_mutex_lock(&g_config_mutex);
+  int val = g_config.audio.buffer_ms;
+  pthread_mutex_unlock(&g_config_mutex);
+  return val;
+}
+
+bool config_get_audio_mmap(void) {
+  pthread_mutex_lock(&g_config_mutex);
+  bool val = g_config.audio.mmap;
+  pthread_mutex_unlock(&g_config_mutex);
+  return val;
+}
+
 int config_get_audio_card_number(void) {
   pthread_mutex_lock(&g_config_mutex);
   int val = g_config.audio.card_number;
@@ -256,6 +277,12 @@ const char *config_get_keypad_device_name(void) {
   return g_config.keypad.device_name;
 }
 
+// ============================================================================
+// Comm Getters
+// ============================================================================
+
+const char *config_get_comm_transport(void) { return g_config.comm.transport; }
+
 // ============================================================================
 // Radio Setters (Act on the currently active radio, auto-save after each)
 // ============================================================================
@@ -443,6 +470,12 @@ static void config_set_defaults(void) {
   g_config.audio.speech_speed = CONFIG_DEFAULT_SPEECH_SPEED;
   g_config.audio.key_beep_enabled = CONFIG_DEFAULT_KEY_BEEP;
   g_config.audio.card_number = -1;
+  g_config.audio.period_ms = CONFIG_DEFAULT_AUDIO_PERIOD_MS;
+  g_config.audio.buffer_ms = CONFIG_DEFAULT_AUDIO_BUFFER_MS;
+  g_config.audio.mmap = CONFIG_DEFAULT_AUDIO_MMAP;
+
+  // Comm defaults
+  strcpy(g_config.comm.transport, CONFIG_DEFAULT_COMM_TRANSPORT);
 }
 
 static void history_push(const HampodConfig *config) {
@@ -553,11 +586,20 @@ static int config_parse_file(const char *path) {
         g_config.audio.key_beep_enabled = (atoi(value) != 0);
       else if (strcmp(key, "card_number") == 0)
         g_config.audio.card_number = atoi(value);
+      else if (strcmp(key, "period_ms") == 0)
+        g_config.audio.period_ms = atoi(value);
+      else if (strcmp(key, "buffer_ms") == 0)
+        g_config.audio.buffer_ms = atoi(value);
+      else if (strcmp(key, "mmap") == 0)
+        g_config.audio.mmap = (atoi(value) != 0);
     } else if (strcmp(section, "keypad") == 0) {
       if (strcmp(key, "port") == 0)
         strncpy(g_config.keypad.port, value, 127);
       else if (strcmp(key, "device_name") == 0)
         strncpy(g_config.keypad.device_name, value, 127);
+    } else if (strcmp(section, "comm") == 0) {
+      if (strcmp(key, "transport") == 0)
+        strncpy(g_config.comm.transport, value, 15);
     }
   }
 
@@ -594,11 +636,17 @@ static int config_write_file(const char *path) {
   fprintf(fp, "card_number = %d\n", g_config.audio.card_number);
   fprintf(fp, "volume = %d\n", g_config.audio.volume);
   fprintf(fp, "speech_speed = %.2f\n", g_config.audio.speech_speed);
-  fprintf(fp, "key_beep = %d\n\n", g_config.audio.key_beep_enabled ? 1 : 0);
+  fprintf(fp, "key_beep = %d\n", g_config.audio.key_beep_enabled ? 1 : 0);
+  fprintf(fp, "period_ms = %d\n", g_config.audio.period_ms);
+  fprintf(fp, "buffer_ms = %d\n", g_config.audio.buffer_ms);
+  fprintf(fp, "mmap = %d\n\n", g_config.audio.mmap ? 1 : 0);
 
   fprintf(fp, "[keypad]\n");
   fprintf(fp, "port = %s\n", g_config.keypad.port);
-  fprintf(fp, "device_name = %s\n", g_config.keypad.device_name);
+  fprintf(fp, "device_name = %s\n\n", g_config.keypad.device_name);
+
+  fprintf(fp, "[comm]\n");
+  fprintf(fp, "transport = %s\n", g_config.comm.transport);
 
   fclose(fp);
   return 0;
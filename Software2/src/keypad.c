@@ -1,9 +1,14 @@
 /**
  * keypad.c - Keypad Input Module Implementation
  * 
- * Implements keypad polling with hold detection using a background thread.
+ * Implements keypad input with hold detection using a background thread.
  * 
- * Hold Detection Algorithm:
+ * Push Mode (preferred):
+ * The thread subscribes to Firmware keypad events. Firmware then sends one
+ * packet per kernel press/repeat/release with the evdev timestamp, so the
+ * thread sleeps until an event arrives or the hold threshold expires.
+ * 
+ * Polling Mode (fallback for Firmware without push support):
  * The Firmware reports a key once when pressed, then reports '-' continuously.
  * We detect holds by measuring the time between key press and release:
  * 
@@ -43,11 +48,13 @@ static KeypadCallback user_callback = NULL;
 // Configuration
 static int hold_threshold_ms = DEFAULT_HOLD_THRESHOLD_MS;
 static int poll_interval_ms = DEFAULT_POLL_INTERVAL_MS;
+static bool push_enabled = true;
 
 // Hold detection state
 static char last_key = '-';           // Last key seen (or '-' for none)
 static struct timespec key_press_time; // When the key was first pressed
 static bool hold_event_fired = false;  // Have we already fired a hold event?
+static long key_press_event_ms = 0;    // Firmware timestamp of the press (push)
 
 // ============================================================================
 // Private Helper Functions
@@ -100,11 +107,82 @@ static void fire_event(char key, bool is_hold) {
 // Keypad Thread
 // ============================================================================
 
-static void* keypad_thread_func(void* arg) {
-    (void)arg;
-    
-    LOG_INFO("Keypad thread started");
-    
+/* Upper bound on one wait so shutdown is noticed promptly */
+#define PUSH_WAIT_SLICE_MS 100
+
+static void keypad_push_loop(void) {
+    while (running) {
+        int timeout_ms = PUSH_WAIT_SLICE_MS;
+        
+        // Wake up exactly when a held key crosses the hold threshold
+        if (last_key != '-' && !hold_event_fired) {
+            long remaining = hold_threshold_ms - elapsed_since_press();
+            if (remaining < 0) {
+                remaining = 0;
+            }
+            if (remaining < timeout_ms) {
+                timeout_ms = (int)remaining;
+            }
+        }
+        
+        CommKeypadEvent event;
+        int result = comm_wait_keypad_event(&event, timeout_ms);
+        
+        if (result == HAMPOD_TIMEOUT) {
+            if (last_key != '-' && !hold_event_fired &&
+                elapsed_since_press() >= hold_threshold_ms) {
+                fire_event(last_key, true);  // Hold event
+                hold_event_fired = true;
+            }
+            continue;
+        }
+        if (result != HAMPOD_OK) {
+            LOG_ERROR("Failed to read keypad event, stopping");
+            break;
+        }
+        
+        switch (event.action) {
+        case COMM_KEYPAD_EVENT_PRESS:
+            if (last_key != '-' && last_key != event.key && !hold_event_fired) {
+                fire_event(last_key, false);  // Press event for old key
+            }
+            last_key = event.key;
+            clock_gettime(CLOCK_MONOTONIC, &key_press_time);
+            key_press_event_ms = event.time_ms;
+            hold_event_fired = false;
+            LOG_DEBUG("Key down: '%c'", event.key);
+            break;
+            
+        case COMM_KEYPAD_EVENT_REPEAT:
+            if (event.key == last_key && !hold_event_fired &&
+                elapsed_since_press() >= hold_threshold_ms) {
+                fire_event(last_key, true);  // Hold event
+                hold_event_fired = true;
+            }
+            break;
+            
+        case COMM_KEYPAD_EVENT_RELEASE:
+            if (event.key == last_key) {
+                // Both timestamps come from the kernel, so pipe latency
+                // does not count towards the hold duration
+                long hold_time = event.time_ms - key_press_event_ms;
+                if (!hold_event_fired) {
+                    fire_event(last_key, hold_time >= hold_threshold_ms);
+                }
+                LOG_DEBUG("Key up: '%c' (held for %ldms)", last_key, hold_time);
+                last_key = '-';
+            }
+            break;
+            
+        default:
+            LOG_DEBUG("Ignoring keypad event action 0x%02X",
+                      (unsigned char)event.action);
+            break;
+        }
+    }
+}
+
+static void keypad_poll_loop(void) {
     /* Number of consecutive no-key polls before considering key released.
      * Linux key repeat has gaps between events, so we need debouncing. */
     static const int RELEASE_THRESHOLD = 6;  /* 6 polls x 50ms = 300ms */
@@ -185,6 +263,21 @@ static void* keypad_thread_func(void* arg) {
         // Sleep between polls
         usleep(poll_interval_ms * 1000);
     }
+}
+
+static void* keypad_thread_func(void* arg) {
+    (void)arg;
+    
+    LOG_INFO("Keypad thread started");
+    
+    // Firmware without push support is polled without asking first
+    if (push_enabled && comm_firmware_has(HAMPOD_CAP_PUSH_KEYPAD) &&
+        comm_subscribe_keypad() == HAMPOD_OK) {
+        keypad_push_loop();
+    } else {
+        LOG_INFO("Keypad using polling mode (%dms interval)", poll_interval_ms);
+        keypad_poll_loop();
+    }
     
     LOG_INFO("Keypad thread exiting");
     
@@ -265,6 +358,11 @@ void keypad_set_hold_threshold(int ms) {
     }
 }
 
+void keypad_set_push_enabled(bool enabled) {
+    push_enabled = enabled;
+    LOG_INFO("Keypad push mode %s", enabled ? "enabled" : "disabled");
+}
+
 void keypad_set_poll_interval(int ms) {
     if (ms > 0) {
         poll_interval_ms = ms;
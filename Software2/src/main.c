@@ -19,6 +19,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #include "comm.h"
@@ -151,6 +152,14 @@ int main(int argc, char *argv[]) {
 
   // Initialize comm (Firmware pipes)
   printf("Connecting to Firmware...\n");
+  const char *transport = config_get_comm_transport();
+  if (strcmp(transport, "shm") == 0) {
+    comm_set_transport(COMM_TRANSPORT_SHM);
+  } else if (strcmp(transport, "local") == 0) {
+    comm_set_transport(COMM_TRANSPORT_LOCAL);
+  } else {
+    comm_set_transport(COMM_TRANSPORT_FIFO);
+  }
   if (comm_init() != 0) {
     fprintf(stderr, "ERROR: Could not connect to Firmware\n");
     fprintf(stderr, "Is firmware.elf running?\n");
@@ -167,31 +176,32 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
-  // Apply volume setting to USB audio
-  // Query the actual card number from Firmware (determined at startup)
-  int card_number = 2; // Default fallback
-  if (comm_query_audio_card_number(&card_number) == 0) {
-    printf("Audio card detected: %d\n", card_number);
-  } else {
-    printf("WARNING: Could not query audio card, using default card %d\n",
-           card_number);
-  }
-
   // Set speech speed from config
   float speech_speed = config_get_speech_speed();
   printf("Setting speech speed to %.2f\n", speech_speed);
   comm_set_speech_speed(speech_speed);
 
+  // Volume is a software gain in the Firmware's mixer: no card number or
+  // amixer needed, and it applies within one audio period
   int volume = config_get_volume();
-  printf("Setting volume to %d%% on card %d...\n", volume, card_number);
-  char vol_cmd[256];
-  snprintf(vol_cmd, sizeof(vol_cmd),
-           "amixer -c %d -q sset PCM %d%% 2>/dev/null", card_number, volume);
-  if (system(vol_cmd) != 0) {
-    printf("WARNING: Volume command failed, trying default device\n");
-    snprintf(vol_cmd, sizeof(vol_cmd), "amixer -q sset PCM %d%% 2>/dev/null",
-             volume);
-    system(vol_cmd);
+  printf("Setting volume to %d%%\n", volume);
+  if (!comm_firmware_has(HAMPOD_CAP_VOLUME)) {
+    printf("WARNING: Firmware has no volume control, update firmware.elf\n");
+  } else if (comm_set_volume(volume) != HAMPOD_OK) {
+    printf("WARNING: Could not set volume\n");
+  }
+
+  // Output period and buffer; the Firmware keeps its own if the card
+  // refuses them
+  if (comm_firmware_has(HAMPOD_CAP_AUDIO_OUTPUT)) {
+    int period_ms = config_get_audio_period_ms();
+    int buffer_ms = config_get_audio_buffer_ms();
+    bool use_mmap = config_get_audio_mmap();
+    printf("Setting audio output to %d ms periods, %d ms buffer%s\n",
+           period_ms, buffer_ms, use_mmap ? " (mmap)" : "");
+    if (comm_set_audio_output(period_ms, buffer_ms, use_mmap) != HAMPOD_OK) {
+      printf("WARNING: Could not set audio output\n");
+    }
   }
 
   // Initialize speech
@@ -262,6 +272,15 @@ int main(int argc, char *argv[]) {
   }
 
   keypad_shutdown();
+
+  // One line of audio health for the session log
+  CommAudioStatsWire stats;
+  if (comm_query_audio_stats(&stats, false) == HAMPOD_OK) {
+    printf("Audio: %u xruns, %u drops, beep p99 %u ms, speech p99 %u ms\n",
+           stats.xruns, stats.drops, stats.beep_start.p99_us / 1000,
+           stats.tts_first_pcm.p99_us / 1000);
+  }
+
   speech_shutdown();
   comm_close();
   config_cleanup();
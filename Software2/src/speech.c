@@ -3,7 +3,8 @@
  *
  * Implements a thread-safe speech queue using pthreads.
  * The speech thread runs in the background, dequeueing items
- * and sending them to Firmware via comm_send_audio_sync().
+ * and sending them to Firmware with comm_send_audio_request(), waiting for
+ * each utterance's own acknowledgment.
  *
  * Part of Phase 0: Core Infrastructure (Step 2.1)
  */
@@ -22,7 +23,8 @@
 // ============================================================================
 
 #define DEFAULT_MAX_QUEUE_SIZE 32
-#define MAX_TEXT_LENGTH 256
+// Type byte and terminator take the rest of a packet
+#define MAX_TEXT_LENGTH (COMM_MAX_DATA_LEN - 1)
 
 // ============================================================================
 // Audio Packet Types
@@ -199,15 +201,18 @@ static void *speech_thread_func(void *arg) {
     LOG_DEBUG("Speaking: type='%c', payload='%s'", item.type, item.payload);
 
     // Send audio request to Firmware
-    if (comm_send_audio(item.type, item.payload) != HAMPOD_OK) {
+    CommRequest request;
+    if (comm_send_audio_request(item.type, item.payload, &request) !=
+        HAMPOD_OK) {
       LOG_ERROR("Failed to send audio: %s", item.payload);
       continue;
     }
 
-    // Wait for audio acknowledgment from router queue
+    // Wait for the acknowledgment of this utterance (matched by tag, so a
+    // beep or interrupt ack cannot end the wait early)
     // This ensures proper sequencing without blocking keypad thread
     CommPacket response;
-    int result = comm_wait_audio_response(&response, COMM_AUDIO_TIMEOUT_MS);
+    int result = comm_wait_request(&request, &response, COMM_AUDIO_TIMEOUT_MS);
 
     if (result == HAMPOD_TIMEOUT) {
       LOG_ERROR("Timeout waiting for audio acknowledgment: %s", item.payload);
@@ -278,6 +283,39 @@ void speech_shutdown(void) {
 
 bool speech_is_running(void) { return running; }
 
+/*
+ * Queue text for TTS. A readout longer than the Firmware accepts in one
+ * request (256 bytes for version 1 Firmware) is split at word boundaries
+ * instead of being cut off.
+ */
+static int queue_push_text(const char *text) {
+  size_t limit = comm_max_payload() - 2; // Type byte and terminator
+  if (limit > MAX_TEXT_LENGTH - 1) {
+    limit = MAX_TEXT_LENGTH - 1;
+  }
+
+  char piece[MAX_TEXT_LENGTH];
+  while (strlen(text) > limit) {
+    size_t cut = limit;
+    while (cut > 0 && text[cut] != ' ') {
+      cut--;
+    }
+    if (cut == 0) {
+      cut = limit; // One very long word
+    }
+    memcpy(piece, text, cut);
+    piece[cut] = '\0';
+    if (queue_push(AUDIO_TYPE_TTS, piece) != HAMPOD_OK) {
+      return HAMPOD_ERROR;
+    }
+    text += cut;
+    while (*text == ' ') {
+      text++;
+    }
+  }
+  return queue_push(AUDIO_TYPE_TTS, text);
+}
+
 // ============================================================================
 // Public API - Queue Operations
 // ============================================================================
@@ -287,7 +325,7 @@ int speech_say_text(const char *text) {
     LOG_ERROR("speech_say_text: NULL text");
     return HAMPOD_ERROR;
   }
-  return queue_push(AUDIO_TYPE_TTS, text);
+  return queue_push_text(text);
 }
 
 int speech_spell_text(const char *text) {
@@ -343,7 +381,9 @@ void speech_interrupt(void) {
 
   // 2. Send interrupt command to Firmware and WAIT for acknowledgment
   // This ensures the interrupt is processed before we queue new speech
-  if (comm_send_audio(AUDIO_TYPE_INTERRUPT, "") != HAMPOD_OK) {
+  CommRequest request;
+  if (comm_send_audio_request(AUDIO_TYPE_INTERRUPT, "", &request) !=
+      HAMPOD_OK) {
     LOG_ERROR("Failed to send interrupt command to Firmware");
     return;
   }
@@ -351,7 +391,7 @@ void speech_interrupt(void) {
   // 3. Wait for acknowledgment from firmware (with short timeout)
   // This blocks until firmware confirms interrupt was processed
   CommPacket ack;
-  if (comm_wait_audio_response(&ack, 100) == HAMPOD_OK) {
+  if (comm_wait_request(&request, &ack, 100) == HAMPOD_OK) {
     LOG_DEBUG("Interrupt acknowledged by firmware");
   } else {
     LOG_ERROR("Interrupt acknowledgment timeout");
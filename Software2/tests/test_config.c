@@ -48,6 +48,11 @@ void test_init_defaults(void) {
         FAIL("speech_speed not default");
         return;
     }
+    if (config_get_audio_period_ms() != CONFIG_DEFAULT_AUDIO_PERIOD_MS ||
+        config_get_audio_buffer_ms() != CONFIG_DEFAULT_AUDIO_BUFFER_MS) {
+        FAIL("audio output not default");
+        return;
+    }
     
     config_cleanup();
     PASS();
@@ -274,6 +279,9 @@ void test_file_parsing(void) {
     fprintf(fp, "volume = 65\n");
     fprintf(fp, "speech_speed = 1.2\n");
     fprintf(fp, "key_beep = 0\n");
+    fprintf(fp, "period_ms = 10\n");
+    fprintf(fp, "buffer_ms = 40\n");
+    fprintf(fp, "mmap = 1\n");
     fclose(fp);
     
     config_init(TEST_CONFIG_PATH);
@@ -308,6 +316,13 @@ void test_file_parsing(void) {
         unlink(TEST_CONFIG_PATH);
         return;
     }
+    if (config_get_audio_period_ms() != 10 ||
+        config_get_audio_buffer_ms() != 40 || !config_get_audio_mmap()) {
+        FAIL("audio output settings not parsed");
+        config_cleanup();
+        unlink(TEST_CONFIG_PATH);
+        return;
+    }
     
     config_cleanup();
     unlink(TEST_CONFIG_PATH);
@@ -0,0 +1,349 @@
+/**
+ * test_frame.c - Test Pipe Packet Framing
+ *
+ * Verifies the shared framing layer (Firmware/hampod_frame.c):
+ * 1. Single packet round trip
+ * 2. A burst of packets is parsed from one buffered read
+ * 3. Oversized packets are dropped without losing sync
+ * 4. Ring buffer wrap-around
+ * 5. Concurrent writers never interleave partial packets
+ * 6. EOF is reported when the writer closes
+ * 7. The scheduling class byte round trips and unset classes are derived
+ * 8. Long messages are split into chunks and joined again
+ *
+ * Note: This test runs WITHOUT Firmware - it uses an anonymous pipe.
+ *
+ * Usage:
+ *   make tests
+ *   ./bin/test_frame
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "hampod_core.h"
+#include "comm.h"
+#include "hampod_frame.h"
+
+// ============================================================================
+// Test Framework
+// ============================================================================
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, msg) do { \
+    if (condition) { \
+        printf("  ✓ PASS: %s\n", msg); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAIL: %s\n", msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+static void test_round_trip(void) {
+    printf("\n--- Test: Single packet round trip ---\n");
+
+    int fds[2];
+    pipe(fds);
+    Frame_reader reader;
+    frame_reader_init(&reader, fds[0]);
+
+    const char* text = "dHello World";
+    int written = frame_write(fds[1], PACKET_AUDIO, 42, text, strlen(text) + 1);
+    TEST_ASSERT(written == 0, "frame_write succeeds");
+
+    Frame_header header;
+    unsigned char data[COMM_MAX_DATA_LEN];
+    int result = frame_read(&reader, &header, data, sizeof(data));
+    TEST_ASSERT(result == FRAME_OK, "frame_read returns FRAME_OK");
+    TEST_ASSERT(header.type == PACKET_AUDIO, "Type preserved");
+    TEST_ASSERT(header.tag == 42, "Tag preserved");
+    TEST_ASSERT(header.data_len == strlen(text) + 1, "Length preserved");
+    TEST_ASSERT(strcmp((char*)data, text) == 0, "Data preserved");
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void test_burst_single_read(void) {
+    printf("\n--- Test: Burst parsed from one read ---\n");
+
+    int fds[2];
+    pipe(fds);
+    Frame_reader reader;
+    frame_reader_init(&reader, fds[0]);
+
+    for (unsigned short i = 0; i < 20; i++) {
+        unsigned char beep[2] = {'b', 'k'};
+        frame_write(fds[1], PACKET_AUDIO, i, beep, sizeof(beep));
+    }
+
+    Frame_header header;
+    unsigned char data[COMM_MAX_DATA_LEN];
+    frame_read(&reader, &header, data, sizeof(data));
+    TEST_ASSERT(frame_reader_buffered(&reader) == 19 * (FRAME_HEADER_SIZE + 2),
+                "Remaining 19 packets buffered after first read");
+
+    bool in_order = (header.tag == 0);
+    for (unsigned short i = 1; i < 20; i++) {
+        frame_read(&reader, &header, data, sizeof(data));
+        in_order = in_order && header.tag == i;
+    }
+    TEST_ASSERT(in_order, "Packets parsed in order");
+    TEST_ASSERT(frame_reader_buffered(&reader) == 0, "Buffer drained");
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void test_oversized_dropped(void) {
+    printf("\n--- Test: Oversized packet dropped ---\n");
+
+    int fds[2];
+    pipe(fds);
+    Frame_reader reader;
+    frame_reader_init(&reader, fds[0]);
+
+    unsigned char big[64];
+    memset(big, 'x', sizeof(big));
+    frame_write(fds[1], PACKET_AUDIO, 1, big, sizeof(big));
+    frame_write(fds[1], PACKET_KEYPAD, 2, "5", 1);
+
+    Frame_header header;
+    unsigned char data[16];
+    int result = frame_read(&reader, &header, data, sizeof(data));
+    TEST_ASSERT(result == FRAME_TOO_LARGE, "Oversized packet reported");
+    TEST_ASSERT(header.data_len == sizeof(big), "Oversized header still returned");
+
+    result = frame_read(&reader, &header, data, sizeof(data));
+    TEST_ASSERT(result == FRAME_OK && header.tag == 2 && data[0] == '5',
+                "Next packet read intact");
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void test_wrap_around(void) {
+    printf("\n--- Test: Ring buffer wrap-around ---\n");
+
+    int fds[2];
+    pipe(fds);
+    Frame_reader reader;
+    frame_reader_init(&reader, fds[0]);
+
+    // 200-byte packets do not divide the ring size, so frames straddle the end
+    unsigned char payload[200];
+    unsigned char data[COMM_MAX_DATA_LEN];
+    bool all_ok = true;
+
+    for (int round = 0; round < 10; round++) {
+        for (int i = 0; i < 8; i++) {
+            memset(payload, round * 8 + i, sizeof(payload));
+            frame_write(fds[1], PACKET_AUDIO, round * 8 + i, payload, sizeof(payload));
+        }
+        for (int i = 0; i < 8; i++) {
+            Frame_header header;
+            int result = frame_read(&reader, &header, data, sizeof(data));
+            all_ok = all_ok && result == FRAME_OK &&
+                     header.tag == round * 8 + i &&
+                     data[0] == (unsigned char)(round * 8 + i) &&
+                     data[sizeof(payload) - 1] == (unsigned char)(round * 8 + i);
+        }
+    }
+    TEST_ASSERT(all_ok, "80 packets survive wrapping the ring");
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+#define WRITER_PACKETS 500
+
+typedef struct {
+    int fd;
+    unsigned char fill;
+} WriterArgs;
+
+static void* writer_thread(void* arg) {
+    WriterArgs* args = (WriterArgs*)arg;
+    unsigned char payload[COMM_MAX_DATA_LEN];
+    memset(payload, args->fill, sizeof(payload));
+    for (int i = 0; i < WRITER_PACKETS; i++) {
+        frame_write(args->fd, PACKET_AUDIO, args->fill, payload, 1 + i % sizeof(payload));
+    }
+    return NULL;
+}
+
+static void test_concurrent_writers(void) {
+    printf("\n--- Test: Concurrent writers ---\n");
+
+    int fds[2];
+    pipe(fds);
+    Frame_reader reader;
+    frame_reader_init(&reader, fds[0]);
+
+    pthread_t writers[2];
+    WriterArgs args[2] = {{fds[1], 'a'}, {fds[1], 'b'}};
+    pthread_create(&writers[0], NULL, writer_thread, &args[0]);
+    pthread_create(&writers[1], NULL, writer_thread, &args[1]);
+
+    bool intact = true;
+    unsigned char data[COMM_MAX_DATA_LEN];
+    for (int i = 0; i < 2 * WRITER_PACKETS; i++) {
+        Frame_header header;
+        if (frame_read(&reader, &header, data, sizeof(data)) != FRAME_OK) {
+            intact = false;
+            break;
+        }
+        for (int j = 0; j < header.data_len; j++) {
+            if (data[j] != header.tag) {
+                intact = false;
+            }
+        }
+    }
+
+    pthread_join(writers[0], NULL);
+    pthread_join(writers[1], NULL);
+    TEST_ASSERT(intact, "Every packet arrives whole");
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void test_eof(void) {
+    printf("\n--- Test: EOF ---\n");
+
+    int fds[2];
+    pipe(fds);
+    Frame_reader reader;
+    frame_reader_init(&reader, fds[0]);
+
+    // Half a header, then the writer goes away
+    write(fds[1], "\x01\x00", 2);
+    close(fds[1]);
+
+    Frame_header header;
+    unsigned char data[16];
+    int result = frame_read(&reader, &header, data, sizeof(data));
+    TEST_ASSERT(result == FRAME_EOF, "Truncated stream reports FRAME_EOF");
+
+    close(fds[0]);
+}
+
+static void test_class_byte(void) {
+    printf("\n--- Test: Scheduling class ---\n");
+
+    int fds[2];
+    pipe(fds);
+    Frame_reader reader;
+    frame_reader_init(&reader, fds[0]);
+
+    unsigned char beep[] = "bk";
+    frame_write(fds[1], FRAME_TYPE_WITH_CLASS(PACKET_AUDIO, FRAME_CLASS_BEEP), 5,
+                beep, sizeof(beep));
+    frame_write(fds[1], PACKET_KEYPAD, 6, "r", 1);
+
+    Frame_header header;
+    unsigned char data[16];
+    frame_read(&reader, &header, data, sizeof(data));
+    TEST_ASSERT(header.type == PACKET_AUDIO && header.priority == FRAME_CLASS_BEEP,
+                "Class byte is split from the type");
+    frame_read(&reader, &header, data, sizeof(data));
+    TEST_ASSERT(header.type == PACKET_KEYPAD && header.priority == FRAME_CLASS_NONE,
+                "Old senders read as FRAME_CLASS_NONE");
+
+    TEST_ASSERT(frame_default_class(PACKET_AUDIO, (const unsigned char*)"i", 1) ==
+                    FRAME_CLASS_INTERRUPT &&
+                frame_default_class(PACKET_AUDIO, (const unsigned char*)"s1.0", 4) ==
+                    FRAME_CLASS_CONTROL &&
+                frame_default_class(PACKET_AUDIO, (const unsigned char*)"v80", 3) ==
+                    FRAME_CLASS_CONTROL &&
+                frame_default_class(PACKET_AUDIO, (const unsigned char*)"mr", 2) ==
+                    FRAME_CLASS_CONTROL &&
+                frame_default_class(PACKET_AUDIO, (const unsigned char*)"o10,40", 6) ==
+                    FRAME_CLASS_CONTROL &&
+                frame_default_class(PACKET_KEYPAD, (const unsigned char*)"r", 1) ==
+                    FRAME_CLASS_KEYPAD &&
+                frame_default_class(PACKET_AUDIO, (const unsigned char*)"dhi", 3) ==
+                    FRAME_CLASS_BULK,
+                "Default classes put speech last");
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void test_chunked_message(void) {
+    printf("\n--- Test: Chunked messages ---\n");
+
+    int fds[2];
+    pipe(fds);
+    Frame_reader reader;
+    frame_reader_init(&reader, fds[0]);
+
+    // Written first so the pipe never fills while nobody reads
+    unsigned char message[3000];
+    for (size_t i = 0; i < sizeof(message); i++) {
+        message[i] = (unsigned char)(i * 7);
+    }
+    frame_write_message(fds[1], PACKET_AUDIO, 11, message, sizeof(message), 1024);
+    frame_write_message(fds[1], PACKET_AUDIO, 12, message, sizeof(message), 1024);
+    frame_write_message(fds[1], PACKET_AUDIO, 13, "dhi", 4, 1024);
+
+    Frame_header header;
+    unsigned char data[COMM_MAX_DATA_LEN];
+    int result = frame_read_message(&reader, &header, data, sizeof(data));
+    TEST_ASSERT(result == FRAME_OK && header.tag == 11 &&
+                header.data_len == sizeof(message) &&
+                memcmp(data, message, sizeof(message)) == 0,
+                "3000-byte message joined from 1024-byte chunks");
+
+    unsigned char small[512];
+    result = frame_read_message(&reader, &header, small, sizeof(small));
+    TEST_ASSERT(result == FRAME_TOO_LARGE, "Message larger than the buffer is reported");
+
+    result = frame_read_message(&reader, &header, data, sizeof(data));
+    TEST_ASSERT(result == FRAME_OK && header.tag == 13 && header.flags == 0 &&
+                strcmp((char*)data, "dhi") == 0,
+                "Short message after a skipped one is intact");
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main() {
+    printf("=== Packet Framing Unit Tests ===\n");
+    printf("Testing framing over an anonymous pipe (no Firmware required)\n");
+
+    test_round_trip();
+    test_burst_single_read();
+    test_oversized_dropped();
+    test_wrap_around();
+    test_concurrent_writers();
+    test_eof();
+    test_class_byte();
+    test_chunked_message();
+
+    printf("\n=== Summary ===\n");
+    printf("Passed: %d\n", tests_passed);
+    printf("Failed: %d\n", tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
@@ -0,0 +1,196 @@
+/**
+ * test_shm.c - Test Shared-Memory Transport
+ *
+ * Verifies the shared-memory rings (Firmware/hampod_shm.c):
+ * 1. Attach sees the region created by the Firmware side
+ * 2. Packets round trip in both directions
+ * 3. Ring wrap-around
+ * 4. Receive timeout and full-ring send timeout
+ * 5. A sleeping receiver in another process is woken
+ * 6. Close detaches and unlinks
+ *
+ * Note: This test runs WITHOUT Firmware - both ends live in the test, under a
+ * private region name.
+ *
+ * Usage:
+ *   make tests
+ *   ./bin/test_shm
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "hampod_core.h"
+#include "comm.h"
+#include "hampod_shm.h"
+
+// ============================================================================
+// Test Framework
+// ============================================================================
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, msg) do { \
+    if (condition) { \
+        printf("  ✓ PASS: %s\n", msg); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAIL: %s\n", msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+static char region_name[64];
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+static void test_attach(Shm_link* firmware, Shm_link* software) {
+    printf("\n--- Test: Create and attach ---\n");
+
+    TEST_ASSERT(shm_link_create(firmware, region_name) == 0, "Firmware side creates region");
+    TEST_ASSERT(!shm_link_is_attached(firmware), "Not attached before Software");
+    TEST_ASSERT(shm_link_attach(software, region_name) == 0, "Software side attaches");
+    TEST_ASSERT(shm_link_is_attached(firmware), "Firmware sees the attach");
+
+    Shm_link missing;
+    TEST_ASSERT(shm_link_attach(&missing, "/hampod_test_missing") == -1,
+                "Attaching to a missing region fails");
+}
+
+static void test_round_trip(Shm_link* firmware, Shm_link* software) {
+    printf("\n--- Test: Round trip ---\n");
+
+    const char* text = "dHello World";
+    TEST_ASSERT(shm_link_send(software, PACKET_AUDIO, 7, text, strlen(text) + 1) == 0,
+                "Software sends request");
+
+    Frame_header header;
+    unsigned char data[COMM_MAX_DATA_LEN];
+    int result = shm_link_recv(firmware, &header, data, sizeof(data), 0);
+    TEST_ASSERT(result == FRAME_OK, "Firmware receives it");
+    TEST_ASSERT(header.type == PACKET_AUDIO && header.tag == 7 &&
+                strcmp((char*)data, text) == 0, "Header and data preserved");
+
+    unsigned char ack = 'p';
+    shm_link_send(firmware, PACKET_AUDIO, 7, &ack, 1);
+    result = shm_link_recv(software, &header, data, sizeof(data), 0);
+    TEST_ASSERT(result == FRAME_OK && header.tag == 7 && data[0] == 'p',
+                "Reply travels the other ring");
+}
+
+static void test_wrap_around(Shm_link* firmware, Shm_link* software) {
+    printf("\n--- Test: Ring wrap-around ---\n");
+
+    // 250-byte packets do not divide the ring size, so frames straddle the end
+    unsigned char payload[250];
+    unsigned char data[COMM_MAX_DATA_LEN];
+    bool all_ok = true;
+
+    for (int i = 0; i < 500; i++) {
+        memset(payload, i & 0xff, sizeof(payload));
+        shm_link_send(software, PACKET_AUDIO, i, payload, sizeof(payload));
+        Frame_header header;
+        int result = shm_link_recv(firmware, &header, data, sizeof(data), 0);
+        all_ok = all_ok && result == FRAME_OK && header.tag == i &&
+                 data[0] == (unsigned char)i &&
+                 data[sizeof(payload) - 1] == (unsigned char)i;
+    }
+    TEST_ASSERT(all_ok, "500 packets survive wrapping the ring");
+}
+
+static void test_timeouts(Shm_link* firmware, Shm_link* software) {
+    printf("\n--- Test: Timeouts ---\n");
+
+    Frame_header header;
+    unsigned char data[COMM_MAX_DATA_LEN];
+    TEST_ASSERT(shm_link_recv(firmware, &header, data, sizeof(data), 20) == SHM_TIMEOUT,
+                "Empty ring times out");
+
+    unsigned char payload[COMM_MAX_DATA_LEN] = {0};
+    int sent = 0;
+    while (shm_link_send(software, PACKET_AUDIO, sent, payload, sizeof(payload)) == 0) {
+        sent++;
+    }
+    TEST_ASSERT(sent == SHM_RING_SIZE / (FRAME_HEADER_SIZE + sizeof(payload)),
+                "Send gives up when the ring is full");
+
+    int drained = 0;
+    while (shm_link_recv(firmware, &header, data, sizeof(data), 0) == FRAME_OK) {
+        drained++;
+    }
+    TEST_ASSERT(drained == sent, "Every queued packet is still delivered");
+}
+
+static void test_cross_process_wake(Shm_link* firmware) {
+    printf("\n--- Test: Wake a receiver in another process ---\n");
+
+    pid_t child = fork();
+    if (child == 0) {
+        Shm_link software;
+        if (shm_link_attach(&software, region_name) != 0) {
+            _exit(1);
+        }
+        usleep(50000); // Let the parent go to sleep on the futex
+        unsigned char key = '5';
+        int result = shm_link_send(&software, PACKET_KEYPAD, 99, &key, 1);
+        _exit(result == 0 ? 0 : 1);
+    }
+
+    Frame_header header;
+    unsigned char data[COMM_MAX_DATA_LEN];
+    int result = shm_link_recv(firmware, &header, data, sizeof(data), 2000);
+    int status = 0;
+    waitpid(child, &status, 0);
+    TEST_ASSERT(result == FRAME_OK && header.tag == 99 && data[0] == '5',
+                "Sleeping receiver woken by other process");
+    TEST_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0, "Child sent cleanly");
+}
+
+static void test_close(Shm_link* firmware, Shm_link* software) {
+    printf("\n--- Test: Close ---\n");
+
+    shm_link_close(software);
+    TEST_ASSERT(!shm_link_is_attached(firmware), "Software close detaches");
+
+    shm_link_close(firmware);
+    Shm_link again;
+    TEST_ASSERT(shm_link_attach(&again, region_name) == -1, "Firmware close unlinks");
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main() {
+    printf("=== Shared-Memory Transport Unit Tests ===\n");
+    printf("Testing both ends in one process (no Firmware required)\n");
+
+    snprintf(region_name, sizeof(region_name), "/hampod_test_%d", (int)getpid());
+
+    Shm_link firmware;
+    Shm_link software;
+    test_attach(&firmware, &software);
+    test_round_trip(&firmware, &software);
+    test_wrap_around(&firmware, &software);
+    test_timeouts(&firmware, &software);
+    test_cross_process_wake(&firmware);
+    test_close(&firmware, &software);
+
+    printf("\n=== Summary ===\n");
+    printf("Passed: %d\n", tests_passed);
+    printf("Failed: %d\n", tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
@@ -0,0 +1,172 @@
+/**
+ * test_trace.c - Test Packet Trace Recorder
+ *
+ * Verifies the trace file format (Firmware/hampod_trace.c):
+ * 1. Records read back with direction, type, tag and payload intact
+ * 2. A second writer (the other process) appends to the same file
+ * 3. Files without the trace header are rejected
+ * 4. A disabled writer records nothing
+ *
+ * Note: This test runs WITHOUT Firmware - it writes a private file in /tmp.
+ *
+ * Usage:
+ *   make tests
+ *   ./bin/test_trace
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "hampod_core.h"
+#include "comm.h"
+#include "hampod_trace.h"
+
+// ============================================================================
+// Test Framework
+// ============================================================================
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST_ASSERT(condition, msg) do { \
+    if (condition) { \
+        printf("  ✓ PASS: %s\n", msg); \
+        tests_passed++; \
+    } else { \
+        printf("  ✗ FAIL: %s\n", msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+static char trace_path[64];
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+static void test_round_trip(void) {
+    printf("\n--- Test: Write and read back ---\n");
+
+    Trace_writer writer;
+    TEST_ASSERT(trace_open(&writer, trace_path, TRACE_SOURCE_SOFTWARE) == 0,
+                "Open new trace");
+
+    const char request[] = "dhello";
+    int result = 0;
+    int type = FRAME_TYPE_WITH_CLASS(PACKET_AUDIO, FRAME_CLASS_BULK);
+    trace_record(&writer, TRACE_TO_FIRMWARE, type, 7, request, strlen(request));
+    trace_record(&writer, TRACE_FROM_FIRMWARE, PACKET_AUDIO, 7, &result, sizeof(int));
+    trace_close(&writer);
+
+    Trace_reader reader;
+    Trace_record record;
+    unsigned char data[COMM_MAX_DATA_LEN];
+    TEST_ASSERT(trace_reader_open(&reader, trace_path) == 0, "Open for reading");
+
+    TEST_ASSERT(trace_read(&reader, &record, data, sizeof(data)) == TRACE_OK,
+                "Read request record");
+    TEST_ASSERT(record.direction == TRACE_TO_FIRMWARE &&
+                record.source == TRACE_SOURCE_SOFTWARE,
+                "Request direction and source");
+    TEST_ASSERT(record.type == type && record.tag == 7, "Request type (with class) and tag");
+    TEST_ASSERT(record.data_len == strlen(request) &&
+                memcmp(data, request, record.data_len) == 0,
+                "Request payload");
+    uint64_t sent = record.time_ns;
+
+    TEST_ASSERT(trace_read(&reader, &record, data, sizeof(data)) == TRACE_OK,
+                "Read reply record");
+    TEST_ASSERT(record.direction == TRACE_FROM_FIRMWARE && record.tag == 7 &&
+                record.data_len == sizeof(int),
+                "Reply direction, tag and length");
+    TEST_ASSERT(record.time_ns >= sent, "Timestamps are monotonic");
+    TEST_ASSERT(trace_read(&reader, &record, data, sizeof(data)) == TRACE_END,
+                "End of trace");
+    trace_reader_close(&reader);
+}
+
+static void test_second_writer(void) {
+    printf("\n--- Test: Second writer appends ---\n");
+
+    Trace_writer firmware;
+    TEST_ASSERT(trace_open(&firmware, trace_path, TRACE_SOURCE_FIRMWARE) == 0,
+                "Open existing trace");
+    unsigned char key = '5';
+    trace_record(&firmware, TRACE_FROM_FIRMWARE, PACKET_KEYPAD, 0, &key, 1);
+    trace_close(&firmware);
+
+    Trace_reader reader;
+    Trace_record record;
+    unsigned char data[COMM_MAX_DATA_LEN];
+    int count = 0;
+    int last_source = -1;
+    trace_reader_open(&reader, trace_path);
+    while (trace_read(&reader, &record, data, sizeof(data)) == TRACE_OK) {
+        count++;
+        last_source = record.source;
+    }
+    trace_reader_close(&reader);
+    TEST_ASSERT(count == 3, "Header written once, all three records present");
+    TEST_ASSERT(last_source == TRACE_SOURCE_FIRMWARE && data[0] == '5',
+                "Appended record is marked as Firmware");
+}
+
+static void test_bad_file(void) {
+    printf("\n--- Test: Reject non-trace files ---\n");
+
+    char bad_path[80];
+    snprintf(bad_path, sizeof(bad_path), "%s.bad", trace_path);
+    FILE* file = fopen(bad_path, "w");
+    fputs("not a trace file", file);
+    fclose(file);
+
+    Trace_reader reader;
+    TEST_ASSERT(trace_reader_open(&reader, bad_path) == -1, "Bad magic rejected");
+    TEST_ASSERT(trace_reader_open(&reader, "/nonexistent/trace") == -1,
+                "Missing file rejected");
+    unlink(bad_path);
+}
+
+static void test_disabled(void) {
+    printf("\n--- Test: Disabled writer ---\n");
+
+    unsetenv(HAMPOD_TRACE_ENV);
+    Trace_writer writer;
+    TEST_ASSERT(trace_open_from_env(&writer, TRACE_SOURCE_SOFTWARE) == -1,
+                "No HAMPOD_TRACE, no tracing");
+    TEST_ASSERT(!trace_enabled(&writer), "Writer reports disabled");
+    trace_record(&writer, TRACE_TO_FIRMWARE, PACKET_AUDIO, 1, "d", 1); // No-op
+    trace_close(&writer);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main() {
+    printf("=== Packet Trace Unit Tests ===\n");
+    printf("Testing the trace file format (no Firmware required)\n");
+
+    snprintf(trace_path, sizeof(trace_path), "/tmp/hampod_trace_test_%d", (int)getpid());
+    unlink(trace_path);
+
+    test_round_trip();
+    test_second_writer();
+    test_bad_file();
+    test_disabled();
+    unlink(trace_path);
+
+    printf("\n=== Summary ===\n");
+    printf("Passed: %d\n", tests_passed);
+    printf("Failed: %d\n", tests_failed);
+
+    if (tests_failed == 0) {
+        printf("\n✓ ALL TESTS PASSED\n");
+        return 0;
+    } else {
+        printf("\n✗ SOME TESTS FAILED\n");
+        return 1;
+    }
+}
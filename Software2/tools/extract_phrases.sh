@@ -0,0 +1,35 @@
+#!/bin/bash
+# =============================================================================
+# Extract the fixed phrases Software2 speaks
+# =============================================================================
+# Prints one phrase per line, sorted and without duplicates:
+# - every string literal passed to speech_say_text()
+# - every string returned by param_name(), mode_to_string() and vfo_name()
+# Format strings (anything with a %) are left out: they are only known at
+# run time.
+#
+# Usage: tools/extract_phrases.sh src/*.c > phrases.txt
+# Used by: make phrases
+# =============================================================================
+
+if [ $# -eq 0 ]; then
+    echo "Usage: $0 source.c..." >&2
+    exit 1
+fi
+
+{
+    # Literals inside speech_say_text( ... ), including both arms of a ?:
+    grep -h 'speech_say_text(' "$@" |
+        sed 's/.*speech_say_text(//' |
+        grep -o '"[^"]*"'
+
+    # Name tables: the return values of the lookup functions
+    awk '
+        /^static const char *\* *(param_name|mode_to_string|vfo_name) *\(/ { inside = 1 }
+        inside && /return *"/ {
+            match($0, /return *"[^"]*"/)
+            print substr($0, RSTART, RLENGTH)
+        }
+        inside && /^}/ { inside = 0 }
+    ' "$@" | grep -o '"[^"]*"'
+} | sed 's/^"//; s/"$//' | grep -v '%' | grep -v '^$' | LC_ALL=C sort -u
@@ -0,0 +1,340 @@
+/**
+ * phrase_bundle.c - Pre-synthesize Software2's fixed phrases
+ *
+ * Reads one phrase per line (tools/extract_phrases.sh), runs Piper on each
+ * and packs the PCM into a phrase bundle the Firmware maps at boot
+ * (hal_tts_cache_load_bundle()). Phrases in the bundle play with no
+ * inference at all.
+ *
+ * The number splicer's vocabulary (hal_tts_splice_vocabulary()) is added
+ * to the list, so frequencies and readings are spliced from the first boot.
+ *
+ * One Piper runs for the whole list, so the model is loaded once. As in the
+ * live engine (hal_tts_piper.c), a phrase ends when Piper logs its
+ * "Real-time factor" line: by then all of its audio is in the pipe.
+ *
+ * Usage: phrase_bundle phrases.txt model.onnx length_scale out.bin
+ * Used by: make phrases
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "hal/hal_tts_cache.h"
+#include "hal/hal_tts_splice.h"
+
+#define MAX_PHRASES 1024
+#define MAX_PHRASE_LENGTH 256
+
+// ============================================================================
+// Synthesis
+// ============================================================================
+
+// Piper's log line after the last sample of each line of text
+#define PIPER_END_MARKER "Real-time factor"
+
+// Longest Piper may go without writing anything before it is taken as hung
+#define PIPER_STALL_MS 30000
+
+static pid_t piper_pid = -1;
+static FILE *piper_in = NULL;
+static int piper_out = -1;
+static int piper_log = -1;
+static char log_line[1024];
+static size_t log_length = 0;
+
+/**
+ * Start Piper with the model loaded, reading one phrase per line.
+ *
+ * @return 0 on success, -1 on failure
+ */
+static int start_piper(const char *model, const char *length_scale) {
+    int to_piper[2], from_piper[2], log_pipe[2];
+    if (pipe(to_piper) != 0) {
+        return -1;
+    }
+    if (pipe(from_piper) != 0) {
+        close(to_piper[0]);
+        close(to_piper[1]);
+        return -1;
+    }
+    if (pipe(log_pipe) != 0) {
+        close(to_piper[0]);
+        close(to_piper[1]);
+        close(from_piper[0]);
+        close(from_piper[1]);
+        return -1;
+    }
+
+    piper_pid = fork();
+    if (piper_pid < 0) {
+        close(to_piper[0]);
+        close(to_piper[1]);
+        close(from_piper[0]);
+        close(from_piper[1]);
+        close(log_pipe[0]);
+        close(log_pipe[1]);
+        return -1;
+    }
+    if (piper_pid == 0) {
+        dup2(to_piper[0], STDIN_FILENO);
+        dup2(from_piper[1], STDOUT_FILENO);
+        dup2(log_pipe[1], STDERR_FILENO);
+        close(to_piper[0]);
+        close(to_piper[1]);
+        close(from_piper[0]);
+        close(from_piper[1]);
+        close(log_pipe[0]);
+        close(log_pipe[1]);
+        execlp("piper", "piper", "--model", model, "--length_scale",
+               length_scale, "--output_raw", NULL);
+        _exit(127);
+    }
+    close(to_piper[0]);
+    close(from_piper[1]);
+    close(log_pipe[1]);
+    piper_in = fdopen(to_piper[1], "w");
+    piper_out = from_piper[0];
+    piper_log = log_pipe[0];
+    return piper_in != NULL ? 0 : -1;
+}
+
+/**
+ * Close Piper's pipes and wait for it to exit.
+ *
+ * @return 0 if it exited cleanly
+ */
+static int stop_piper(void) {
+    int status = 0;
+    if (piper_in != NULL) {
+        fclose(piper_in);
+        piper_in = NULL;
+    }
+    // Closed before the wait, so a Piper still writing is not left blocked
+    if (piper_out >= 0) {
+        close(piper_out);
+        piper_out = -1;
+    }
+    if (piper_log >= 0) {
+        close(piper_log);
+        piper_log = -1;
+    }
+    if (piper_pid > 0) {
+        waitpid(piper_pid, &status, 0);
+        piper_pid = -1;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+/**
+ * Read what Piper has logged, passing errors and warnings on.
+ *
+ * @return End markers read, or -1 if Piper closed its log
+ */
+static int read_log(void) {
+    ssize_t got = read(piper_log, log_line + log_length,
+                       sizeof(log_line) - 1 - log_length);
+    if (got <= 0) {
+        return -1;
+    }
+    log_length += (size_t)got;
+    log_line[log_length] = '\0';
+
+    int finished = 0;
+    char *line = log_line;
+    char *newline;
+    while ((newline = strchr(line, '\n')) != NULL) {
+        *newline = '\0';
+        if (strstr(line, PIPER_END_MARKER) != NULL) {
+            finished++;
+        } else if (strstr(line, "[error]") != NULL ||
+                   strstr(line, "[warning]") != NULL) {
+            fprintf(stderr, "phrase_bundle: Piper: %s\n", line);
+        }
+        line = newline + 1;
+    }
+    size_t rest = log_length - (size_t)(line - log_line);
+    if (rest == sizeof(log_line) - 1) {
+        rest = 0; // No newline in a full buffer: drop the line
+    }
+    memmove(log_line, line, rest);
+    log_length = rest;
+    return finished;
+}
+
+/**
+ * Speak text through the running Piper and collect its raw 16 kHz output.
+ *
+ * @return Sample buffer (caller frees), or NULL on failure
+ */
+static int16_t *synthesize(const char *text, size_t *num_samples) {
+    // Same line the live engine sends (hal_tts_speak())
+    if (fprintf(piper_in, "%s\n", text) < 0 || fflush(piper_in) != 0) {
+        return NULL;
+    }
+
+    size_t capacity = 16000;
+    size_t bytes = 0;
+    char *pcm = malloc(capacity * sizeof(int16_t));
+    int finished = 0;
+    while (pcm != NULL) {
+        // Once the marker is in, only what is already in the pipe is left
+        struct pollfd fds[2] = {{piper_out, POLLIN, 0}, {piper_log, POLLIN, 0}};
+        int ready = poll(fds, finished ? 1 : 2, finished ? 0 : PIPER_STALL_MS);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ready == 0 && finished) {
+            break;
+        }
+        if (ready <= 0) {
+            fprintf(stderr, "phrase_bundle: Piper wrote nothing for %d ms\n",
+                    PIPER_STALL_MS);
+            free(pcm);
+            return NULL;
+        }
+        if (!finished && fds[1].revents != 0) {
+            int ended = read_log();
+            if (ended < 0) {
+                free(pcm);
+                return NULL;
+            }
+            finished = ended > 0;
+        }
+        if (fds[0].revents == 0) {
+            continue;
+        }
+        ssize_t got = read(piper_out, pcm + bytes,
+                           capacity * sizeof(int16_t) - bytes);
+        if (got <= 0) {
+            free(pcm);
+            return NULL;
+        }
+        bytes += (size_t)got;
+        if (bytes == capacity * sizeof(int16_t)) {
+            capacity *= 2;
+            char *grown = realloc(pcm, capacity * sizeof(int16_t));
+            if (grown == NULL) {
+                free(pcm);
+            }
+            pcm = grown;
+        }
+    }
+
+    if (pcm == NULL || bytes < sizeof(int16_t)) {
+        free(pcm);
+        return NULL;
+    }
+    *num_samples = bytes / sizeof(int16_t);
+    return (int16_t *)pcm;
+}
+
+// ============================================================================
+// Phrase List
+// ============================================================================
+
+static char *texts[MAX_PHRASES];
+static int16_t *samples[MAX_PHRASES];
+static size_t num_samples[MAX_PHRASES];
+static size_t count = 0;
+static size_t total = 0;
+
+/**
+ * Synthesize a phrase and add it, unless it is already in the list.
+ *
+ * @return 0 on success, -1 if Piper failed or the list is full
+ */
+static int add_phrase(const char *text) {
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(texts[i], text) == 0) {
+            return 0;
+        }
+    }
+    if (count == MAX_PHRASES) {
+        fprintf(stderr, "phrase_bundle: more than %d phrases\n", MAX_PHRASES);
+        return -1;
+    }
+    samples[count] = synthesize(text, &num_samples[count]);
+    if (samples[count] == NULL) {
+        fprintf(stderr, "phrase_bundle: Piper failed on \"%s\"\n", text);
+        return -1;
+    }
+    texts[count] = strdup(text);
+    total += num_samples[count];
+    printf("  %5.2fs  %s\n", num_samples[count] / 16000.0, text);
+    count++;
+    return 0;
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main(int argc, char *argv[]) {
+    if (argc != 5) {
+        fprintf(stderr,
+                "Usage: %s phrases.txt model.onnx length_scale out.bin\n",
+                argv[0]);
+        return 1;
+    }
+    const char *model = argv[2];
+    const char *length_scale = argv[3];
+
+    FILE *list = fopen(argv[1], "r");
+    if (list == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN); // A dead Piper fails the write instead
+    if (start_piper(model, length_scale) != 0) {
+        fprintf(stderr, "phrase_bundle: cannot start Piper\n");
+        fclose(list);
+        return 1;
+    }
+
+    int failed = 0;
+    char line[MAX_PHRASE_LENGTH];
+    while (!failed && fgets(line, sizeof(line), list) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] != '\0') {
+            failed = add_phrase(line) != 0;
+        }
+    }
+    fclose(list);
+
+    // Word clips for spliced numbers and frequencies
+    size_t words = 0;
+    const char *const *vocabulary = hal_tts_splice_vocabulary(&words);
+    for (size_t i = 0; i < words && !failed; i++) {
+        failed = add_phrase(vocabulary[i]) != 0;
+    }
+    if (stop_piper() != 0 && !failed) {
+        fprintf(stderr, "phrase_bundle: Piper exited with an error\n");
+        failed = 1;
+    }
+
+    if (!failed &&
+        hal_tts_cache_write_bundle(argv[4], model, (float)atof(length_scale),
+                                   (const char *const *)texts,
+                                   (const int16_t *const *)samples,
+                                   num_samples, count) != 0) {
+        fprintf(stderr, "phrase_bundle: cannot write %s\n", argv[4]);
+        failed = 1;
+    }
+    if (!failed) {
+        printf("Wrote %zu phrases (%.1f s of speech, %zu KB) to %s\n", count,
+               total / 16000.0, total * sizeof(int16_t) / 1024, argv[4]);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        free(texts[i]);
+        free(samples[i]);
+    }
+    return failed ? 1 : 0;
+}